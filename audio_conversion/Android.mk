@@ -1,6 +1,6 @@
 #
 #
-# Copyright (C) Intel 2013-2017
+# Copyright (C) Intel 2013-2018
 #
 # Licensed under the Apache License, Version 2.0 (the "License");
 # you may not use this file except in compliance with the License.
@@ -32,7 +32,8 @@ component_src_files :=  \
     src/AudioConverter.cpp \
     src/AudioReformatter.cpp \
     src/AudioRemapper.cpp \
-    src/AudioResampler.cpp
+    src/AudioResampler.cpp \
+    src/PolyphaseResampler.cpp
 
 component_includes_common := \
     $(component_export_include_dir) \
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -17,9 +17,11 @@
 #pragma once
 
 #include <SampleSpec.hpp>
+#include <RateRatio.hpp>
 #include <media/AudioBufferProvider.h>
 #include <AudioNonCopyable.hpp>
 #include <list>
+#include <vector>
 
 namespace intel_audio
 {
@@ -44,15 +46,14 @@ public:
      * Configures the conversion chain.
      *
      * It configures the conversion chain that may be used to convert samples from the source
-     * to destination sample specification. This configuration tries to order the list
-     * of converters so that it minimizes the number of samples on which the resampling is done.
-     * To optimize the convertion and make the processing as light as possible, the
-     * order of converter is important.
+     * to destination sample specification. To make the processing as light as possible, the
+     * order of the converters, i.e. the remapper (working on the number of channels), the
+     * reformatter (working on the format of the samples) and the resampler (working on the
+     * sample rate), is the cheapest one according to a cost model (see planConversion).
      *
-     * This function will call the recursive function configureAndAddConverter starting
-     * from the remapper operation (i.e. the converter working on the number of channels),
-     * then the reformatter operation (i.e. converter changing the format of the samples),
-     * and finally the resampler (i.e. converter changing the sample rate).
+     * Chains configured for the latest pairs of source and destination sample specifications
+     * are kept with their converters, so that switching back to a previous pair (for example
+     * upon rerouting from headset to speaker) only resets the state of the converters.
      *
      * @param[in] ssSrc source sample specifications.
      * @param[in] ssDst destination sample specifications.
@@ -105,7 +106,118 @@ public:
                                          const size_t outFrames,
                                          android::AudioBufferProvider *bufferProvider);
 
+    /**
+     * @return sample spec items converted by the chain configured, in order of conversion.
+     */
+    const std::vector<SampleSpecItem> &getPlan() const { return mPlan; }
+
+    /**
+     * @return estimated cost of the chain configured, in nanoseconds of processing per second
+     *         of audio.
+     */
+    float getPlanCost() const { return mPlanCost; }
+
+    /**
+     * @param[in] sampleSpecItem sample spec item converted.
+     *
+     * @return name of the converter of the given item, as dumped in the plan.
+     */
+    static const char *getConverterName(SampleSpecItem sampleSpecItem);
+
+    /**
+     * @return converters of the chain configured, in order of conversion. A chain reused from
+     *         the cache keeps its converters.
+     */
+    const std::list<AudioConverter *> &getActiveConverters() const
+    {
+        return mActiveAudioConvList;
+    }
+
+    /** @return number of chains planned and configured, i.e. not reused from the cache. */
+    uint32_t getChainBuildCount() const { return mChainBuildCount; }
+
+    /**
+     * Dumps the conversion chain configured, with its estimated cost.
+     *
+     * @param[in] fd file descriptor to dump into.
+     * @param[in] spaces indentation of the dump.
+     *
+     * @return OK.
+     */
+    android::status_t dump(int fd, int spaces) const;
+
 private:
+    /**
+     * Conversion chain configured for a pair of source and destination sample specifications.
+     * Each chain owns its converters, hence keeps their configuration and allocated resources.
+     */
+    struct ConversionChain
+    {
+        SampleSpec ssSrc;
+        SampleSpec ssDst;
+        bool isValid; /**< The chain has been fully configured. */
+        AudioConverter *converters[NbSampleSpecItems];
+        std::list<AudioConverter *> activeList;
+        std::vector<SampleSpecItem> plan;
+        float planCost;
+    };
+
+    /**
+     * Plans the conversion from the source to the destination sample specifications.
+     *
+     * It enumerates the orders in which the sample spec items to convert may be converted,
+     * drops the orders going through a conversion that is not supported, and estimates the cost
+     * of the others from the samples output and the bytes touched by each converter.
+     * For example, converting 8 channels 16 bits to 2 channels 32 bits with a rate change is
+     * cheaper down-remapping first, then resampling 16 bits samples, and reformatting last.
+     *
+     * @param[in] ssSrc source sample specifications.
+     * @param[in] ssDst destination sample specifications.
+     * @param[out] plan cheapest order of the sample spec items to convert.
+     * @param[out] cost estimated cost of the plan, in nanoseconds per second of audio.
+     *
+     * @return OK if a plan is found, INVALID_OPERATION if no order is supported.
+     */
+    static android::status_t planConversion(const SampleSpec &ssSrc, const SampleSpec &ssDst,
+                                            std::vector<SampleSpecItem> &plan, float &cost);
+
+    /**
+     * Estimates the cost of converting one sample spec item, i.e. of one converter.
+     *
+     * @param[in] sampleSpecItem sample spec item to convert.
+     * @param[in] ssSrc source sample specifications of the converter.
+     * @param[in] ssDst destination sample specifications of the converter.
+     *
+     * @return cost in nanoseconds per second of audio, negative if not supported.
+     */
+    static float estimateConverterCost(SampleSpecItem sampleSpecItem, const SampleSpec &ssSrc,
+                                       const SampleSpec &ssDst);
+
+    /**
+     * @param[in] sampleSpecItem sample spec item to convert.
+     * @param[in] ssSrc source sample specifications.
+     * @param[in] ssDst destination sample specifications.
+     *
+     * @return source sample specifications with the given item converted to the destination.
+     */
+    static SampleSpec getConvertedSampleSpec(SampleSpecItem sampleSpecItem,
+                                             const SampleSpec &ssSrc,
+                                             const SampleSpec &ssDst);
+
+    /**
+     * Returns the valid chain cached for the given sample specifications, moving it to the
+     * front of the cache as the most recently used.
+     *
+     * @return chain if found, NULL otherwise.
+     */
+    ConversionChain *findCachedChain(const SampleSpec &ssSrc, const SampleSpec &ssDst);
+
+    /**
+     * Returns a chain to configure, either newly allocated or recycled from the least recently
+     * used one if the cache is full, moved to the front of the cache.
+     */
+    ConversionChain *allocateChain();
+
     /**
      * This function pushes the converter to the list.
      * and alters the source sample spec according to the sample spec reached
@@ -125,69 +237,18 @@ private:
      * next convertion that might have to be added.
      * ssSrc = temp dest = { a, b', c }.
      *
+     * @param[in:out] chain in which the converter is configured and added.
      * @param[in] sampleSpecItem sample spec item on which the converter is working.
      * @param[in:out] ssSrc source sample specifications.
      * @param[in] ssDst destination sample specifications.
      *
      * @return status OK, error code otherwise.
      */
-    android::status_t doConfigureAndAddConverter(SampleSpecItem sampleSpecItem,
+    android::status_t doConfigureAndAddConverter(ConversionChain &chain,
+                                                 SampleSpecItem sampleSpecItem,
                                                  SampleSpec *ssSrc,
                                                  const SampleSpec *ssDst);
 
-    /**
-     * Recursive function to add converters to the chain of convertion required.
-     *
-     * When a converter is added, the source sample specification is modified to represent the
-     * audio data sample specification AFTER applying this converter.
-     * This sample spec will be used as the source for next convertion.
-     * In order to minimize power consumption, resampling operation should be applied
-     * on the minimum frame size. So, down-remapping or down-formatting will be done in
-     * prior of resampling.
-     *
-     * Let's take an example:
-     * ssSrc = { a, b, c } and ssDst = { a', b', c' } where:
-     *              -a / a' are the channel numbers,
-     *              -b / b' are the number of bytes used in the audio format.
-     *              -c / c' are the rates,
-     * and with (a' > a) and (b' < b)
-     * As all sample spec items are different, we need to use 3 converter to reach the destination
-     * audio data sample specifications.
-     *
-     * First take into account a (number of channels):
-     *      As a' is higher than a, first performs the remapping:
-     *      ssSrc = { a, b, c } dst = { a', b', c' }
-     *      The temporary output becomes the new source for next converter
-     *      ssSrc = temporary Output = { a', b, c }
-     *
-     * Then, take into account b (format size).
-     *      As b' is lower than b, do not perform the reformating now...
-     *
-     * Finally, take into account the sample rate:
-     *      as they are different, use a resampler:
-     *      ssSrc = { a', b, c } dst = { a', b', c' }
-     *      The temporary output becomes the new source for next converter
-     *      ssSrc = temporary Output = { a', b, c' }
-     *
-     * No more converter: exit from last recursive call
-     * Taking into account b again...(format size)
-     *      as b' < b, use a reformatter
-     *      ssSrc = { a', b, c' } dst = { a', b', c' }
-     *      The temporary output becomes the new source for next converter
-     *      ssSrc = temporary Output = { a', b', c' }
-     *
-     * Exit from recursive call.
-     *
-     * @param[in] sampleSpecItem sample spec item on which the converter is working.
-     * @param[in:out] ssSrc source sample specifications.
-     * @param[in] ssDst destination sample specifications.
-     *
-     * @return status OK, error code otherwise.
-     */
-    android::status_t configureAndAddConverter(SampleSpecItem sampleSpecItem,
-                                               SampleSpec *ssSrc,
-                                               const SampleSpec *ssDst);
-
     /**
      * Reset the list of active converter.
      * This function must be called before reconfiguring the conversion chain.
@@ -200,10 +261,13 @@ private:
     std::list<AudioConverter *> mActiveAudioConvList;
 
     /**
-     * List of Audio Converter objects available.
-     * Each converter works on a dedicated sample spec item.
+     * Chains configured, from the most to the least recently used.
      */
-    AudioConverter *mAudioConverter[NbSampleSpecItems];
+    std::list<ConversionChain *> mChainCache;
+
+    std::vector<SampleSpecItem> mPlan; /**< Sample spec items converted by the chain. */
+    float mPlanCost; /**< Estimated cost of the chain, in nanoseconds per second of audio. */
+    uint32_t mChainBuildCount; /**< Chains planned and configured since creation. */
 
     /**
      * Source audio data sample specifications.
@@ -215,6 +279,11 @@ private:
      */
     SampleSpec mSsDst;
 
+    /**
+     * Frames conversion from destination to source rate, to request frames to the provider.
+     */
+    RateRatio mDstToSrcRatio;
+
     // Conversion is done into ConvOutBuffer
     size_t mConvOutBufferIndex; /**< Current position into the Converted buffer. */
     size_t mConvOutFrames; /**< Number of converted Frames. */
@@ -234,5 +303,11 @@ private:
      * Multiplication factor used to allocate a big enough conversion buffer.
      */
     static const uint32_t mAllocBufferMultFactor;
+
+    /**
+     * Number of conversion chains kept configured, i.e. of routes a stream may switch between
+     * without rebuilding its chain.
+     */
+    static const size_t mMaxCachedChains;
 };
 }  // namespace intel_audio
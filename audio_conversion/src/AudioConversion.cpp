@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -25,7 +25,11 @@
 #include <AudioCommsAssert.hpp>
 #include <utilities/Log.hpp>
 #include <media/AudioBufferProvider.h>
+#include <utils/String8.h>
+#include <algorithm>
+#include <string>
 #include <stdlib.h>
+#include <unistd.h>
 
 using audio_comms::utilities::Log;
 using namespace android;
@@ -40,24 +44,44 @@ const uint32_t AudioConversion::mMinRate = 8000;
 
 const uint32_t AudioConversion::mAllocBufferMultFactor = 2;
 
+const size_t AudioConversion::mMaxCachedChains = 4;
+
+/**
+ * Cost model of the converters, in nanoseconds per sample output by the kernel of the remapper,
+ * reformatter and resampler respectively (indexed by sample spec item), and per byte read or
+ * written. Only relative costs matter to plan the conversions. Default calibration, may be
+ * updated on a platform from the costs recorded by the converterCost unit test.
+ */
+static const float gConverterCostNsPerSample[NbSampleSpecItems] = {
+    0.6f, 0.4f, 12.0f
+};
+static const float gCostNsPerByte = 0.05f;
+
+static const char *const gConverterNames[NbSampleSpecItems] = {
+    "remap", "reformat", "resample"
+};
+
 AudioConversion::AudioConversion()
-    : mConvOutBufferIndex(0),
+    : mPlanCost(0),
+      mChainBuildCount(0),
+      mConvOutBufferIndex(0),
       mConvOutFrames(0),
       mConvOutBufferSizeInFrames(0),
       mConvOutBuffer(NULL)
 {
-    mAudioConverter[ChannelCountSampleSpecItem] = new AudioRemapper(ChannelCountSampleSpecItem);
-    mAudioConverter[FormatSampleSpecItem] = new AudioReformatter(FormatSampleSpecItem);
-    mAudioConverter[RateSampleSpecItem] = new AudioResampler(RateSampleSpecItem);
 }
 
 AudioConversion::~AudioConversion()
 {
-    for (int i = 0; i < NbSampleSpecItems; i++) {
+    for (ConversionChain *chain : mChainCache) {
+
+        for (int i = 0; i < NbSampleSpecItems; i++) {
 
-        delete mAudioConverter[i];
-        mAudioConverter[i] = NULL;
+            delete chain->converters[i];
+        }
+        delete chain;
     }
+    mChainCache.clear();
 
     free(mConvOutBuffer);
     mConvOutBuffer = NULL;
@@ -90,21 +114,41 @@ status_t AudioConversion::configure(const SampleSpec &ssSrc, const SampleSpec &s
 
     emptyConversionChain();
 
-    free(mConvOutBuffer);
-
-    mConvOutBuffer = NULL;
+    // Keep the conversion buffer, only its size in frames depends on the destination
+    size_t convOutBufferSize = mSsDst.convertFramesToBytes(mConvOutBufferSizeInFrames);
     mConvOutBufferIndex = 0;
     mConvOutFrames = 0;
-    mConvOutBufferSizeInFrames = 0;
+    mConvOutBufferSizeInFrames = ssDst.getFrameSize() != 0 ?
+                                 ssDst.convertBytesToFrames(convOutBufferSize) : 0;
 
     mSsSrc = ssSrc;
     mSsDst = ssDst;
+    mPlan.clear();
+    mPlanCost = 0;
+
+    if (ssSrc.getSampleRate() != 0 && ssDst.getSampleRate() != 0) {
+        mDstToSrcRatio = RateRatio(ssDst.getSampleRate(), ssSrc.getSampleRate());
+    }
 
     if (ssSrc == ssDst) {
         Log::Debug() << __FUNCTION__ << ": no convertion required";
         return ret;
     }
 
+    ConversionChain *chain = findCachedChain(ssSrc, ssDst);
+    if (chain != NULL) {
+
+        for (AudioConverter *converter : chain->activeList) {
+
+            converter->reset();
+        }
+        mActiveAudioConvList = chain->activeList;
+        mPlan = chain->plan;
+        mPlanCost = chain->planCost;
+        Log::Debug() << __FUNCTION__ << ": reusing cached conversion chain";
+        return ret;
+    }
+
     Log::Debug() << __FUNCTION__ << ": SOURCE rate=" << ssSrc.getSampleRate()
                  << " format=" << static_cast<int32_t>(ssSrc.getFormat())
                  << " channels=" << ssSrc.getChannelCount();
@@ -112,16 +156,198 @@ status_t AudioConversion::configure(const SampleSpec &ssSrc, const SampleSpec &s
                  << " format=" << static_cast<int32_t>(ssDst.getFormat())
                  << " channels=" << ssDst.getChannelCount();
 
-    SampleSpec tmpSsSrc = ssSrc;
-
-    // Start by adding the remapper, it will add consequently the reformatter and resampler
-    // This function may alter the source sample spec
-    ret = configureAndAddConverter(ChannelCountSampleSpecItem, &tmpSsSrc, &ssDst);
+    std::vector<SampleSpecItem> plan;
+    float planCost;
+    ret = planConversion(ssSrc, ssDst, plan, planCost);
     if (ret != NO_ERROR) {
 
+        Log::Error() << __FUNCTION__ << ": no supported conversion";
         return ret;
     }
-    return tmpSsSrc == ssDst ? OK : INVALID_OPERATION;
+
+    chain = allocateChain();
+    mChainBuildCount++;
+    chain->ssSrc = ssSrc;
+    chain->ssDst = ssDst;
+    chain->plan = plan;
+    chain->planCost = planCost;
+
+    // Each converter alters the source sample spec for the next one
+    SampleSpec tmpSsSrc = ssSrc;
+    for (SampleSpecItem sampleSpecItem : plan) {
+
+        ret = doConfigureAndAddConverter(*chain, sampleSpecItem, &tmpSsSrc, &ssDst);
+        if (ret != NO_ERROR) {
+
+            return ret;
+        }
+    }
+    if (tmpSsSrc != ssDst) {
+
+        return INVALID_OPERATION;
+    }
+    chain->isValid = true;
+    mActiveAudioConvList = chain->activeList;
+    mPlan = plan;
+    mPlanCost = planCost;
+    return OK;
+}
+
+SampleSpec AudioConversion::getConvertedSampleSpec(SampleSpecItem sampleSpecItem,
+                                                   const SampleSpec &ssSrc,
+                                                   const SampleSpec &ssDst)
+{
+    SampleSpec converted = ssSrc;
+    converted.setSampleSpecItem(sampleSpecItem, ssDst.getSampleSpecItem(sampleSpecItem));
+
+    if (sampleSpecItem == ChannelCountSampleSpecItem) {
+
+        // The channel mask tells the layout of the channels to the remapper
+        converted.setChannelMask(ssDst.getChannelMask(), true);
+        converted.setChannelCount(ssDst.getChannelCount());
+        converted.setChannelsPolicy(ssDst.getChannelsPolicy());
+    }
+    return converted;
+}
+
+float AudioConversion::estimateConverterCost(SampleSpecItem sampleSpecItem,
+                                             const SampleSpec &ssSrc,
+                                             const SampleSpec &ssDst)
+{
+    bool isSupported = false;
+    switch (sampleSpecItem) {
+    case ChannelCountSampleSpecItem:
+        isSupported = supportRemap(ssSrc.getChannelCount(), ssDst.getChannelCount());
+        break;
+    case FormatSampleSpecItem:
+        isSupported = supportReformat(ssSrc.getFormat(), ssDst.getFormat());
+        break;
+    case RateSampleSpecItem:
+        // The resampler works on 16 bits samples only
+        isSupported = ssSrc.getFormat() == AUDIO_FORMAT_PCM_16_BIT &&
+                      supportResample(ssSrc.getSampleRate(), ssDst.getSampleRate());
+        break;
+    default:
+        break;
+    }
+    if (!isSupported) {
+
+        return -1;
+    }
+    float samplesOut = static_cast<float>(ssDst.getSampleRate()) * ssDst.getChannelCount();
+    float bytesTouched = static_cast<float>(ssSrc.getSampleRate()) * ssSrc.getFrameSize() +
+                         static_cast<float>(ssDst.getSampleRate()) * ssDst.getFrameSize();
+    return gConverterCostNsPerSample[sampleSpecItem] * samplesOut +
+           gCostNsPerByte * bytesTouched;
+}
+
+status_t AudioConversion::planConversion(const SampleSpec &ssSrc, const SampleSpec &ssDst,
+                                         std::vector<SampleSpecItem> &plan, float &cost)
+{
+    // Sorted, so that all the orders are enumerated
+    std::vector<SampleSpecItem> order;
+    for (int i = 0; i < NbSampleSpecItems; i++) {
+
+        SampleSpecItem sampleSpecItem = static_cast<SampleSpecItem>(i);
+        if (!SampleSpec::isSampleSpecItemEqual(sampleSpecItem, ssSrc, ssDst)) {
+
+            order.push_back(sampleSpecItem);
+        }
+    }
+
+    bool isPlanned = false;
+    do {
+        SampleSpec tmpSsSrc = ssSrc;
+        float orderCost = 0;
+        bool isSupported = true;
+        for (SampleSpecItem sampleSpecItem : order) {
+
+            SampleSpec tmpSsDst = getConvertedSampleSpec(sampleSpecItem, tmpSsSrc, ssDst);
+            float converterCost = estimateConverterCost(sampleSpecItem, tmpSsSrc, tmpSsDst);
+            if (converterCost < 0) {
+
+                isSupported = false;
+                break;
+            }
+            orderCost += converterCost;
+            tmpSsSrc = tmpSsDst;
+        }
+        if (isSupported && (!isPlanned || orderCost < cost)) {
+
+            plan = order;
+            cost = orderCost;
+            isPlanned = true;
+        }
+    } while (std::next_permutation(order.begin(), order.end()));
+
+    return isPlanned ? OK : INVALID_OPERATION;
+}
+
+const char *AudioConversion::getConverterName(SampleSpecItem sampleSpecItem)
+{
+    return sampleSpecItem < NbSampleSpecItems ? gConverterNames[sampleSpecItem] : "unknown";
+}
+
+status_t AudioConversion::dump(int fd, int spaces) const
+{
+    const size_t SIZE = 256;
+    char buffer[SIZE];
+    android::String8 result;
+    std::string plan;
+    for (SampleSpecItem sampleSpecItem : mPlan) {
+
+        plan += (plan.empty() ? "" : " > ") + std::string(getConverterName(sampleSpecItem));
+    }
+    snprintf(buffer, SIZE, "%*s- conversion plan: %s\n", spaces, "",
+             plan.empty() ? "none" : plan.c_str());
+    result.append(buffer);
+    snprintf(buffer, SIZE, "%*s- conversion estimated cost: %.1f us per second\n", spaces, "",
+             mPlanCost / 1000);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "%*s- conversion chains built: %u\n", spaces, "", mChainBuildCount);
+    result.append(buffer);
+
+    write(fd, result.string(), result.size());
+    return OK;
+}
+
+AudioConversion::ConversionChain *AudioConversion::findCachedChain(const SampleSpec &ssSrc,
+                                                                   const SampleSpec &ssDst)
+{
+    for (auto it = mChainCache.begin(); it != mChainCache.end(); ++it) {
+
+        ConversionChain *chain = *it;
+        if (chain->isValid && chain->ssSrc == ssSrc && chain->ssDst == ssDst &&
+            chain->ssSrc.getChannelMask() == ssSrc.getChannelMask() &&
+            chain->ssDst.getChannelMask() == ssDst.getChannelMask()) {
+
+            mChainCache.splice(mChainCache.begin(), mChainCache, it);
+            return chain;
+        }
+    }
+    return NULL;
+}
+
+AudioConversion::ConversionChain *AudioConversion::allocateChain()
+{
+    ConversionChain *chain;
+    if (mChainCache.size() < mMaxCachedChains) {
+
+        chain = new ConversionChain;
+        chain->converters[ChannelCountSampleSpecItem] =
+            new AudioRemapper(ChannelCountSampleSpecItem);
+        chain->converters[FormatSampleSpecItem] = new AudioReformatter(FormatSampleSpecItem);
+        chain->converters[RateSampleSpecItem] = new AudioResampler(RateSampleSpecItem);
+        mChainCache.push_front(chain);
+    } else {
+
+        // Recycle the converters of the least recently used chain
+        mChainCache.splice(mChainCache.begin(), mChainCache, --mChainCache.end());
+        chain = mChainCache.front();
+    }
+    chain->isValid = false;
+    chain->activeList.clear();
+    return chain;
 }
 
 status_t AudioConversion::getConvertedBuffer(void *dst,
@@ -183,7 +409,7 @@ status_t AudioConversion::getConvertedBuffer(void *dst,
         // Calculate the frames we need to get from buffer provider
         // (Runs at ssSrc sample spec)
         // Note that is is rounded up.
-        buffer.frameCount = AudioUtils::convertSrcToDstInFrames(framesRequested, mSsDst, mSsSrc);
+        buffer.frameCount = mDstToSrcRatio.convert(framesRequested);
 
         //
         // Acquire next buffer from buffer provider
@@ -307,65 +533,21 @@ void AudioConversion::emptyConversionChain()
     mActiveAudioConvList.clear();
 }
 
-status_t AudioConversion::doConfigureAndAddConverter(SampleSpecItem sampleSpecItem,
+status_t AudioConversion::doConfigureAndAddConverter(ConversionChain &chain,
+                                                     SampleSpecItem sampleSpecItem,
                                                      SampleSpec *ssSrc,
                                                      const SampleSpec *ssDst)
 {
-    SampleSpec tmpSsDst = *ssSrc;
-    tmpSsDst.setSampleSpecItem(sampleSpecItem, ssDst->getSampleSpecItem(sampleSpecItem));
+    SampleSpec tmpSsDst = getConvertedSampleSpec(sampleSpecItem, *ssSrc, *ssDst);
 
-    if (sampleSpecItem == ChannelCountSampleSpecItem) {
-
-        tmpSsDst.setChannelsPolicy(ssDst->getChannelsPolicy());
-    }
-
-    status_t ret = mAudioConverter[sampleSpecItem]->configure(*ssSrc, tmpSsDst);
+    status_t ret = chain.converters[sampleSpecItem]->configure(*ssSrc, tmpSsDst);
     if (ret != NO_ERROR) {
 
         return ret;
     }
-    mActiveAudioConvList.push_back(mAudioConverter[sampleSpecItem]);
+    chain.activeList.push_back(chain.converters[sampleSpecItem]);
     *ssSrc = tmpSsDst;
 
     return NO_ERROR;
 }
-
-status_t AudioConversion::configureAndAddConverter(SampleSpecItem sampleSpecItem,
-                                                   SampleSpec *ssSrc,
-                                                   const SampleSpec *ssDst)
-{
-    if (sampleSpecItem >= NbSampleSpecItems) {
-        Log::Error() << __FUNCTION__ << ": Sample Spec item out of range";
-        return INVALID_OPERATION;
-    }
-    // If the input format size is higher, first perform the reformat
-    // then add the resampler
-    // and perform the reformat (if not already done)
-    if (ssSrc->getSampleSpecItem(sampleSpecItem) > ssDst->getSampleSpecItem(sampleSpecItem)) {
-
-        status_t ret = doConfigureAndAddConverter(sampleSpecItem, ssSrc, ssDst);
-        if (ret != NO_ERROR) {
-
-            return ret;
-        }
-    }
-
-    if ((sampleSpecItem + 1) < NbSampleSpecItems) {
-        // Dive
-        status_t ret = configureAndAddConverter((SampleSpecItem)(sampleSpecItem + 1), ssSrc,
-                                                ssDst);
-        if (ret != NO_ERROR) {
-
-            return ret;
-        }
-    }
-
-    // Handle the case of destination sample spec item is higher than input sample spec
-    // or destination and source channels policy are different
-    if (!SampleSpec::isSampleSpecItemEqual(sampleSpecItem, *ssSrc, *ssDst)) {
-
-        return doConfigureAndAddConverter(sampleSpecItem, ssSrc, ssDst);
-    }
-    return NO_ERROR;
-}
 }  // namespace intel_audio
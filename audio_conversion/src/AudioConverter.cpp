@@ -18,7 +18,6 @@
 #define LOG_TAG "AudioConverter"
 
 #include "AudioConverter.hpp"
-#include "AudioUtils.hpp"
 #include <utilities/Log.hpp>
 #include <stdlib.h>
 
@@ -90,6 +89,11 @@ status_t AudioConverter::configure(const SampleSpec &ssSrc, const SampleSpec &ss
     mSsSrc = ssSrc;
     mSsDst = ssDst;
 
+    if (ssSrc.getSampleRate() != 0 && ssDst.getSampleRate() != 0) {
+        mSrcToDstRatio = RateRatio(ssSrc.getSampleRate(), ssDst.getSampleRate());
+        mDstToSrcRatio = RateRatio(ssDst.getSampleRate(), ssSrc.getSampleRate());
+    }
+
     for (int i = 0; i < NbSampleSpecItems; i++) {
 
         if (i == mSampleSpecItem) {
@@ -148,11 +152,11 @@ status_t AudioConverter::convert(const void *src,
 
 size_t AudioConverter::convertSrcToDstInFrames(ssize_t frames) const
 {
-    return AudioUtils::convertSrcToDstInFrames(frames, mSsSrc, mSsDst);
+    return mSrcToDstRatio.convert(frames);
 }
 
 size_t AudioConverter::convertSrcFromDstInFrames(ssize_t frames) const
 {
-    return AudioUtils::convertSrcToDstInFrames(frames, mSsDst, mSsSrc);
+    return mDstToSrcRatio.convert(frames);
 }
 }  // namespace intel_audio
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <SampleSpec.hpp>
+#include <RateRatio.hpp>
 #include <AudioNonCopyable.hpp>
 #include <utils/Errors.h>
 
@@ -88,6 +89,12 @@ public:
                                       size_t inFrames,
                                       size_t *outFrames);
 
+    /**
+     * Resets the state kept by the converter from previous conversions, if any, keeping its
+     * configuration. Called when reusing a configured converter for a new audio stream.
+     */
+    virtual void reset() {}
+
 protected:
     /**
      * Converts the number of frames in the destination sample spec in a number of frames in the
@@ -122,6 +129,9 @@ protected:
     SampleSpec mSsDst;
 
 private:
+    RateRatio mSrcToDstRatio; /**< Frames conversion from source to destination rate. */
+    RateRatio mDstToSrcRatio; /**< Frames conversion from destination to source rate. */
+
     /**
      * Returns a suitable output buffer.
      *
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -19,6 +19,8 @@
 
 #include "AudioRemapper.hpp"
 #include <utilities/Log.hpp>
+#include <algorithm>
+#include <math.h>
 
 using namespace android;
 using audio_comms::utilities::Log;
@@ -52,12 +54,238 @@ const std::vector < std::pair < uint32_t, uint32_t >> AudioRemapper::mSupportedC
     { multichan8, stereo }
 };
 
+/** Speaker positions, in the order of the channels within a frame. */
+enum Speaker
+{
+    SpeakerFrontLeft = 0,
+    SpeakerFrontRight,
+    SpeakerFrontCenter,
+    SpeakerLowFrequency,
+    SpeakerBackLeft,
+    SpeakerBackRight,
+    SpeakerSideLeft,
+    SpeakerSideRight,
+    SpeakerBackCenter,
+
+    NbSpeakers
+};
+
+/**
+ * Speaker positions of the channels, per number of channels, following the canonical channel
+ * masks (mono, stereo, 3.0, quad, 5.0, 5.1, 6.1, 7.1). Sample specifications do not tell whether
+ * their positional mask is an input or output one, so only the number of channels is relied on.
+ */
+static const std::vector<std::vector<Speaker> > gSpeakerLayouts = {
+    {},
+    { SpeakerFrontCenter },
+    { SpeakerFrontLeft, SpeakerFrontRight },
+    { SpeakerFrontLeft, SpeakerFrontRight, SpeakerFrontCenter },
+    { SpeakerFrontLeft, SpeakerFrontRight, SpeakerBackLeft, SpeakerBackRight },
+    { SpeakerFrontLeft, SpeakerFrontRight, SpeakerFrontCenter, SpeakerBackLeft, SpeakerBackRight },
+    { SpeakerFrontLeft, SpeakerFrontRight, SpeakerFrontCenter, SpeakerLowFrequency,
+      SpeakerBackLeft, SpeakerBackRight },
+    { SpeakerFrontLeft, SpeakerFrontRight, SpeakerFrontCenter, SpeakerLowFrequency,
+      SpeakerBackLeft, SpeakerBackRight, SpeakerBackCenter },
+    { SpeakerFrontLeft, SpeakerFrontRight, SpeakerFrontCenter, SpeakerLowFrequency,
+      SpeakerBackLeft, SpeakerBackRight, SpeakerSideLeft, SpeakerSideRight }
+};
+
+/** ITU-R BS.775 gain of a channel folded into two speakers (-3dB). */
+static const float gMinus3dB = static_cast<float>(M_SQRT1_2);
+
+/** Fractional bits of the mixing matrix coefficients. */
+static const uint32_t gMatrixFractionalBits = 15;
+
+/** Range of 24 bits samples held in 32 bits containers. */
+static const int64_t gMin824 = -(1 << 23);
+static const int64_t gMax824 = (1 << 23) - 1;
+
+/**
+ * Mixing matrix of floating point coefficients under construction, one row of source channels
+ * coefficients per destination channel.
+ */
+class MixingMatrix
+{
+public:
+    MixingMatrix(const std::vector<Speaker> &dstLayout, size_t srcChannels)
+        : mDstLayout(dstLayout), mSrcChannels(srcChannels),
+          mCoefficients(dstLayout.size() * srcChannels, 0.f)
+    {
+    }
+
+    float &at(size_t dstChannel, size_t srcChannel)
+    {
+        return mCoefficients[dstChannel * mSrcChannels + srcChannel];
+    }
+
+    /**
+     * Mixes a source channel into the destination channel at the given speaker position.
+     *
+     * @return false if the destination has no such speaker.
+     */
+    bool mix(size_t srcChannel, Speaker speaker, float gain)
+    {
+        auto it = std::find(mDstLayout.begin(), mDstLayout.end(), speaker);
+        if (it == mDstLayout.end()) {
+            return false;
+        }
+        at(it - mDstLayout.begin(), srcChannel) += gain;
+        return true;
+    }
+
+    /** Mixes a source channel into a pair of destination speakers, if both are present. */
+    bool mix(size_t srcChannel, Speaker left, Speaker right, float gain)
+    {
+        if (!hasSpeaker(left) || !hasSpeaker(right)) {
+            return false;
+        }
+        return mix(srcChannel, left, gain) && mix(srcChannel, right, gain);
+    }
+
+    bool hasSpeaker(Speaker speaker) const
+    {
+        return std::find(mDstLayout.begin(), mDstLayout.end(), speaker) != mDstLayout.end();
+    }
+
+    bool isRowEmpty(size_t dstChannel) const
+    {
+        for (size_t srcChannel = 0; srcChannel < mSrcChannels; srcChannel++) {
+            if (mCoefficients[dstChannel * mSrcChannels + srcChannel] != 0.f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** Scales down the coefficients of each destination channel whose sum exceeds unity. */
+    void normalize()
+    {
+        for (size_t dstChannel = 0; dstChannel < mDstLayout.size(); dstChannel++) {
+            float sum = 0.f;
+            for (size_t srcChannel = 0; srcChannel < mSrcChannels; srcChannel++) {
+                sum += fabsf(at(dstChannel, srcChannel));
+            }
+            for (size_t srcChannel = 0; sum > 1.f && srcChannel < mSrcChannels; srcChannel++) {
+                at(dstChannel, srcChannel) /= sum;
+            }
+        }
+    }
+
+    /** @return coefficients converted in fixed point. */
+    std::vector<int32_t> toFixedPoint() const
+    {
+        std::vector<int32_t> matrix;
+        for (float coefficient : mCoefficients) {
+            matrix.push_back(static_cast<int32_t>(lroundf(coefficient *
+                                                          (1 << gMatrixFractionalBits))));
+        }
+        return matrix;
+    }
+
+private:
+    const std::vector<Speaker> &mDstLayout;
+    size_t mSrcChannels;
+    std::vector<float> mCoefficients;
+};
+
+/**
+ * Downmixes a source channel whose speaker is missing in the destination, following
+ * ITU-R BS.775: center folded into front left and right, surround folded into the other
+ * surround speakers if any, into the front otherwise. Low frequency is dropped.
+ */
+static void foldSpeaker(MixingMatrix &matrix, size_t srcChannel, Speaker speaker)
+{
+    switch (speaker) {
+    case SpeakerFrontCenter:
+        matrix.mix(srcChannel, SpeakerFrontLeft, SpeakerFrontRight, gMinus3dB);
+        break;
+    case SpeakerFrontLeft:
+    case SpeakerFrontRight:
+        matrix.mix(srcChannel, SpeakerFrontCenter, 1.f);
+        break;
+    case SpeakerBackLeft:
+        matrix.mix(srcChannel, SpeakerSideLeft, 1.f) ||
+        matrix.mix(srcChannel, SpeakerFrontLeft, gMinus3dB) ||
+        matrix.mix(srcChannel, SpeakerFrontCenter, gMinus3dB);
+        break;
+    case SpeakerBackRight:
+        matrix.mix(srcChannel, SpeakerSideRight, 1.f) ||
+        matrix.mix(srcChannel, SpeakerFrontRight, gMinus3dB) ||
+        matrix.mix(srcChannel, SpeakerFrontCenter, gMinus3dB);
+        break;
+    case SpeakerSideLeft:
+        matrix.mix(srcChannel, SpeakerBackLeft, 1.f) ||
+        matrix.mix(srcChannel, SpeakerFrontLeft, gMinus3dB) ||
+        matrix.mix(srcChannel, SpeakerFrontCenter, gMinus3dB);
+        break;
+    case SpeakerSideRight:
+        matrix.mix(srcChannel, SpeakerBackRight, 1.f) ||
+        matrix.mix(srcChannel, SpeakerFrontRight, gMinus3dB) ||
+        matrix.mix(srcChannel, SpeakerFrontCenter, gMinus3dB);
+        break;
+    case SpeakerBackCenter:
+        matrix.mix(srcChannel, SpeakerBackLeft, SpeakerBackRight, gMinus3dB) ||
+        matrix.mix(srcChannel, SpeakerSideLeft, SpeakerSideRight, gMinus3dB) ||
+        matrix.mix(srcChannel, SpeakerFrontLeft, SpeakerFrontRight, 0.5f) ||
+        matrix.mix(srcChannel, SpeakerFrontCenter, gMinus3dB);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Upmixes the surround speakers of the destination fed by no source channel by copying the
+ * front left and right channels of the source, as done by the stereo to quad remap.
+ * Center and low frequency are left silent.
+ */
+static void upmixSurround(MixingMatrix &matrix, const std::vector<Speaker> &srcLayout,
+                          const std::vector<Speaker> &dstLayout)
+{
+    auto srcLeft = std::find(srcLayout.begin(), srcLayout.end(), SpeakerFrontLeft);
+    auto srcRight = std::find(srcLayout.begin(), srcLayout.end(), SpeakerFrontRight);
+    if (srcLeft == srcLayout.end() || srcRight == srcLayout.end()) {
+        return;
+    }
+    size_t left = srcLeft - srcLayout.begin();
+    size_t right = srcRight - srcLayout.begin();
+    for (size_t dstChannel = 0; dstChannel < dstLayout.size(); dstChannel++) {
+        if (!matrix.isRowEmpty(dstChannel)) {
+            continue;
+        }
+        switch (dstLayout[dstChannel]) {
+        case SpeakerBackLeft:
+        case SpeakerSideLeft:
+            matrix.at(dstChannel, left) = 1.f;
+            break;
+        case SpeakerBackRight:
+        case SpeakerSideRight:
+            matrix.at(dstChannel, right) = 1.f;
+            break;
+        case SpeakerBackCenter:
+            matrix.at(dstChannel, left) = 0.5f;
+            matrix.at(dstChannel, right) = 0.5f;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static bool isIndexMask(audio_channel_mask_t channelMask)
+{
+    return audio_channel_mask_get_representation(channelMask) ==
+           AUDIO_CHANNEL_REPRESENTATION_INDEX;
+}
+
 AudioRemapper::AudioRemapper(SampleSpecItem sampleSpecItem)
-    : AudioConverter(sampleSpecItem)
+    : AudioConverter(sampleSpecItem),
+      mSampleMin(0),
+      mSampleMax(0)
 {
 }
 
-bool AudioRemapper::supportRemap(uint32_t srcChannels, uint32_t dstChannels)
+bool AudioRemapper::hasDedicatedRemap(uint32_t srcChannels, uint32_t dstChannels)
 {
     for (auto &candidate : mSupportedConversions) {
         if (candidate.first == srcChannels && dstChannels == candidate.second) {
@@ -67,12 +295,23 @@ bool AudioRemapper::supportRemap(uint32_t srcChannels, uint32_t dstChannels)
     return false;
 }
 
+bool AudioRemapper::supportRemap(uint32_t srcChannels, uint32_t dstChannels)
+{
+    return hasDedicatedRemap(srcChannels, dstChannels) ||
+           (srcChannels != 0 && srcChannels <= mMaxMatrixChannels &&
+            dstChannels != 0 && dstChannels <= mMaxMatrixChannels);
+}
+
 status_t AudioRemapper::configure(const SampleSpec &ssSrc, const SampleSpec &ssDst)
 {
     status_t ret = AudioConverter::configure(ssSrc, ssDst);
     if (ret != NO_ERROR) {
         return ret;
     }
+    if (!hasDedicatedRemap(ssSrc.getChannelCount(), ssDst.getChannelCount()) ||
+        isIndexMask(ssSrc.getChannelMask()) || isIndexMask(ssDst.getChannelMask())) {
+        return configureMatrix();
+    }
     switch (ssSrc.getFormat()) {
     case AUDIO_FORMAT_PCM_16_BIT:
         return configure<int16_t>();
@@ -91,7 +330,7 @@ android::status_t AudioRemapper::configure()
 {
     formatSupported<type>();
 
-    if (not supportRemap(mSsSrc.getChannelCount(), mSsDst.getChannelCount())) {
+    if (not hasDedicatedRemap(mSsSrc.getChannelCount(), mSsDst.getChannelCount())) {
         Log::Error() << __FUNCTION__ << ": remapper not available";
         return INVALID_OPERATION;
     }
@@ -156,6 +395,112 @@ android::status_t AudioRemapper::configure()
     return INVALID_OPERATION;
 }
 
+status_t AudioRemapper::configureMatrix()
+{
+    uint32_t srcChannels = mSsSrc.getChannelCount();
+    uint32_t dstChannels = mSsDst.getChannelCount();
+    if (not supportRemap(srcChannels, dstChannels)) {
+        Log::Error() << __FUNCTION__ << ": remapper not available";
+        return INVALID_OPERATION;
+    }
+
+    const std::vector<Speaker> &srcLayout = gSpeakerLayouts[srcChannels];
+    const std::vector<Speaker> &dstLayout = gSpeakerLayouts[dstChannels];
+    MixingMatrix matrix(dstLayout, srcChannels);
+
+    if (isIndexMask(mSsSrc.getChannelMask()) || isIndexMask(mSsDst.getChannelMask())) {
+        // Channels without position: channel to channel, others dropped or silent
+        for (uint32_t channel = 0; channel < std::min(srcChannels, dstChannels); channel++) {
+            matrix.at(channel, channel) = 1.f;
+        }
+    } else {
+        for (uint32_t srcChannel = 0; srcChannel < srcChannels; srcChannel++) {
+            if (!matrix.mix(srcChannel, srcLayout[srcChannel], 1.f)) {
+                foldSpeaker(matrix, srcChannel, srcLayout[srcChannel]);
+            }
+        }
+        upmixSurround(matrix, srcLayout, dstLayout);
+    }
+
+    // Apply the channels policy
+    uint32_t validSrcChannels = 0;
+    for (uint32_t srcChannel = 0; srcChannel < srcChannels; srcChannel++) {
+        if (mSsSrc.getChannelsPolicy(srcChannel) == SampleSpec::Ignore) {
+            for (uint32_t dstChannel = 0; dstChannel < dstChannels; dstChannel++) {
+                matrix.at(dstChannel, srcChannel) = 0.f;
+            }
+        } else {
+            validSrcChannels++;
+        }
+    }
+    for (uint32_t dstChannel = 0; dstChannel < dstChannels; dstChannel++) {
+        SampleSpec::ChannelsPolicy policy = mSsDst.getChannelsPolicy(dstChannel);
+        for (uint32_t srcChannel = 0; srcChannel < srcChannels; srcChannel++) {
+            if (policy == SampleSpec::Ignore) {
+                matrix.at(dstChannel, srcChannel) = 0.f;
+            } else if (policy == SampleSpec::Average &&
+                       mSsSrc.getChannelsPolicy(srcChannel) != SampleSpec::Ignore) {
+                matrix.at(dstChannel, srcChannel) = 1.f / validSrcChannels;
+            }
+        }
+    }
+    matrix.normalize();
+    mMatrix = matrix.toFixedPoint();
+
+    switch (mSsSrc.getFormat()) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+        mSampleMin = INT16_MIN;
+        mSampleMax = INT16_MAX;
+        mConvertSamplesFct = static_cast<SampleConverter>(&AudioRemapper::convertMatrix<int16_t>);
+        return OK;
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        mSampleMin = gMin824;
+        mSampleMax = gMax824;
+        mConvertSamplesFct = static_cast<SampleConverter>(&AudioRemapper::convertMatrix<int32_t>);
+        return OK;
+    case AUDIO_FORMAT_PCM_32_BIT:
+        mSampleMin = INT32_MIN;
+        mSampleMax = INT32_MAX;
+        mConvertSamplesFct = static_cast<SampleConverter>(&AudioRemapper::convertMatrix<int32_t>);
+        return OK;
+    default:
+        return INVALID_OPERATION;
+    }
+}
+
+template <typename type>
+status_t AudioRemapper::convertMatrix(const void *src, void *dst, const size_t inFrames,
+                                      size_t *outFrames)
+{
+    formatSupported<type>();
+
+    const type *srcTyped = static_cast<const type *>(src);
+    type *dstTyped = static_cast<type *>(dst);
+    const size_t srcChannels = mSsSrc.getChannelCount();
+    const size_t dstChannels = mSsDst.getChannelCount();
+    const int32_t *matrix = mMatrix.data();
+    const int64_t rounding = 1 << (gMatrixFractionalBits - 1);
+
+    for (size_t frames = 0; frames < inFrames; frames++) {
+        const type *srcFrame = &srcTyped[srcChannels * frames];
+        type *dstFrame = &dstTyped[dstChannels * frames];
+
+        for (size_t dstChannel = 0; dstChannel < dstChannels; dstChannel++) {
+            const int32_t *coefficients = &matrix[dstChannel * srcChannels];
+            int64_t sum = rounding;
+            for (size_t srcChannel = 0; srcChannel < srcChannels; srcChannel++) {
+                sum += static_cast<int64_t>(srcFrame[srcChannel]) * coefficients[srcChannel];
+            }
+            sum >>= gMatrixFractionalBits;
+            dstFrame[dstChannel] = static_cast<type>(std::min(std::max(sum, mSampleMin),
+                                                              mSampleMax));
+        }
+    }
+    // Transformation is "iso" frames
+    *outFrames = inFrames;
+    return NO_ERROR;
+}
+
 template <typename type>
 status_t AudioRemapper::convertMultiNToMultiM(const void *src, void *dst, const size_t inFrames,
                                               size_t *outFrames)
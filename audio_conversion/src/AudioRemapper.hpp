@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -37,6 +37,9 @@ private:
     };
     static const std::vector<std::pair<uint32_t, uint32_t> > mSupportedConversions;
 
+    /** Largest number of channels remapped through a mixing matrix. */
+    static const uint32_t mMaxMatrixChannels = 8;
+
 public:
     /**
      * Constructor of the remapper.
@@ -49,6 +52,12 @@ public:
     static bool supportRemap(uint32_t srcChannels, uint32_t dstChannels);
 
 private:
+    /**
+     * @return true if a dedicated remap operation exists for the given numbers of channels,
+     *         false if the remap goes through the mixing matrix.
+     */
+    static bool hasDedicatedRemap(uint32_t srcChannels, uint32_t dstChannels);
+
     /**
      * Configures the remapper.
      *
@@ -75,6 +84,38 @@ private:
     template <typename type>
     android::status_t configure();
 
+    /**
+     * Configures the remap through a mixing matrix.
+     *
+     * Builds the mixing coefficients from the layouts of the source and destination channels,
+     * i.e. channel to channel for channel index masks, or standard ITU downmix / upmix
+     * coefficients between speaker positions otherwise. Channels policy are taken into account.
+     * Coefficients of a destination channel are normalized so that its mix cannot clip.
+     *
+     * @return error code.
+     */
+    android::status_t configureMatrix();
+
+    /**
+     * Remaps from N-channels to M-channels in typed format through the mixing matrix.
+     *
+     * Each destination sample is the sum of the source samples of the frame weighted by
+     * fixed point coefficients, saturated to the range of the format. The loops have no branch
+     * so that they can be vectorized by the compiler.
+     *
+     * @tparam type Audio data format from S16 to S32.
+     * @param[in] src the source buffer.
+     * @param[out] dst the destination buffer, the caller must ensure the destination
+     *             is large enough.
+     * @param[in] inFrames number of input frames.
+     * @param[out] outFrames output frames processed.
+     *
+     * @return error code.
+     */
+    template <typename type>
+    android::status_t convertMatrix(const void *src, void *dst, const size_t inFrames,
+                                    size_t *outFrames);
+
     /**
      * Remap simply from M-channels to N-channels in typed format.
      *
@@ -163,5 +204,13 @@ private:
      */
     template <typename T>
     struct formatSupported;
+
+    /**
+     * Mixing matrix in Q15 fixed point, one row of source channels coefficients per destination
+     * channel.
+     */
+    std::vector<int32_t> mMatrix;
+    int64_t mSampleMin; /**< Lowest valid sample value of the format remapped by the matrix. */
+    int64_t mSampleMax; /**< Highest valid sample value of the format remapped by the matrix. */
 };
 }  // namespace intel_audio
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2015 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -30,7 +30,8 @@ namespace intel_audio
 
 AudioResampler::AudioResampler(SampleSpecItem sampleSpecItem)
     : AudioConverter(sampleSpecItem),
-      mResampler(NULL)
+      mResampler(NULL),
+      mUsePolyphaseResampler(false)
 {
 }
 
@@ -46,8 +47,9 @@ status_t AudioResampler::configure(const SampleSpec &ssSrc, const SampleSpec &ss
 {
     if ((ssSrc.getSampleRate() == mSsSrc.getSampleRate()) &&
         (ssDst.getSampleRate() == mSsDst.getSampleRate()) &&
-        (mResampler != NULL)) {
-        mResampler->reset(mResampler);
+        (ssSrc.getChannelCount() == mSsSrc.getChannelCount()) &&
+        (mResampler != NULL || mUsePolyphaseResampler)) {
+        reset();
         return NO_ERROR;
     }
 
@@ -65,6 +67,17 @@ status_t AudioResampler::configure(const SampleSpec &ssSrc, const SampleSpec &ss
         release_resampler(mResampler);
         mResampler = NULL;
     }
+    mUsePolyphaseResampler = false;
+    if (PolyphaseResampler::supportRates(ssSrc.getSampleRate(), ssDst.getSampleRate())) {
+        status = mPolyphaseResampler.configure(ssSrc.getSampleRate(), ssDst.getSampleRate(),
+                                               ssSrc.getChannelCount());
+        if (status != OK) {
+            return status;
+        }
+        mUsePolyphaseResampler = true;
+        mConvertSamplesFct = static_cast<SampleConverter>(&AudioResampler::resamplePolyphase);
+        return OK;
+    }
     //  resampler_buffer_provider is NULL since we will be driven by the input...
     status = create_resampler(ssSrc.getSampleRate(), ssDst.getSampleRate(),
                               ssSrc.getChannelCount(), RESAMPLER_QUALITY_DEFAULT, NULL,
@@ -80,6 +93,25 @@ status_t AudioResampler::configure(const SampleSpec &ssSrc, const SampleSpec &ss
     return OK;
 }
 
+void AudioResampler::reset()
+{
+    if (mUsePolyphaseResampler) {
+        mPolyphaseResampler.reset();
+    } else if (mResampler != NULL) {
+        mResampler->reset(mResampler);
+    }
+}
+
+status_t AudioResampler::resamplePolyphase(const void *src,
+                                           void *dst,
+                                           const size_t inFrames,
+                                           size_t *outFrames)
+{
+    *outFrames = mPolyphaseResampler.resample(static_cast<const int16_t *>(src), inFrames,
+                                              static_cast<int16_t *>(dst));
+    return NO_ERROR;
+}
+
 status_t AudioResampler::resampleFrames(const void *src,
                                         void *dst,
                                         const size_t inFrames,
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -16,6 +16,7 @@
 
 #pragma once
 #include "AudioConverter.hpp"
+#include "PolyphaseResampler.hpp"
 #include <audio_utils/resampler.h>
 #include <list>
 
@@ -37,11 +38,18 @@ public:
 
     static bool supportResample(uint32_t /*srcRate*/, uint32_t /*dstRate*/) { return true; }
 
+    /**
+     * Flushes the history of the resampler, keeping its instance.
+     */
+    virtual void reset();
+
 private:
     /**
      * Configures the resampler.
      * It configures the resampler that may be used to convert samples from the source
-     * to destination sample rate, with option 'RESAMPLER_QUALITY_DEFAULT'.
+     * to destination sample rate: the polyphase resampler for integer ratios (e.g. voice
+     * 8 or 16 kHz to 48 kHz), the audio utils resampler with option 'RESAMPLER_QUALITY_DEFAULT'
+     * otherwise.
      *
      * @param[in] ssSrc source sample specifications.
      * @param[in] ssDst destination sample specification.
@@ -69,7 +77,26 @@ private:
                                      const size_t inFrames,
                                      size_t *outFrames);
 
+    /**
+     * Resamples buffer by an integer ratio through the polyphase resampler.
+     *
+     * @param[in] src the source buffer.
+     * @param[out] dst the destination buffer, caller to ensure the destination
+     *             is large enough.
+     * @param[in] inFrames number of input frames.
+     * @param[out] outFrames output frames processed.
+     *
+     * @return error code.
+     */
+    android::status_t resamplePolyphase(const void *src,
+                                        void *dst,
+                                        const size_t inFrames,
+                                        size_t *outFrames);
+
     struct resampler_itfe *mResampler;
 
+    PolyphaseResampler mPolyphaseResampler;
+    bool mUsePolyphaseResampler; /**< Rates are an integer ratio of each other. */
+
 };
 }  // namespace intel_audio
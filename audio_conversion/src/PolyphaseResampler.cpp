@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PolyphaseResampler"
+
+#include "PolyphaseResampler.hpp"
+#include <utilities/Log.hpp>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+using audio_comms::utilities::Log;
+using namespace android;
+
+namespace intel_audio
+{
+
+static const uint32_t gSupportedFactors[] = {
+    2, 3, 4, 6
+};
+
+/**
+ * Taps of the filter per phase, i.e. per output sample when interpolating, per input sample
+ * when decimating. With the attenuation below, it keeps the passband of 8 kHz voice up to
+ * 3.4 kHz.
+ */
+static const size_t gTapsPerPhase = 48;
+
+static const double gStopbandAttenuationDb = 60.;
+
+static const uint32_t gCoefficientFractionalBits = 15;
+
+/** Zeroth order modified Bessel function of the first kind, for the Kaiser window. */
+static double besselI0(double x)
+{
+    double sum = 1.;
+    double term = 1.;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2. * k)) * (x / (2. * k));
+        sum += term;
+    }
+    return sum;
+}
+
+PolyphaseResampler::PolyphaseResampler()
+    : mInterpolation(1),
+      mDecimation(1),
+      mChannels(0),
+      mTaps(0),
+      mHistoryFrames(0),
+      mDecimationPhase(0)
+{
+}
+
+bool PolyphaseResampler::supportRates(uint32_t srcRate, uint32_t dstRate)
+{
+    uint32_t lowRate = std::min(srcRate, dstRate);
+    uint32_t highRate = std::max(srcRate, dstRate);
+    if (lowRate == 0 || (highRate % lowRate) != 0) {
+        return false;
+    }
+    const uint32_t *factorsEnd = gSupportedFactors +
+                                 sizeof(gSupportedFactors) / sizeof(gSupportedFactors[0]);
+    return std::find(gSupportedFactors, factorsEnd, highRate / lowRate) != factorsEnd;
+}
+
+status_t PolyphaseResampler::configure(uint32_t srcRate, uint32_t dstRate, uint32_t channels)
+{
+    if (!supportRates(srcRate, dstRate) || channels == 0) {
+        return BAD_VALUE;
+    }
+    mInterpolation = dstRate > srcRate ? dstRate / srcRate : 1;
+    mDecimation = srcRate > dstRate ? srcRate / dstRate : 1;
+    mChannels = channels;
+    uint32_t factor = std::max(mInterpolation, mDecimation);
+
+    // Kaiser windowed sinc, cut at the Nyquist frequency of the lowest rate minus half of the
+    // transition band, in cycles per sample at the highest rate.
+    size_t length = gTapsPerPhase * factor;
+    double transition = (gStopbandAttenuationDb - 7.95) / (2.285 * 2. * M_PI * length);
+    double cutoff = 0.5 / factor - transition / 2.;
+    double beta = 0.1102 * (gStopbandAttenuationDb - 8.7);
+    std::vector<double> prototype(length);
+    for (size_t i = 0; i < length; i++) {
+        double t = i - (length - 1) / 2.;
+        double sinc = t == 0. ? 2. * cutoff : sin(2. * M_PI * cutoff * t) / (M_PI * t);
+        double position = 2. * i / (length - 1) - 1.;
+        prototype[i] = sinc * besselI0(beta * sqrt(1. - position * position)) / besselI0(beta);
+    }
+
+    // Taps are ordered from the oldest sample, for the filter to walk the frames forward.
+    // Each phase of the interpolator holds one out of mInterpolation taps, hence the gain.
+    mTaps = length / mInterpolation;
+    mCoefficients.resize(length);
+    for (uint32_t phase = 0; phase < mInterpolation; phase++) {
+        for (size_t tap = 0; tap < mTaps; tap++) {
+            double coefficient = prototype[phase + (mTaps - 1 - tap) * mInterpolation] *
+                                 mInterpolation * (1 << gCoefficientFractionalBits);
+            mCoefficients[phase * mTaps + tap] = static_cast<int16_t>(
+                std::min(std::max(lround(coefficient), static_cast<long>(INT16_MIN)),
+                         static_cast<long>(INT16_MAX)));
+        }
+    }
+    mHistoryFrames = mTaps - 1;
+    reset();
+    Log::Debug() << __FUNCTION__ << ": " << srcRate << " to " << dstRate << ", " << mTaps
+                 << " taps";
+    return OK;
+}
+
+void PolyphaseResampler::reset()
+{
+    mBuffer.assign(mHistoryFrames * mChannels, 0);
+    mDecimationPhase = 0;
+}
+
+void PolyphaseResampler::appendToHistory(const int16_t *src, size_t inFrames)
+{
+    // Shrinking the buffer keeps its capacity: no allocation once the largest buffer is seen
+    mBuffer.resize((mHistoryFrames + inFrames) * mChannels);
+    memcpy(&mBuffer[mHistoryFrames * mChannels], src, inFrames * mChannels * sizeof(int16_t));
+}
+
+void PolyphaseResampler::keepHistory(size_t frames)
+{
+    memmove(mBuffer.data(), &mBuffer[frames * mChannels],
+            mHistoryFrames * mChannels * sizeof(int16_t));
+    mBuffer.resize(mHistoryFrames * mChannels);
+}
+
+int16_t PolyphaseResampler::filter(const int16_t *frame, const int16_t *coefficients) const
+{
+    int64_t sum = 1 << (gCoefficientFractionalBits - 1);
+    for (size_t tap = 0; tap < mTaps; tap++) {
+        sum += static_cast<int32_t>(frame[tap * mChannels]) * coefficients[tap];
+    }
+    sum >>= gCoefficientFractionalBits;
+    return static_cast<int16_t>(std::min<int64_t>(std::max<int64_t>(sum, INT16_MIN), INT16_MAX));
+}
+
+size_t PolyphaseResampler::interpolate(size_t inFrames, int16_t *dst)
+{
+    // The taps of the frame i start at i within the buffer, its newest sample being the new one
+    for (size_t frame = 0; frame < inFrames; frame++) {
+        const int16_t *taps = &mBuffer[frame * mChannels];
+        for (uint32_t phase = 0; phase < mInterpolation; phase++) {
+            const int16_t *coefficients = &mCoefficients[phase * mTaps];
+            for (uint32_t channel = 0; channel < mChannels; channel++) {
+                *dst++ = filter(taps + channel, coefficients);
+            }
+        }
+    }
+    return inFrames * mInterpolation;
+}
+
+size_t PolyphaseResampler::decimate(size_t inFrames, int16_t *dst)
+{
+    size_t outFrames = 0;
+    size_t frame = mDecimationPhase;
+    for (; frame < inFrames; frame += mDecimation) {
+        const int16_t *taps = &mBuffer[frame * mChannels];
+        for (uint32_t channel = 0; channel < mChannels; channel++) {
+            *dst++ = filter(taps + channel, mCoefficients.data());
+        }
+        outFrames++;
+    }
+    mDecimationPhase = frame - inFrames;
+    return outFrames;
+}
+
+size_t PolyphaseResampler::resample(const int16_t *src, size_t inFrames, int16_t *dst)
+{
+    appendToHistory(src, inFrames);
+    size_t outFrames = mInterpolation > 1 ? interpolate(inFrames, dst) : decimate(inFrames, dst);
+    keepHistory(inFrames);
+    return outFrames;
+}
+
+} // namespace intel_audio
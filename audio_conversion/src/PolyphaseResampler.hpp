@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <AudioNonCopyable.hpp>
+#include <utils/Errors.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace intel_audio
+{
+
+/**
+ * Resampler of 16 bits samples by an integer ratio, e.g. 8 or 16 kHz voice to 48 kHz, or
+ * 176.4 kHz to 44.1 kHz.
+ *
+ * It filters through a Kaiser windowed sinc low pass FIR, split in polyphase components:
+ * an interpolator computes each output sample from the taps of a single phase, a decimator only
+ * computes the output samples kept. Coefficients are in Q15 fixed point.
+ * The last input frames are kept as history, so that buffers are resampled seamlessly.
+ */
+class PolyphaseResampler : private audio_comms::utilities::NonCopyable
+{
+public:
+    PolyphaseResampler();
+
+    /**
+     * @param[in] srcRate source sample rate.
+     * @param[in] dstRate destination sample rate.
+     *
+     * @return true if the rates are a supported integer ratio of each other.
+     */
+    static bool supportRates(uint32_t srcRate, uint32_t dstRate);
+
+    /**
+     * Designs the filter for the given rates.
+     *
+     * @param[in] srcRate source sample rate.
+     * @param[in] dstRate destination sample rate.
+     * @param[in] channels number of interleaved channels.
+     *
+     * @return OK if the ratio is supported, error code otherwise.
+     */
+    android::status_t configure(uint32_t srcRate, uint32_t dstRate, uint32_t channels);
+
+    /** Clears the history, keeping the filter. */
+    void reset();
+
+    /**
+     * Resamples frames.
+     *
+     * @param[in] src source frames.
+     * @param[in] inFrames number of source frames.
+     * @param[out] dst destination frames, large enough for inFrames * dstRate / srcRate frames,
+     *             rounded up.
+     *
+     * @return number of destination frames.
+     */
+    size_t resample(const int16_t *src, size_t inFrames, int16_t *dst);
+
+private:
+    /** Appends the source frames to the history within the work buffer. */
+    void appendToHistory(const int16_t *src, size_t inFrames);
+
+    /** Keeps the last frames of the work buffer as history for the next call. */
+    void keepHistory(size_t frames);
+
+    size_t interpolate(size_t inFrames, int16_t *dst);
+    size_t decimate(size_t inFrames, int16_t *dst);
+
+    /**
+     * @param[in] frame pointer on the oldest sample of the taps, in the work buffer.
+     * @param[in] coefficients of the taps, oldest sample first.
+     *
+     * @return filtered sample, saturated.
+     */
+    int16_t filter(const int16_t *frame, const int16_t *coefficients) const;
+
+    uint32_t mInterpolation; /**< Upsampling factor, 1 if decimating. */
+    uint32_t mDecimation; /**< Downsampling factor, 1 if interpolating. */
+    uint32_t mChannels;
+    size_t mTaps; /**< Number of taps of each output sample. */
+
+    /**
+     * Coefficients in Q15, taps of each output phase in a row (a single row when decimating),
+     * oldest sample first.
+     */
+    std::vector<int16_t> mCoefficients;
+
+    std::vector<int16_t> mBuffer; /**< History followed by the frames being resampled. */
+    size_t mHistoryFrames;
+    uint32_t mDecimationPhase; /**< Source frames to skip before the next output frame. */
+};
+
+} // namespace intel_audio
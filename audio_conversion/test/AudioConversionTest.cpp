@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2014-2015 Intel Corporation
+ * Copyright (C) 2014-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -21,6 +21,11 @@
 #include <media/AudioBufferProvider.h>
 #include <gtest/gtest.h>
 #include <utils/Errors.h>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
 
 namespace intel_audio
 {
@@ -974,4 +979,327 @@ TEST(AudioConversion, frameExactApi)
     // @todo: quality check of output
 }
 
+/**
+ * Test that switching back to a previously configured pair of sample specifications reuses the
+ * cached chain with a fresh state, i.e. converts as a newly configured chain would.
+ */
+TEST(AudioConversion, cachedChainReuse)
+{
+    const SampleSpec streamSpec(2, AUDIO_FORMAT_PCM_16_BIT, 48000);
+    const SampleSpec speakerSpec(4, AUDIO_FORMAT_PCM_8_24_BIT, 48000);
+    const SampleSpec headsetSpec(2, AUDIO_FORMAT_PCM_16_BIT, 44100);
+
+    const size_t frames = 480;
+    std::vector<int16_t> source(frames * streamSpec.getChannelCount());
+    for (size_t i = 0; i < source.size(); i++) {
+        source[i] = static_cast<int16_t>(i * 64);
+    }
+
+    AudioConversion freshConversion;
+    ASSERT_EQ(0, freshConversion.configure(streamSpec, speakerSpec));
+    std::vector<uint8_t> expected(speakerSpec.convertFramesToBytes(frames));
+    void *dst = expected.data();
+    size_t outFrames = 0;
+    ASSERT_EQ(0, freshConversion.convert(source.data(), &dst, frames, &outFrames));
+    EXPECT_EQ(frames, outFrames);
+
+    AudioConversion audioConversion;
+    std::vector<uint8_t> output(speakerSpec.convertFramesToBytes(frames));
+    std::vector<uint8_t> resampled(headsetSpec.convertFramesToBytes(frames));
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(0, audioConversion.configure(streamSpec, speakerSpec));
+        dst = output.data();
+        ASSERT_EQ(0, audioConversion.convert(source.data(), &dst, frames, &outFrames));
+        EXPECT_EQ(frames, outFrames);
+        EXPECT_EQ(0, memcmp(expected.data(), output.data(), output.size()));
+
+        ASSERT_EQ(0, audioConversion.configure(streamSpec, headsetSpec));
+        dst = resampled.data();
+        ASSERT_EQ(0, audioConversion.convert(source.data(), &dst, frames, &outFrames));
+        EXPECT_EQ(AudioUtils::convertSrcToDstInFrames(frames, streamSpec, headsetSpec),
+                  outFrames);
+    }
+}
+
+/** @return monotonic time in nanoseconds. */
+static int64_t getMonotonicTimeNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * Test that reattaching a stream alternately to two routes requiring resampling reuses the
+ * chains built for each route, with their converters, instead of building them again.
+ * The reattach time with and without the cache is recorded, not asserted.
+ */
+TEST(AudioConversion, reattachReusesChain)
+{
+    static const int iterations = 100;
+    const SampleSpec streamSpec(2, AUDIO_FORMAT_PCM_16_BIT, 44100);
+    const SampleSpec speakerSpec(2, AUDIO_FORMAT_PCM_16_BIT, 48000);
+    const SampleSpec headsetSpec(2, AUDIO_FORMAT_PCM_16_BIT, 16000);
+
+    AudioConversion audioConversion;
+    ASSERT_EQ(0, audioConversion.configure(streamSpec, speakerSpec));
+    const std::list<AudioConverter *> speakerChain = audioConversion.getActiveConverters();
+    ASSERT_EQ(0, audioConversion.configure(streamSpec, headsetSpec));
+    const std::list<AudioConverter *> headsetChain = audioConversion.getActiveConverters();
+    EXPECT_EQ(2u, audioConversion.getChainBuildCount());
+    ASSERT_FALSE(speakerChain.empty());
+    EXPECT_TRUE(speakerChain != headsetChain);
+
+    for (int i = 0; i < 10; i++) {
+        ASSERT_EQ(0, audioConversion.configure(streamSpec, speakerSpec));
+        EXPECT_TRUE(speakerChain == audioConversion.getActiveConverters());
+        ASSERT_EQ(0, audioConversion.configure(streamSpec, headsetSpec));
+        EXPECT_TRUE(headsetChain == audioConversion.getActiveConverters());
+    }
+    EXPECT_EQ(2u, audioConversion.getChainBuildCount());
+
+    int64_t start = getMonotonicTimeNs();
+    for (int i = 0; i < iterations; i++) {
+        AudioConversion uncachedConversion;
+        ASSERT_EQ(0, uncachedConversion.configure(streamSpec, (i % 2) ? headsetSpec : speakerSpec));
+    }
+    int64_t uncachedNs = getMonotonicTimeNs() - start;
+
+    start = getMonotonicTimeNs();
+    for (int i = 0; i < iterations; i++) {
+        ASSERT_EQ(0, audioConversion.configure(streamSpec, (i % 2) ? headsetSpec : speakerSpec));
+    }
+    int64_t cachedNs = getMonotonicTimeNs() - start;
+    EXPECT_EQ(2u, audioConversion.getChainBuildCount());
+
+    ::testing::Test::RecordProperty("uncachedReattachNs",
+                                    static_cast<int>(uncachedNs / iterations));
+    ::testing::Test::RecordProperty("cachedReattachNs", static_cast<int>(cachedNs / iterations));
+}
+
+/**
+ * Test that the conversion is planned on the cheapest order of converters, i.e. resampling
+ * after down-remapping and before up-reformatting, and that orders not supported are dropped.
+ */
+TEST(AudioConversion, conversionPlan)
+{
+    const SampleSpec sampleSpecSrc(8, AUDIO_FORMAT_PCM_16_BIT, 48000);
+    const SampleSpec sampleSpecDst(2, AUDIO_FORMAT_PCM_32_BIT, 16000);
+
+    AudioConversion audioConversion;
+    ASSERT_EQ(0, audioConversion.configure(sampleSpecSrc, sampleSpecDst));
+    const std::vector<SampleSpecItem> expectedPlan = {
+        ChannelCountSampleSpecItem, RateSampleSpecItem, FormatSampleSpecItem
+    };
+    EXPECT_TRUE(expectedPlan == audioConversion.getPlan());
+    EXPECT_LT(0.f, audioConversion.getPlanCost());
+
+    // The resampler only works on 16 bits samples
+    const SampleSpec sampleSpec32Src(2, AUDIO_FORMAT_PCM_32_BIT, 44100);
+    const SampleSpec sampleSpec32Dst(2, AUDIO_FORMAT_PCM_32_BIT, 48000);
+    EXPECT_NE(0, audioConversion.configure(sampleSpec32Src, sampleSpec32Dst));
+    EXPECT_TRUE(audioConversion.getPlan().empty());
+}
+
+/** @return plan of a conversion, as dumped. */
+static std::string getPlanName(const std::vector<SampleSpecItem> &plan)
+{
+    std::string name;
+    for (SampleSpecItem sampleSpecItem : plan) {
+        name += (name.empty() ? "" : " > ") +
+                std::string(AudioConversion::getConverterName(sampleSpecItem));
+    }
+    return name;
+}
+
+/**
+ * Test the chains planned for representative conversions of streams to routes: each converter
+ * runs on as few channels as possible, and the resampler runs on 16 bits samples.
+ */
+TEST(AudioConversion, plannedChains)
+{
+    struct
+    {
+        SampleSpec ssSrc;
+        SampleSpec ssDst;
+        const char *plan;
+    } const conversions[] = {
+        // Multichannel stream to stereo 32 bits codec at another rate
+        { SampleSpec(8, AUDIO_FORMAT_PCM_16_BIT, 48000),
+          SampleSpec(2, AUDIO_FORMAT_PCM_32_BIT, 16000), "remap > resample > reformat" },
+        // Stereo music to 5.1 24 bits speakers
+        { SampleSpec(2, AUDIO_FORMAT_PCM_16_BIT, 44100),
+          SampleSpec(6, AUDIO_FORMAT_PCM_8_24_BIT, 48000), "resample > reformat > remap" },
+        // Mono voice to stereo 32 bits codec
+        { SampleSpec(1, AUDIO_FORMAT_PCM_16_BIT, 16000),
+          SampleSpec(2, AUDIO_FORMAT_PCM_32_BIT, 48000), "resample > reformat > remap" },
+        // Stereo 32 bits capture to mono 16 bits stream
+        { SampleSpec(2, AUDIO_FORMAT_PCM_32_BIT, 48000),
+          SampleSpec(1, AUDIO_FORMAT_PCM_16_BIT, 48000), "remap > reformat" },
+        // 32 bits capture to 16 bits stream at another rate
+        { SampleSpec(2, AUDIO_FORMAT_PCM_32_BIT, 48000),
+          SampleSpec(2, AUDIO_FORMAT_PCM_16_BIT, 44100), "reformat > resample" },
+    };
+
+    for (const auto &conversion : conversions) {
+        AudioConversion audioConversion;
+        ASSERT_EQ(0, audioConversion.configure(conversion.ssSrc, conversion.ssDst))
+            << conversion.plan;
+        EXPECT_EQ(conversion.plan, getPlanName(audioConversion.getPlan()));
+        EXPECT_EQ(audioConversion.getPlan().size(), audioConversion.getActiveConverters().size());
+    }
+}
+
+/**
+ * Measures the cost of each converter alone, in nanoseconds per sample output, from which the
+ * cost model of the conversion planner is calibrated. Costs are recorded, not asserted.
+ */
+TEST(AudioConversion, converterCost)
+{
+    static const int iterations = 100;
+    static const size_t frames = 960;
+    const SampleSpec sampleSpecSrc(2, AUDIO_FORMAT_PCM_16_BIT, 48000);
+    const SampleSpec sampleSpecDst[NbSampleSpecItems] = {
+        SampleSpec(1, AUDIO_FORMAT_PCM_16_BIT, 48000),
+        SampleSpec(2, AUDIO_FORMAT_PCM_32_BIT, 48000),
+        SampleSpec(2, AUDIO_FORMAT_PCM_16_BIT, 44100)
+    };
+    std::vector<int16_t> source(frames * sampleSpecSrc.getChannelCount());
+    for (size_t i = 0; i < source.size(); i++) {
+        source[i] = static_cast<int16_t>(i * 32);
+    }
+
+    for (int item = 0; item < NbSampleSpecItems; item++) {
+        const char *name = AudioConversion::getConverterName(static_cast<SampleSpecItem>(item));
+        AudioConversion audioConversion;
+        ASSERT_EQ(0, audioConversion.configure(sampleSpecSrc, sampleSpecDst[item]));
+        ASSERT_EQ(name, getPlanName(audioConversion.getPlan()));
+        std::vector<uint8_t> output(sampleSpecDst[item].convertFramesToBytes(2 * frames));
+        size_t samplesOut = 0;
+
+        int64_t start = getMonotonicTimeNs();
+        for (int i = 0; i < iterations; i++) {
+            void *dst = output.data();
+            size_t outFrames = 0;
+            ASSERT_EQ(0, audioConversion.convert(source.data(), &dst, frames, &outFrames));
+            samplesOut += outFrames * sampleSpecDst[item].getChannelCount();
+        }
+        int64_t elapsedNs = getMonotonicTimeNs() - start;
+        ASSERT_NE(0u, samplesOut);
+
+        char cost[32];
+        snprintf(cost, sizeof(cost), "%.2f", static_cast<double>(elapsedNs) / samplesOut);
+        ::testing::Test::RecordProperty(std::string(name) + "NsPerSample", cost);
+    }
+}
+
+/**
+ * Test the remap through the mixing matrix: ITU downmix of 5.1 to stereo, normalized not to
+ * clip, upmix of stereo to 5.1, and channel to channel remap of channel index masks.
+ */
+TEST(AudioConversion, matrixRemap)
+{
+    EXPECT_TRUE(AudioConversion::supportRemap(6, 2));
+    EXPECT_TRUE(AudioConversion::supportRemap(2, 6));
+    EXPECT_TRUE(AudioConversion::supportRemap(8, 6));
+    EXPECT_FALSE(AudioConversion::supportRemap(10, 2));
+
+    const SampleSpec stereo(2, AUDIO_FORMAT_PCM_16_BIT, 48000);
+    const SampleSpec surround51(6, AUDIO_FORMAT_PCM_16_BIT, 48000);
+    AudioConversion audioConversion;
+    size_t outFrames = 0;
+
+    // FL, FR, FC, LFE, BL, BR: left gets FL + FC and BL at -3dB, normalized; LFE is dropped
+    const int16_t source51[] = {
+        10000, 0, 10000, 30000, 0, 0,
+        32767, 32767, 32767, 32767, 32767, 32767
+    };
+    int16_t downmix[4];
+    void *dst = downmix;
+    ASSERT_EQ(0, audioConversion.configure(surround51, stereo));
+    ASSERT_EQ(0, audioConversion.convert(source51, &dst, 2, &outFrames));
+    EXPECT_EQ(2u, outFrames);
+    EXPECT_NEAR(7071, downmix[0], 2);
+    EXPECT_NEAR(2929, downmix[1], 2);
+    EXPECT_NEAR(32767, downmix[2], 2);
+    EXPECT_NEAR(32767, downmix[3], 2);
+
+    // Surround mirrors the front, center and low frequency are silent
+    const int16_t sourceStereo[] = { 1000, -2000 };
+    const int16_t expectedUpmix[] = { 1000, -2000, 0, 0, 1000, -2000 };
+    int16_t upmix[6];
+    dst = upmix;
+    ASSERT_EQ(0, audioConversion.configure(stereo, surround51));
+    ASSERT_EQ(0, audioConversion.convert(sourceStereo, &dst, 1, &outFrames));
+    EXPECT_EQ(0, memcmp(expectedUpmix, upmix, sizeof(upmix)));
+
+    SampleSpec index4(4, AUDIO_FORMAT_PCM_16_BIT, 48000);
+    index4.setChannelMask(audio_channel_mask_for_index_assignment_from_count(4), true);
+    SampleSpec index2(2, AUDIO_FORMAT_PCM_16_BIT, 48000);
+    index2.setChannelMask(audio_channel_mask_for_index_assignment_from_count(2), true);
+    const int16_t sourceIndex[] = { 1, 2, 3, 4 };
+    int16_t remapped[2];
+    dst = remapped;
+    ASSERT_EQ(0, audioConversion.configure(index4, index2));
+    ASSERT_EQ(0, audioConversion.convert(sourceIndex, &dst, 1, &outFrames));
+    EXPECT_EQ(1, remapped[0]);
+    EXPECT_EQ(2, remapped[1]);
+}
+
+/**
+ * Resamples a sine by chunks and returns the RMS of the output once the filter settled,
+ * relative to the RMS of the input.
+ */
+static double resampleSine(uint32_t srcRate, uint32_t dstRate, double frequency)
+{
+    static const size_t chunkFrames = 480;
+    static const size_t chunks = 20;
+    static const double amplitude = 16000;
+    const SampleSpec sampleSpecSrc(1, AUDIO_FORMAT_PCM_16_BIT, srcRate);
+    const SampleSpec sampleSpecDst(1, AUDIO_FORMAT_PCM_16_BIT, dstRate);
+    AudioConversion audioConversion;
+    EXPECT_EQ(0, audioConversion.configure(sampleSpecSrc, sampleSpecDst));
+
+    std::vector<int16_t> output;
+    std::vector<int16_t> source(chunkFrames);
+    size_t expectedFrames = AudioUtils::convertSrcToDstInFrames(chunkFrames, sampleSpecSrc,
+                                                                sampleSpecDst);
+    std::vector<int16_t> converted(expectedFrames);
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        for (size_t i = 0; i < chunkFrames; i++) {
+            source[i] = static_cast<int16_t>(
+                amplitude * sin(2 * M_PI * frequency * (chunk * chunkFrames + i) / srcRate));
+        }
+        void *dst = converted.data();
+        size_t outFrames = 0;
+        EXPECT_EQ(0, audioConversion.convert(source.data(), &dst, chunkFrames, &outFrames));
+        EXPECT_EQ(expectedFrames, outFrames);
+        output.insert(output.end(), converted.begin(), converted.begin() + outFrames);
+    }
+    // Skip the first chunks while the filter settles
+    double sum = 0;
+    size_t settled = output.size() / 4;
+    for (size_t i = settled; i < output.size(); i++) {
+        sum += static_cast<double>(output[i]) * output[i];
+    }
+    return sqrt(sum / (output.size() - settled)) / (amplitude / sqrt(2.));
+}
+
+/**
+ * Test the integer ratio resampling: voice band kept, aliases above the Nyquist frequency of
+ * the destination rejected.
+ */
+TEST(AudioConversion, integerRatioResampling)
+{
+    // Passband within 0.5 dB
+    EXPECT_NEAR(1., resampleSine(8000, 48000, 1000), 0.06);
+    EXPECT_NEAR(1., resampleSine(16000, 48000, 3000), 0.06);
+    EXPECT_NEAR(1., resampleSine(48000, 16000, 1000), 0.06);
+    EXPECT_NEAR(1., resampleSine(176400, 44100, 10000), 0.06);
+
+    // Stopband below -40 dB
+    EXPECT_GT(0.01, resampleSine(48000, 8000, 11000));
+    EXPECT_GT(0.01, resampleSine(96000, 48000, 30000));
+}
+
 } // namespace intel_audio
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -161,9 +161,12 @@ public:
     std::string getParameters(const std::string &keys);
 
     /**
-     * Print debug information from target debug files
+     * Collects debug information from target debug files.
+     * Reads the debug files, so must not be called from an audio thread.
+     *
+     * @param[out] info content of the debug files, appended to.
      */
-    void printPlatformFwErrorInfo() const;
+    void getPlatformFwErrorInfo(std::string &info) const;
 
     /**
      * Apply the configuration of the platform on the parameter manager.
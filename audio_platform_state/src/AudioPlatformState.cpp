@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -179,10 +179,8 @@ string AudioPlatformState::getParameters(const string &keys)
     return returnedPairs.toString();
 }
 
-void AudioPlatformState::printPlatformFwErrorInfo() const
+void AudioPlatformState::getPlatformFwErrorInfo(std::string &info) const
 {
-    Log::Error() << "^^^^  Print platform Audio firmware error info  ^^^^";
-
     string paramValue;
 
     /**
@@ -203,21 +201,17 @@ void AudioPlatformState::printPlatformFwErrorInfo() const
 
     vector<std::string> debugFiles;
     char *debugFile;
-    string debugFileString;
     char *tokenString = static_cast<char *>(alloca(paramValue.length() + 1));
     vector<std::string>::const_iterator it;
 
     strncpy(tokenString, paramValue.c_str(), paramValue.length() + 1);
 
     while ((debugFile = NaiveTokenizer::getNextToken(&tokenString)) != NULL) {
-        debugFileString = string(debugFile);
-        debugFileString = debugFile;
-        debugFiles.push_back(debugFileString);
+        debugFiles.push_back(string(debugFile));
     }
 
     for (it = debugFiles.begin(); it != debugFiles.end(); ++it) {
         ifstream debugStream;
-        Log::Error() << "Opening file " << *it << " and reading it.";
         debugStream.open(it->c_str(), ifstream::in);
 
         if (debugStream.fail()) {
@@ -229,12 +223,13 @@ void AudioPlatformState::printPlatformFwErrorInfo() const
             debugStream.close();
             continue;
         }
+        info += "File " + *it + ":\n";
 
         while (debugStream.good()) {
             char dataToRead[mMaxDebugStreamSize];
 
             debugStream.read(dataToRead, mMaxDebugStreamSize);
-            Log::Error() << dataToRead;
+            info.append(dataToRead, debugStream.gcount());
         }
 
         debugStream.close();
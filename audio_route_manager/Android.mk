@@ -27,10 +27,12 @@ include $(OPTIONAL_QUALITY_ENV_SETUP)
 component_src_files :=  \
     AudioStreamRoute.cpp \
     AudioRouteManager.cpp \
-    AudioRouteManagerObserver.cpp \
+    FwErrorReporter.cpp \
     MixPortConfig.cpp \
+    PeriodCountController.cpp \
     AudioBackendRoute.cpp \
     AudioCapabilities.cpp \
+    RouteConfigImage.cpp \
     Serializer.cpp
 
 component_export_includes := \
@@ -193,6 +195,143 @@ include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
 
 include $(BUILD_HOST_STATIC_LIBRARY)
 endif
+#######################################################################
+# Component unit tests
+
+# Firmware error reporter tested upon a fake platform state
+route_manager_test_src_files := \
+    PeriodCountController.cpp \
+    FwErrorReporter.cpp \
+    RouteConfigImage.cpp \
+    test/PeriodCountControllerTest.cpp \
+    test/FwErrorReporterTest.cpp \
+    test/RouteConfigImageTest.cpp
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(route_manager_test_src_files)
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/test/fake \
+    $(LOCAL_PATH) \
+    external/libxml2/include \
+    external/icu/icu4c/source/common
+LOCAL_STATIC_LIBRARIES := \
+    libaudio_comms_utilities \
+    libxml2 \
+    liblog
+LOCAL_SHARED_LIBRARIES := libcutils libutils libicuuc
+LOCAL_MODULE := route_manager_test
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Werror -Wextra -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+include $(BUILD_NATIVE_TEST)
+
+ifeq (ENABLE_HOST_VERSION,1)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(route_manager_test_src_files)
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/test/fake \
+    $(LOCAL_PATH) \
+    external/libxml2/include \
+    external/icu/icu4c/source/common \
+    external/gtest/include
+LOCAL_STATIC_LIBRARIES := \
+    libaudio_comms_utilities_host \
+    libutils \
+    libxml2 \
+    liblog \
+    libgtest_host \
+    libgtest_main_host
+LOCAL_SHARED_LIBRARIES := libicuuc-host
+LOCAL_LDFLAGS += -lpthread -lrt
+LOCAL_MODULE := route_manager_test_host
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Werror -Wextra -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+# Cannot use $(BUILD_HOST_NATIVE_TEST) because of compilation flag
+# misalignment against gtest mk files
+include $(BUILD_HOST_EXECUTABLE)
+endif
+
+#######################################################################
+# Warm standby of stream routes tested upon fake audio device and streams
+
+stream_route_test_src_files := \
+    AudioStreamRoute.cpp \
+    MixPortConfig.cpp \
+    AudioCapabilities.cpp \
+    PeriodCountController.cpp \
+    test/WarmStandbyTest.cpp
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(stream_route_test_src_files)
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH) \
+    $(component_includes_dir_target)
+LOCAL_STATIC_LIBRARIES := $(component_static_lib_target)
+LOCAL_SHARED_LIBRARIES := $(component_shared_lib_target)
+LOCAL_MODULE := stream_route_test
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(component_cflags) -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+include $(BUILD_NATIVE_TEST)
+
+ifeq (ENABLE_HOST_VERSION,1)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(stream_route_test_src_files)
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH) \
+    $(component_includes_dir_host) \
+    external/gtest/include
+LOCAL_STATIC_LIBRARIES := \
+    $(component_static_lib_host) \
+    libgtest_host \
+    libgtest_main_host
+LOCAL_SHARED_LIBRARIES := $(component_shared_lib_host)
+LOCAL_LDFLAGS += -lpthread -lrt
+LOCAL_MODULE := stream_route_test_host
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := $(component_cflags) -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+# Cannot use $(BUILD_HOST_NATIVE_TEST) because of compilation flag
+# misalignment against gtest mk files
+include $(BUILD_HOST_EXECUTABLE)
+endif
+
+#######################################################################
+# Tool for route manager configuration image generation
+
+include $(CLEAR_VARS)
+LOCAL_MODULE := buildRouteConfigImage
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := \
+    RouteConfigImage.cpp \
+    tools/buildRouteConfigImage.cpp
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH) \
+    external/libxml2/include \
+    external/icu/icu4c/source/common
+LOCAL_STATIC_LIBRARIES := \
+    libaudio_comms_utilities_host \
+    libxml2
+LOCAL_SHARED_LIBRARIES := \
+    libicuuc-host \
+    liblog
+LOCAL_CFLAGS := $(component_cflags)
+include $(BUILD_HOST_EXECUTABLE)
+
 #######################################################################
 # Tools for audio pfw settings generation
 
@@ -202,14 +202,34 @@ public:
      * Backend routes don't need implement, so add the
      * default implementation.
      */
-    void loadCapabilities() {}
+    virtual void loadCapabilities() {}
 
     /**
      * Reset the capabilities of stream route
      * Backend routes don't need implement, so add the
      * default implementation.
      */
-    void resetCapabilities() {}
+    virtual void resetCapabilities() {}
+
+    /**
+     * Defer the loading of the capabilities of stream route until its first use.
+     * Backend routes don't need implement, so add the
+     * default implementation.
+     */
+    virtual void deferCapabilitiesLoading() {}
+
+    /**
+     * Load the capabilities of stream route if their loading has been deferred.
+     * Backend routes don't need implement, so add the
+     * default implementation.
+     */
+    virtual void loadPendingCapabilities() {}
+
+    /**
+     * @return true if the loading of the capabilities of stream route has been deferred and not
+     *         performed yet. Backend routes have no capabilities to load.
+     */
+    virtual bool hasPendingCapabilities() const { return false; }
 
     /**
      * Get the supported devices of the route.
@@ -66,7 +66,7 @@ public:
      */
     void resetAvailability()
     {
-        for (uint32_t i = 0; i < Direction::gNbDirections; i++) {
+        for (uint32_t i = 0; i < ROUTE_TYPE_NUM; i++) {
             mRoutes[i].reset();
         }
         for (auto it : *this) {
@@ -74,7 +74,10 @@ public:
         }
     }
 
-    void prepareRouting()
+    /**
+     * @param[in] nowUs monotonic time in microseconds, to check the standby delay of routes.
+     */
+    void prepareRouting(int64_t nowUs)
     {
         for (auto route : *this) {
             // The stream route collection must not only ensure that the route is applicable
@@ -95,6 +98,70 @@ public:
                 }
             }
         }
+        // Stream routes left without stream stay enabled during their standby delay
+        for (auto route : *this) {
+            if (route && route->isMixRoute() && route->previouslyUsed() && !route->isUsed() &&
+                static_cast<AudioStreamRoute *>(route)->keepWarmStandby(nowUs)) {
+                route->setUsed(true);
+                mRoutes[route->getRouteType()].setEnabledRoute(route->getMask());
+            }
+        }
+    }
+
+    /**
+     * Detaches / attaches streams of the routes entering / leaving warm standby. As these routes
+     * stay enabled, no routing stage is involved.
+     */
+    void applyWarmStandby()
+    {
+        for (auto route : *this) {
+            if (route && route->isMixRoute()) {
+                static_cast<AudioStreamRoute *>(route)->applyWarmStandby();
+            }
+        }
+    }
+
+    /**
+     * Detaches the streams leaving shared routes, before the routing stages.
+     */
+    void detachLeavingSharedStreams()
+    {
+        for (auto route : *this) {
+            if (route && route->isMixRoute()) {
+                static_cast<AudioStreamRoute *>(route)->detachLeavingSharedStreams();
+            }
+        }
+    }
+
+    /**
+     * Attaches the streams joining shared routes already enabled, after the routing
+     * stages.
+     */
+    void attachJoiningSharedStreams()
+    {
+        for (auto route : *this) {
+            if (route && route->isMixRoute()) {
+                static_cast<AudioStreamRoute *>(route)->attachJoiningSharedStreams();
+            }
+        }
+    }
+
+    /**
+     * @return earliest end of standby delay of routes in warm standby in microseconds, 0 if none.
+     */
+    int64_t getNextWarmStandbyDeadlineUs() const
+    {
+        int64_t deadlineUs = 0;
+        for (auto route : *this) {
+            if (route && route->isMixRoute()) {
+                int64_t routeDeadlineUs =
+                    static_cast<const AudioStreamRoute *>(route)->getWarmStandbyDeadlineUs();
+                if (routeDeadlineUs != 0 && (deadlineUs == 0 || routeDeadlineUs < deadlineUs)) {
+                    deadlineUs = routeDeadlineUs;
+                }
+            }
+        }
+        return deadlineUs;
     }
 
     bool routingHasChanged() const
@@ -149,6 +216,8 @@ public:
      *
      * @param[in] route applicable route to be associated to a stream.
      *
+     * A shared route is associated to all the matching streams, up to its maximum.
+     *
      * @return true if a stream was found and attached to the route, false otherwise.
      */
     bool setStreamForRoute(AudioRoute &route)
@@ -160,19 +229,27 @@ public:
             return false;
         }
 
+        bool hasStream = false;
         for (auto stream : mOrderedStreamList[route.getRouteType()]) {
             if (stream->isStarted() && stream->isRoutedByPolicy() &&
                 !stream->isNewRouteAvailable()) {
                 AudioStreamRoute *streamRoute = (AudioStreamRoute *)&route;
+                streamRoute->loadPendingCapabilities();
                 if (streamRoute->isMatchingWithStream(*stream)) {
                     audio_comms::utilities::Log::Verbose() << __FUNCTION__ << ": route "
                                                            << streamRoute->getName()
                                                            << " is maching with the stream";
-                    return streamRoute->setStream(*stream);
+                    if (!streamRoute->setStream(*stream)) {
+                        return hasStream;
+                    }
+                    hasStream = true;
+                    if (!streamRoute->canAcceptStream()) {
+                        return true;
+                    }
                 }
             }
         }
-        return false;
+        return hasStream;
     }
 
     /**
@@ -261,7 +338,8 @@ public:
 
     /**
      * Handle the change of state of a device to whom it concerns by loading / resetting
-     * capabilities of route(s) supporting this device.
+     * capabilities of route(s) supporting this device. Loading is deferred until a stream looks
+     * for a route supporting this device.
      * @param[in] device that has been connected / disconnected
      * @param[in] state of the device.
      */
@@ -270,7 +348,7 @@ public:
         for (auto route : *this) {
             if ((route->getSupportedDeviceMask() & device) == device) {
                 if (isConnected) {
-                    route->loadCapabilities();
+                    route->deferCapabilitiesLoading();
                 } else {
                     route->resetCapabilities();
                 }
@@ -278,6 +356,36 @@ public:
         }
     }
 
+    /**
+     * @param[in] devices for which a route is looked for.
+     *
+     * @return true if a route supporting at least one of the devices has its capabilities
+     *         loading pending.
+     */
+    bool hasPendingCapabilities(audio_devices_t devices) const
+    {
+        for (auto route : *this) {
+            if ((route->getSupportedDeviceMask() & devices) != 0 &&
+                route->hasPendingCapabilities()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Loads the deferred capabilities of the route(s) supporting at least one of the devices.
+     * @param[in] devices for which a route is looked for.
+     */
+    void loadPendingCapabilities(audio_devices_t devices)
+    {
+        for (auto route : *this) {
+            if ((route->getSupportedDeviceMask() & devices) != 0) {
+                route->loadPendingCapabilities();
+            }
+        }
+    }
+
     /**
      * Performs the post-disabling of the route.
      * It only concerns the action that needs to be done on routes themselves, ie detaching
@@ -485,7 +593,7 @@ private:
         {
             return (prevEnabledRoutes() & ~enabledRoutes()) | needRepathRoutes();
         }
-    } mRoutes[Direction::gNbDirections];
+    } mRoutes[ROUTE_TYPE_NUM];
 };
 
 } // namespace intel_audio
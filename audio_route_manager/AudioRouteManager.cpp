@@ -18,20 +18,22 @@
 // #define LOG_NDEBUG 0
 
 #include "AudioRouteManager.hpp"
-#include "AudioRouteManagerObserver.hpp"
 #include "RouteManagerConfig.hpp"
 #include "AudioRouteCollection.hpp"
+#include "FwErrorReporter.hpp"
 #include "Serializer.hpp"
 #include "RoutingStage.hpp"
 
 #include <AudioPlatformState.hpp>
 #include <EventThread.h>
 #include <property/Property.hpp>
-#include <Observer.hpp>
 #include <IoStream.hpp>
+#include <SoundCardRegistry.hpp>
 #include <BitField.hpp>
 #include <cutils/bitops.h>
+#include <future>
 #include <string>
+#include <time.h>
 
 #include <utilities/Log.hpp>
 
@@ -54,6 +56,8 @@ static const char *gConfigFilePathList[] = {
     "/vendor/etc/", "/system/etc/"
 };
 static const char *gConfigFileName = "audio_policy_configuration.xml";
+/** Precompiled image of the configuration file, generated at build time. */
+static const char *gConfigImageFileName = "audio_policy_configuration.bin";
 
 static const std::string gVoiceVolume = "/Audio/CONFIGURATION/VOICE_VOLUME_CTRL_PARAMETER";
 
@@ -74,6 +78,9 @@ static const std::string gRecoverUevent {
 static const std::string gCrashUevent {
     gEventType + "=" + "SST_CRASHED"
 };
+static const std::string gSoundSubsystemUevent {
+    "SUBSYSTEM=sound"
+};
 
 namespace intel_audio
 {
@@ -92,11 +99,38 @@ static const std::string gRouteCriterionType[ROUTE_TYPE_NUM] = {
 };
 static const std::string gRoutingStageCriterion = "RoutageState";
 
+static int64_t getMonotonicTimeUs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
 AudioRouteManager::AudioRouteManager()
     : mRoutes(new AudioRouteCollection()),
       mEventThread(new CEventThread(this)),
-      mPlatformState(new AudioPlatformState())
-{
+      mPlatformState(nullptr),
+      mFwErrorReporter(nullptr)
+{
+    int64_t startTime = getMonotonicTimeUs();
+    int64_t phaseStartTime = startTime;
+
+    // Only creates the PFW connector, on which the configuration registers the criteria.
+    mPlatformState = new AudioPlatformState();
+    addStartupTiming("platform state creation", phaseStartTime);
+
+    // Loading the configuration only involves file accesses (and XML parsing if no valid
+    // precompiled image): overlap it with the uevent socket opening.
+    Criteria criteria;
+    CriterionTypes criterionTypes;
+    int64_t configLoadingTimeUs = 0;
+    std::future<status_t> configLoading = std::async(std::launch::async, [&]() {
+        int64_t loadingStartTime = getMonotonicTimeUs();
+        status_t status = loadConfiguration(criteria, criterionTypes);
+        configLoadingTimeUs = getMonotonicTimeUs() - loadingStartTime;
+        return status;
+    });
+
 #ifdef EMULATE_UEVENT
     mUEventFd = socket_local_server(uevent_socket_name, ANDROID_SOCKET_NAMESPACE_ABSTRACT,
                                     SOCK_STREAM);
@@ -114,41 +148,113 @@ AudioRouteManager::AudioRouteManager()
         Log::Debug() << __FUNCTION__ << ": UEvent fd added to event thread";
         mEventThread->addOpenedFd(FdFromSstDriver, mUEventFd, true);
     }
-    // Load configuration file to populate Criterion types, criteria and rogues.
-    Criteria mCriteria;
-    CriterionTypes mCriterionTypes;
-    RouteManagerConfig config(*mRoutes, mCriteria, mCriterionTypes, mParameters,
-                              mPlatformState->getConnector<Audio>());
-    RouteSerializer serializer;
-    status_t status;
-    for (const auto &path : gConfigFilePathList) {
-        status = serializer.deserialize((string(path) + string(gConfigFileName)).c_str(), config);
-        if (status == OK) {
-            break;
-        }
-    }
-    AUDIOCOMMS_ASSERT(status == NO_ERROR, "AudioRouteManager: could not parse any config file");
+    addStartupTiming("uevent socket opening", phaseStartTime);
+
+    // Populates Criterion types, criteria and rogues.
+    status_t status = configLoading.get();
+    mStartupTimings.push_back(std::make_pair(string("configuration loading"),
+                                             configLoadingTimeUs));
+    addStartupTiming("configuration loading wait", phaseStartTime);
+    AUDIOCOMMS_ASSERT(status == NO_ERROR, "AudioRouteManager: could not load any config file");
 
-    mPlatformState->setConfig<Audio>(mCriteria, mCriterionTypes, mParameters);
+    mPlatformState->setConfig<Audio>(criteria, criterionTypes, mParameters);
     for (const auto route : *mRoutes) {
         mPlatformState->addCriterionTypeValuePair<Audio>(gRouteCriterionType[route->
                                                                              getRouteType()],
                                                          route->getName(),
                                                          route->getMask());
     }
+    addStartupTiming("criteria registration", phaseStartTime);
+
+    // The PFW start parses its own configuration and applies the initial settings: meanwhile,
+    // resolve the sound cards of the routes and open their mixers, needed by the first routing
+    // and capabilities loading.
+    int64_t soundCardsWarmUpTimeUs = 0;
+    std::future<void> soundCardsWarmUp = std::async(std::launch::async, [&]() {
+        int64_t warmUpStartTime = getMonotonicTimeUs();
+        warmUpSoundCards();
+        soundCardsWarmUpTimeUs = getMonotonicTimeUs() - warmUpStartTime;
+    });
 
     /// Construct the platform state component and start it
     status = mPlatformState->start();
     AUDIOCOMMS_ASSERT(status == NO_ERROR, "AudioRouteManager: could not start Platform State");
+    addStartupTiming("platform state start", phaseStartTime);
+
+    soundCardsWarmUp.get();
+    mStartupTimings.push_back(std::make_pair(string("sound cards warm up"),
+                                             soundCardsWarmUpTimeUs));
+    addStartupTiming("sound cards warm up wait", phaseStartTime);
+
+    mFwErrorReporter = new FwErrorReporter(*mPlatformState, mRoutingLock);
+    if (!mFwErrorReporter->start()) {
+        Log::Error() << __FUNCTION__ << ": firmware errors will not be reported";
+    }
 
     // Now that is setup correctly to ensure the route service, start the event thread!
     bool isStarted = mEventThread->start();
     AUDIOCOMMS_ASSERT(isStarted, "AudioRouteManager: Failed to start event thread");
+    addStartupTiming("event thread start", phaseStartTime);
 
+    mStartupTimings.push_back(std::make_pair(string("total"), getMonotonicTimeUs() - startTime));
+}
+
+status_t AudioRouteManager::loadConfiguration(Criteria &criteria, CriterionTypes &criterionTypes)
+{
+    RouteManagerConfig config(*mRoutes, criteria, criterionTypes, mParameters,
+                              mPlatformState->getConnector<Audio>());
+    RouteSerializer serializer;
+
+    // In each folder, prefer the precompiled image if still matching its XML sources. A file that
+    // cannot be deserialized falls back on the next one, as the serializer checks the root
+    // element and version of the document before populating the configuration.
+    for (const auto &path : gConfigFilePathList) {
+        string imageFile = string(path) + string(gConfigImageFileName);
+        RouteConfigImage image;
+        if (image.load(imageFile) == OK && image.isUpToDate(path)) {
+            if (serializer.deserialize(image, config) == OK) {
+                mConfigurationSource = imageFile;
+                return OK;
+            }
+            Log::Error() << __FUNCTION__ << ": could not deserialize " << imageFile;
+        }
+        string xmlFile = string(path) + string(gConfigFileName);
+        if (image.parseXml(xmlFile) == OK) {
+            if (serializer.deserialize(image, config) == OK) {
+                mConfigurationSource = xmlFile;
+                return OK;
+            }
+            Log::Error() << __FUNCTION__ << ": could not deserialize " << xmlFile;
+        }
+    }
+    return NAME_NOT_FOUND;
+}
+
+void AudioRouteManager::warmUpSoundCards() const
+{
+    for (const auto route : *mRoutes) {
+        if (route->getRouteType() >= ROUTE_TYPE_BACKEND) {
+            continue;
+        }
+        const AudioStreamRoute *streamRoute = static_cast<const AudioStreamRoute *>(route);
+        // Failed lookups are not cached: a card not probed yet is resolved on first use.
+        SoundCardRegistry::getMixer(SoundCardRegistry::getCardIndex(streamRoute->getCardName()));
+    }
+}
+
+void AudioRouteManager::addStartupTiming(const std::string &phase, int64_t &phaseStartTime)
+{
+    int64_t now = getMonotonicTimeUs();
+    mStartupTimings.push_back(std::make_pair(phase, now - phaseStartTime));
+    Log::Debug() << __FUNCTION__ << ": " << phase << " took " << now - phaseStartTime << " us";
+    phaseStartTime = now;
 }
 
 AudioRouteManager::~AudioRouteManager()
 {
+    // The reporter collects with routing lock held in R mode, stop it before locking
+    delete mFwErrorReporter;
+
     // Synchronous stop of the event thread must be called with NOT held lock as pending request
     // may need to be served
     mEventThread->stop();
@@ -198,37 +304,53 @@ void AudioRouteManager::reconsiderRoutingUnsafe(bool isSynchronous)
     AUDIOCOMMS_ASSERT(
         !mEventThread->inThreadContext(), "Failure: not in correct thread context!");
 
-    if (!isSynchronous) {
+    mReroutingRequests++;
+    if (mPendingRerouting == nullptr) {
+        mPendingRerouting.reset(new std::promise<void>());
+        mPendingReroutingDone = mPendingRerouting->get_future().share();
+
         // Trigs the processing of the list
         mEventThread->trig(NULL);
-    } else {
-        // Create a route manager observer
-        AudioRouteManagerObserver obs;
+    }
+    if (!isSynchronous) {
+        return;
+    }
+    std::shared_future<void> reroutingDone = mPendingReroutingDone;
 
-        // Add the observer to the route manager
-        addObserver(&obs);
+    // Unlock to allow the worker thread to serve the pending reconsideration
+    mRoutingLock.unlock();
 
-        // Trig the processing of the list
-        mEventThread->trig(NULL);
+    reroutingDone.wait();
 
-        // Unlock to allow for sem wait
-        mRoutingLock.unlock();
+    // Relock
+    mRoutingLock.writeLock();
+}
 
-        // Wait a notification from the route manager
-        obs.waitNotification();
+void AudioRouteManager::doReconsiderRouting()
+{
+    // Whatever the event running it, the evaluation serves the pending reconsideration as all its
+    // requests have been issued with routing lock held.
+    std::unique_ptr<std::promise<void> > servedRerouting(std::move(mPendingRerouting));
+    mReroutingEvaluations++;
 
-        // Relock
-        mRoutingLock.writeLock();
+    evaluateRouting();
 
-        // Remove the observer from Route Manager
-        removeObserver(&obs);
+    if (servedRerouting != nullptr) {
+        servedRerouting->set_value();
     }
 }
 
-void AudioRouteManager::doReconsiderRouting()
+void AudioRouteManager::evaluateRouting()
 {
+    bool routingHasChanged = checkAndPrepareRouting();
+
+    // Routes in warm standby stay enabled: their streams are detached / attached without stage.
+    mRoutes->applyWarmStandby();
+    armWarmStandbyAlarm();
+    // Same for streams leaving / joining a shared route
+    mRoutes->detachLeavingSharedStreams();
 
-    if (!checkAndPrepareRouting()) {
+    if (!routingHasChanged) {
         // No need to reroute. Some criterion might have changed, update all criteria and apply
         // the conf in order to take for example tuning configuration that are glitch free and do
         // not need to go through the 5-steps routing.
@@ -237,6 +359,7 @@ void AudioRouteManager::doReconsiderRouting()
         if (mAudioSubsystemAvailable) {
             mPlatformState->commitCriteriaAndApplyConfiguration<Audio>();
         }
+        mRoutes->attachJoiningSharedStreams();
         return;
     }
     Log::Debug() << __FUNCTION__ << ": Route state:"
@@ -265,6 +388,7 @@ void AudioRouteManager::doReconsiderRouting()
                  << routeMaskToString<ROUTE_TYPE_STREAM_PLAYBACK>(mRoutes->needRepathRouteMask(
                                                          ROUTE_TYPE_STREAM_PLAYBACK));
     executeRouting();
+    mRoutes->attachJoiningSharedStreams();
     Log::Debug() << __FUNCTION__ << ": DONE";
 }
 
@@ -298,7 +422,7 @@ bool AudioRouteManager::checkAndPrepareRouting()
 {
     resetRouting();
     if (mAudioSubsystemAvailable) {
-        mRoutes->prepareRouting();
+        mRoutes->prepareRouting(getMonotonicTimeUs());
     }
     return mRoutes->routingHasChanged();
 }
@@ -391,6 +515,8 @@ bool AudioRouteManager::onEvent(int fd)
 {
     if (fd == mEventThread->getFd(FdFromSstDriver)) {
         bool audioSubsystemAvailable = mAudioSubsystemAvailable;
+        // Any crash / recovery or sound card uevent may change the card indexes and controls.
+        bool soundCardsChanged = true;
 #ifdef EMULATE_UEVENT
         int clientSocketFd = accept(mUEventFd, NULL, NULL);
         if (clientSocketFd < 0) {
@@ -431,19 +557,27 @@ bool AudioRouteManager::onEvent(int fd)
         }
         msg[n] = '\0';
         cp = msg;
+        soundCardsChanged = false;
         while (cp < msg + n) {
-            if (!strcmp(cp, gRecoverUevent.c_str())) {
+            if (!strcmp(cp, gSoundSubsystemUevent.c_str())) {
+                soundCardsChanged = true;
+            } else if (!strcmp(cp, gRecoverUevent.c_str())) {
                 Log::Warning() << __FUNCTION__ << ": Audio Subsystem Up and Running again :-)";
                 audioSubsystemAvailable = true;
+                soundCardsChanged = true;
                 break;
             } else if (!strcmp(cp, gCrashUevent.c_str())) {
                 Log::Warning() << __FUNCTION__ << ": Audio Subsystem down :-(";
                 audioSubsystemAvailable = false;
+                soundCardsChanged = true;
                 break;
             }
             cp += strlen(cp) + 1;
         }
 #endif
+        if (soundCardsChanged) {
+            SoundCardRegistry::invalidate();
+        }
         AutoW lock(mRoutingLock);
         if (audioSubsystemAvailable != mAudioSubsystemAvailable) {
             mAudioSubsystemAvailable = audioSubsystemAvailable;
@@ -463,9 +597,22 @@ bool AudioRouteManager::onHangup(int)
     return false;
 }
 
+void AudioRouteManager::armWarmStandbyAlarm()
+{
+    int64_t deadlineUs = mRoutes->getNextWarmStandbyDeadlineUs();
+    if (deadlineUs == 0) {
+        mEventThread->cancelAlarm();
+        return;
+    }
+    int64_t delayUs = deadlineUs - getMonotonicTimeUs();
+    mEventThread->setAlarmMs(delayUs > 0 ? (delayUs + 999) / 1000 : 1);
+}
+
 void AudioRouteManager::onAlarm()
 {
-    Log::Debug() << __FUNCTION__;
+    Log::Debug() << __FUNCTION__ << ": end of standby delay";
+    AutoW lock(mRoutingLock);
+    doReconsiderRouting();
 }
 
 void AudioRouteManager::onPollError()
@@ -475,11 +622,11 @@ void AudioRouteManager::onPollError()
 bool AudioRouteManager::onProcess(void *, uint32_t)
 {
     AutoW lock(mRoutingLock);
+    if (mPendingRerouting == nullptr) {
+        // Already served by an evaluation upon alarm or uevent
+        return false;
+    }
     doReconsiderRouting();
-
-    // Notify all potential observer of Route Manager Subject
-    notify();
-
     return false;
 }
 
@@ -523,8 +670,23 @@ status_t AudioRouteManager::setVoiceVolume(float gain)
     return android::OK;
 }
 
+void AudioRouteManager::loadPendingCapabilities(const IoStream &stream) const
+{
+    audio_devices_t devices = stream.getDevices();
+    {
+        AutoR lock(mRoutingLock);
+        if (!mRoutes->hasPendingCapabilities(devices)) {
+            return;
+        }
+    }
+    // Loading reads the device (e.g. EDID), and changes capabilities the routing relies on.
+    AutoW lock(mRoutingLock);
+    mRoutes->loadPendingCapabilities(devices);
+}
+
 uint32_t AudioRouteManager::getPeriodInUs(const IoStream &stream) const
 {
+    loadPendingCapabilities(stream);
     AutoR lock(mRoutingLock);
     const AudioStreamRoute *route = mRoutes->findMatchingRouteForStream(stream);
     if (route == NULL) {
@@ -537,6 +699,7 @@ uint32_t AudioRouteManager::getPeriodInUs(const IoStream &stream) const
 
 uint32_t AudioRouteManager::getLatencyInUs(const IoStream &stream) const
 {
+    loadPendingCapabilities(stream);
     AutoR lock(mRoutingLock);
     const AudioStreamRoute *route = mRoutes->findMatchingRouteForStream(stream);
     if (route == NULL) {
@@ -549,11 +712,13 @@ uint32_t AudioRouteManager::getLatencyInUs(const IoStream &stream) const
 
 bool AudioRouteManager::supportStreamConfig(const IoStream &stream) const
 {
+    loadPendingCapabilities(stream);
     return mRoutes->findMatchingRouteForStream(stream) != nullptr;
 }
 
 AudioCapabilities AudioRouteManager::getCapabilities(const IoStream &stream) const
 {
+    loadPendingCapabilities(stream);
     auto streamRoute = mRoutes->findMatchingRouteForStream(stream);
     if (streamRoute != nullptr) {
         return streamRoute->getCapabilities();
@@ -588,6 +753,8 @@ status_t AudioRouteManager::setParameters(const std::string &keyValuePair, bool
     int device;
     status_t status = pairs.get<int>(AUDIO_PARAMETER_DEVICE_CONNECT, device);
     if (status == android::OK) {
+        // A connected device may come with its own card (USB, HDMI), drop stale card resources.
+        SoundCardRegistry::invalidate();
         mRoutes->handleDeviceConnectionState(device, true);
     }
     status = pairs.get<int>(AUDIO_PARAMETER_DEVICE_DISCONNECT, device);
@@ -603,6 +770,11 @@ std::string AudioRouteManager::getParameters(const std::string &keys) const
     return mPlatformState->getParameters(keys);
 }
 
+void AudioRouteManager::reportPlatformFwError()
+{
+    mFwErrorReporter->post();
+}
+
 android::status_t AudioRouteManager::dump(const int fd, int spaces) const
 {
     AutoR lock(mRoutingLock);
@@ -612,8 +784,23 @@ android::status_t AudioRouteManager::dump(const int fd, int spaces) const
 
     snprintf(buffer, SIZE, "%*sAudio Route Manager:\n", spaces, "");
     result.append(buffer);
+    snprintf(buffer, SIZE, "%*sConfiguration: %s\n", spaces + 2, "",
+             mConfigurationSource.c_str());
+    result.append(buffer);
+    snprintf(buffer, SIZE, "%*sStartup timings:\n", spaces + 2, "");
+    result.append(buffer);
+    for (const auto &timing : mStartupTimings) {
+        snprintf(buffer, SIZE, "%*s- %s: %lld us\n", spaces + 4, "", timing.first.c_str(),
+                 static_cast<long long>(timing.second));
+        result.append(buffer);
+    }
+    snprintf(buffer, SIZE, "%*sRouting reconsiderations: %llu requested, %llu evaluated\n",
+             spaces + 2, "", static_cast<unsigned long long>(mReroutingRequests),
+             static_cast<unsigned long long>(mReroutingEvaluations));
+    result.append(buffer);
 
     write(fd, result.string(), result.size());
+    mFwErrorReporter->dump(fd, spaces + 2);
     mRoutes->dump(fd, spaces + 4);
     return android::OK;
 }
@@ -28,6 +28,7 @@
 #include <policy.h>
 #include <utils/String8.h>
 #include "AudioPort.hpp"
+#include <algorithm>
 using namespace std;
 using audio_comms::utilities::Log;
 
@@ -39,7 +40,9 @@ AudioStreamRoute::AudioStreamRoute(string name, AudioPorts &sinks, AudioPorts &s
     : AudioRoute(name, sinks, sources, type),
       mCurrentStream(NULL),
       mNewStream(NULL),
-      mEffectSupported(0)
+      mEffectSupported(0),
+      mCapabilitiesLoadPending(false),
+      mPeriodCountController(0, 0, 0)
 {
     mIsOut = (type == ROUTE_TYPE_STREAM_PLAYBACK);
     MixPort *port = NULL;
@@ -50,6 +53,8 @@ AudioStreamRoute::AudioStreamRoute(string name, AudioPorts &sinks, AudioPorts &s
     }
     mConfig = port->getConfig();
     mAudioDevice = port->getAlsaDevice();
+    mPeriodCountController = PeriodCountController(mConfig.minPeriodCount,
+                                                   mConfig.maxPeriodCount, mConfig.periodCount);
 }
 
 AudioStreamRoute::~AudioStreamRoute()
@@ -63,20 +68,64 @@ void AudioStreamRoute::loadCapabilities()
     mConfig.loadCapabilities();
 }
 
+void AudioStreamRoute::deferCapabilitiesLoading()
+{
+    Log::Debug() << __FUNCTION__ << ": for route " << getName();
+    mCapabilitiesLoadPending = true;
+}
+
+void AudioStreamRoute::loadPendingCapabilities()
+{
+    if (!mCapabilitiesLoadPending) {
+        return;
+    }
+    loadCapabilities();
+    mCapabilitiesLoadPending = false;
+}
+
 void AudioStreamRoute::resetCapabilities()
 {
+    mCapabilitiesLoadPending = false;
     mConfig.resetCapabilities();
 }
 
 bool AudioStreamRoute::needReflow()
 {
-    if (stillUsed() && (mCurrentStream == mNewStream) && mCurrentStream->needReconfigure()) {
+    if (!stillUsed() || (mCurrentStream != mNewStream)) {
+        return false;
+    }
+    if (mCurrentStream->needReconfigure()) {
         // it is now safe to reset the stream NeedReconfigure flag, route has been marked as
         // need to be reconfigured to be muted and unmuted while the change is taken into account.
         mCurrentStream->resetNeedReconfigure();
         return true;
     }
-    return false;
+    // A new period count is taken into account when reopening the device, i.e. upon reflow.
+    return adaptPeriodCount();
+}
+
+bool AudioStreamRoute::adaptPeriodCount()
+{
+    if (!mPeriodCountController.isEnabled() || mAudioDevice == nullptr) {
+        return false;
+    }
+    XrunMonitor &xrunMonitor = mAudioDevice->getXrunMonitor();
+    uint32_t xrunCount = xrunMonitor.getXrunCount();
+    int64_t activeNs = xrunMonitor.getActiveTimeNs();
+    mPeriodCountController.addStatistics(xrunCount - mLastXrunCount,
+                                         xrunMonitor.consumeMaxTransferIntervalNs(),
+                                         activeNs - mLastActiveNs);
+    mLastXrunCount = xrunCount;
+    mLastActiveNs = activeNs;
+
+    int64_t periodNs = static_cast<int64_t>(getPeriodInUs()) * 1000;
+    if (!mPeriodCountController.adapt(periodNs)) {
+        return false;
+    }
+    Log::Debug() << __FUNCTION__ << ": route " << getName() << " period count "
+                 << mConfig.periodCount << " -> " << mPeriodCountController.getPeriodCount();
+    mConfig.setPeriodCount(mPeriodCountController.getPeriodCount());
+    return true;
 }
 
 android::status_t AudioStreamRoute::route(bool isPreEnable)
@@ -84,6 +133,7 @@ android::status_t AudioStreamRoute::route(bool isPreEnable)
     AUDIOCOMMS_ASSERT(mAudioDevice != nullptr, "No valid device attached");
     if (isPreEnable == isPreEnableRequired()) {
 
+        adaptPeriodCount();
         android::status_t err = mAudioDevice->open(getCardName(), getPcmDeviceId(),
                                                    getRouteConfig(), isOut());
         if (err) {
@@ -91,6 +141,16 @@ android::status_t AudioStreamRoute::route(bool isPreEnable)
             // Failed to open PCM device -> bailing out
             return err;
         }
+        if (isShared() && !isOut()) {
+            mCaptureFanOut.reset(*mAudioDevice, mConfig.periodSize);
+        } else if (isShared() &&
+                   mPlaybackMixer.reset(*mAudioDevice, getSampleSpec(), mConfig.periodSize) !=
+                   android::OK) {
+            // Streams writing the device directly would interleave their frames
+            Log::Error() << __FUNCTION__ << ": route " << getName()
+                         << " cannot mix its streams, serving a single stream from now on";
+            mIsMixingUnsupported = true;
+        }
     }
 
     if (!isPreEnable) {
@@ -130,11 +190,15 @@ void AudioStreamRoute::unroute(bool isPostDisable)
          * Detach the stream from its route at the beginning of unrouting stage
          * Action of audio-parameter-manager on the audio path may lead to blocking issue, so
          * need to garantee that the stream will not access to the device before unrouting.
+         * A route in warm standby has no stream attached anymore.
          */
-        detachCurrentStream();
+        if (mCurrentStream != NULL) {
+            detachCurrentStream();
+        }
     }
 
     if (isPostDisable == isPostDisableRequired()) {
+        mWarmStandbyDeadlineUs = 0;
 
         android::status_t err = mAudioDevice->close();
         if (err) {
@@ -144,12 +208,88 @@ void AudioStreamRoute::unroute(bool isPostDisable)
     }
 }
 
+bool AudioStreamRoute::keepWarmStandby(int64_t nowUs)
+{
+    if (mConfig.standbyDelayMs == 0 || mAudioDevice == nullptr || !mAudioDevice->isOpened()) {
+        return false;
+    }
+    if (!isWarmStandby()) {
+        mWarmStandbyDeadlineUs = nowUs + static_cast<int64_t>(mConfig.standbyDelayMs) * 1000;
+        mWarmStandbySampleSpec = getSampleSpec();
+    }
+    return nowUs < mWarmStandbyDeadlineUs;
+}
+
+void AudioStreamRoute::applyWarmStandby()
+{
+    if (!isWarmStandby()) {
+        return;
+    }
+    if (mNewStream == NULL && mCurrentStream != NULL) {
+        Log::Debug() << __FUNCTION__ << ": route " << getName() << " enters warm standby";
+        detachCurrentStream();
+        // Next transfer restarts the device
+        mAudioDevice->pcmStop();
+    } else if (isWarmStandbyResumable()) {
+        Log::Debug() << __FUNCTION__ << ": route " << getName() << " resumed from warm standby";
+        if (attachNewStream() == android::OK) {
+            mWarmStandbyDeadlineUs = 0;
+        }
+    }
+}
+
+void AudioStreamRoute::detachLeavingSharedStreams()
+{
+    for (auto it = mCurrentSharedStreams.begin(); it != mCurrentSharedStreams.end();) {
+        IoStream *stream = *it;
+        if (std::find(mNewSharedStreams.begin(), mNewSharedStreams.end(), stream) !=
+            mNewSharedStreams.end() && stillUsed() && !needRepath()) {
+            ++it;
+            continue;
+        }
+        Log::Debug() << __FUNCTION__ << ": stream " << stream << " leaves route " << getName();
+        stream->detachRoute();
+        it = mCurrentSharedStreams.erase(it);
+    }
+}
+
+void AudioStreamRoute::attachJoiningSharedStreams()
+{
+    if (mCurrentStream == NULL) {
+        // Not routed, shared streams will be attached with the stream of the route
+        return;
+    }
+    for (auto stream : mNewSharedStreams) {
+        if (std::find(mCurrentSharedStreams.begin(), mCurrentSharedStreams.end(), stream) !=
+            mCurrentSharedStreams.end()) {
+            continue;
+        }
+        if (!isShared()) {
+            // Admitted before the route found out it cannot be shared
+            Log::Error() << __FUNCTION__ << ": stream " << stream << " cannot join route "
+                         << getName();
+            continue;
+        }
+        if (stream->attachRoute() != android::OK) {
+            Log::Error() << __FUNCTION__ << ": failed to attach stream " << stream
+                         << " to route " << getName();
+            continue;
+        }
+        Log::Debug() << __FUNCTION__ << ": stream " << stream << " joins route " << getName();
+        mCurrentSharedStreams.push_back(stream);
+    }
+}
+
 void AudioStreamRoute::resetAvailability()
 {
     if (mNewStream) {
         mNewStream->resetNewStreamRoute();
         mNewStream = NULL;
     }
+    for (auto stream : mNewSharedStreams) {
+        stream->resetNewStreamRoute();
+    }
+    mNewSharedStreams.clear();
 
     /**
      * Reset route as available
@@ -168,10 +308,16 @@ bool AudioStreamRoute::setStream(IoStream &stream)
         Log::Error() << __FUNCTION__ << ": to route " << getName() << " which has not the same dir";
         return false;
     }
-    if (mNewStream != NULL) {
+    if (!canAcceptStream()) {
         Log::Error() << __FUNCTION__ << ": route " << getName() << " is busy";
         return false;
     }
+    if (mNewStream != NULL) {
+        Log::Verbose() << __FUNCTION__ << ": shares " << getName() << " route";
+        mNewSharedStreams.push_back(&stream);
+        stream.setNewStreamRoute(this);
+        return true;
+    }
     Log::Verbose() << __FUNCTION__ << ": to " << getName() << " route";
     mNewStream = &stream;
 
@@ -259,6 +405,7 @@ android::status_t AudioStreamRoute::attachNewStream()
     }
 
     mCurrentStream = mNewStream;
+    attachJoiningSharedStreams();
 
     return android::OK;
 }
@@ -270,6 +417,10 @@ android::status_t AudioStreamRoute::detachCurrentStream()
                      << " from invalid stream";
         return android::DEAD_OBJECT;
     }
+    for (auto stream : mCurrentSharedStreams) {
+        stream->detachRoute();
+    }
+    mCurrentSharedStreams.clear();
     mCurrentStream->detachRoute();
     mCurrentStream = NULL;
     return android::OK;
@@ -318,7 +469,35 @@ android::status_t AudioStreamRoute::dump(const int fd, int spaces) const
     snprintf(buffer, SIZE, "%*s- CurrentFormat: %s\n", spaces + 4, "",
              FormatConverter::toString(mConfig.getFormat()).c_str());
     result.append(buffer);
-    snprintf(buffer, SIZE, "%*sConfiguration:\n", spaces + 2, "");
+    if (mAudioDevice != nullptr) {
+        const XrunMonitor &xrunMonitor = mAudioDevice->getXrunMonitor();
+        snprintf(buffer, SIZE, "%*s- Xruns: %u (%u per minute), frames lost: %llu\n",
+                 spaces + 4, "", xrunMonitor.getXrunCount(), xrunMonitor.getXrunsPerMinute(),
+                 static_cast<unsigned long long>(xrunMonitor.getFramesLost()));
+        result.append(buffer);
+    }
+    if (isShared()) {
+        snprintf(buffer, SIZE, "%*s- shared by %zu stream(s) out of %u, %s: %u\n",
+                 spaces + 4, "", mCurrentSharedStreams.size() + (mCurrentStream != nullptr),
+                 mConfig.maxStreams, isOut() ? "mixer underruns" : "slow readers",
+                 isOut() ? mPlaybackMixer.getUnderrunCount() :
+                 mCaptureFanOut.getSlowReaderCount());
+        result.append(buffer);
+    }
+    if (isWarmStandby()) {
+        snprintf(buffer, SIZE, "%*s- in warm standby until: %lld us\n", spaces + 4, "",
+                 static_cast<long long>(mWarmStandbyDeadlineUs));
+        result.append(buffer);
+    }
+    snprintf(buffer, SIZE, "%*s- CurrentPeriodCount: %u", spaces + 4, "", mConfig.periodCount);
+    result.append(buffer);
+    if (mPeriodCountController.isEnabled()) {
+        snprintf(buffer, SIZE, " (adaptive within [%u, %u])",
+                 mPeriodCountController.getMinPeriodCount(),
+                 mPeriodCountController.getMaxPeriodCount());
+        result.append(buffer);
+    }
+    snprintf(buffer, SIZE, "\n%*sConfiguration:\n", spaces + 2, "");
     result.append(buffer);
     snprintf(buffer, SIZE, "%*s- requirePreEnable: %d\n", spaces + 4, "", mConfig.requirePreEnable);
     result.append(buffer);
@@ -333,6 +512,11 @@ android::status_t AudioStreamRoute::dump(const int fd, int spaces) const
     result.append(buffer);
     snprintf(buffer, SIZE, "%*s- deviceId: %d\n", spaces + 4, "", mConfig.deviceId);
     result.append(buffer);
+    snprintf(buffer, SIZE, "%*s- standbyDelayMs: %u\n", spaces + 4, "", mConfig.standbyDelayMs);
+    result.append(buffer);
+    snprintf(buffer, SIZE, "%*s- capabilities loading pending: %d\n", spaces + 4, "",
+             mCapabilitiesLoadPending.load());
+    result.append(buffer);
     snprintf(buffer, SIZE, "%*s- device Address: %s\n", spaces + 4, "",
              mConfig.deviceAddress.c_str());
     result.append(buffer);
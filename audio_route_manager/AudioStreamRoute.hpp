@@ -18,9 +18,13 @@
 #include "IStreamRoute.hpp"
 #include "MixPortConfig.hpp"
 #include "AudioCapabilities.hpp"
+#include "PeriodCountController.hpp"
 #include <AudioUtils.hpp>
 #include <SampleSpec.hpp>
 #include <IoStream.hpp>
+#include <CaptureFanOut.hpp>
+#include <PlaybackMixer.hpp>
+#include <atomic>
 #include <list>
 #include <utils/Errors.h>
 #include "AudioPort.hpp"
@@ -49,11 +53,24 @@ public:
      */
     virtual void loadCapabilities();
 
+    /**
+     * Upon connection of device managed by this route, loading the capabilities may take long
+     * (EDID read), so it is deferred until a stream looks for a route supporting this device.
+     */
+    virtual void deferCapabilitiesLoading();
+
     /**
      * For route with dynamic behavior: upon disconnection of device managed by this route,
      * the capabilities shall be resetted.
      */
-    void resetCapabilities();
+    virtual void resetCapabilities();
+
+    /**
+     * Loads the capabilities from the device if their loading has been deferred.
+     */
+    virtual void loadPendingCapabilities();
+
+    virtual bool hasPendingCapabilities() const { return mCapabilitiesLoadPending; }
 
     /**
      * Get the sample specifications of this route.
@@ -78,6 +95,49 @@ public:
         return mAudioDevice;
     }
 
+    /**
+     * Get the shared capture of the route.
+     * From IStreamRoute, intended to be called by the stream.
+     *
+     * @return shared capture, NULL if the route serves a single stream.
+     */
+    virtual CaptureFanOut *getCaptureFanOut()
+    {
+        return (isShared() && !mIsOut) ? &mCaptureFanOut : NULL;
+    }
+
+    /**
+     * Get the mixer of the route.
+     * From IStreamRoute, intended to be called by the stream.
+     *
+     * @return mixer, NULL if the route serves a single stream.
+     */
+    virtual PlaybackMixer *getPlaybackMixer()
+    {
+        return (isShared() && mIsOut) ? &mPlaybackMixer : NULL;
+    }
+
+    /**
+     * Checks if the route may be shared by several streams, mixed for an output route, or
+     * fanned out for an input route. An output route whose format cannot be mixed serves a single
+     * stream, once detected upon opening.
+     *
+     * @return true if shared route, false otherwise.
+     */
+    bool isShared() const { return mConfig.maxStreams > 1 && !mIsMixingUnsupported; }
+
+    /**
+     * Checks if another stream may be assigned to this route, i.e. the route has no new stream
+     * yet, or it is a shared route with room for another stream.
+     *
+     * @return true if a stream may be set, false otherwise.
+     */
+    bool canAcceptStream() const
+    {
+        return (mNewStream == NULL) ||
+               (isShared() && (mNewSharedStreams.size() + 1 < mConfig.maxStreams));
+    }
+
     /**
      * Get amount of silence delay upon stream opening.
      * From IStreamRoute, intended to be called by the stream.
@@ -103,6 +163,8 @@ public:
      * Assign a new stream to this route.
      * It overrides the applicability of Route Parameter Manager to apply the port strategy
      * and to match the mask of the stream requesting to be routed.
+     * The first stream sets the configuration of the route, other streams of a shared route
+     * convert their frames from / to this configuration.
      *
      * @param true if the stream has been attached to the route, falsoe otherwise..
      */
@@ -244,9 +306,43 @@ public:
      */
     bool needRepath() const
     {
-        return stillUsed() && (mCurrentStream != mNewStream);
+        return stillUsed() && (mCurrentStream != mNewStream) && !isWarmStandbyResumable();
     }
 
+    /**
+     * Checks if the route, left without stream, shall stay enabled in warm standby, i.e. with its
+     * device opened but stopped. The standby delay starts on first call.
+     *
+     * @param[in] nowUs monotonic time in microseconds.
+     *
+     * @return true if the standby delay of the route has not elapsed yet, false otherwise.
+     */
+    bool keepWarmStandby(int64_t nowUs);
+
+    /** @return true if the route is enabled without stream, false otherwise. */
+    bool isWarmStandby() const { return mWarmStandbyDeadlineUs != 0; }
+
+    /** @return end of the standby delay in microseconds, 0 if not in warm standby. */
+    int64_t getWarmStandbyDeadlineUs() const { return mWarmStandbyDeadlineUs; }
+
+    /**
+     * Detaches the stream of a route entering warm standby, and stops the device, or attaches
+     * the new stream of a route leaving warm standby, without any routing stage.
+     */
+    void applyWarmStandby();
+
+    /**
+     * Detaches the streams that do not share the route anymore.
+     * To be called before the routing stages, as these streams may be attached to other routes.
+     */
+    void detachLeavingSharedStreams();
+
+    /**
+     * Attaches the streams joining a shared route already enabled, without any
+     * routing stage. To be called after the routing stages.
+     */
+    void attachJoiningSharedStreams();
+
     AudioCapabilities getCapabilities() const { return mConfig.mAudioCapabilities; }
 
     android::status_t dump(const int fd, int spaces = 0) const;
@@ -254,11 +350,19 @@ public:
 protected:
     IoStream *mCurrentStream; /**< Current stream attached to this route. */
     IoStream *mNewStream; /**< New stream that will be attached to this route after rerouting. */
+    std::list<IoStream *> mCurrentSharedStreams; /**< Other streams sharing the route. */
+    std::list<IoStream *> mNewSharedStreams; /**< Other streams that will share the route. */
 
     std::list<std::string> mEffectSupported; /**< list of name of supported effects. */
     uint32_t mEffectSupportedMask; /**< Mask of supported effects. */
     MixPortConfig mConfig; /**< Configuration of the audio stream route. */
 
+    /**
+     * Device connected, capabilities to be loaded on first use. Written with routing lock held in
+     * W mode, read with the lock in R mode to avoid taking it in W mode if nothing is pending.
+     */
+    std::atomic<bool> mCapabilitiesLoadPending;
+
 private:
     bool supportDeviceAddress(const std::string &streamDeviceAddress, audio_devices_t device) const;
 
@@ -325,7 +429,36 @@ private:
      */
     android::status_t detachCurrentStream();
 
+    /**
+     * A route in warm standby may be resumed by a new stream without any routing stage if the
+     * device opened matches the configuration required by the new stream.
+     */
+    bool isWarmStandbyResumable() const
+    {
+        return isWarmStandby() && (mCurrentStream == NULL) && (mNewStream != NULL) &&
+               (getSampleSpec() == mWarmStandbySampleSpec);
+    }
+
+    /**
+     * Feeds the period count controller with the statistics of the audio device, and applies its
+     * decision to the configuration used on next opening of the device.
+     *
+     * @return true if the period count has changed, false otherwise.
+     */
+    bool adaptPeriodCount();
+
     IAudioDevice *mAudioDevice; /**< Platform dependant audio device. */
+
+    PeriodCountController mPeriodCountController;
+    uint32_t mLastXrunCount = 0; /**< Xrun count of the device at previous adaptation. */
+    int64_t mLastActiveNs = 0; /**< Active time of the device at previous adaptation. */
+
+    int64_t mWarmStandbyDeadlineUs = 0; /**< End of the standby delay, 0 if not in standby. */
+    SampleSpec mWarmStandbySampleSpec; /**< Sample spec of the device kept opened. */
+
+    CaptureFanOut mCaptureFanOut; /**< Frames captured once, read by all the streams. */
+    PlaybackMixer mPlaybackMixer; /**< Frames of all the streams, mixed once played. */
+    bool mIsMixingUnsupported = false; /**< Mixer failed to handle the device configuration. */
     bool mIsOut;
 };
 
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RouteManager/FwErrorReporter"
+
+#include "FwErrorReporter.hpp"
+#include <AudioPlatformState.hpp>
+#include <utilities/Log.hpp>
+#include <utils/String8.h>
+#include <algorithm>
+#include <stdio.h>
+#include <unistd.h>
+
+using audio_comms::utilities::Log;
+using audio_comms::utilities::Mutex;
+typedef android::RWLock::AutoRLock AutoR;
+
+namespace intel_audio
+{
+
+/** Size of the info kept per report, the debug files being logged in full upon collection. */
+static const size_t gMaxReportInfoSize = 16 * 1024;
+
+/** Size of the info logged per message, well below the size the log truncates messages to. */
+static const size_t gMaxLogChunkSize = 1024;
+
+const int64_t FwErrorReporter::mMinReportIntervalUs;
+const size_t FwErrorReporter::mMaxReports;
+
+FwErrorReporter::FwErrorReporter(const AudioPlatformState &platformState,
+                                 android::RWLock &platformStateLock)
+    : mPlatformState(platformState),
+      mPlatformStateLock(platformStateLock),
+      mPostedErrors(0),
+      mPendingErrors(0),
+      mLastReportTimeUs(0),
+      mThreadRunning(false),
+      mExitRequested(false)
+{
+}
+
+FwErrorReporter::~FwErrorReporter()
+{
+    stop();
+}
+
+bool FwErrorReporter::start()
+{
+    Mutex::Locker locker(mLock);
+    if (mThreadRunning) {
+        return true;
+    }
+    mExitRequested = false;
+    if (pthread_create(&mThread, NULL, workerThreadLoop, this) != 0) {
+        Log::Error() << __FUNCTION__ << ": failed to create firmware error reporter thread";
+        return false;
+    }
+    mThreadRunning = true;
+    return true;
+}
+
+void FwErrorReporter::stop()
+{
+    Mutex::Locker locker(mLock);
+    if (!mThreadRunning) {
+        return;
+    }
+    mExitRequested = true;
+    mCondition.signal();
+    mLock.unlock();
+    pthread_join(mThread, NULL);
+    mLock.lock();
+    mThreadRunning = false;
+    mPendingErrors = 0;
+}
+
+void FwErrorReporter::post()
+{
+    Mutex::Locker locker(mLock);
+    mPostedErrors++;
+    mPendingErrors++;
+    mCondition.signal();
+}
+
+void *FwErrorReporter::workerThreadLoop(void *context)
+{
+    static_cast<FwErrorReporter *>(context)->workerLoop();
+    return NULL;
+}
+
+void FwErrorReporter::workerLoop()
+{
+    mLock.lock();
+    while (!mExitRequested) {
+        if (mPendingErrors == 0) {
+            mCondition.wait(mLock);
+            continue;
+        }
+        uint32_t errors = mPendingErrors;
+        mPendingErrors = 0;
+        int64_t now = getMonotonicTimeUs();
+        if (mLastReportTimeUs != 0 && now - mLastReportTimeUs < mMinReportIntervalUs) {
+            // The audio device keeps failing: the firmware state collected lately still stands
+            mReports.back().errors += errors;
+            continue;
+        }
+        mLastReportTimeUs = now;
+
+        // Debug files are read without lock: streams post errors meanwhile.
+        mLock.unlock();
+        Report report;
+        report.errors = errors;
+        collectReport(report);
+        mLock.lock();
+        mReports.push_back(report);
+        if (mReports.size() > mMaxReports) {
+            mReports.pop_front();
+        }
+    }
+    mLock.unlock();
+}
+
+void FwErrorReporter::collectReport(Report &report)
+{
+    Log::Error() << "^^^^  Print platform Audio firmware error info  ^^^^";
+    clock_gettime(CLOCK_REALTIME, &report.time);
+    {
+        AutoR lock(mPlatformStateLock);
+        mPlatformState.getPlatformFwErrorInfo(report.info);
+    }
+    logInfo(report.info);
+    if (report.info.size() > gMaxReportInfoSize) {
+        report.info.resize(gMaxReportInfoSize);
+        report.info += "\n[truncated]";
+    }
+}
+
+void FwErrorReporter::logInfo(const std::string &info)
+{
+    size_t start = 0;
+    while (start < info.size()) {
+        size_t end = info.find('\n', start);
+        if (end == std::string::npos) {
+            end = info.size();
+        }
+        size_t chunkSize = std::min(end - start, gMaxLogChunkSize);
+        if (chunkSize != 0) {
+            Log::Error() << info.substr(start, chunkSize);
+        }
+        start += chunkSize;
+        if (start == end) {
+            // Line logged in full: skip its end
+            start++;
+        }
+    }
+}
+
+void FwErrorReporter::dump(const int fd, int spaces) const
+{
+    Mutex::Locker locker(mLock);
+    const size_t SIZE = 256;
+    char buffer[SIZE];
+    android::String8 result;
+
+    snprintf(buffer, SIZE, "%*sFirmware errors: %u posted, %zu last reports:\n", spaces, "",
+             mPostedErrors, mReports.size());
+    result.append(buffer);
+    for (const auto &report : mReports) {
+        struct tm time;
+        char timeString[32];
+        localtime_r(&report.time.tv_sec, &time);
+        strftime(timeString, sizeof(timeString), "%m-%d %H:%M:%S", &time);
+        snprintf(buffer, SIZE, "%*s- %s.%03ld: %u error(s)\n", spaces + 2, "", timeString,
+                 report.time.tv_nsec / 1000000, report.errors);
+        result.append(buffer);
+        result.append(report.info.c_str());
+        if (!report.info.empty() && report.info.back() != '\n') {
+            result.append("\n");
+        }
+    }
+    write(fd, result.string(), result.size());
+}
+
+int64_t FwErrorReporter::getMonotonicTimeUs() const
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+} // namespace intel_audio
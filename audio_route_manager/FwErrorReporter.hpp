@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <AudioNonCopyable.hpp>
+#include <ConditionVariable.hpp>
+#include <Mutex.hpp>
+#include <utils/RWLock.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <list>
+#include <string>
+
+namespace intel_audio
+{
+
+class AudioPlatformState;
+
+/**
+ * Collects the audio firmware error info on a worker thread.
+ *
+ * Streams post the errors of the audio device from their audio thread, which must not wait for
+ * the debug files to be read. Errors posted within the rate limit interval after a report are
+ * counted as repeats of this report and not collected again. The last reports are kept for dump.
+ */
+class FwErrorReporter : private audio_comms::utilities::NonCopyable
+{
+public:
+    /**
+     * @param[in] platformState collecting the debug files.
+     * @param[in] platformStateLock taken in R mode while collecting.
+     */
+    FwErrorReporter(const AudioPlatformState &platformState,
+                    android::RWLock &platformStateLock);
+    virtual ~FwErrorReporter();
+
+    /** @return true if the worker thread is started, false otherwise. */
+    bool start();
+
+    /** Stops the worker thread, errors pending are dropped. */
+    void stop();
+
+    /** Posts an error of the audio device. Does not wait for the collection. */
+    void post();
+
+    void dump(const int fd, int spaces = 0) const;
+
+    /** Errors posted within this interval after a report are repeats of this report. */
+    static const int64_t mMinReportIntervalUs = 10000000;
+
+    /** Number of reports kept for dump. */
+    static const size_t mMaxReports = 4;
+
+protected:
+    /**
+     * @return monotonic time in microseconds, read by the worker thread with lock held for each
+     *         batch of errors posted.
+     */
+    virtual int64_t getMonotonicTimeUs() const;
+
+private:
+    struct Report
+    {
+        struct timespec time; /**< Realtime of the collection. */
+        uint32_t errors; /**< Errors served by this report, i.e. including its repeats. */
+        std::string info;
+    };
+
+    static void *workerThreadLoop(void *context);
+
+    /** Collects a report for each error posted, rate limited, until stopped. */
+    void workerLoop();
+
+    /** Collects the firmware error info. From worker thread, without lock held. */
+    void collectReport(Report &report);
+
+    /** Logs the info line by line, long lines in chunks, as the log truncates long messages. */
+    static void logInfo(const std::string &info);
+
+    const AudioPlatformState &mPlatformState;
+    android::RWLock &mPlatformStateLock;
+
+    uint32_t mPostedErrors; /**< Errors posted since start. */
+    uint32_t mPendingErrors; /**< Errors posted, not served by the worker yet. */
+    int64_t mLastReportTimeUs; /**< Monotonic time of the last collection, 0 if none. */
+    std::list<Report> mReports; /**< Last reports, oldest first. */
+
+    pthread_t mThread;
+    bool mThreadRunning;
+    bool mExitRequested;
+    audio_comms::utilities::ConditionVariable mCondition; /**< Error posted or exit requested. */
+    mutable audio_comms::utilities::Mutex mLock;
+};
+
+} // namespace intel_audio
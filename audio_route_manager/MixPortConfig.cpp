@@ -19,9 +19,10 @@
 #include "MixPortConfig.hpp"
 #include <AudioConversion.hpp>
 #include <tinyalsa/asoundlib.h>
-#include <AudioUtils.hpp>
+#include <SoundCardRegistry.hpp>
 #include <convert.hpp>
 #include <utilities/Log.hpp>
+#include <algorithm>
 #include <string>
 
 using namespace std;
@@ -116,6 +117,21 @@ uint32_t MixPortConfig::getChannelCount() const
            audio_channel_count_from_in_mask(getChannelMask());
 }
 
+void MixPortConfig::setPeriodCount(uint32_t count)
+{
+    uint32_t bufferSize = periodSize * periodCount;
+    uint32_t newBufferSize = periodSize * count;
+    for (uint32_t *threshold : { &startThreshold, &stopThreshold }) {
+        // Thresholds beyond the ring buffer (i.e. boundary) are left unchanged
+        if (*threshold == bufferSize) {
+            *threshold = newBufferSize;
+        } else if (*threshold < bufferSize) {
+            *threshold = std::min(*threshold, newBufferSize);
+        }
+    }
+    periodCount = count;
+}
+
 void MixPortConfig::resetCapabilities()
 {
     for (auto &capabilities : mAudioCapabilities) {
@@ -150,30 +166,28 @@ android::status_t MixPortConfig::loadChannelMaskCapabilities(AudioCapability &ca
     // Discover supported channel maps from control parameter
     Log::Debug() << __FUNCTION__ << ": Control for channels: " << dynamicChannelMapsControl;
 
-    struct mixer *mixer;
     struct mixer_ctl *ctl;
     unsigned int channelMaskSize;
     int channelCount = 0;
 
-    int cardIndex = AudioUtils::getCardIndexByName(cardName.c_str());
+    int cardIndex = SoundCardRegistry::getCardIndex(cardName);
     if (cardIndex < 0) {
         Log::Error() << __FUNCTION__ << ": Failed to get Card Name index " << cardIndex;
         return android::BAD_VALUE;
     }
-    mixer = mixer_open(cardIndex);
+    std::shared_ptr<struct mixer> mixer = SoundCardRegistry::getMixer(cardIndex);
     if (!mixer) {
         Log::Error() << __FUNCTION__ << ": Failed to open mixer for card " << cardName.c_str();
         return android::BAD_VALUE;
     }
     uint32_t controlNumber;
     if (convertTo<std::string, uint32_t>(dynamicChannelMapsControl, controlNumber)) {
-        ctl = mixer_get_ctl(mixer, controlNumber);
+        ctl = mixer_get_ctl(mixer.get(), controlNumber);
     } else {
-        ctl = mixer_get_ctl_by_name(mixer, dynamicChannelMapsControl.c_str());
+        ctl = mixer_get_ctl_by_name(mixer.get(), dynamicChannelMapsControl.c_str());
     }
     if (mixer_ctl_get_type(ctl) != MIXER_CTL_TYPE_INT) {
         audio_comms::utilities::Log::Error() << __FUNCTION__ << ": invalid mixer type";
-        mixer_close(mixer);
         return android::BAD_VALUE;
     }
     channelMaskSize = mixer_ctl_get_num_values(ctl);
@@ -200,7 +214,6 @@ android::status_t MixPortConfig::loadChannelMaskCapabilities(AudioCapability &ca
         audio_channel_mask_t mask = isOut ? AUDIO_CHANNEL_OUT_STEREO : AUDIO_CHANNEL_IN_STEREO;
         capability.mSupportedChannelMasks.push_back(mask);
     }
-    mixer_close(mixer);
     return android::OK;
 }
 
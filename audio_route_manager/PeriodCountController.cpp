@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "RouteManager/PeriodCountController"
+
+#include "PeriodCountController.hpp"
+#include <utilities/Log.hpp>
+#include <algorithm>
+
+using audio_comms::utilities::Log;
+
+namespace intel_audio
+{
+
+const int64_t PeriodCountController::mMinObservationNs = 10 * 1000000000LL;
+const uint32_t PeriodCountController::mCalmWindowsToDecrease;
+
+PeriodCountController::PeriodCountController(uint32_t minPeriodCount, uint32_t maxPeriodCount,
+                                             uint32_t periodCount)
+    : mMinPeriodCount(minPeriodCount),
+      mMaxPeriodCount(maxPeriodCount),
+      mPeriodCount(periodCount),
+      mCalmWindows(0)
+{
+    if (isEnabled()) {
+        mPeriodCount = std::min(std::max(periodCount, mMinPeriodCount), mMaxPeriodCount);
+    }
+    restartWindow();
+}
+
+void PeriodCountController::restartWindow()
+{
+    mWindowXruns = 0;
+    mWindowMaxTransferIntervalNs = 0;
+    mWindowActiveNs = 0;
+}
+
+void PeriodCountController::addStatistics(uint32_t xruns, int64_t maxTransferIntervalNs,
+                                          int64_t activeNs)
+{
+    mWindowXruns += xruns;
+    mWindowMaxTransferIntervalNs = std::max(mWindowMaxTransferIntervalNs, maxTransferIntervalNs);
+    mWindowActiveNs += activeNs;
+}
+
+bool PeriodCountController::adapt(int64_t periodNs)
+{
+    if (!isEnabled() || periodNs <= 0) {
+        return false;
+    }
+    if (mWindowXruns == 0 && mWindowActiveNs < mMinObservationNs) {
+        // Not enough observed yet to lower the latency
+        return false;
+    }
+    uint32_t periodCount = mPeriodCount;
+    int64_t marginNs = periodCount * periodNs - mWindowMaxTransferIntervalNs;
+
+    if (mWindowXruns != 0 || marginNs < periodNs) {
+        periodCount = std::min(periodCount + 1, mMaxPeriodCount);
+        mCalmWindows = 0;
+    } else if (periodCount > mMinPeriodCount && marginNs >= 2 * periodNs) {
+        // One period less would still have left a period of margin
+        if (++mCalmWindows >= mCalmWindowsToDecrease) {
+            periodCount--;
+            mCalmWindows = 0;
+        }
+    } else {
+        mCalmWindows = 0;
+    }
+    Log::Verbose() << __FUNCTION__ << ": xruns=" << mWindowXruns
+                   << " max transfer interval=" << mWindowMaxTransferIntervalNs << "ns"
+                   << " period=" << periodNs << "ns, period count " << mPeriodCount << " -> "
+                   << periodCount;
+    restartWindow();
+
+    if (periodCount == mPeriodCount) {
+        return false;
+    }
+    mPeriodCount = periodCount;
+    return true;
+}
+
+} // namespace intel_audio
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdint.h>
+
+namespace intel_audio
+{
+
+/**
+ * Adapts the number of periods of the ring buffer of a stream route to the load of the system.
+ *
+ * Statistics of the audio device (xruns, largest interval between transfers) are accumulated
+ * over an observation window. An xrun, or a transfer interval leaving less than a period of
+ * margin, adds a period (i.e. trades latency for robustness). Several calm windows in a row,
+ * which would have kept a period of margin with one period less, remove a period.
+ *
+ * Opt-in: only enabled if the route declares a range of period counts.
+ */
+class PeriodCountController
+{
+public:
+    /**
+     * @param[in] minPeriodCount lower bound of period count.
+     * @param[in] maxPeriodCount upper bound of period count.
+     * @param[in] periodCount initial period count.
+     */
+    PeriodCountController(uint32_t minPeriodCount, uint32_t maxPeriodCount,
+                          uint32_t periodCount);
+
+    bool isEnabled() const { return mMinPeriodCount < mMaxPeriodCount; }
+
+    /**
+     * Accumulates statistics of the audio device in the observation window.
+     *
+     * @param[in] xruns number of xruns since previous call.
+     * @param[in] maxTransferIntervalNs largest interval between transfers since previous call.
+     * @param[in] activeNs streaming time since previous call.
+     */
+    void addStatistics(uint32_t xruns, int64_t maxTransferIntervalNs, int64_t activeNs);
+
+    /**
+     * Evaluates the observation window, if long enough or upon xrun, then restarts it.
+     *
+     * @param[in] periodNs duration of a period.
+     *
+     * @return true if the period count has changed, false otherwise.
+     */
+    bool adapt(int64_t periodNs);
+
+    uint32_t getPeriodCount() const { return mPeriodCount; }
+
+    uint32_t getMinPeriodCount() const { return mMinPeriodCount; }
+
+    uint32_t getMaxPeriodCount() const { return mMaxPeriodCount; }
+
+    /** Minimum streaming time of an observation window without xrun to be evaluated. */
+    static const int64_t mMinObservationNs;
+
+    /** Number of calm windows in a row required to lower the latency. */
+    static const uint32_t mCalmWindowsToDecrease = 3;
+
+private:
+    void restartWindow();
+
+    uint32_t mMinPeriodCount;
+    uint32_t mMaxPeriodCount;
+    uint32_t mPeriodCount;
+
+    uint32_t mWindowXruns;
+    int64_t mWindowMaxTransferIntervalNs;
+    int64_t mWindowActiveNs;
+    uint32_t mCalmWindows;
+};
+
+} // namespace intel_audio
@@ -0,0 +1,520 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RouteManager::ConfigImage"
+
+#include "RouteConfigImage.hpp"
+#include <utilities/Log.hpp>
+#include <libxml/parser.h>
+#include <libxml/xinclude.h>
+#include <libxml/uri.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <map>
+
+using android::status_t;
+using audio_comms::utilities::Log;
+
+namespace intel_audio
+{
+
+const uint32_t RouteConfigImage::gMagic = 0x49434d52; // "RMCI" in little endian
+const uint16_t RouteConfigImage::gMajor = 1;
+const uint16_t RouteConfigImage::gMinor = 0;
+const uint32_t RouteConfigImage::gInvalidIndex = UINT32_MAX;
+
+class RouteConfigImage::Builder
+{
+public:
+    Builder(xmlDocPtr doc, const std::string &configFolder)
+        : mDoc(doc), mConfigFolder(configFolder)
+    {}
+
+    /**
+     * Records an XML source of the image, with its size and checksum.
+     *
+     * @return true if the source could be read, false otherwise.
+     */
+    bool addSource(const std::string &path)
+    {
+        std::vector<uint8_t> content;
+        if (!readFile(path, content)) {
+            Log::Error() << __FUNCTION__ << ": could not read source " << path;
+            return false;
+        }
+        std::string relativePath = path;
+        if (relativePath.compare(0, mConfigFolder.size(), mConfigFolder) == 0) {
+            relativePath.erase(0, mConfigFolder.size());
+        }
+        uint32_t pathOffset = addString(relativePath);
+        for (const auto &source : mSources) {
+            if (source.path == pathOffset) {
+                return true;
+            }
+        }
+        mSources.push_back({pathOffset, static_cast<uint32_t>(content.size()),
+                            computeChecksum(content.data(), content.size())});
+        return true;
+    }
+
+    /**
+     * Adds an element and, recursively, all its children elements. Elements are stored in
+     * document order, so that children and siblings always have a greater index than the element.
+     *
+     * @return index of the element within the image.
+     */
+    uint32_t addElement(const xmlNode *element)
+    {
+        uint32_t index = mNodes.size();
+        NodeRecord record = {
+            addString(reinterpret_cast<const char *>(element->name)),
+            static_cast<uint32_t>(mAttributes.size()), 0, gInvalidIndex, gInvalidIndex
+        };
+        for (const xmlAttr *attribute = element->properties; attribute != NULL;
+             attribute = attribute->next) {
+            xmlChar *value = xmlGetProp(element, attribute->name);
+            mAttributes.push_back({addString(reinterpret_cast<const char *>(attribute->name)),
+                                   addString(value != NULL ?
+                                             reinterpret_cast<const char *>(value) : "")});
+            xmlFree(value);
+            record.attributeCount += 1;
+        }
+        mNodes.push_back(record);
+
+        uint32_t previous = gInvalidIndex;
+        for (const xmlNode *child = element->children; child != NULL; child = child->next) {
+            if (child->type == XML_XINCLUDE_START) {
+                addInclude(child);
+            }
+            if (child->type != XML_ELEMENT_NODE) {
+                continue;
+            }
+            uint32_t childIndex = addElement(child);
+            if (previous == gInvalidIndex) {
+                mNodes[index].firstChild = childIndex;
+            } else {
+                mNodes[previous].nextSibling = childIndex;
+            }
+            previous = childIndex;
+        }
+        return index;
+    }
+
+    /**
+     * Serializes the collected records into the image layout.
+     */
+    void build(std::vector<uint8_t> &image) const
+    {
+        size_t sourcesSize = mSources.size() * sizeof(SourceRecord);
+        size_t nodesSize = mNodes.size() * sizeof(NodeRecord);
+        size_t attributesSize = mAttributes.size() * sizeof(AttributeRecord);
+        size_t payloadSize = sourcesSize + nodesSize + attributesSize + mStrings.size();
+
+        image.assign(sizeof(Header) + payloadSize, 0);
+        uint8_t *payload = image.data() + sizeof(Header);
+        uint8_t *cursor = payload;
+        memcpy(cursor, mSources.data(), sourcesSize);
+        cursor += sourcesSize;
+        memcpy(cursor, mNodes.data(), nodesSize);
+        cursor += nodesSize;
+        memcpy(cursor, mAttributes.data(), attributesSize);
+        cursor += attributesSize;
+        memcpy(cursor, mStrings.data(), mStrings.size());
+
+        Header header = {
+            gMagic, gMajor, gMinor,
+            static_cast<uint32_t>(payloadSize),
+            computeChecksum(payload, payloadSize),
+            static_cast<uint32_t>(mSources.size()),
+            static_cast<uint32_t>(mNodes.size()),
+            static_cast<uint32_t>(mAttributes.size()),
+            static_cast<uint32_t>(mStrings.size())
+        };
+        memcpy(image.data(), &header, sizeof(header));
+    }
+
+private:
+    uint32_t addString(const std::string &value)
+    {
+        auto it = mStringOffsets.find(value);
+        if (it != mStringOffsets.end()) {
+            return it->second;
+        }
+        uint32_t offset = mStrings.size();
+        mStrings.append(value.c_str(), value.size() + 1);
+        mStringOffsets[value] = offset;
+        return offset;
+    }
+
+    /** Records the file included by an XInclude node as a source of the image. */
+    void addInclude(const xmlNode *include)
+    {
+        // xmlGetProp only applies to element nodes, look for the attribute by hand.
+        xmlChar *href = NULL;
+        for (const xmlAttr *attribute = include->properties; attribute != NULL;
+             attribute = attribute->next) {
+            if (xmlStrEqual(attribute->name, reinterpret_cast<const xmlChar *>("href"))) {
+                href = xmlNodeListGetString(mDoc, attribute->children, 1);
+                break;
+            }
+        }
+        if (href == NULL) {
+            return;
+        }
+        xmlChar *base = xmlNodeGetBase(mDoc, include);
+        xmlChar *uri = xmlBuildURI(href, base);
+        if (uri != NULL) {
+            addSource(reinterpret_cast<const char *>(uri));
+        }
+        xmlFree(uri);
+        xmlFree(base);
+        xmlFree(href);
+    }
+
+    xmlDocPtr mDoc;
+    std::string mConfigFolder;
+    std::vector<SourceRecord> mSources;
+    std::vector<NodeRecord> mNodes;
+    std::vector<AttributeRecord> mAttributes;
+    std::string mStrings;
+    std::map<std::string, uint32_t> mStringOffsets;
+};
+
+RouteConfigImage::Node::Node(const RouteConfigImage *image, uint32_t index)
+    : mImage(image),
+      mRecord((image->mHeader != nullptr && index < image->mHeader->nodeCount) ?
+              &image->mNodes[index] : nullptr)
+{
+}
+
+const char *RouteConfigImage::Node::getName() const
+{
+    return mImage->getString(mRecord->name);
+}
+
+bool RouteConfigImage::Node::hasName(const char *name) const
+{
+    return strcmp(getName(), name) == 0;
+}
+
+std::string RouteConfigImage::Node::getAttribute(const char *name) const
+{
+    const AttributeRecord *attributes = mImage->mAttributes + mRecord->firstAttribute;
+    for (uint32_t i = 0; i < mRecord->attributeCount; i++) {
+        if (strcmp(mImage->getString(attributes[i].name), name) == 0) {
+            return mImage->getString(attributes[i].value);
+        }
+    }
+    return "";
+}
+
+RouteConfigImage::Node RouteConfigImage::Node::getFirstChild() const
+{
+    return Node(mImage, mRecord->firstChild);
+}
+
+RouteConfigImage::Node RouteConfigImage::Node::getNextSibling() const
+{
+    return Node(mImage, mRecord->nextSibling);
+}
+
+RouteConfigImage::RouteConfigImage()
+    : mHeader(nullptr),
+      mSources(nullptr),
+      mNodes(nullptr),
+      mAttributes(nullptr),
+      mStrings(nullptr),
+      mMappedImage(nullptr),
+      mMappedSize(0),
+      mMappedTime(0)
+{
+}
+
+RouteConfigImage::~RouteConfigImage()
+{
+    reset();
+}
+
+void RouteConfigImage::reset()
+{
+    mHeader = nullptr;
+    mSources = nullptr;
+    mNodes = nullptr;
+    mAttributes = nullptr;
+    mStrings = nullptr;
+    mOwnedImage.clear();
+    if (mMappedImage != nullptr) {
+        munmap(mMappedImage, mMappedSize);
+        mMappedImage = nullptr;
+        mMappedSize = 0;
+        mMappedTime = 0;
+    }
+}
+
+status_t RouteConfigImage::parseXml(const std::string &xmlFile)
+{
+    reset();
+    xmlDocPtr doc = xmlParseFile(xmlFile.c_str());
+    if (doc == NULL) {
+        Log::Error() << __FUNCTION__ << ": Could not parse document " << xmlFile;
+        return android::BAD_VALUE;
+    }
+    if (xmlXIncludeProcess(doc) < 0) {
+        Log::Error() << __FUNCTION__ << ": libxml failed to resolve XIncludes on document "
+                     << xmlFile;
+    }
+    xmlNodePtr root = xmlDocGetRootElement(doc);
+    if (root == NULL) {
+        Log::Error() << __FUNCTION__ << ": Could not parse: empty document " << xmlFile;
+        xmlFreeDoc(doc);
+        return android::BAD_VALUE;
+    }
+    Builder builder(doc, xmlFile.substr(0, xmlFile.find_last_of('/') + 1));
+    builder.addSource(xmlFile);
+    builder.addElement(root);
+    xmlFreeDoc(doc);
+
+    builder.build(mOwnedImage);
+    status_t status = setImage(mOwnedImage.data(), mOwnedImage.size());
+    if (status != android::OK) {
+        reset();
+    }
+    return status;
+}
+
+status_t RouteConfigImage::load(const std::string &imageFile)
+{
+    reset();
+    int fd = open(imageFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        status_t status = -errno;
+        Log::Verbose() << __FUNCTION__ << ": no image " << imageFile << ": " << strerror(-status);
+        return status;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) < 0 || fileStat.st_size < static_cast<off_t>(sizeof(Header))) {
+        Log::Error() << __FUNCTION__ << ": invalid image " << imageFile;
+        close(fd);
+        return android::BAD_VALUE;
+    }
+    void *data = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    status_t mapStatus = (data == MAP_FAILED) ? -errno : android::OK;
+    close(fd);
+    if (mapStatus != android::OK) {
+        Log::Error() << __FUNCTION__ << ": could not map " << imageFile << ": "
+                     << strerror(-mapStatus);
+        return mapStatus;
+    }
+    mMappedImage = data;
+    mMappedSize = fileStat.st_size;
+    mMappedTime = fileStat.st_mtime;
+
+    status_t status = setImage(static_cast<const uint8_t *>(data), mMappedSize);
+    if (status != android::OK) {
+        Log::Error() << __FUNCTION__ << ": corrupted or incompatible image " << imageFile;
+        reset();
+    }
+    return status;
+}
+
+status_t RouteConfigImage::save(const std::string &imageFile) const
+{
+    if (mHeader == nullptr) {
+        return android::NO_INIT;
+    }
+    size_t size = sizeof(Header) + mHeader->payloadSize;
+    int fd = open(imageFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        status_t status = -errno;
+        Log::Error() << __FUNCTION__ << ": could not create " << imageFile << ": "
+                     << strerror(-status);
+        return status;
+    }
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(mHeader);
+    size_t written = 0;
+    while (written < size) {
+        ssize_t ret = write(fd, data + written, size - written);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            status_t status = -errno;
+            Log::Error() << __FUNCTION__ << ": could not write " << imageFile << ": "
+                         << strerror(-status);
+            close(fd);
+            return status;
+        }
+        written += ret;
+    }
+    close(fd);
+    return android::OK;
+}
+
+status_t RouteConfigImage::setImage(const uint8_t *data, size_t size)
+{
+    if (size < sizeof(Header)) {
+        return android::BAD_VALUE;
+    }
+    const Header *header = reinterpret_cast<const Header *>(data);
+    if (header->magic != gMagic || header->major != gMajor) {
+        Log::Error() << __FUNCTION__ << ": unsupported image version " << header->major << "."
+                     << header->minor << ", expecting " << gMajor << "." << gMinor;
+        return android::BAD_VALUE;
+    }
+    const uint8_t *payload = data + sizeof(Header);
+    uint64_t expectedSize = static_cast<uint64_t>(header->sourceCount) * sizeof(SourceRecord) +
+                            static_cast<uint64_t>(header->nodeCount) * sizeof(NodeRecord) +
+                            static_cast<uint64_t>(header->attributeCount) *
+                            sizeof(AttributeRecord) +
+                            header->stringTableSize;
+    if (header->payloadSize != size - sizeof(Header) || expectedSize != header->payloadSize) {
+        Log::Error() << __FUNCTION__ << ": inconsistent image size";
+        return android::BAD_VALUE;
+    }
+    if (computeChecksum(payload, header->payloadSize) != header->payloadChecksum) {
+        Log::Error() << __FUNCTION__ << ": checksum mismatch";
+        return android::BAD_VALUE;
+    }
+    const SourceRecord *sources = reinterpret_cast<const SourceRecord *>(payload);
+    const NodeRecord *nodes = reinterpret_cast<const NodeRecord *>(sources + header->sourceCount);
+    const AttributeRecord *attributes =
+        reinterpret_cast<const AttributeRecord *>(nodes + header->nodeCount);
+    const char *strings = reinterpret_cast<const char *>(attributes + header->attributeCount);
+
+    // Checksum only protects against corruption: check every index before trusting them.
+    // Children and siblings always follow their element, which also forbids any loop.
+    uint32_t stringTableSize = header->stringTableSize;
+    if (header->nodeCount == 0 || stringTableSize == 0 || strings[stringTableSize - 1] != '\0') {
+        return android::BAD_VALUE;
+    }
+    for (uint32_t i = 0; i < header->sourceCount; i++) {
+        if (sources[i].path >= stringTableSize) {
+            return android::BAD_VALUE;
+        }
+    }
+    for (uint32_t i = 0; i < header->nodeCount; i++) {
+        const NodeRecord &node = nodes[i];
+        if (node.name >= stringTableSize ||
+            static_cast<uint64_t>(node.firstAttribute) + node.attributeCount >
+            header->attributeCount ||
+            (node.firstChild != gInvalidIndex &&
+             (node.firstChild <= i || node.firstChild >= header->nodeCount)) ||
+            (node.nextSibling != gInvalidIndex &&
+             (node.nextSibling <= i || node.nextSibling >= header->nodeCount))) {
+            return android::BAD_VALUE;
+        }
+    }
+    for (uint32_t i = 0; i < header->attributeCount; i++) {
+        if (attributes[i].name >= stringTableSize || attributes[i].value >= stringTableSize) {
+            return android::BAD_VALUE;
+        }
+    }
+    mHeader = header;
+    mSources = sources;
+    mNodes = nodes;
+    mAttributes = attributes;
+    mStrings = strings;
+    return android::OK;
+}
+
+bool RouteConfigImage::isUpToDate(const std::string &configFolder) const
+{
+    if (mHeader == nullptr) {
+        return false;
+    }
+    if (mMappedImage == nullptr) {
+        // Built from the sources themselves
+        return true;
+    }
+    for (uint32_t i = 0; i < mHeader->sourceCount; i++) {
+        std::string path = getString(mSources[i].path);
+        if (path.empty() || path[0] != '/') {
+            path = configFolder + path;
+        }
+        struct stat sourceStat;
+        if (stat(path.c_str(), &sourceStat) < 0) {
+            Log::Warning() << __FUNCTION__ << ": source " << path << " not found, "
+                           << "image trusted";
+            continue;
+        }
+        if (sourceStat.st_size != static_cast<off_t>(mSources[i].size) ||
+            sourceStat.st_mtime > mMappedTime) {
+            Log::Warning() << __FUNCTION__ << ": source " << path << " modified since image "
+                           << "installed";
+            return false;
+        }
+    }
+    return true;
+}
+
+RouteConfigImage::Node RouteConfigImage::getRoot() const
+{
+    return Node(this, 0);
+}
+
+bool RouteConfigImage::readFile(const std::string &path, std::vector<uint8_t> &content)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    content.clear();
+    uint8_t buffer[4096];
+    ssize_t ret;
+    while ((ret = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            return false;
+        }
+        content.insert(content.end(), buffer, buffer + ret);
+    }
+    close(fd);
+    return true;
+}
+
+uint32_t RouteConfigImage::computeChecksum(const void *data, size_t size)
+{
+    static const struct Table
+    {
+        Table()
+        {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    crc = (crc & 1) ? (0xEDB88320 ^ (crc >> 1)) : (crc >> 1);
+                }
+                values[i] = crc;
+            }
+        }
+        uint32_t values[256];
+    } table;
+
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc = table.values[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+} // namespace intel_audio
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <AudioNonCopyable.hpp>
+#include <utils/Errors.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+namespace intel_audio
+{
+
+/**
+ * Flat, position independent image of the route manager configuration document.
+ *
+ * The image holds the element tree of audio_policy_configuration.xml once XIncludes have been
+ * resolved: element names, attributes and parent / child / sibling links, all stored as indexes
+ * in fixed size records followed by a string table. It can either be built from the XML file
+ * (parsing it with libxml2) or memory-mapped from a binary file generated at build time, in which
+ * case no XML work is performed at all.
+ *
+ * Binary layout (native endianness, all fields 32-bit aligned):
+ *      Header | SourceRecord[sourceCount] | NodeRecord[nodeCount] |
+ *      AttributeRecord[attributeCount] | string table
+ *
+ * The header carries a checksum of the payload, and each source record the size and checksum of
+ * an XML file the image was built from. A corrupted image is detected when loaded. A stale image,
+ * i.e. whose XML sources were modified once installed, is detected from the file attributes only,
+ * so that the XML files are not read at all at boot. In both cases the caller may fall back on the
+ * XML file.
+ */
+class RouteConfigImage : private audio_comms::utilities::NonCopyable
+{
+private:
+    struct NodeRecord;
+
+public:
+    /**
+     * Lightweight cursor on an element of the image. Only valid while the image lives.
+     */
+    class Node
+    {
+    public:
+        /** @return true if the cursor points to an element, false if end of list reached. */
+        bool isValid() const { return mRecord != nullptr; }
+
+        /** @return tag name of the element. */
+        const char *getName() const;
+
+        /** @return true if the tag name of the element matches the given name. */
+        bool hasName(const char *name) const;
+
+        /**
+         * @param[in] name of the attribute.
+         *
+         * @return value of the attribute, empty string if the element has no such attribute.
+         */
+        std::string getAttribute(const char *name) const;
+
+        /** @return first child element, invalid node if the element has no child. */
+        Node getFirstChild() const;
+
+        /** @return next sibling element, invalid node if the element is the last one. */
+        Node getNextSibling() const;
+
+    private:
+        friend class RouteConfigImage;
+
+        Node(const RouteConfigImage *image, uint32_t index);
+
+        const RouteConfigImage *mImage;
+        const NodeRecord *mRecord;
+    };
+
+    RouteConfigImage();
+    ~RouteConfigImage();
+
+    /**
+     * Builds the image from an XML configuration file, resolving its XIncludes.
+     *
+     * @param[in] xmlFile path of the XML configuration file.
+     *
+     * @return OK if the document has been parsed, error code otherwise.
+     */
+    android::status_t parseXml(const std::string &xmlFile);
+
+    /**
+     * Maps a binary image previously generated with save. Header, checksum and every index of the
+     * image are checked before the image is considered as loaded.
+     *
+     * @param[in] imageFile path of the binary image.
+     *
+     * @return OK if the image is valid, error code otherwise.
+     */
+    android::status_t load(const std::string &imageFile);
+
+    /**
+     * Writes the image into a binary file that may later be loaded.
+     *
+     * @param[in] imageFile path of the binary image to create.
+     *
+     * @return OK if the image has been written, error code otherwise.
+     */
+    android::status_t save(const std::string &imageFile) const;
+
+    /**
+     * Checks the XML sources the image was built from against the ones found in the given folder,
+     * without reading them: a source is considered as modified if its size differs from the one
+     * recorded in the image, or if it is more recent than the loaded image file (e.g. pushed
+     * for tuning). An image built from XML is always up to date.
+     * A source that could not be found cannot invalidate the image, as there would be no XML to
+     * fall back on: the image is trusted, with a warning.
+     *
+     * @param[in] configFolder folder in which the XML sources are installed.
+     *
+     * @return true if no source was modified since the image was installed, false otherwise.
+     */
+    bool isUpToDate(const std::string &configFolder) const;
+
+    /** @return root element of the image, invalid node if no image loaded. */
+    Node getRoot() const;
+
+    /**
+     * Computes the checksum (CRC-32) used by the image.
+     *
+     * @param[in] data buffer to checksum.
+     * @param[in] size of the buffer in bytes.
+     *
+     * @return checksum of the buffer.
+     */
+    static uint32_t computeChecksum(const void *data, size_t size);
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t major;
+        uint16_t minor;
+        uint32_t payloadSize; /**< Size in bytes following the header. */
+        uint32_t payloadChecksum;
+        uint32_t sourceCount;
+        uint32_t nodeCount;
+        uint32_t attributeCount;
+        uint32_t stringTableSize;
+    };
+
+    struct SourceRecord
+    {
+        uint32_t path; /**< Offset in string table, relative to the main XML file folder. */
+        uint32_t size;
+        uint32_t checksum;
+    };
+
+    struct NodeRecord
+    {
+        uint32_t name; /**< Offset in string table. */
+        uint32_t firstAttribute;
+        uint32_t attributeCount;
+        uint32_t firstChild;
+        uint32_t nextSibling;
+    };
+
+    struct AttributeRecord
+    {
+        uint32_t name; /**< Offset in string table. */
+        uint32_t value; /**< Offset in string table. */
+    };
+
+    /** Builds the image during XML parsing. */
+    class Builder;
+
+    /**
+     * Sets the image on a buffer, checking its consistency.
+     *
+     * @return OK if the buffer holds a valid image, error code otherwise.
+     */
+    android::status_t setImage(const uint8_t *data, size_t size);
+
+    /** Releases the current image, if any. */
+    void reset();
+
+    const char *getString(uint32_t offset) const { return mStrings + offset; }
+
+    static bool readFile(const std::string &path, std::vector<uint8_t> &content);
+
+    const Header *mHeader;
+    const SourceRecord *mSources;
+    const NodeRecord *mNodes;
+    const AttributeRecord *mAttributes;
+    const char *mStrings;
+
+    std::vector<uint8_t> mOwnedImage; /**< Storage of the image when built from XML. */
+    void *mMappedImage; /**< Storage of the image when mapped from a file. */
+    size_t mMappedSize;
+    time_t mMappedTime; /**< Modification time of the mapped file. */
+
+    static const uint32_t gMagic;
+    static const uint16_t gMajor; /**< Bumped on any incompatible change of the layout. */
+    static const uint16_t gMinor;
+    static const uint32_t gInvalidIndex;
+};
+
+} // namespace intel_audio
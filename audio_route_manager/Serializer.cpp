@@ -26,8 +26,6 @@
 #include "MixPortConfig.hpp"
 #include <convert.hpp>
 #include <typeconverter/TypeConverter.hpp>
-#include <libxml/parser.h>
-#include <libxml/xinclude.h>
 #include <string>
 #include <vector>
 #include <sstream>
@@ -48,78 +46,40 @@ namespace intel_audio
 
 typedef std::pair<std::string, std::string> AndroidParamMappingValuePair;
 
-string getXmlAttribute(const xmlNode *cur, const char *attribute)
-{
-    xmlChar *xmlValue = xmlGetProp(cur, (const xmlChar *)attribute);
-    if (xmlValue == NULL) {
-        return "";
-    }
-    string value((const char *)xmlValue);
-    xmlFree(xmlValue);
-    return value;
-}
-
 const char *const RouteSerializer::rootName = "audioPolicyConfiguration";
 const char *const RouteSerializer::versionAttribute = "version";
 const uint32_t RouteSerializer::gMajor = 1;
 const uint32_t RouteSerializer::gMinor = 0;
 
-static const char *const gReferenceElementName = "reference";
-static const char *const gReferenceAttributeName = "name";
-
 template <class Trait>
-static void getReference(const _xmlNode *root, const _xmlNode * &refNode, const string &refName)
-{
-    const _xmlNode *col = root;
-    while (col != NULL) {
-        if (!xmlStrcmp(col->name, (const xmlChar *)Trait::collectionTag)) {
-            const xmlNode *cur = col->children;
-            while (cur != NULL) {
-                if ((!xmlStrcmp(cur->name, (const xmlChar *)gReferenceElementName))) {
-                    string name = getXmlAttribute(cur, gReferenceAttributeName);
-                    if (refName == name) {
-                        refNode = cur;
-                        return;
-                    }
-                }
-                cur = cur->next;
-            }
-        }
-        col = col->next;
-    }
-    return;
-}
-
-template <class Trait>
-static status_t deserializeCollection(_xmlDoc *doc, const _xmlNode *cur,
+static status_t deserializeCollection(const RouteConfigImage::Node &cur,
                                       typename Trait::Collection &collection,
                                       typename Trait::PtrSerializingCtx serializingContext)
 {
-    const xmlNode *root = cur->xmlChildrenNode;
-    while (root != NULL) {
-        if (xmlStrcmp(root->name, (const xmlChar *)Trait::collectionTag) &&
-            xmlStrcmp(root->name, (const xmlChar *)Trait::tag)) {
-            root = root->next;
+    RouteConfigImage::Node root = cur.getFirstChild();
+    while (root.isValid()) {
+        if (!root.hasName(Trait::collectionTag) && !root.hasName(Trait::tag)) {
+            root = root.getNextSibling();
             continue;
         }
-        const xmlNode *child = root;
-        if (!xmlStrcmp(child->name, (const xmlChar *)Trait::collectionTag)) {
-            child = child->xmlChildrenNode;
+        RouteConfigImage::Node child = root;
+        if (child.hasName(Trait::collectionTag)) {
+            child = child.getFirstChild();
         }
-        while (child != NULL) {
-            if (!xmlStrcmp(child->name, (const xmlChar *)Trait::tag)) {
+        while (child.isValid()) {
+            if (child.hasName(Trait::tag)) {
                 typename Trait::PtrElement element;
-                status_t status = Trait::deserialize(doc, child, element, serializingContext);
+                status_t status = Trait::deserialize(child, element, serializingContext);
                 if (status == NO_ERROR) {
                     collection.push_back(element);
                 }
             }
-            child = child->next;
+            child = child.getNextSibling();
         }
-        if (!xmlStrcmp(root->name, (const xmlChar *)Trait::tag)) {
+        if (root.hasName(Trait::tag)) {
             return NO_ERROR;
         }
-        root = root->next;
+        root = root.getNextSibling();
     }
     return NO_ERROR;
 }
@@ -176,18 +136,18 @@ const char AudioCriterionTypeTraits::Attributes::name[] = "name";
 const char AudioCriterionTypeTraits::Attributes::type[] = "type";
 const char AudioCriterionTypeTraits::Attributes::values[] = "values";
 
-status_t AudioCriterionTypeTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode *child,
+status_t AudioCriterionTypeTraits::deserialize(const RouteConfigImage::Node &child,
                                                PtrElement &criterionType,
                                                PtrSerializingCtx serializingContext)
 {
-    string name = getXmlAttribute(child, Attributes::name);
+    string name = child.getAttribute(Attributes::name);
     if (name.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::name << " found.";
         return BAD_VALUE;
     }
     Log::Verbose() << __FUNCTION__ << ": " << tag << " " << Attributes::name << "=" << name;
 
-    string type = getXmlAttribute(child, Attributes::type);
+    string type = child.getAttribute(Attributes::type);
     if (type.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::type << " found.";
         return BAD_VALUE;
@@ -201,7 +161,7 @@ status_t AudioCriterionTypeTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode
     Log::Verbose() << __FUNCTION__ << ": Adding " << name << " for " << tag << " PFW";
     criterionType = new CriterionType(name, isInclusive, serializingContext->getConnector());
 
-    string values = getXmlAttribute(child, Attributes::values);
+    string values = child.getAttribute(Attributes::values);
     if (values.empty()) {
         Log::Verbose() << __FUNCTION__ << ": No attribute " << Attributes::values << " found.";
     }
@@ -261,11 +221,11 @@ const char AudioCriterionTraits::Attributes::defaultVal[] = "default";
 const char AudioCriterionTraits::Attributes::mapping[] = "mapping";
 const char AudioCriterionTraits::Attributes::route[] = "route";
 
-status_t AudioCriterionTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode *child,
+status_t AudioCriterionTraits::deserialize(const RouteConfigImage::Node &child,
                                            PtrElement &criterion,
                                            PtrSerializingCtx serializingContext)
 {
-    string name = getXmlAttribute(child, Attributes::name);
+    string name = child.getAttribute(Attributes::name);
     if (name.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::name << " found.";
         return BAD_VALUE;
@@ -275,21 +235,21 @@ status_t AudioCriterionTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode *chi
     AUDIOCOMMS_ASSERT(serializingContext->getCriterion(name) == nullptr,
                       "Criterion " << name << " already added.");
 
-    string defaultValue = getXmlAttribute(child, Attributes::defaultVal);
+    string defaultValue = child.getAttribute(Attributes::defaultVal);
     if (defaultValue.empty()) {
         Log::Verbose() << __FUNCTION__ << ": No attribute " << Attributes::defaultVal << " found.";
     }
     Log::Verbose() << __FUNCTION__ << ": " << tag << " " << Attributes::defaultVal << "=" <<
         defaultValue;
 
-    string paramKey = getXmlAttribute(child, Attributes::parameter);
+    string paramKey = child.getAttribute(Attributes::parameter);
     if (paramKey.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::parameter << " found.";
     }
     Log::Verbose() << __FUNCTION__ << ": " << tag << " " << Attributes::parameter << "=" <<
         paramKey;
 
-    string criterionTypeName = getXmlAttribute(child, Attributes::type);
+    string criterionTypeName = child.getAttribute(Attributes::type);
     if (criterionTypeName.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::type << " found.";
     }
@@ -298,14 +258,14 @@ status_t AudioCriterionTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode *chi
     CriterionType *criterionType = serializingContext->getCriterionType(criterionTypeName);
 
     std::vector<AndroidParamMappingValuePair> valuePairs;
-    string mapping = getXmlAttribute(child, Attributes::mapping);
+    string mapping = child.getAttribute(Attributes::mapping);
     if (not mapping.empty()) {
         Log::Verbose() << __FUNCTION__ << ": " << tag << " " << Attributes::mapping << "=" <<
             mapping;
         valuePairs = parseMappingTable(mapping.c_str());
     }
 
-    string route = getXmlAttribute(child, Attributes::route);
+    string route = child.getAttribute(Attributes::route);
 
     criterion =
         new Criterion(name, criterionType, serializingContext->getConnector(), defaultValue);
@@ -330,18 +290,18 @@ const char RogueParameterTraits::Attributes::mapping[] = "mapping";
 const char RogueParameterTraits::Attributes::parameter[] = "parameter";
 const char RogueParameterTraits::Attributes::defaultVal[] = "default";
 
-status_t RogueParameterTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode *child,
+status_t RogueParameterTraits::deserialize(const RouteConfigImage::Node &child,
                                            PtrElement &paramRogue,
                                            PtrSerializingCtx serializingContext)
 {
-    string path = getXmlAttribute(child, Attributes::path);
+    string path = child.getAttribute(Attributes::path);
     if (path.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::path << " found.";
         return BAD_VALUE;
     }
     Log::Verbose() << __FUNCTION__ << ": " << tag << " " << Attributes::path << "=" << path;
 
-    string typeName = getXmlAttribute(child, Attributes::type);
+    string typeName = child.getAttribute(Attributes::type);
     if (typeName.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::type << " found.";
         return BAD_VALUE;
@@ -349,7 +309,7 @@ status_t RogueParameterTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode *chi
     Log::Verbose() << __FUNCTION__ << ": " << tag << " " << Attributes::type << "=" << typeName;
 
 
-    string paramKey = getXmlAttribute(child, Attributes::parameter);
+    string paramKey = child.getAttribute(Attributes::parameter);
     if (paramKey.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::parameter << " found.";
         return BAD_VALUE;
@@ -357,14 +317,14 @@ status_t RogueParameterTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode *chi
     Log::Verbose() << __FUNCTION__ << ": " << tag << " " << Attributes::parameter << "=" <<
         paramKey;
 
-    string defaultValue = getXmlAttribute(child, Attributes::defaultVal);
+    string defaultValue = child.getAttribute(Attributes::defaultVal);
     if (defaultValue.empty()) {
         Log::Verbose() << __FUNCTION__ << ": No attribute " << Attributes::defaultVal << " found.";
     }
     Log::Verbose() << __FUNCTION__ << ": " << tag << " " << Attributes::defaultVal << "=" <<
         defaultValue;
 
-    string mapping = getXmlAttribute(child, Attributes::mapping);
+    string mapping = child.getAttribute(Attributes::mapping);
     if (not mapping.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::mapping << " found.";
         return BAD_VALUE;
@@ -399,26 +359,25 @@ const char AudioProfileTraits::Attributes::samplingRates[] = "samplingRates";
 const char AudioProfileTraits::Attributes::format[] = "format";
 const char AudioProfileTraits::Attributes::channelMasks[] = "channelMasks";
 
-status_t AudioProfileTraits::deserialize(_xmlDoc */*doc*/,
-                                         const _xmlNode *child,
+status_t AudioProfileTraits::deserialize(const RouteConfigImage::Node &child,
                                          PtrElement &profile,
                                          PtrSerializingCtx /*serializingContext*/)
 {
     // Empty channel masks allowed (dynamic)
-    string channelMasks = getXmlAttribute(child, Attributes::channelMasks);
+    string channelMasks = child.getAttribute(Attributes::channelMasks);
     // Empty mask means dynamic channels
     if (not channelMasks.empty()) {
         profile.mSupportedChannelMasks = channelMasksFromString(channelMasks, ",");
     }
     Log::Verbose() << __FUNCTION__ << ": " << Attributes::channelMasks << "=" << channelMasks;
     // Empty channel rates allowed (dynamic)
-    string rates = getXmlAttribute(child, Attributes::samplingRates);
+    string rates = child.getAttribute(Attributes::samplingRates);
     if (not rates.empty()) {
         profile.mSupportedRates = samplingRatesFromString(rates, ",");
     }
     Log::Verbose() << __FUNCTION__ << ": " << Attributes::samplingRates << "=" << rates;
     // Empty formats allowed (dynamic)
-    string format = getXmlAttribute(child, Attributes::format);
+    string format = child.getAttribute(Attributes::format);
     if (not format.empty()) {
         FormatConverter::toEnum(format, profile.mSupportedFormat);
     }
@@ -438,17 +397,17 @@ const char DevicePortTraits::Attributes::role[] = "role";
 const char DevicePortTraits::Attributes::type[] = "type";
 const char DevicePortTraits::Attributes::address[] = "address";
 
-status_t DevicePortTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode *root, PtrElement &element,
+status_t DevicePortTraits::deserialize(const RouteConfigImage::Node &root, PtrElement &element,
                                        PtrSerializingCtx /*serializingContext*/)
 {
-    string name = getXmlAttribute(root, Attributes::name);
+    string name = root.getAttribute(Attributes::name);
     if (name.empty()) {
         Log::Error() << __FUNCTION__ << ": DevicePort: No attribute " << Attributes::name <<
             " found.";
         return BAD_VALUE;
     }
     Log::Verbose() << __FUNCTION__ << ": DevicePort: attribute " << Attributes::name << "=" << name;
-    string typeName = getXmlAttribute(root, Attributes::type);
+    string typeName = root.getAttribute(Attributes::type);
     if (typeName.empty()) {
         Log::Error() << __FUNCTION__ << ": DevicePort: No attribute " << Attributes::type <<
             " found.";
@@ -456,7 +415,7 @@ status_t DevicePortTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode *root, P
     }
     Log::Verbose() << __FUNCTION__ << ": DevicePort: attribute " << Attributes::type << "=" <<
         typeName;
-    string role = getXmlAttribute(root, Attributes::role);
+    string role = root.getAttribute(Attributes::role);
     if (role.empty()) {
         Log::Error() << __FUNCTION__ << ": DevicePort: No attribute " << Attributes::role <<
             " found.";
@@ -469,7 +428,7 @@ status_t DevicePortTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode *root, P
             Attributes::type << " found.";
         return BAD_VALUE;
     }
-    string address = getXmlAttribute(root, Attributes::address);
+    string address = root.getAttribute(Attributes::address);
     if (not address.empty()) {
         Log::Verbose() << __FUNCTION__ << ": DevicePort: attribute " << Attributes::address <<
             " = " << address;
@@ -524,24 +483,24 @@ status_t RouteTraits::parsePorts(AudioPorts &ports,
     return NO_ERROR;
 }
 
-status_t RouteTraits::deserialize(_xmlDoc */*doc*/, const _xmlNode *root, PtrElement &element,
+status_t RouteTraits::deserialize(const RouteConfigImage::Node &root, PtrElement &element,
                                   PtrSerializingCtx ctx)
 {
-    string sinkAttr = getXmlAttribute(root, Attributes::sink);
+    string sinkAttr = root.getAttribute(Attributes::sink);
     if (sinkAttr.empty()) {
         Log::Error() << __FUNCTION__ << ": Route: No attribute " << Attributes::sink << " found.";
         return BAD_VALUE;
     }
     Log::Verbose() << __FUNCTION__ << ": Route: attribute " << Attributes::sink << "=" << sinkAttr;
 
-    string name = getXmlAttribute(root, Attributes::name);
+    string name = root.getAttribute(Attributes::name);
     if (name.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::name << " found.";
         return BAD_VALUE;
     }
     Log::Verbose() << __FUNCTION__ << ": Route: attribute " << Attributes::name << "=" << name;
 
-    string sourcesAttr = getXmlAttribute(root, Attributes::sources);
+    string sourcesAttr = root.getAttribute(Attributes::sources);
     if (sourcesAttr.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::sources << " found.";
         return BAD_VALUE;
@@ -595,12 +554,16 @@ const char MixPortTraits::Attributes::flagMask[] = "flags";
 const char MixPortTraits::Attributes::requirePreEnable[] = "requirePreEnable";
 const char MixPortTraits::Attributes::requirePostDisable[] = "requirePostDisable";
 const char MixPortTraits::Attributes::silencePrologMs[] = "silencePrologMs";
+const char MixPortTraits::Attributes::standbyDelayMs[] = "standbyDelayMs";
+const char MixPortTraits::Attributes::maxStreams[] = "maxStreams";
 const char MixPortTraits::Attributes::channelsPolicy[] = "channelsPolicy";
 const char MixPortTraits::Attributes::channelPolicyCopy[] = "copy";
 const char MixPortTraits::Attributes::channelPolicyIgnore[] = "ignore";
 const char MixPortTraits::Attributes::channelPolicyAverage[] = "average";
 const char MixPortTraits::Attributes::periodSize[] = "periodSize";
 const char MixPortTraits::Attributes::periodCount[] = "periodCount";
+const char MixPortTraits::Attributes::minPeriodCount[] = "minPeriodCount";
+const char MixPortTraits::Attributes::maxPeriodCount[] = "maxPeriodCount";
 const char MixPortTraits::Attributes::startThreshold[] = "startThreshold";
 const char MixPortTraits::Attributes::stopThreshold[] = "stopThreshold";
 const char MixPortTraits::Attributes::silenceThreshold[] = "silenceThreshold";
@@ -613,16 +576,16 @@ const char MixPortTraits::Attributes::supportedDevices[] = "supportedDevices";
 const char MixPortTraits::Attributes::devicePorts[] = "devicePorts";
 const char MixPortTraits::Attributes::effects[] = "effectsSupported";
 
-status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElement &mixPort,
+status_t MixPortTraits::deserialize(const RouteConfigImage::Node &child, PtrElement &mixPort,
                                     PtrSerializingCtx ctx)
 {
-    string name = getXmlAttribute(child, Attributes::name);
+    string name = child.getAttribute(Attributes::name);
     if (name.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::name << " found.";
         return BAD_VALUE;
     }
     Log::Verbose() << __FUNCTION__ << ": " << tag << " " << Attributes::name << "=" << name.c_str();
-    string role = getXmlAttribute(child, Attributes::role);
+    string role = child.getAttribute(Attributes::role);
     if (role.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::role << " found.";
         return BAD_VALUE;
@@ -632,7 +595,7 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
 
     MixPortConfig mixPortConfig;
     mixPortConfig.isOut = (role == "source");
-    string card = getXmlAttribute(child, Attributes::card);
+    string card = child.getAttribute(Attributes::card);
     if (card.empty()) {
         Log::Error() << __FUNCTION__ << ": No attribute " << Attributes::card << " found.";
         delete mixPort;
@@ -641,7 +604,7 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
     Log::Verbose() << __FUNCTION__ << ": " << Attributes::card << "=" << card;
     mixPortConfig.cardName = card;
 
-    string device = getXmlAttribute(child, Attributes::device);
+    string device = child.getAttribute(Attributes::device);
 
     // Empty device name -> infer user side alsa card
     // Valid device name -> use tiny alsa audio device
@@ -664,7 +627,7 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
     }
 
     mixPortConfig.flagMask = 0;
-    string flags = getXmlAttribute(child, Attributes::flagMask);
+    string flags = child.getAttribute(Attributes::flagMask);
     if (not flags.empty()) {
         Log::Verbose() << __FUNCTION__ << ": attribute " << Attributes::flagMask << "=" << flags;
         // Source role
@@ -679,14 +642,14 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
                                  AUDIO_INPUT_FLAG_PRIMARY : mixPortConfig.flagMask;
     }
 
-    string periodSize = getXmlAttribute(child, Attributes::periodSize);
+    string periodSize = child.getAttribute(Attributes::periodSize);
     if (periodSize.empty() || !convertTo<string, uint32_t>(periodSize, mixPortConfig.periodSize)) {
         Log::Error() << __FUNCTION__ << ": No valid attribute " << Attributes::periodSize
                      << " found.";
         delete mixPort;
         return BAD_VALUE;
     }
-    string periodCount = getXmlAttribute(child, Attributes::periodCount);
+    string periodCount = child.getAttribute(Attributes::periodCount);
     if (periodCount.empty() ||
         !convertTo<string, uint32_t>(periodCount, mixPortConfig.periodCount)) {
         Log::Error() << __FUNCTION__ << ": No valid attribute " << Attributes::periodCount
@@ -694,7 +657,25 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
         delete mixPort;
         return BAD_VALUE;
     }
-    string startThreshold = getXmlAttribute(child, Attributes::startThreshold);
+    // Optional range of period count: adaptation to the system load is opt-in
+    mixPortConfig.minPeriodCount = mixPortConfig.maxPeriodCount = mixPortConfig.periodCount;
+    string minPeriodCount = child.getAttribute(Attributes::minPeriodCount);
+    string maxPeriodCount = child.getAttribute(Attributes::maxPeriodCount);
+    if (not minPeriodCount.empty() || not maxPeriodCount.empty()) {
+        if (not convertTo<string, uint32_t>(minPeriodCount, mixPortConfig.minPeriodCount) ||
+            not convertTo<string, uint32_t>(maxPeriodCount, mixPortConfig.maxPeriodCount) ||
+            mixPortConfig.minPeriodCount == 0 ||
+            mixPortConfig.periodCount < mixPortConfig.minPeriodCount ||
+            mixPortConfig.periodCount > mixPortConfig.maxPeriodCount) {
+            Log::Error() << __FUNCTION__ << ": Invalid " << Attributes::minPeriodCount << "="
+                         << minPeriodCount << " " << Attributes::maxPeriodCount << "="
+                         << maxPeriodCount << " for " << Attributes::periodCount << "="
+                         << periodCount;
+            delete mixPort;
+            return BAD_VALUE;
+        }
+    }
+    string startThreshold = child.getAttribute(Attributes::startThreshold);
     if (startThreshold.empty() ||
         not convertTo<string, uint32_t>(startThreshold, mixPortConfig.startThreshold)) {
         Log::Error() << __FUNCTION__ << ": No valid attribute " << Attributes::startThreshold
@@ -702,7 +683,7 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
         delete mixPort;
         return BAD_VALUE;
     }
-    string stopThreshold = getXmlAttribute(child, Attributes::stopThreshold);
+    string stopThreshold = child.getAttribute(Attributes::stopThreshold);
     if (stopThreshold.empty() ||
         not convertTo<string, uint32_t>(stopThreshold, mixPortConfig.stopThreshold)) {
         Log::Error() << __FUNCTION__ << ": No valid attribute " << Attributes::stopThreshold
@@ -710,7 +691,7 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
         delete mixPort;
         return BAD_VALUE;
     }
-    string silenceThreshold = getXmlAttribute(child, Attributes::silenceThreshold);
+    string silenceThreshold = child.getAttribute(Attributes::silenceThreshold);
     if (silenceThreshold.empty() ||
         not convertTo<string, uint32_t>(silenceThreshold, mixPortConfig.silenceThreshold)) {
         Log::Error() << __FUNCTION__ << ": No valid attribute " << Attributes::silenceThreshold
@@ -718,14 +699,14 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
         delete mixPort;
         return BAD_VALUE;
     }
-    string availMin = getXmlAttribute(child, Attributes::availMin);
+    string availMin = child.getAttribute(Attributes::availMin);
     if (availMin.empty() || not convertTo<string, uint32_t>(availMin, mixPortConfig.availMin)) {
         Log::Error() << __FUNCTION__ << ": No valid attribute " << Attributes::availMin <<
             " found.";
         delete mixPort;
         return BAD_VALUE;
     }
-    string silencePrologInMs = getXmlAttribute(child, Attributes::silencePrologMs);
+    string silencePrologInMs = child.getAttribute(Attributes::silencePrologMs);
     if (silencePrologInMs.empty() ||
         not convertTo<string, uint32_t>(silencePrologInMs, mixPortConfig.silencePrologInMs)) {
         Log::Error() << __FUNCTION__ << ": No valid attribute " << Attributes::silencePrologMs
@@ -733,7 +714,24 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
         delete mixPort;
         return BAD_VALUE;
     }
-    string requirePreEnable = getXmlAttribute(child, Attributes::requirePreEnable);
+    string standbyDelayMs = child.getAttribute(Attributes::standbyDelayMs);
+    if (not standbyDelayMs.empty() &&
+        not convertTo<string, uint32_t>(standbyDelayMs, mixPortConfig.standbyDelayMs)) {
+        Log::Error() << __FUNCTION__ << ": Invalid " << standbyDelayMs << " for attribute "
+                     << Attributes::standbyDelayMs;
+        delete mixPort;
+        return BAD_VALUE;
+    }
+    string maxStreams = child.getAttribute(Attributes::maxStreams);
+    if (not maxStreams.empty() &&
+        (not convertTo<string, uint32_t>(maxStreams, mixPortConfig.maxStreams) ||
+         mixPortConfig.maxStreams == 0)) {
+        Log::Error() << __FUNCTION__ << ": Invalid " << maxStreams << " for attribute "
+                     << Attributes::maxStreams;
+        delete mixPort;
+        return BAD_VALUE;
+    }
+    string requirePreEnable = child.getAttribute(Attributes::requirePreEnable);
     if (requirePreEnable.empty() ||
         not convertTo<string, bool>(requirePreEnable, mixPortConfig.requirePreEnable)) {
         Log::Error() << __FUNCTION__ << ": Invalid " << requirePreEnable << " for attribute "
@@ -741,7 +739,7 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
         delete mixPort;
         return BAD_VALUE;
     }
-    string requirePostDisable = getXmlAttribute(child, Attributes::requirePostDisable);
+    string requirePostDisable = child.getAttribute(Attributes::requirePostDisable);
     if (requirePostDisable.empty() ||
         not convertTo<string, bool>(requirePostDisable, mixPortConfig.requirePostDisable)) {
         Log::Error() << __FUNCTION__ << ": Invalid " << requirePostDisable << " for attribute "
@@ -749,19 +747,19 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
         delete mixPort;
         return BAD_VALUE;
     }
-    mixPortConfig.dynamicChannelMapsControl = getXmlAttribute(child,
-                                                              Attributes::dynamicChannelMapsControl);
-    mixPortConfig.dynamicFormatsControl = getXmlAttribute(child, Attributes::dynamicFormatsControl);
+    mixPortConfig.dynamicChannelMapsControl =
+        child.getAttribute(Attributes::dynamicChannelMapsControl);
+    mixPortConfig.dynamicFormatsControl = child.getAttribute(Attributes::dynamicFormatsControl);
     mixPortConfig.dynamicRatesControl =
-        getXmlAttribute(child, Attributes::dynamicSampleRatesControl);
-    //    mixPortConfig.deviceAddress = getXmlAttribute(child, Attributes::deviceAddress);
+        child.getAttribute(Attributes::dynamicSampleRatesControl);
+    //    mixPortConfig.deviceAddress = child.getAttribute(Attributes::deviceAddress);
 
     mixPortConfig.useCaseMask = 0;
-    string supportedUseCases = getXmlAttribute(child, Attributes::supportedUseCases);
+    string supportedUseCases = child.getAttribute(Attributes::supportedUseCases);
     mixPortConfig.useCaseMask = (role == "source") ?
                                 0 : InputSourceConverter::maskFromString(supportedUseCases, ",");
     mixPortConfig.supportedDeviceMask = 0;
-    string supportedDevices = getXmlAttribute(child, Attributes::supportedDevices);
+    string supportedDevices = child.getAttribute(Attributes::supportedDevices);
     char *devices = strndup(supportedDevices.c_str(), strlen(supportedDevices.c_str()));
     char *dev = strtok(devices, ",");
     while (dev != NULL) {
@@ -782,7 +780,7 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
     }
 
     free(devices);
-    string channelsPolicy = getXmlAttribute(child, Attributes::channelsPolicy);
+    string channelsPolicy = child.getAttribute(Attributes::channelsPolicy);
     if (not channelsPolicy.empty()) {
         vector<string> channelsPolicyVector;
         collectionFromString<DefaultTraits<string> >(channelsPolicy, channelsPolicyVector, ",");
@@ -804,12 +802,12 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
         }
     }
     AudioProfileTraits::Collection profiles;
-    deserializeCollection<AudioProfileTraits>(doc, child, profiles, NULL);
+    deserializeCollection<AudioProfileTraits>(child, profiles, NULL);
     mixPortConfig.mAudioCapabilities = profiles;
 
     mixPort->setConfig(mixPortConfig);
 
-    string effects = getXmlAttribute(child, Attributes::effects);
+    string effects = child.getAttribute(Attributes::effects);
     if (not effects.empty()) {
         vector<string> effectsSupported;
         collectionFromString<DefaultTraits<string> >(effects, effectsSupported, ",");
@@ -822,10 +820,10 @@ status_t MixPortTraits::deserialize(_xmlDoc *doc, const _xmlNode *child, PtrElem
 const char *const ModuleTraits::tag = "module";
 const char *const ModuleTraits::collectionTag = "modules";
 
-status_t ModuleTraits::deserialize(xmlDocPtr doc, const xmlNode *root, PtrElement & /*module*/,
+status_t ModuleTraits::deserialize(const RouteConfigImage::Node &root, PtrElement & /*module*/,
                                    PtrSerializingCtx ctx)
 {
-    std::string name = getXmlAttribute(root, "name");
+    std::string name = root.getAttribute("name");
     if (name != "primary") {
         Log::Warning() << __FUNCTION__ << ": Module " << name <<
             " outside primary outside HAL Scope";
@@ -840,9 +838,9 @@ status_t ModuleTraits::deserialize(xmlDocPtr doc, const xmlNode *root, PtrElemen
      * @see RouteManagerConfig::mMixPorts
      * @see RouteManagerConfig::mRoutes
      */
-    deserializeCollection<DevicePortTraits>(doc, root, ctx->mDevicePorts, nullptr);
-    deserializeCollection<MixPortTraits>(doc, root, ctx->mMixPorts, ctx);
-    deserializeCollection<RouteTraits>(doc, root, ctx->mRoutes, ctx);
+    deserializeCollection<DevicePortTraits>(root, ctx->mDevicePorts, nullptr);
+    deserializeCollection<MixPortTraits>(root, ctx->mMixPorts, ctx);
+    deserializeCollection<RouteTraits>(root, ctx->mRoutes, ctx);
     return NO_ERROR;
 }
 
@@ -857,31 +855,28 @@ RouteSerializer::RouteSerializer() : mRootElementName(rootName)
 
 status_t RouteSerializer::deserialize(const char *configFile, RouteManagerConfig &config)
 {
-    xmlDocPtr doc;
-    doc = xmlParseFile(configFile);
-    if (doc == NULL) {
-        Log::Error() << __FUNCTION__ << ": Could not parse document " << configFile;
-        return BAD_VALUE;
+    RouteConfigImage image;
+    status_t status = image.parseXml(configFile);
+    if (status != android::OK) {
+        return status;
     }
-    xmlNodePtr cur = xmlDocGetRootElement(doc);
-    if (cur == NULL) {
-        Log::Error() << __FUNCTION__ << ": Could not parse: empty document " << configFile;
-        xmlFreeDoc(doc);
+    return deserialize(image, config);
+}
+
+status_t RouteSerializer::deserialize(const RouteConfigImage &image, RouteManagerConfig &config)
+{
+    RouteConfigImage::Node cur = image.getRoot();
+    if (!cur.isValid()) {
+        Log::Error() << __FUNCTION__ << ": Could not parse: empty document";
         return BAD_VALUE;
     }
-    if (xmlXIncludeProcess(doc) < 0) {
-        Log::Error() << __FUNCTION__ << ": libxml failed to resolve XIncludes on document "
-                     << configFile;
-    }
-
-    if (xmlStrcmp(cur->name, (const xmlChar *)mRootElementName.c_str())) {
+    if (!cur.hasName(mRootElementName.c_str())) {
         Log::Error() << __FUNCTION__ << ": No " << mRootElementName.c_str()
-                     << " root element found in xml data " << (const char *)cur->name;
-        xmlFreeDoc(doc);
+                     << " root element found in xml data " << cur.getName();
         return BAD_VALUE;
     }
 
-    string version = getXmlAttribute(cur, versionAttribute);
+    string version = cur.getAttribute(versionAttribute);
     if (version.empty()) {
         Log::Error() << __FUNCTION__ << ": No version found in node " << mRootElementName.c_str();
         return BAD_VALUE;
@@ -893,12 +888,11 @@ status_t RouteSerializer::deserialize(const char *configFile, RouteManagerConfig
     }
     // Lets deserialize children
     ModuleTraits::Collection modules;
-    deserializeCollection<ModuleTraits>(doc, cur, modules, &config);
-    deserializeCollection<RogueParameterTraits>(doc, cur, config.mParameters, &config);
-    deserializeCollection<AudioCriterionTypeTraits>(doc, cur, config.mCriterionTypes, &config);
-    deserializeCollection<AudioCriterionTraits>(doc, cur, config.mCriteria, &config);
+    deserializeCollection<ModuleTraits>(cur, modules, &config);
+    deserializeCollection<RogueParameterTraits>(cur, config.mParameters, &config);
+    deserializeCollection<AudioCriterionTypeTraits>(cur, config.mCriterionTypes, &config);
+    deserializeCollection<AudioCriterionTraits>(cur, config.mCriteria, &config);
 
-    xmlFreeDoc(doc);
     return android::OK;
 }
 
@@ -17,14 +17,12 @@
 #pragma once
 
 #include "RouteManagerConfig.hpp"
+#include "RouteConfigImage.hpp"
 #include "AudioPort.hpp"
 #include <stdint.h>
 #include <string>
 #include <utils/Errors.h>
 
-struct _xmlNode;
-struct _xmlDoc;
-
 namespace intel_audio
 {
 
@@ -45,7 +43,7 @@ struct AudioCriterionTypeTraits
     typedef CriterionTypes Collection;
     typedef RouteManagerConfig *PtrSerializingCtx;
 
-    static android::status_t deserialize(_xmlDoc *doc, const _xmlNode *root, PtrElement &element,
+    static android::status_t deserialize(const RouteConfigImage::Node &root, PtrElement &element,
                                          PtrSerializingCtx serializingContext);
 };
 
@@ -69,7 +67,7 @@ struct AudioCriterionTraits
     typedef Criteria Collection;
     typedef RouteManagerConfig *PtrSerializingCtx;
 
-    static android::status_t deserialize(_xmlDoc *doc, const _xmlNode *root, PtrElement &element,
+    static android::status_t deserialize(const RouteConfigImage::Node &root, PtrElement &element,
                                          PtrSerializingCtx serializingContext);
 };
 
@@ -93,7 +91,7 @@ struct RogueParameterTraits
     typedef Parameters Collection;
     typedef RouteManagerConfig *PtrSerializingCtx;
 
-    static android::status_t deserialize(_xmlDoc *doc, const _xmlNode *root, PtrElement &element,
+    static android::status_t deserialize(const RouteConfigImage::Node &root, PtrElement &element,
                                          PtrSerializingCtx serializingContext);
 };
 
@@ -114,7 +112,7 @@ struct AudioProfileTraits
     typedef AudioCapabilities Collection;
     typedef void *PtrSerializingCtx;
 
-    static android::status_t deserialize(_xmlDoc *doc, const _xmlNode *root, PtrElement &element,
+    static android::status_t deserialize(const RouteConfigImage::Node &root, PtrElement &element,
                                          PtrSerializingCtx serializingContext);
 };
 
@@ -136,7 +134,7 @@ struct DevicePortTraits
     typedef AudioPorts Collection;
     typedef void *PtrSerializingCtx;
 
-    static android::status_t deserialize(_xmlDoc *doc, const _xmlNode *root, PtrElement &element,
+    static android::status_t deserialize(const RouteConfigImage::Node &root, PtrElement &element,
                                          PtrSerializingCtx serializingContext);
 };
 
@@ -173,7 +171,7 @@ struct RouteTraits
                                         bool &hasMixPort,
                                         PtrSerializingCtx ctx);
 
-    static android::status_t deserialize(_xmlDoc *doc, const _xmlNode *root, PtrElement &element,
+    static android::status_t deserialize(const RouteConfigImage::Node &root, PtrElement &element,
                                          PtrSerializingCtx serializingContext);
 };
 
@@ -188,7 +186,7 @@ struct ModuleTraits
     typedef std::vector<Module *> Collection;
     typedef RouteManagerConfig *PtrSerializingCtx;
 
-    static android::status_t deserialize(_xmlDoc * doc, const _xmlNode * root, PtrElement & element,
+    static android::status_t deserialize(const RouteConfigImage::Node &root, PtrElement &element,
                                          PtrSerializingCtx /*serializingContext*/);
 };
 
@@ -208,12 +206,16 @@ struct MixPortTraits
         static const char requirePreEnable[];
         static const char requirePostDisable[];
         static const char silencePrologMs[];
+        static const char standbyDelayMs[];
+        static const char maxStreams[];
         static const char channelsPolicy[];
         static const char channelPolicyCopy[];
         static const char channelPolicyIgnore[];
         static const char channelPolicyAverage[];
         static const char periodSize[];
         static const char periodCount[];
+        static const char minPeriodCount[];
+        static const char maxPeriodCount[];
         static const char startThreshold[];
         static const char stopThreshold[];
         static const char silenceThreshold[];
@@ -233,7 +235,7 @@ struct MixPortTraits
     typedef AudioPorts Collection;
     typedef RouteManagerConfig *PtrSerializingCtx;
 
-    static android::status_t deserialize(_xmlDoc *doc, const _xmlNode *root, PtrElement &element,
+    static android::status_t deserialize(const RouteConfigImage::Node &root, PtrElement &element,
                                          PtrSerializingCtx serializingContext);
 
     // MixPort has no child
@@ -251,7 +253,27 @@ private:
 
 public:
     RouteSerializer();
-    android::status_t deserialize(const char *str, RouteManagerConfig &config);
+
+    /**
+     * Parses the XML configuration file and populates the route manager configuration.
+     *
+     * @param[in] configFile path of the XML configuration file.
+     * @param[out] config populated route manager configuration.
+     *
+     * @return OK if the configuration has been deserialized, error code otherwise.
+     */
+    android::status_t deserialize(const char *configFile, RouteManagerConfig &config);
+
+    /**
+     * Populates the route manager configuration from an image of the configuration document,
+     * either built from the XML file or loaded from a precompiled binary file.
+     *
+     * @param[in] image of the configuration document.
+     * @param[out] config populated route manager configuration.
+     *
+     * @return OK if the configuration has been deserialized, error code otherwise.
+     */
+    android::status_t deserialize(const RouteConfigImage &image, RouteManagerConfig &config);
 
 private:
     std::string mRootElementName;
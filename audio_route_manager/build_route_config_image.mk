@@ -0,0 +1,48 @@
+#
+#
+# Copyright (C) Intel 2018
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Generates the precompiled image of the route manager configuration.
+#
+# Usage from a device makefile:
+#   include $(CLEAR_VARS)
+#   LOCAL_MODULE := audio_policy_configuration.bin
+#   LOCAL_VENDOR_MODULE := true
+#   ROUTE_CONFIG_XML_FILE := $(LOCAL_PATH)/audio_policy_configuration.xml
+#   ROUTE_CONFIG_XML_DEPS := $(LOCAL_PATH)/audio_criteria.xml ...
+#   include <path of the audio HAL>/audio_route_manager/build_route_config_image.mk
+#
+# The image must be installed in the same folder than the XML file and its XIncluded files.
+
+LOCAL_MODULE_CLASS := ETC
+LOCAL_MODULE_TAGS := optional
+LOCAL_ADDITIONAL_DEPENDENCIES += \
+    $(HOST_OUT_EXECUTABLES)/buildRouteConfigImage \
+    $(ROUTE_CONFIG_XML_FILE) \
+    $(ROUTE_CONFIG_XML_DEPS)
+
+include $(BUILD_SYSTEM)/base_rules.mk
+
+$(LOCAL_BUILT_MODULE): MY_TOOL := $(HOST_OUT_EXECUTABLES)/buildRouteConfigImage
+$(LOCAL_BUILT_MODULE): MY_XML_FILE := $(ROUTE_CONFIG_XML_FILE)
+$(LOCAL_BUILT_MODULE): $(LOCAL_ADDITIONAL_DEPENDENCIES)
+	$(hide) mkdir -p $(dir $@)
+	"$(MY_TOOL)" "$(MY_XML_FILE)" "$@"
+
+# Clear variables for further use
+ROUTE_CONFIG_XML_FILE :=
+ROUTE_CONFIG_XML_DEPS :=
@@ -18,15 +18,20 @@
 #include "AudioCapabilities.hpp"
 #include <AudioCommsAssert.hpp>
 #include <Parameter.hpp>
-#include <Observable.hpp>
 #include <EventListener.h>
 #include <AudioNonCopyable.hpp>
 #include <utils/RWLock.h>
+#include <future>
 #include <list>
 #include <map>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 class CEventThread;
+class Criteria;
+class CriterionTypes;
 
 namespace intel_audio
 {
@@ -35,9 +40,9 @@ class IoStream;
 struct pcm_config;
 class AudioPlatformState;
 class AudioRouteCollection;
+class FwErrorReporter;
 
 class AudioRouteManager : private IEventListener,
-                          private audio_comms::utilities::Observable,
                           private audio_comms::utilities::NonCopyable
 {
 public:
@@ -60,6 +65,8 @@ public:
 
     /**
      * Trigs a routing reconsideration.
+     * Requests received until the worker thread serves them are coalesced into a single
+     * evaluation of the routing.
      *
      * @param[in] synchronous: if set, re routing shall be synchronous.
      */
@@ -145,9 +152,11 @@ public:
     std::string getParameters(const std::string &keys) const;
 
     /**
-     * Print debug information from target debug files
+     * Reports an error of the audio device, e.g. EIO upon write.
+     * The debug information of the firmware is collected asynchronously, so that it may be
+     * called from the audio thread of a stream.
      */
-    void printPlatformFwErrorInfo() const {}
+    void reportPlatformFwError();
 
     android::status_t dump(const int  fd, int spaces = 0) const;
 
@@ -156,13 +165,22 @@ private:
      * From worker thread context
      * This function requests to evaluate the routing for all the streams
      * after a mode change, a modem event ...
+     * It serves the pending routing reconsideration if any.
      */
     void doReconsiderRouting();
 
+    /**
+     * Evaluates the routing for all the streams and applies it. From worker thread context.
+     */
+    void evaluateRouting();
+
     /**
      * Trigs a routing reconsideration. Must be called with Routing Lock held in W Mode
+     * If a reconsideration is already pending, the request joins it: the worker thread is
+     * trigged only once per pending reconsideration.
      *
-     * @param[in] synchronous: if set, re routing shall be synchronous.
+     * @param[in] synchronous: if set, re routing shall be synchronous, i.e. the lock is released
+     *                         until the pending reconsideration has been served.
      */
     void reconsiderRoutingUnsafe(bool isSynchronous = false);
 
@@ -183,6 +201,12 @@ private:
      */
     bool checkAndPrepareRouting();
 
+    /**
+     * Schedules a routing reconsideration at the end of the earliest standby delay of the routes
+     * in warm standby, in order to disable them. From worker thread context.
+     */
+    void armWarmStandbyAlarm();
+
     /**
      * Execute 5-steps routing.
      */
@@ -251,6 +275,42 @@ private:
     template <uint32_t type>
     inline const std::string routeMaskToString(uint32_t mask) const;
 
+    /**
+     * Loads the capabilities of the routes that may be matched by the stream and whose
+     * capabilities loading has been deferred upon connection of their device.
+     * Only takes the routing lock in W mode if a loading is pending, must not be called with
+     * routing lock held.
+     *
+     * @param[in] stream for which a route is looked for.
+     */
+    void loadPendingCapabilities(const IoStream &stream) const;
+
+    /**
+     * Loads the configuration from the first folder providing a file that can be deserialized,
+     * preferring the precompiled image if still matching its XML sources.
+     *
+     * @param[out] criteria populated from the configuration.
+     * @param[out] criterionTypes populated from the configuration.
+     *
+     * @return OK if a configuration has been loaded, error code otherwise.
+     */
+    android::status_t loadConfiguration(Criteria &criteria, CriterionTypes &criterionTypes);
+
+    /**
+     * Resolves the sound cards of the stream routes and opens their mixers, so that the first
+     * routing and capabilities loading find them in the sound card registry.
+     */
+    void warmUpSoundCards() const;
+
+    /**
+     * Records the duration of a startup phase.
+     *
+     * @param[in] phase name of the startup phase.
+     * @param[in,out] phaseStartTime start time of the phase in microseconds, set to current time
+     *                               for the next phase.
+     */
+    void addStartupTiming(const std::string &phase, int64_t &phaseStartTime);
+
     /**
      * Reset the routing conditions.
      * It backup the enabled routes, resets the route criteria, resets the needReconfigure flags,
@@ -275,6 +335,8 @@ private:
 
     AudioPlatformState *mPlatformState; /**< Platform state handler for Route / Audio PFW. */
 
+    FwErrorReporter *mFwErrorReporter; /**< Collects firmware error info off audio threads. */
+
     /**Socket Id enumerator */
     enum UeventSockDesc
     {
@@ -292,6 +354,21 @@ private:
     static const int gSocketBufferDefaultSize;
 
     bool mAudioSubsystemAvailable = true;
+
+    std::string mConfigurationSource; /**< File from which the configuration has been loaded. */
+
+    /** Duration in microseconds of each startup phase, in order of execution. */
+    std::vector<std::pair<std::string, int64_t> > mStartupTimings;
+
+    /**
+     * Reconsideration requested and not yet served by the worker thread, null if none.
+     * Synchronous requesters wait on mPendingReroutingDone, set once the routing is evaluated.
+     */
+    std::unique_ptr<std::promise<void> > mPendingRerouting;
+    std::shared_future<void> mPendingReroutingDone;
+
+    uint64_t mReroutingRequests = 0; /**< Routing reconsiderations requested. */
+    uint64_t mReroutingEvaluations = 0; /**< Routing evaluations run by the worker thread. */
 };
 
 } // namespace intel_audio
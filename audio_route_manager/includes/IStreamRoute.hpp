@@ -23,6 +23,8 @@ namespace intel_audio
 
 struct StreamRouteConfig;
 class IAudioDevice;
+class CaptureFanOut;
+class PlaybackMixer;
 
 class IStreamRoute
 {
@@ -46,6 +48,20 @@ public:
 
     virtual IAudioDevice *getAudioDevice() = 0;
 
+    /**
+     * Get the shared capture of an input route that several streams may use concurrently.
+     *
+     * @return shared capture, NULL if the route serves a single stream.
+     */
+    virtual CaptureFanOut *getCaptureFanOut() = 0;
+
+    /**
+     * Get the mixer of an output route that several streams may use concurrently.
+     *
+     * @return mixer, NULL if the route serves a single stream.
+     */
+    virtual PlaybackMixer *getPlaybackMixer() = 0;
+
     virtual ~IStreamRoute() {}
 
     /**
@@ -48,6 +48,21 @@ struct MixPortConfig
     uint32_t silenceThreshold;
     uint32_t availMin;
 
+    /**
+     * Range of period count within which the ring buffer may be adapted to the load of the
+     * system. Adaptation is disabled unless minPeriodCount < maxPeriodCount.
+     */
+    uint32_t minPeriodCount = 0;
+    uint32_t maxPeriodCount = 0;
+
+    /**
+     * Changes the number of periods of the ring buffer, thresholds bound to the ring buffer size
+     * following it.
+     *
+     * @param[in] count new number of periods.
+     */
+    void setPeriodCount(uint32_t count);
+
     AudioCapabilities mAudioCapabilities;
 
     bool supportSampleSpec(const SampleSpec &spec) const;
@@ -61,6 +76,19 @@ struct MixPortConfig
     std::string dynamicRatesControl; /**< Control to retrieve supported rates. */
 
     uint32_t silencePrologInMs; /**< if needed, silence to be appended before valid samples. */
+
+    /**
+     * Delay during which the route stays enabled, with its device opened but stopped, once no
+     * stream uses it anymore (aka warm standby). 0 to disable the route as soon as unused.
+     */
+    uint32_t standbyDelayMs = 0;
+
+    /**
+     * Number of streams that may share the route: output streams are mixed before being written
+     * to the device, input streams read the frames captured once from the device.
+     * 1 for an exclusive route.
+     */
+    uint32_t maxStreams = 1;
     uint32_t flagMask; /**< flags supported by this route. To be checked with stream flags. */
     uint32_t useCaseMask; /**< use cases supported by this route. To be checked with stream. */
 
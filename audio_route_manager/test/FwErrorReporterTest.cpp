@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <FwErrorReporter.hpp>
+#include <AudioPlatformState.hpp>
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+
+namespace intel_audio
+{
+
+static const int64_t gSecondUs = 1000000;
+
+/**
+ * Reporter upon a fake clock, counting the time reads, i.e. the batches of errors served by the
+ * worker thread, whether collected or counted as repeats.
+ */
+class FakeClockReporter : public FwErrorReporter
+{
+public:
+    FakeClockReporter(const AudioPlatformState &platformState, android::RWLock &lock)
+        : FwErrorReporter(platformState, lock), mNowUs(0), mTimeReads(0)
+    {
+    }
+
+    virtual ~FakeClockReporter()
+    {
+        // Before the clock is destroyed
+        stop();
+    }
+
+    void setTimeUs(int64_t nowUs)
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mNowUs = nowUs;
+    }
+
+    void waitForTimeReads(uint32_t reads)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCond.wait(lock, [this, reads] { return mTimeReads >= reads; });
+    }
+
+    /** @return the dump of the reporter. */
+    std::string getDump() const
+    {
+        FILE *file = tmpfile();
+        EXPECT_TRUE(file != NULL);
+        if (file == NULL) {
+            return "";
+        }
+        dump(fileno(file));
+        rewind(file);
+        std::string dumped;
+        char buffer[256];
+        size_t size;
+        while ((size = fread(buffer, 1, sizeof(buffer), file)) != 0) {
+            dumped.append(buffer, size);
+        }
+        fclose(file);
+        return dumped;
+    }
+
+protected:
+    virtual int64_t getMonotonicTimeUs() const
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mTimeReads++;
+        mCond.notify_all();
+        return mNowUs;
+    }
+
+private:
+    mutable std::mutex mLock;
+    mutable std::condition_variable mCond;
+    int64_t mNowUs;
+    mutable uint32_t mTimeReads;
+};
+
+class FwErrorReporterTest : public ::testing::Test
+{
+protected:
+    FwErrorReporterTest() : mReporter(mPlatformState, mPlatformStateLock) {}
+
+    virtual void SetUp() { ASSERT_TRUE(mReporter.start()); }
+
+    AudioPlatformState mPlatformState;
+    android::RWLock mPlatformStateLock;
+    FakeClockReporter mReporter;
+};
+
+TEST_F(FwErrorReporterTest, repeatsRateLimited)
+{
+    mReporter.setTimeUs(gSecondUs);
+    mReporter.post();
+    mPlatformState.waitForCollections(1);
+
+    // Errors within the interval after the report are its repeats, whatever the errors between
+    mReporter.setTimeUs(gSecondUs + FwErrorReporter::mMinReportIntervalUs / 2);
+    mReporter.post();
+    mReporter.waitForTimeReads(2);
+    mReporter.setTimeUs(gSecondUs + FwErrorReporter::mMinReportIntervalUs - 1);
+    mReporter.post();
+    mReporter.waitForTimeReads(3);
+
+    // Interval elapsed since the report: collected again
+    mReporter.setTimeUs(gSecondUs + FwErrorReporter::mMinReportIntervalUs);
+    mReporter.post();
+    mPlatformState.waitForCollections(2);
+    mReporter.stop();
+
+    std::string dumped = mReporter.getDump();
+    EXPECT_NE(std::string::npos, dumped.find("4 posted, 2 last reports")) << dumped;
+    size_t first = dumped.find(": 3 error(s)\ncollection 1\n");
+    size_t second = dumped.find(": 1 error(s)\ncollection 2\n");
+    EXPECT_NE(std::string::npos, first) << dumped;
+    EXPECT_NE(std::string::npos, second) << dumped;
+    EXPECT_LT(first, second) << dumped;
+}
+
+TEST_F(FwErrorReporterTest, lastReportsKept)
+{
+    static const uint32_t reports = FwErrorReporter::mMaxReports + 2;
+    for (uint32_t report = 1; report <= reports; report++) {
+        mReporter.setTimeUs(report * FwErrorReporter::mMinReportIntervalUs);
+        mReporter.post();
+        mPlatformState.waitForCollections(report);
+    }
+    mReporter.stop();
+
+    // Oldest reports dropped, the others kept in order
+    std::string dumped = mReporter.getDump();
+    EXPECT_NE(std::string::npos,
+              dumped.find(std::to_string(reports) + " posted, " +
+                          std::to_string(FwErrorReporter::mMaxReports) + " last reports"))
+        << dumped;
+    size_t previous = 0;
+    for (uint32_t report = 1; report <= reports; report++) {
+        size_t position = dumped.find(": 1 error(s)\ncollection " + std::to_string(report) + "\n");
+        if (report <= reports - FwErrorReporter::mMaxReports) {
+            EXPECT_EQ(std::string::npos, position) << "report " << report;
+        } else {
+            ASSERT_NE(std::string::npos, position) << "report " << report;
+            EXPECT_LT(previous, position) << "report " << report;
+            previous = position;
+        }
+    }
+}
+
+} // namespace intel_audio
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <PeriodCountController.hpp>
+#include <gtest/gtest.h>
+
+namespace intel_audio
+{
+
+static const int64_t gPeriodNs = 5000000;
+static const int64_t gWindowNs = PeriodCountController::mMinObservationNs;
+
+TEST(PeriodCountController, disabledWithoutRange)
+{
+    PeriodCountController controller(4, 4, 4);
+    EXPECT_FALSE(controller.isEnabled());
+    controller.addStatistics(3, 10 * gPeriodNs, gWindowNs);
+    EXPECT_FALSE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(4u, controller.getPeriodCount());
+}
+
+TEST(PeriodCountController, initialCountClamped)
+{
+    PeriodCountController controller(2, 6, 8);
+    EXPECT_TRUE(controller.isEnabled());
+    EXPECT_EQ(6u, controller.getPeriodCount());
+}
+
+TEST(PeriodCountController, growUponXrun)
+{
+    PeriodCountController controller(2, 6, 4);
+
+    // An xrun is evaluated at once, whatever the window length
+    controller.addStatistics(1, gPeriodNs, 0);
+    EXPECT_TRUE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(5u, controller.getPeriodCount());
+
+    controller.addStatistics(2, gPeriodNs, 0);
+    EXPECT_TRUE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(6u, controller.getPeriodCount());
+
+    // Saturated
+    controller.addStatistics(1, gPeriodNs, 0);
+    EXPECT_FALSE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(6u, controller.getPeriodCount());
+}
+
+TEST(PeriodCountController, growUponLowMargin)
+{
+    PeriodCountController controller(2, 6, 4);
+
+    // Jitter leaving less than a period of margin within the ring buffer
+    controller.addStatistics(0, 3 * gPeriodNs + 1, gWindowNs);
+    EXPECT_TRUE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(5u, controller.getPeriodCount());
+
+    // A period of margin exactly: kept
+    controller.addStatistics(0, 4 * gPeriodNs, gWindowNs);
+    EXPECT_FALSE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(5u, controller.getPeriodCount());
+}
+
+TEST(PeriodCountController, shortWindowNotEvaluated)
+{
+    PeriodCountController controller(2, 6, 4);
+
+    // Statistics accumulate until the window is long enough
+    controller.addStatistics(0, 3 * gPeriodNs + 1, gWindowNs / 2);
+    EXPECT_FALSE(controller.adapt(gPeriodNs));
+    controller.addStatistics(0, gPeriodNs, gWindowNs / 2);
+    EXPECT_TRUE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(5u, controller.getPeriodCount());
+}
+
+TEST(PeriodCountController, shrinkAfterCalmWindows)
+{
+    PeriodCountController controller(2, 6, 4);
+
+    for (uint32_t window = 1; window < PeriodCountController::mCalmWindowsToDecrease; window++) {
+        controller.addStatistics(0, gPeriodNs, gWindowNs);
+        EXPECT_FALSE(controller.adapt(gPeriodNs));
+    }
+    controller.addStatistics(0, gPeriodNs, gWindowNs);
+    EXPECT_TRUE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(3u, controller.getPeriodCount());
+
+    // Calm windows are counted again from the change
+    for (uint32_t window = 1; window < PeriodCountController::mCalmWindowsToDecrease; window++) {
+        controller.addStatistics(0, gPeriodNs, gWindowNs);
+        EXPECT_FALSE(controller.adapt(gPeriodNs));
+    }
+    controller.addStatistics(0, gPeriodNs, gWindowNs);
+    EXPECT_TRUE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(2u, controller.getPeriodCount());
+
+    // Lower bound
+    for (uint32_t window = 0; window < PeriodCountController::mCalmWindowsToDecrease; window++) {
+        controller.addStatistics(0, 0, gWindowNs);
+        EXPECT_FALSE(controller.adapt(gPeriodNs));
+    }
+    EXPECT_EQ(2u, controller.getPeriodCount());
+}
+
+TEST(PeriodCountController, calmWindowsInARow)
+{
+    PeriodCountController controller(2, 6, 4);
+
+    // Window neither calm enough to shrink nor loaded enough to grow: calm windows restart
+    for (uint32_t window = 1; window < PeriodCountController::mCalmWindowsToDecrease; window++) {
+        controller.addStatistics(0, gPeriodNs, gWindowNs);
+        EXPECT_FALSE(controller.adapt(gPeriodNs));
+    }
+    controller.addStatistics(0, 2 * gPeriodNs + 1, gWindowNs);
+    EXPECT_FALSE(controller.adapt(gPeriodNs));
+    controller.addStatistics(0, gPeriodNs, gWindowNs);
+    EXPECT_FALSE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(4u, controller.getPeriodCount());
+
+    // An xrun restarts them as well
+    controller.addStatistics(1, gPeriodNs, gWindowNs);
+    EXPECT_TRUE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(5u, controller.getPeriodCount());
+    for (uint32_t window = 1; window < PeriodCountController::mCalmWindowsToDecrease; window++) {
+        controller.addStatistics(0, gPeriodNs, gWindowNs);
+        EXPECT_FALSE(controller.adapt(gPeriodNs));
+    }
+    controller.addStatistics(0, gPeriodNs, gWindowNs);
+    EXPECT_TRUE(controller.adapt(gPeriodNs));
+    EXPECT_EQ(4u, controller.getPeriodCount());
+}
+
+} // namespace intel_audio
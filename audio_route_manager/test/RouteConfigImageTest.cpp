@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <RouteConfigImage.hpp>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace intel_audio
+{
+
+#ifdef __ANDROID__
+static const char gTmpFolder[] = "/data/local/tmp";
+#else
+static const char gTmpFolder[] = "/tmp";
+#endif
+
+static const char gMainXml[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<audioPolicyConfiguration version=\"1.0\" xmlns:xi=\"http://www.w3.org/2001/XInclude\">\n"
+    "    <modules>\n"
+    "        <module name=\"primary\" halVersion=\"3.0\"/>\n"
+    "        <xi:include href=\"usb.xml\"/>\n"
+    "    </modules>\n"
+    "    <volumes/>\n"
+    "</audioPolicyConfiguration>\n";
+
+static const char gIncludedXml[] = "<module name=\"usb\" halVersion=\"2.0\"/>\n";
+
+/**
+ * Binary layout of the image, as documented by RouteConfigImage, in 32-bit words: header, then
+ * source and node records.
+ */
+static const size_t gHeaderWords = 8;
+static const size_t gHeaderSize = gHeaderWords * sizeof(uint32_t);
+static const size_t gVersionOffset = sizeof(uint32_t);
+static const size_t gPayloadChecksumWord = 3;
+static const size_t gSourceCountWord = 4;
+static const size_t gNodeCountWord = 5;
+static const size_t gAttributeCountWord = 6;
+static const size_t gSourceRecordWords = 3;
+static const size_t gNodeRecordWords = 5;
+static const size_t gFirstAttributeField = 1;
+static const size_t gFirstChildField = 3;
+static const size_t gNextSiblingField = 4;
+
+class RouteConfigImageTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        const char *tmpFolder = getenv("TMPDIR");
+        std::string folder = std::string(tmpFolder != NULL ? tmpFolder : gTmpFolder) +
+                             "/RouteConfigImageTest.XXXXXX";
+        ASSERT_TRUE(mkdtemp(&folder[0]) != NULL) << folder;
+        mFolder = folder + "/";
+        writeFile(mFolder + "main.xml", gMainXml);
+        writeFile(mFolder + "usb.xml", gIncludedXml);
+        mImageFile = mFolder + "main.bin";
+    }
+
+    virtual void TearDown()
+    {
+        unlink((mFolder + "main.xml").c_str());
+        unlink((mFolder + "usb.xml").c_str());
+        unlink(mImageFile.c_str());
+        rmdir(mFolder.c_str());
+    }
+
+    static void writeFile(const std::string &path, const std::string &content)
+    {
+        FILE *file = fopen(path.c_str(), "wb");
+        ASSERT_TRUE(file != NULL) << path;
+        EXPECT_EQ(content.size(), fwrite(content.data(), 1, content.size(), file));
+        fclose(file);
+    }
+
+    static std::vector<uint8_t> readFile(const std::string &path)
+    {
+        std::vector<uint8_t> content;
+        FILE *file = fopen(path.c_str(), "rb");
+        EXPECT_TRUE(file != NULL) << path;
+        if (file != NULL) {
+            uint8_t buffer[256];
+            size_t size;
+            while ((size = fread(buffer, 1, sizeof(buffer), file)) != 0) {
+                content.insert(content.end(), buffer, buffer + size);
+            }
+            fclose(file);
+        }
+        return content;
+    }
+
+    static void writeFile(const std::string &path, const std::vector<uint8_t> &content)
+    {
+        writeFile(path, std::string(content.begin(), content.end()));
+    }
+
+    /** @return 32-bit word of the image at the given word index. */
+    static uint32_t getWord(const std::vector<uint8_t> &image, size_t word)
+    {
+        uint32_t value;
+        memcpy(&value, &image[word * sizeof(value)], sizeof(value));
+        return value;
+    }
+
+    static void setWord(std::vector<uint8_t> &image, size_t word, uint32_t value)
+    {
+        memcpy(&image[word * sizeof(value)], &value, sizeof(value));
+    }
+
+    /** Sets the modification time of a file, relative to the one of the image. */
+    void setModificationTime(const std::string &path, time_t delaySinceImage)
+    {
+        struct stat imageStat;
+        ASSERT_EQ(0, stat(mImageFile.c_str(), &imageStat));
+        struct timeval times[2] = {
+            { imageStat.st_mtime + delaySinceImage, 0 },
+            { imageStat.st_mtime + delaySinceImage, 0 }
+        };
+        ASSERT_EQ(0, utimes(path.c_str(), times));
+    }
+
+    /** Builds the image from the XML files, and saves it. */
+    void saveImage()
+    {
+        RouteConfigImage image;
+        ASSERT_EQ(android::OK, image.parseXml(mFolder + "main.xml"));
+        ASSERT_EQ(android::OK, image.save(mImageFile));
+        // Sources installed before the image
+        setModificationTime(mFolder + "main.xml", -10);
+        setModificationTime(mFolder + "usb.xml", -10);
+    }
+
+    /** Modifies a word of the node records, and checksums the payload again. */
+    void corruptNode(uint32_t node, size_t field, uint32_t value)
+    {
+        std::vector<uint8_t> image = readFile(mImageFile);
+        ASSERT_GT(image.size(), gHeaderSize);
+        size_t nodes = gHeaderWords + getWord(image, gSourceCountWord) * gSourceRecordWords;
+        ASSERT_LT(node, getWord(image, gNodeCountWord));
+        setWord(image, nodes + node * gNodeRecordWords + field, value);
+        setWord(image, gPayloadChecksumWord,
+                RouteConfigImage::computeChecksum(&image[gHeaderSize],
+                                                  image.size() - gHeaderSize));
+        writeFile(mImageFile, image);
+    }
+
+    std::string mFolder;
+    std::string mImageFile;
+};
+
+/** Checks the element tree of the test configuration, XInclude resolved. */
+static void checkTree(const RouteConfigImage &image)
+{
+    RouteConfigImage::Node root = image.getRoot();
+    ASSERT_TRUE(root.isValid());
+    EXPECT_STREQ("audioPolicyConfiguration", root.getName());
+    EXPECT_EQ("1.0", root.getAttribute("version"));
+    EXPECT_EQ("", root.getAttribute("missing"));
+
+    RouteConfigImage::Node modules = root.getFirstChild();
+    ASSERT_TRUE(modules.isValid());
+    EXPECT_TRUE(modules.hasName("modules"));
+    RouteConfigImage::Node primary = modules.getFirstChild();
+    ASSERT_TRUE(primary.isValid());
+    EXPECT_EQ("primary", primary.getAttribute("name"));
+    EXPECT_EQ("3.0", primary.getAttribute("halVersion"));
+    EXPECT_FALSE(primary.getFirstChild().isValid());
+    RouteConfigImage::Node usb = primary.getNextSibling();
+    ASSERT_TRUE(usb.isValid());
+    EXPECT_TRUE(usb.hasName("module"));
+    EXPECT_EQ("usb", usb.getAttribute("name"));
+    EXPECT_FALSE(usb.getNextSibling().isValid());
+
+    RouteConfigImage::Node volumes = modules.getNextSibling();
+    ASSERT_TRUE(volumes.isValid());
+    EXPECT_TRUE(volumes.hasName("volumes"));
+    EXPECT_FALSE(volumes.getFirstChild().isValid());
+    EXPECT_FALSE(volumes.getNextSibling().isValid());
+}
+
+TEST_F(RouteConfigImageTest, roundTrip)
+{
+    RouteConfigImage parsed;
+    ASSERT_EQ(android::OK, parsed.parseXml(mFolder + "main.xml"));
+    checkTree(parsed);
+    EXPECT_TRUE(parsed.isUpToDate(mFolder));
+    ASSERT_EQ(android::OK, parsed.save(mImageFile));
+
+    RouteConfigImage loaded;
+    ASSERT_EQ(android::OK, loaded.load(mImageFile));
+    checkTree(loaded);
+
+    RouteConfigImage empty;
+    EXPECT_FALSE(empty.getRoot().isValid());
+    EXPECT_EQ(android::NO_INIT, empty.save(mImageFile));
+    EXPECT_NE(android::OK, empty.load(mFolder + "missing.bin"));
+}
+
+TEST_F(RouteConfigImageTest, corruptedPayload)
+{
+    saveImage();
+    std::vector<uint8_t> content = readFile(mImageFile);
+    ASSERT_GT(content.size(), gHeaderSize);
+    content[content.size() - 2] ^= 1;
+    writeFile(mImageFile, content);
+
+    RouteConfigImage image;
+    EXPECT_EQ(android::BAD_VALUE, image.load(mImageFile));
+    EXPECT_FALSE(image.getRoot().isValid());
+}
+
+TEST_F(RouteConfigImageTest, incompatibleHeader)
+{
+    saveImage();
+    const std::vector<uint8_t> content = readFile(mImageFile);
+    ASSERT_GT(content.size(), gHeaderSize);
+    RouteConfigImage image;
+
+    std::vector<uint8_t> badMagic = content;
+    badMagic[0] ^= 1;
+    writeFile(mImageFile, badMagic);
+    EXPECT_EQ(android::BAD_VALUE, image.load(mImageFile));
+
+    // Major version is the first half word following the magic, then comes the minor version
+    std::vector<uint8_t> unknownMajor = content;
+    uint16_t version;
+    memcpy(&version, &unknownMajor[gVersionOffset], sizeof(version));
+    version++;
+    memcpy(&unknownMajor[gVersionOffset], &version, sizeof(version));
+    writeFile(mImageFile, unknownMajor);
+    EXPECT_EQ(android::BAD_VALUE, image.load(mImageFile));
+
+    // Unknown minor version is compatible, as long as the checksum matches
+    std::vector<uint8_t> unknownMinor = content;
+    memcpy(&version, &unknownMinor[gVersionOffset + sizeof(version)], sizeof(version));
+    version++;
+    memcpy(&unknownMinor[gVersionOffset + sizeof(version)], &version, sizeof(version));
+    writeFile(mImageFile, unknownMinor);
+    EXPECT_EQ(android::OK, image.load(mImageFile));
+}
+
+TEST_F(RouteConfigImageTest, truncatedFile)
+{
+    saveImage();
+    struct stat imageStat;
+    ASSERT_EQ(0, stat(mImageFile.c_str(), &imageStat));
+    RouteConfigImage image;
+
+    ASSERT_EQ(0, truncate(mImageFile.c_str(), imageStat.st_size - 1));
+    EXPECT_EQ(android::BAD_VALUE, image.load(mImageFile));
+
+    // Not even a header
+    ASSERT_EQ(0, truncate(mImageFile.c_str(), 10));
+    EXPECT_EQ(android::BAD_VALUE, image.load(mImageFile));
+    ASSERT_EQ(0, truncate(mImageFile.c_str(), 0));
+    EXPECT_EQ(android::BAD_VALUE, image.load(mImageFile));
+}
+
+TEST_F(RouteConfigImageTest, indexOutOfRange)
+{
+    saveImage();
+    const std::vector<uint8_t> content = readFile(mImageFile);
+    ASSERT_GT(content.size(), gHeaderSize);
+    const uint32_t nodeCount = getWord(content, gNodeCountWord);
+    const uint32_t attributeCount = getWord(content, gAttributeCountWord);
+    RouteConfigImage image;
+
+    corruptNode(0, gFirstChildField, nodeCount);
+    EXPECT_EQ(android::BAD_VALUE, image.load(mImageFile));
+    writeFile(mImageFile, content);
+
+    corruptNode(1, gNextSiblingField, nodeCount);
+    EXPECT_EQ(android::BAD_VALUE, image.load(mImageFile));
+    writeFile(mImageFile, content);
+
+    // Link backwards, i.e. a loop
+    corruptNode(1, gFirstChildField, 0);
+    EXPECT_EQ(android::BAD_VALUE, image.load(mImageFile));
+    writeFile(mImageFile, content);
+
+    corruptNode(0, gFirstAttributeField, attributeCount);
+    EXPECT_EQ(android::BAD_VALUE, image.load(mImageFile));
+    writeFile(mImageFile, content);
+
+    // Valid again once restored
+    EXPECT_EQ(android::OK, image.load(mImageFile));
+}
+
+TEST_F(RouteConfigImageTest, staleSources)
+{
+    saveImage();
+    RouteConfigImage image;
+    ASSERT_EQ(android::OK, image.load(mImageFile));
+    EXPECT_TRUE(image.isUpToDate(mFolder));
+
+    // Same size, pushed after the image
+    setModificationTime(mFolder + "usb.xml", 10);
+    EXPECT_FALSE(image.isUpToDate(mFolder));
+    setModificationTime(mFolder + "usb.xml", -10);
+    EXPECT_TRUE(image.isUpToDate(mFolder));
+
+    // Size changed, whatever its modification time
+    writeFile(mFolder + "usb.xml", std::string(gIncludedXml) + "\n");
+    setModificationTime(mFolder + "usb.xml", -10);
+    EXPECT_FALSE(image.isUpToDate(mFolder));
+
+    // Missing source cannot invalidate the image
+    unlink((mFolder + "usb.xml").c_str());
+    EXPECT_TRUE(image.isUpToDate(mFolder));
+}
+
+} // namespace intel_audio
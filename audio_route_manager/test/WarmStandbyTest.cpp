@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AudioRouteCollection.hpp"
+#include "AudioStreamRoute.hpp"
+#include "AudioPort.hpp"
+#include <AudioDevice.hpp>
+#include <IoStream.hpp>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace intel_audio
+{
+
+static const uint32_t gStandbyDelayMs = 100;
+static const int64_t gStandbyDelayUs = static_cast<int64_t>(gStandbyDelayMs) * 1000;
+static const uint32_t gRate = 48000;
+static const uint32_t gOtherRate = 44100;
+
+/** Device counting its openings, closings and stops. */
+class FakeAudioDevice : public IAudioDevice
+{
+public:
+    FakeAudioDevice() : mIsOpened(false), mOpenings(0), mClosings(0), mStops(0) {}
+
+    virtual android::status_t open(const char *, uint32_t, const MixPortConfig &, bool)
+    {
+        mIsOpened = true;
+        mOpenings++;
+        return android::OK;
+    }
+
+    virtual android::status_t close()
+    {
+        mIsOpened = false;
+        mClosings++;
+        return android::OK;
+    }
+
+    virtual bool isOpened() { return mIsOpened; }
+
+    virtual android::status_t pcmReadFrames(void *, size_t, std::string &) const
+    {
+        return android::INVALID_OPERATION;
+    }
+
+    virtual android::status_t pcmWriteFrames(void *, ssize_t, std::string &) const
+    {
+        return android::INVALID_OPERATION;
+    }
+
+    virtual uint32_t getBufferSizeInBytes() const { return 0; }
+    virtual size_t getBufferSizeInFrames() const { return 0; }
+    virtual android::status_t getFramesAvailable(size_t &, struct timespec &) const
+    {
+        return android::INVALID_OPERATION;
+    }
+
+    virtual android::status_t pcmStop() const
+    {
+        mStops++;
+        return android::OK;
+    }
+
+    virtual XrunMonitor &getXrunMonitor() { return mXrunMonitor; }
+
+    bool mIsOpened;
+    uint32_t mOpenings;
+    uint32_t mClosings;
+    mutable uint32_t mStops;
+
+private:
+    XrunMonitor mXrunMonitor;
+};
+
+/** Primary output stream, started and stopped by the test. */
+class FakeOutputStream : public IoStream
+{
+public:
+    FakeOutputStream(uint32_t rate) : mIsStarted(false)
+    {
+        setSampleRate(rate);
+        setFormat(AUDIO_FORMAT_PCM_16_BIT);
+        setChannels(AUDIO_CHANNEL_OUT_STEREO, true);
+        setDevices(AUDIO_DEVICE_OUT_SPEAKER, "");
+    }
+
+    virtual bool isOut() const { return true; }
+    virtual audio_port_role_t getRole() const { return AUDIO_PORT_ROLE_SOURCE; }
+    virtual bool isStarted() const { return mIsStarted; }
+    virtual bool isRoutedByPolicy() const { return true; }
+    virtual uint32_t getFlagMask() const { return AUDIO_OUTPUT_FLAG_PRIMARY; }
+    virtual uint32_t getUseCaseMask() const { return 0; }
+
+    bool mIsStarted;
+};
+
+/**
+ * Single primary playback route with a standby delay, routed the way the route manager does,
+ * upon a clock driven by the test.
+ */
+class WarmStandbyTest : public ::testing::Test
+{
+protected:
+    WarmStandbyTest()
+        : mStream(gRate),
+          mOtherRateStream(gOtherRate),
+          mPort("primary_out", true),
+          mDevice(new FakeAudioDevice),
+          mRoute(NULL)
+    {}
+
+    virtual void SetUp()
+    {
+        AudioCapability capability;
+        capability.mSupportedFormat = AUDIO_FORMAT_PCM_16_BIT;
+        capability.mSupportedRates.push_back(gRate);
+        capability.mSupportedRates.push_back(gOtherRate);
+        capability.mSupportedChannelMasks.push_back(AUDIO_CHANNEL_OUT_STEREO);
+
+        MixPortConfig config;
+        config.isOut = true;
+        config.requirePreEnable = false;
+        config.requirePostDisable = false;
+        config.cardName = "fake";
+        config.deviceId = 0;
+        config.periodSize = 240;
+        config.periodCount = 4;
+        config.startThreshold = 240;
+        config.stopThreshold = 960;
+        config.silenceThreshold = 0;
+        config.availMin = 240;
+        config.mAudioCapabilities.push_back(capability);
+        config.silencePrologInMs = 0;
+        config.standbyDelayMs = gStandbyDelayMs;
+        config.flagMask = AUDIO_OUTPUT_FLAG_PRIMARY;
+        config.useCaseMask = 0;
+        config.supportedDeviceMask = AUDIO_DEVICE_OUT_SPEAKER;
+        mPort.setConfig(config);
+        mPort.setAlsaDevice(mDevice);
+
+        AudioPorts sinks;
+        AudioPorts sources;
+        sources.push_back(&mPort);
+        // Owned by the collection, the route owns the device
+        mRoute = new AudioStreamRoute("primary_out", sinks, sources, ROUTE_TYPE_STREAM_PLAYBACK);
+        mRoutes.push_back(mRoute);
+        mRoutes.addStream(mStream);
+        mRoutes.addStream(mOtherRateStream);
+    }
+
+    /**
+     * Mirrors the evaluation of the route manager, the routing stages applying no configuration.
+     *
+     * @param[in] nowUs monotonic time of the evaluation.
+     *
+     * @return true if the routing stages were run, i.e. the Parameter Framework was involved.
+     */
+    bool evaluateRouting(int64_t nowUs)
+    {
+        mRoutes.resetAvailability();
+        mRoutes.prepareRouting(nowUs);
+        bool routingHasChanged = mRoutes.routingHasChanged();
+
+        mRoutes.applyWarmStandby();
+        mRoutes.detachLeavingSharedStreams();
+        if (routingHasChanged) {
+            mRoutes.disableRoutes();
+            mRoutes.postDisableRoutes();
+            mRoutes.preEnableRoutes();
+            mRoutes.enableRoutes();
+        }
+        mRoutes.attachJoiningSharedStreams();
+        return routingHasChanged;
+    }
+
+    /** Plays the stream, then parks the route in warm standby at the given time. */
+    void parkInWarmStandby(int64_t nowUs)
+    {
+        mStream.mIsStarted = true;
+        ASSERT_TRUE(evaluateRouting(nowUs));
+        ASSERT_TRUE(mStream.isRouted());
+
+        mStream.mIsStarted = false;
+        // The route stays enabled, no routing stage
+        ASSERT_FALSE(evaluateRouting(nowUs));
+        ASSERT_TRUE(mRoute->isWarmStandby());
+        ASSERT_FALSE(mStream.isRouted());
+        ASSERT_TRUE(mDevice->isOpened());
+        ASSERT_EQ(1u, mDevice->mStops);
+        ASSERT_EQ(nowUs + gStandbyDelayUs, mRoutes.getNextWarmStandbyDeadlineUs());
+    }
+
+    /** Declared first, the routes being destroyed before the streams they refer to. */
+    FakeOutputStream mStream;
+    FakeOutputStream mOtherRateStream;
+    MixPort mPort;
+    FakeAudioDevice *mDevice;
+    AudioStreamRoute *mRoute;
+    AudioRouteCollection mRoutes;
+};
+
+TEST_F(WarmStandbyTest, resumeWithoutRoutingStage)
+{
+    ASSERT_NO_FATAL_FAILURE(parkInWarmStandby(0));
+
+    mStream.mIsStarted = true;
+    EXPECT_FALSE(evaluateRouting(gStandbyDelayUs / 2));
+    EXPECT_TRUE(mStream.isRouted());
+    EXPECT_FALSE(mRoute->isWarmStandby());
+    EXPECT_EQ(0, mRoutes.getNextWarmStandbyDeadlineUs());
+    // Device neither reopened nor closed
+    EXPECT_EQ(1u, mDevice->mOpenings);
+    EXPECT_EQ(0u, mDevice->mClosings);
+
+    // A new standby restarts the delay
+    mStream.mIsStarted = false;
+    EXPECT_FALSE(evaluateRouting(gStandbyDelayUs));
+    EXPECT_EQ(2 * gStandbyDelayUs, mRoutes.getNextWarmStandbyDeadlineUs());
+}
+
+TEST_F(WarmStandbyTest, teardownUponDelayExpiry)
+{
+    ASSERT_NO_FATAL_FAILURE(parkInWarmStandby(0));
+
+    // Evaluation before the alarm keeps the route
+    EXPECT_FALSE(evaluateRouting(gStandbyDelayUs - 1));
+    EXPECT_TRUE(mRoute->isWarmStandby());
+    EXPECT_EQ(gStandbyDelayUs, mRoutes.getNextWarmStandbyDeadlineUs());
+
+    // Evaluation upon alarm disables the route
+    EXPECT_TRUE(evaluateRouting(mRoutes.getNextWarmStandbyDeadlineUs()));
+    EXPECT_FALSE(mRoute->isWarmStandby());
+    EXPECT_FALSE(mRoute->isUsed());
+    EXPECT_FALSE(mDevice->isOpened());
+    EXPECT_EQ(1u, mDevice->mClosings);
+    EXPECT_EQ(0, mRoutes.getNextWarmStandbyDeadlineUs());
+
+    // Next start goes through the routing stages
+    mStream.mIsStarted = true;
+    EXPECT_TRUE(evaluateRouting(2 * gStandbyDelayUs));
+    EXPECT_TRUE(mStream.isRouted());
+    EXPECT_EQ(2u, mDevice->mOpenings);
+}
+
+TEST_F(WarmStandbyTest, noResumeUponConfigurationChange)
+{
+    ASSERT_NO_FATAL_FAILURE(parkInWarmStandby(0));
+
+    // The device opened at the previous rate cannot serve the new stream
+    mOtherRateStream.mIsStarted = true;
+    EXPECT_TRUE(evaluateRouting(gStandbyDelayUs / 2));
+    EXPECT_TRUE(mOtherRateStream.isRouted());
+    EXPECT_FALSE(mRoute->isWarmStandby());
+    EXPECT_EQ(gOtherRate, mRoute->getSampleSpec().getSampleRate());
+    EXPECT_EQ(1u, mDevice->mClosings);
+    EXPECT_EQ(2u, mDevice->mOpenings);
+    EXPECT_TRUE(mDevice->isOpened());
+}
+
+} // namespace intel_audio
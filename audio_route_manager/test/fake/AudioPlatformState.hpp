@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+namespace intel_audio
+{
+
+/**
+ * Fake of the platform state for unit tests, collecting an info naming each collection.
+ */
+class AudioPlatformState
+{
+public:
+    AudioPlatformState() : mCollections(0) {}
+
+    void getPlatformFwErrorInfo(std::string &info) const
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mCollections++;
+        info += "collection " + std::to_string(mCollections) + "\n";
+        mCond.notify_all();
+    }
+
+    void waitForCollections(uint32_t collections)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCond.wait(lock, [this, collections] { return mCollections >= collections; });
+    }
+
+private:
+    mutable std::mutex mLock;
+    mutable std::condition_variable mCond;
+    mutable uint32_t mCollections;
+};
+
+} // namespace intel_audio
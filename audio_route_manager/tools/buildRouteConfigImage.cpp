@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Host tool generating the precompiled image of the route manager configuration file.
+ *
+ * Usage: buildRouteConfigImage <audio_policy_configuration.xml> <output image>
+ *
+ * The XIncluded files are resolved relatively to the configuration file, and are expected to be
+ * installed in the same folder on target, so that the route manager is able to detect a stale
+ * image and fall back on the XML file.
+ */
+
+#include "RouteConfigImage.hpp"
+#include <stdio.h>
+
+using intel_audio::RouteConfigImage;
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <configuration xml file> <output image file>\n", argv[0]);
+        return 1;
+    }
+    RouteConfigImage image;
+    if (image.parseXml(argv[1]) != android::OK) {
+        fprintf(stderr, "%s: could not parse %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    if (image.save(argv[2]) != android::OK) {
+        fprintf(stderr, "%s: could not write %s\n", argv[0], argv[2]);
+        return 1;
+    }
+    // Ensure the generated image will be accepted on target.
+    RouteConfigImage check;
+    if (check.load(argv[2]) != android::OK) {
+        fprintf(stderr, "%s: generated image %s is invalid\n", argv[0], argv[2]);
+        return 1;
+    }
+    return 0;
+}
@@ -1,6 +1,6 @@
 #
 #
-# Copyright (C) Intel 2013-2017
+# Copyright (C) Intel 2013-2018
 #
 # Licensed under the Apache License, Version 2.0 (the "License");
 # you may not use this file except in compliance with the License.
@@ -31,6 +31,11 @@ component_src_files :=  \
     src/StreamIn.cpp \
     src/StreamOut.cpp \
     src/CompressedStreamOut.cpp \
+    src/OffloadCommandQueue.cpp \
+    src/OffloadBufferSizer.cpp \
+    src/PreProcessingPipeline.cpp \
+    src/PresentationPositionTracker.cpp \
+    src/CapturePositionTracker.cpp \
     src/Patch.cpp \
     src/Port.cpp
 
@@ -234,6 +239,174 @@ include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
 include $(BUILD_HOST_EXECUTABLE)
 endif
 
+#######################################################################
+# Offload unit tests: command queue (using a fake compress device) and buffer sizing
+
+offload_queue_test_src_files := \
+    src/OffloadCommandQueue.cpp \
+    src/OffloadBufferSizer.cpp \
+    test/OffloadCommandQueueTest.cpp \
+    test/OffloadBufferSizerTest.cpp
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(offload_queue_test_src_files)
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/src
+LOCAL_STATIC_LIBRARIES := \
+    libaudio_comms_utilities \
+    liblog
+LOCAL_SHARED_LIBRARIES := libcutils
+LOCAL_MODULE := offload_command_queue_test
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Werror -Wextra -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+include $(BUILD_NATIVE_TEST)
+
+ifeq (ENABLE_HOST_VERSION,1)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(offload_queue_test_src_files)
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/src \
+    external/gtest/include
+LOCAL_STATIC_LIBRARIES := \
+    libaudio_comms_utilities_host \
+    liblog \
+    libgtest_host \
+    libgtest_main_host
+LOCAL_LDFLAGS += -lpthread -lrt
+LOCAL_MODULE := offload_command_queue_test_host
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Werror -Wextra -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+# Cannot use $(BUILD_HOST_NATIVE_TEST) because of compilation flag
+# misalignment against gtest mk files
+include $(BUILD_HOST_EXECUTABLE)
+endif
+
+#######################################################################
+# Preprocessing pipeline unit tests (using a fake effect)
+
+preprocessing_pipeline_test_src_files := \
+    src/PreProcessingPipeline.cpp \
+    test/PreProcessingPipelineTest.cpp
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(preprocessing_pipeline_test_src_files)
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/src
+LOCAL_STATIC_LIBRARIES := \
+    libaudio_comms_utilities \
+    liblog
+LOCAL_SHARED_LIBRARIES := libcutils
+LOCAL_MODULE := preprocessing_pipeline_test
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Werror -Wextra -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+include $(BUILD_NATIVE_TEST)
+
+ifeq (ENABLE_HOST_VERSION,1)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(preprocessing_pipeline_test_src_files)
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/src \
+    external/gtest/include
+LOCAL_STATIC_LIBRARIES := \
+    libaudio_comms_utilities_host \
+    liblog \
+    libgtest_host \
+    libgtest_main_host
+LOCAL_LDFLAGS += -lpthread -lrt
+LOCAL_MODULE := preprocessing_pipeline_test_host
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Werror -Wextra -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+# Cannot use $(BUILD_HOST_NATIVE_TEST) because of compilation flag
+# misalignment against gtest mk files
+include $(BUILD_HOST_EXECUTABLE)
+endif
+
+#######################################################################
+# Presentation and capture position tracker unit tests
+
+presentation_position_test_src_files := \
+    src/PresentationPositionTracker.cpp \
+    src/CapturePositionTracker.cpp \
+    test/PresentationPositionTrackerTest.cpp \
+    test/CapturePositionTrackerTest.cpp
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(presentation_position_test_src_files)
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/src
+LOCAL_STATIC_LIBRARIES := \
+    libaudio_comms_utilities \
+    liblog
+LOCAL_SHARED_LIBRARIES := libcutils
+LOCAL_MODULE := presentation_position_test
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Werror -Wextra -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+include $(BUILD_NATIVE_TEST)
+
+ifeq (ENABLE_HOST_VERSION,1)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(presentation_position_test_src_files)
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/src \
+    external/gtest/include
+LOCAL_STATIC_LIBRARIES := \
+    libaudio_comms_utilities_host \
+    liblog \
+    libgtest_host \
+    libgtest_main_host
+LOCAL_LDFLAGS += -lpthread -lrt
+LOCAL_MODULE := presentation_position_test_host
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Werror -Wextra -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+# Cannot use $(BUILD_HOST_NATIVE_TEST) because of compilation flag
+# misalignment against gtest mk files
+include $(BUILD_HOST_EXECUTABLE)
+endif
+
+#######################################################################
+# Stream state contention benchmark (using the streams of the HAL without parent device)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    $(component_src_files) \
+    test/StreamStateContentionTest.cpp
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/src \
+    $(component_includes_dir_target)
+LOCAL_STATIC_LIBRARIES := $(component_static_lib_target)
+LOCAL_WHOLE_STATIC_LIBRARIES := $(component_whole_static_lib)
+LOCAL_SHARED_LIBRARIES := $(component_shared_lib_target)
+LOCAL_MODULE := stream_state_contention_test
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+# Built as the HAL, with its own flags
+LOCAL_CFLAGS := $(component_cflags) -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+include $(BUILD_NATIVE_TEST)
+
 #######################################################################
 # Build for configuration file
 
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CapturePositionTracker.hpp"
+
+using audio_comms::utilities::Mutex;
+
+namespace intel_audio
+{
+
+static const int64_t gNsecPerSec = 1000000000LL;
+
+CapturePositionTracker::CapturePositionTracker()
+    : mFrames(0),
+      mTimeNs(0)
+{
+}
+
+void CapturePositionTracker::update(uint64_t readFrames, size_t kernelFrames,
+                                    uint32_t kernelRate, size_t pendingFrames, uint32_t rate,
+                                    const struct timespec &timestamp)
+{
+    Mutex::Locker locker(mWriterLock);
+    if (kernelRate == 0 || rate == 0) {
+        writePositionL(0, 0);
+        return;
+    }
+    // The frame following the frames read is the oldest one captured and not read yet: it was
+    // captured before all the frames in the kernel and pending in the stream.
+    int64_t delayNs = static_cast<int64_t>(kernelFrames) * gNsecPerSec / kernelRate +
+                      static_cast<int64_t>(pendingFrames) * gNsecPerSec / rate;
+    writePositionL(readFrames, timestamp.tv_sec * gNsecPerSec + timestamp.tv_nsec - delayNs);
+}
+
+void CapturePositionTracker::invalidate()
+{
+    Mutex::Locker locker(mWriterLock);
+    writePositionL(0, 0);
+}
+
+void CapturePositionTracker::writePositionL(int64_t frames, int64_t timeNs)
+{
+    mSequenceLock.beginWrite();
+    mFrames.store(frames, std::memory_order_relaxed);
+    mTimeNs.store(timeNs, std::memory_order_relaxed);
+    mSequenceLock.endWrite();
+}
+
+bool CapturePositionTracker::getCapturePosition(int64_t &frames, int64_t &timeNs) const
+{
+    uint32_t sequence;
+    int64_t positionFrames;
+    int64_t positionTimeNs;
+    do {
+        sequence = mSequenceLock.beginRead();
+        positionFrames = mFrames.load(std::memory_order_relaxed);
+        positionTimeNs = mTimeNs.load(std::memory_order_relaxed);
+    } while (mSequenceLock.retryRead(sequence));
+    if (positionTimeNs == 0) {
+        return false;
+    }
+    frames = positionFrames;
+    timeNs = positionTimeNs;
+    return true;
+}
+
+} // namespace intel_audio
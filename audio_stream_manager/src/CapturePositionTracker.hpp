@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "SequenceLock.hpp"
+#include <AudioNonCopyable.hpp>
+#include <Mutex.hpp>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+namespace intel_audio
+{
+
+/**
+ * Tracks the capture position of a capture stream while routed.
+ *
+ * The stream thread updates it once per read from the HW timestamp of the audio device,
+ * corrected by the frames captured but not read yet by the client. Position pollers read the
+ * latest update through a seqlock: they take neither the stream lock nor issue any syscall to
+ * the device.
+ */
+class CapturePositionTracker : private audio_comms::utilities::NonCopyable
+{
+public:
+    CapturePositionTracker();
+
+    /**
+     * Publishes the position of the stream after a read.
+     *
+     * @param[in] readFrames frames read since the stream started.
+     * @param[in] kernelFrames frames captured in the ring buffer of the device, not read yet.
+     * @param[in] kernelRate rate of the device.
+     * @param[in] pendingFrames frames read from the device, not read by the client yet, e.g.
+     *                          conversion leftovers or frames within the preprocessing.
+     * @param[in] rate of the stream.
+     * @param[in] timestamp monotonic HW timestamp at which kernelFrames were captured.
+     */
+    void update(uint64_t readFrames, size_t kernelFrames, uint32_t kernelRate,
+                size_t pendingFrames, uint32_t rate, const struct timespec &timestamp);
+
+    /** Invalidates the position, e.g. when the stream is unrouted. */
+    void invalidate();
+
+    /**
+     * @param[out] frames read at last update.
+     * @param[out] timeNs monotonic capture time of the frame following the frames read.
+     *
+     * @return true if the position is valid, false if no update since invalidated.
+     */
+    bool getCapturePosition(int64_t &frames, int64_t &timeNs) const;
+
+private:
+    /** Publishes a position, under writer lock. timeNs is 0 for an invalid position. */
+    void writePositionL(int64_t frames, int64_t timeNs);
+
+    SequenceLock mSequenceLock;
+
+    std::atomic<int64_t> mFrames;
+    std::atomic<int64_t> mTimeNs;
+
+    /** Serializes the writers: read and route detachment may happen in any thread. */
+    audio_comms::utilities::Mutex mWriterLock;
+};
+
+} // namespace intel_audio
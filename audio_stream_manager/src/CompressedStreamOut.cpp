@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2015-2016 Intel Corporation
+ * Copyright (C) 2015-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -18,6 +18,8 @@
 
 #include "CompressedStreamOut.hpp"
 #include "AudioUtils.hpp"
+#include <AudioCommsAssert.hpp>
+#include <SoundCardRegistry.hpp>
 #include <property/Property.hpp>
 #include <convert/convert.hpp>
 #include <utilities/Log.hpp>
@@ -31,6 +33,7 @@
 #include <fcntl.h>
 #include <time.h>
 #include <utils/threads.h>
+#include <utils/String8.h>
 #include <sys/resource.h>
 #include <sys/prctl.h>
 #include <cutils/sched_policy.h>
@@ -56,6 +59,13 @@ static const size_t gOffloadMaxAllowedBufferSizeInBytes = (128 * 1024);
 static const uint32_t gOffloadTransferIntervalInSec = 8;
 static const uint32_t gCodecOffloadDefaultBitrateInBps = 128000;
 
+static int64_t getMonotonicTimeNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
 CompressedStreamOut::CompressedStreamOut(Device *parent, audio_io_handle_t handle,
                                          uint32_t flagMask, audio_devices_t devices,
                                          const std::string &address)
@@ -63,6 +73,12 @@ CompressedStreamOut::CompressedStreamOut(Device *parent, audio_io_handle_t handl
       mCompress(NULL),
       mVolume(SST_VOLUME_MUTE),
       mIsVolumeChangeRequestPending(false),
+      mBufferSizer(gOffloadMinAllowedBufferSizeInBytes, gOffloadMaxAllowedBufferSizeInBytes,
+                   gOffloadTransferIntervalInSec),
+      mFragmentSize(0),
+      mFragments(0),
+      mBytesWritten(0),
+      mStopGeneration(0),
       mIsOffloadThreadBlocked(false),
       mOffloadCookie(NULL),
       mNewMetadataPendingToSend(true),
@@ -89,7 +105,7 @@ CompressedStreamOut::CompressedStreamOut(Device *parent, audio_io_handle_t handl
                 << mMixVolumeCtl << ", mute = " << mMixMuteCtl << ", Ramp = " << mMixVolumeRampCtl;
 
     string cardName(Property<string>("audio.device.name", "0").getValue());
-    mSoundCardNo = AudioUtils::getCardIndexByName(cardName.c_str());
+    mSoundCardNo = SoundCardRegistry::getCardIndex(cardName);
 
     Log::Verbose() << __FUNCTION__ << ": creating callback";
     createOffloadCallbackThread();
@@ -124,6 +140,8 @@ status_t CompressedStreamOut::set(audio_config_t &config)
     mCodec.numChannels = config.channel_mask;
 
     setBufferSize();
+    // Nominal size is a first guess, refined on measured consumption
+    mBufferSizer.reset(mBufferSize);
     return android::OK;
 }
 
@@ -208,7 +226,7 @@ status_t CompressedStreamOut::openDeviceUnsafe()
 {
     struct compr_config config;
     struct snd_codec codec;
-    int device = AudioUtils::getCompressDeviceIndex();
+    int device = SoundCardRegistry::getCompressDeviceIndex();
     if (device < 0) {
         Log::Error() << __FUNCTION__ << ": Error getting device number ";
         return android::BAD_VALUE;
@@ -235,8 +253,11 @@ status_t CompressedStreamOut::openDeviceUnsafe()
                 << ",codec.rate_control=" << codec.rate_control << ", codec.profile="
                 << codec.profile << ",codec.level=" << codec.level << ",codec.ch_mode="
                 << codec.ch_mode << ",codec.format=" << codec.format;
-    config.fragment_size = mBufferSize;
-    config.fragments = 2;
+    mFragmentSize = mBufferSizer.getFragmentSize();
+    mFragments = mBufferSizer.getFragments();
+    Log::Verbose() << __FUNCTION__ << ": fragments " << mFragments << "x" << mFragmentSize;
+    config.fragment_size = mFragmentSize;
+    config.fragments = mFragments;
     config.codec = &codec;
 
     mCompress = compress_open(mSoundCardNo, device, COMPRESS_IN, &config);
@@ -247,17 +268,17 @@ status_t CompressedStreamOut::openDeviceUnsafe()
         return android::BAD_VALUE;
     }
     Log::Verbose() << __FUNCTION__ << ": Compress device opened sucessfully";
+    mBytesWritten = 0;
+    mBufferSizer.startMeasurement(getMonotonicTimeNs());
     Log::Verbose() << __FUNCTION__ << ": setting compress non block";
     compress_nonblock(mCompress, mIsNonBlocking);
 
-    struct mixer *mixer;
-    mixer = mixer_open(mSoundCardNo);
+    std::shared_ptr<struct mixer> mixer = SoundCardRegistry::getMixer(mSoundCardNo);
     if (!mixer) {
         Log::Error() << __FUNCTION__ << ": Failed to open mixer for card " << mSoundCardNo;
         return android::INVALID_OPERATION;
     }
-    unmute(mixer);
-    mixer_close(mixer);
+    unmute(mixer.get());
 
     mState = SstState::IDLE;
     return android::OK;
@@ -266,7 +287,10 @@ status_t CompressedStreamOut::openDeviceUnsafe()
 void CompressedStreamOut::stopCompressedOutputUnsafe()
 {
     mNewMetadataPendingToSend = true;
+    // Pending wait for buffer commands are obsolete
+    mStopGeneration++;
     if (mCompress != NULL) {
+        // Unblocks compress_wait if the offload thread is waiting for a buffer
         compress_stop(mCompress);
         while (mIsOffloadThreadBlocked) {
             mCond.wait(mCodecLock);
@@ -284,6 +308,7 @@ status_t CompressedStreamOut::standby()
         stopCompressedOutputUnsafe();
         mGaplessMdata.encoder_delay = 0;
         mGaplessMdata.encoder_padding = 0;
+        mBufferSizer.onTrackBoundary(getMonotonicTimeNs());
         closeDeviceUnsafe();
         StreamOut::setStandby(true);
     }
@@ -367,27 +392,24 @@ android::status_t CompressedStreamOut::setVolumeUnsafe(float left, float right)
     // If error happens during setting the volume, try to set while in out_write
     mIsVolumeChangeRequestPending = true;
 
-    struct mixer *mixer;
     struct mixer_ctl *vol_ctl;
     int volume[2];
     int prevVolume[2];
     struct mixer_ctl *volRamp_ctl;
 
-    mixer = mixer_open(mSoundCardNo);
+    std::shared_ptr<struct mixer> mixer = SoundCardRegistry::getMixer(mSoundCardNo);
     if (!mixer) {
         Log::Error() << __FUNCTION__ << ": Failed to open mixer for card " << mSoundCardNo;
         return android::INVALID_OPERATION;
     }
-    status_t ret = (left == 0 && right == 0) ? mute(mixer) : unmute(mixer);
+    status_t ret = (left == 0 && right == 0) ? mute(mixer.get()) : unmute(mixer.get());
     if (ret != android::OK) {
-        mixer_close(mixer);
         return ret;
     }
 
     StreamOut::setVolume(left, right);
 
     if (isMuted()) {
-        mixer_close(mixer);
         mIsVolumeChangeRequestPending = false;
         return android::OK;
     }
@@ -396,24 +418,21 @@ android::status_t CompressedStreamOut::setVolumeUnsafe(float left, float right)
     // Eg., 60 in decimal represents 6dB
     volume[0] = convertAmplToBel(left);
     volume[1] = convertAmplToBel(right);
-    vol_ctl = mixer_get_ctl_by_name(mixer, mMixVolumeCtl.c_str());
+    vol_ctl = mixer_get_ctl_by_name(mixer.get(), mMixVolumeCtl.c_str());
     if (!vol_ctl) {
         Log::Error() << __FUNCTION__ << ": Error opening mixerVolumecontrol " << mMixVolumeCtl;
-        mixer_close(mixer);
         return android::INVALID_OPERATION;
     }
     Log::Verbose() << __FUNCTION__ << ": volume computed: %x db" << volume[0];
     mixer_ctl_get_array(vol_ctl, prevVolume, 2);
     if (prevVolume[0] == volume[0] && prevVolume[1] == volume[1]) {
         Log::Verbose() << __FUNCTION__ << ": No update since volume requested";
-        mixer_close(mixer);
         mIsVolumeChangeRequestPending = false;
         return android::OK;
     }
-    volRamp_ctl = mixer_get_ctl_by_name(mixer, mMixVolumeRampCtl.c_str());
+    volRamp_ctl = mixer_get_ctl_by_name(mixer.get(), mMixVolumeRampCtl.c_str());
     if (!volRamp_ctl) {
         Log::Error() << __FUNCTION__ << ": Error opening mixerVolRamp ctl " << mMixVolumeRampCtl;
-        mixer_close(mixer);
         return android::INVALID_OPERATION;
     }
     unsigned int num_ctl_values =  mixer_ctl_get_num_values(volRamp_ctl);
@@ -428,26 +447,23 @@ android::status_t CompressedStreamOut::setVolumeUnsafe(float left, float right)
     int retval1 = mixer_ctl_set_array(vol_ctl, volume, 2);
     if (retval1 < 0) {
         Log::Error() << __FUNCTION__ << ": Err setting volume dB value %x" << volume[0];
-        mixer_close(mixer);
         return android::INVALID_OPERATION;
     }
     Log::Verbose() << __FUNCTION__ << ": Successful in set volume";
-    mixer_close(mixer);
     mIsVolumeChangeRequestPending = false;
     return android::OK;
 }
 
 android::status_t CompressedStreamOut::sendOffloadCmdUnsafe(offload_cmd::Command command)
 {
-    struct offload_cmd *cmd = new struct offload_cmd (command);
-    if (!cmd) {
-        Log::Verbose() << __FUNCTION__ << ": NO_MEMORY";
-        return android::NO_MEMORY;
-    }
     Log::Verbose() << __FUNCTION__ << ": [" << mState << "] cmd=" << command;
 
-    list_add_tail(&mOffloadCmdList, &cmd->node);
-    mOffloadCond.signal();
+    OffloadCommandQueue::Command cmd = { command, mStopGeneration };
+    // Exit shall never be dropped, else the destroying thread would wait forever for the join.
+    if (!mOffloadCmdQueue.push(cmd, command == offload_cmd::EXIT)) {
+        Log::Error() << __FUNCTION__ << ": [" << mState << "] command queue full, cmd=" << command;
+        return android::NO_MEMORY;
+    }
     return android::OK;
 }
 
@@ -481,13 +497,18 @@ android::status_t CompressedStreamOut::write(const void *buffer, size_t &bytes)
     int ret = compress_write(mCompress, buffer, bytes);
     if ((ret >= 0) && (ret < static_cast<int>(bytes))) {
         Log::Verbose() << __FUNCTION__ << ": [" << mState << "] sending wait for buffer cmd";
-        sendOffloadCmdUnsafe(offload_cmd::WAIT_FOR_BUFFER);
+        if (sendOffloadCmdUnsafe(offload_cmd::WAIT_FOR_BUFFER) != android::OK) {
+            // The client waits for a write ready callback that will never be sent
+            Log::Error() << __FUNCTION__ << ": [" << mState << "] partial write of " << ret
+                         << "/" << bytes << " bytes, write ready callback lost";
+        }
     }
     if (ret < 0) {
         Log::Error() << __FUNCTION__ << ": compress write error: " << compress_get_error(mCompress);
         return ret;
     }
     bytes = ret;
+    mBytesWritten += ret;
     Log::Verbose() << __FUNCTION__ << ": [" << mState << "] written " << ret << " bytes now";
     if (mState != SstState::PLAYING) {
         ret = compress_start(mCompress);
@@ -637,6 +658,7 @@ bool CompressedStreamOut::handleCommand(offload_cmd::Command cmd, stream_callbac
             mState = SstState::DRAINING;
             // Resend the metadata for next iteration.
             mNewMetadataPendingToSend = true;
+            mBufferSizer.onTrackBoundary(getMonotonicTimeNs());
         }
         return true;
 
@@ -647,6 +669,7 @@ bool CompressedStreamOut::handleCommand(offload_cmd::Command cmd, stream_callbac
         {
             Mutex::Locker locker(mCodecLock);
             mState = SstState::IDLE;
+            mBufferSizer.onTrackBoundary(getMonotonicTimeNs());
         }
         return true;
     }
@@ -657,7 +680,6 @@ bool CompressedStreamOut::handleCommand(offload_cmd::Command cmd, stream_callbac
 void *CompressedStreamOut::offloadThreadLoop(void *context)
 {
     CompressedStreamOut *out = static_cast<CompressedStreamOut *>(context);
-    struct listnode *item;
 
     setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_AUDIO);
     set_sched_policy(0, SP_FOREGROUND);
@@ -665,65 +687,98 @@ void *CompressedStreamOut::offloadThreadLoop(void *context)
 
     Log::Verbose() << __FUNCTION__;
 
-    Mutex::Locker locker(out->mCodecLock);
-
-    for (;;) {
-        offload_cmd *cmd = NULL;
-
-        if (list_empty(&out->mOffloadCmdList)) {
-            Log::Verbose() << __FUNCTION__ << ": [" << out->mState << "] Cmd list empty, SLEEPING";
-            out->mOffloadCond.wait(out->mCodecLock);
-            Log::Verbose() << __FUNCTION__ << ": [" << out->mState << "] RUNNING";
-            continue;
-        }
+    out->mOffloadCmdQueue.run(*out, offload_cmd::EXIT);
+    return NULL;
+}
 
-        item = list_head(&out->mOffloadCmdList);
-        cmd = node_to_item(item, offload_cmd, node);
-        list_remove(item);
+void CompressedStreamOut::onCommand(const OffloadCommandQueue::Command &cmd)
+{
+    mCodecLock.lock();
 
-        Log::Verbose() << __FUNCTION__ << ": [" << out->mState << "] CMD " << cmd->get();
+    if (mCompress == NULL) {
+        Log::Error() << __FUNCTION__ << ": [" << mState << "] Compress handle is NULL";
+        mCond.signal();
+        mCodecLock.unlock();
+        return;
+    }
+    if (cmd.code == offload_cmd::WAIT_FOR_BUFFER && cmd.generation != mStopGeneration) {
+        // Stream stopped or flushed since the command was sent: no buffer to wait for.
+        Log::Verbose() << __FUNCTION__ << ": [" << mState << "] dropping stale CMD " << cmd.code;
+        mCodecLock.unlock();
+        return;
+    }
+    mIsOffloadThreadBlocked = true;
 
-        if (cmd->get() == offload_cmd::EXIT) {
-            delete cmd;
-            Log::Verbose() << __FUNCTION__ << ": [" << out->mState << "] EXITING";
-            break;
-        }
+    mCodecLock.unlock();
 
-        if (out->mCompress == NULL) {
-            Log::Error() << __FUNCTION__ << ": [" << out->mState << "] Compress handle is NULL";
-            out->mCond.signal();
-            continue;
-        }
-        out->mIsOffloadThreadBlocked = true;
+    stream_callback_event_t event;
+    bool sendCallback = handleCommand(cmd.code, event);
 
-        out->mCodecLock.unlock();
+    mCodecLock.lock();
 
-        stream_callback_event_t event;
-        bool sendCallback = out->handleCommand(cmd->get(), event);
+    mIsOffloadThreadBlocked = false;
+    mCond.signal();
+    if (cmd.code == offload_cmd::WAIT_FOR_BUFFER) {
+        measureConsumptionUnsafe();
+    }
+    if (sendCallback) {
+        Log::Verbose() << __FUNCTION__ << ": sending callback event" << static_cast<int>(event);
+        mOffloadCallback(event, NULL, mOffloadCookie);
+    }
+    mCodecLock.unlock();
+}
 
-        out->mCodecLock.lock();
+void CompressedStreamOut::measureConsumptionUnsafe()
+{
+    if (mCompress == NULL || mState != SstState::PLAYING) {
+        return;
+    }
+    unsigned int avail;
+    struct timespec tstamp;
+    unsigned long renderedFrames;
+    unsigned int samplingRate;
+    if (compress_get_hpointer(mCompress, &avail, &tstamp) < 0 ||
+        compress_get_tstamp(mCompress, &renderedFrames, &samplingRate) < 0) {
+        Log::Verbose() << __FUNCTION__ << ": Failed Err=" << compress_get_error(mCompress);
+        return;
+    }
+    // Bytes not consumed yet are the ones still queued in the ring buffer
+    uint64_t bufferedBytes = static_cast<uint64_t>(mFragmentSize) * mFragments - avail;
+    uint64_t consumedBytes = mBytesWritten > bufferedBytes ? mBytesWritten - bufferedBytes : 0;
+    mBufferSizer.onFragmentConsumed(consumedBytes, renderedFrames, samplingRate);
+}
 
-        out->mIsOffloadThreadBlocked = false;
-        out->mCond.signal();
-        if (sendCallback) {
-            Log::Verbose() << __FUNCTION__ << ": sending callback event" << static_cast<int>(event);
-            out->mOffloadCallback(event, NULL, out->mOffloadCookie);
-        }
-        delete cmd;
-    }
+status_t CompressedStreamOut::dump(int fd) const
+{
+    Stream::dump(fd);
 
-    out->mCond.signal();
-    while (!list_empty(&out->mOffloadCmdList)) {
-        item = list_head(&out->mOffloadCmdList);
-        list_remove(item);
-        free(node_to_item(item, offload_cmd, node));
-    }
-    return NULL;
+    Mutex::Locker locker(mCodecLock);
+    const size_t SIZE = 256;
+    char buffer[SIZE];
+    android::String8 result;
+    int spaces = 4;
+    int64_t now = getMonotonicTimeNs();
+
+    snprintf(buffer, SIZE, "%*s Compress offload: state %d\n", spaces, "",
+             static_cast<int>(mState));
+    result.append(buffer);
+    snprintf(buffer, SIZE, "%*s- Fragments: %zu x %zu bytes (next opening: %zu x %zu bytes)\n",
+             spaces + 2, "", mFragments, mFragmentSize, mBufferSizer.getFragments(),
+             mBufferSizer.getFragmentSize());
+    result.append(buffer);
+    snprintf(buffer, SIZE, "%*s- Measured consumption: %u bytes/s\n", spaces + 2, "",
+             mBufferSizer.getMeasuredBytesPerSec());
+    result.append(buffer);
+    snprintf(buffer, SIZE, "%*s- Wakeups/min: %u (%u wakeups), previous track: %u\n",
+             spaces + 2, "", mBufferSizer.getWakeupsPerMinute(now), mBufferSizer.getWakeups(),
+             mBufferSizer.getPreviousWakeupsPerMinute());
+    result.append(buffer);
+    ::write(fd, result.string(), result.size());
+    return android::OK;
 }
 
 status_t CompressedStreamOut::createOffloadCallbackThread()
 {
-    list_init(&mOffloadCmdList);
     pthread_create(&mOffloadThread, (const pthread_attr_t *)NULL, offloadThreadLoop, this);
     return android::OK;
 }
@@ -734,7 +789,8 @@ status_t CompressedStreamOut::destroyOffloadCallbackThread()
 
     Log::Verbose() << __FUNCTION__;
     stopCompressedOutputUnsafe();
-    sendOffloadCmdUnsafe(offload_cmd::EXIT);
+    status_t status = sendOffloadCmdUnsafe(offload_cmd::EXIT);
+    AUDIOCOMMS_ASSERT(status == android::OK, "could not request offload thread exit");
 
     mCodecLock.unlock();
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2015 Intel Corporation
+ * Copyright (C) 2015-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -16,13 +16,14 @@
 #pragma once
 
 #include "StreamOut.hpp"
+#include "OffloadCommandQueue.hpp"
+#include "OffloadBufferSizer.hpp"
 
 #include <sound/compress_params.h>
 #include <tinycompress/tinycompress.h>
 
 #include <Mutex.hpp>
 #include <ConditionVariable.hpp>
-#include <cutils/list.h>
 
 static const uint32_t CODEC_OFFLOAD_LATENCY = 10;      /* Default latency in mSec  */
 
@@ -32,7 +33,7 @@ struct compr_gapless_mdata;
 namespace intel_audio
 {
 
-class CompressedStreamOut : public StreamOut
+class CompressedStreamOut : public StreamOut, private OffloadCommandQueue::Handler
 {
 private:
     struct SstState
@@ -67,14 +68,6 @@ private:
             WAIT_FOR_BUFFER     /* wait for buffer released by DSP */
         };
         typedef int Command;
-
-        offload_cmd(Command offloadCommand) : mCmd(offloadCommand) {}
-
-        Command get() const { return mCmd; }
-        struct listnode node;
-        // @todo: private member but beware since used in list.h with widespread usage
-        // of offsetof
-        Command mCmd;
     };
 
 public:
@@ -93,7 +86,7 @@ public:
 
     virtual android::status_t standby();
 
-    virtual android::status_t dump(int) const { return android::OK; }
+    virtual android::status_t dump(int fd) const;
 
     virtual android::status_t setParameters(const std::string &keyValuePairs);
 
@@ -175,7 +168,14 @@ private:
     void setBufferSize();
 
     /**
-     * Send a command to offload thread.
+     * Samples the consumption of the DSP upon a buffer released, for adaptive buffer sizing.
+     * Must be call with lock held.
+     */
+    void measureConsumptionUnsafe();
+
+    /**
+     * Send a command to offload thread, tagged with the current stop generation.
+     * Never blocks on the offload thread. Must be call with lock held.
      *
      * @param[in] command to send to offload thread
      *
@@ -185,7 +185,8 @@ private:
 
     /**
      * Stop the compress output stream, wait that all buffer has been consummed (drain or partial
-     * drain).
+     * drain). Wait for buffer commands still queued become stale and are dropped by the offload
+     * thread, so that only the command in progress, if any, is waited for.
      */
     void stopCompressedOutputUnsafe();
 
@@ -216,12 +217,19 @@ private:
     android::status_t createOffloadCallbackThread();
 
     /**
-     * Offload Thread Main loop: it waits commands from the list, and notify if required the caller.
+     * Offload Thread Main loop: it waits commands from the queue, and notify if required the
+     * caller. The codec lock is not held while waiting for commands.
      * @param[in] context
      * @return start_routing exit status
      */
     static void *offloadThreadLoop(void *context);
 
+    /**
+     * From OffloadCommandQueue::Handler, in offload thread context: drops the command if stale,
+     * handles it without codec lock held, then notifies the caller if required.
+     */
+    virtual void onCommand(const OffloadCommandQueue::Command &cmd);
+
     /**
      * @brief recover: when an unrecoverable error is detected, Compress Stream may recover itself.
      */
@@ -233,11 +241,15 @@ private:
     float mVolume;
     bool mIsVolumeChangeRequestPending;
     size_t mBufferSize;
+    OffloadBufferSizer mBufferSizer;
+    size_t mFragmentSize; /**< Fragment size of the opened device. */
+    size_t mFragments; /**< Fragment count of the opened device. */
+    uint64_t mBytesWritten; /**< Bytes written since the device has been opened. */
     mutable audio_comms::utilities::Mutex mCodecLock;
     bool mIsNonBlocking;
-    audio_comms::utilities::ConditionVariable mOffloadCond;
     pthread_t mOffloadThread;
-    struct listnode mOffloadCmdList;
+    OffloadCommandQueue mOffloadCmdQueue;
+    uint32_t mStopGeneration; /**< Incremented on each stop, protected by codec lock. */
     bool mIsOffloadThreadBlocked;
 
     stream_callback_t mOffloadCallback;
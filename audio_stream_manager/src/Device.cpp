@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -323,9 +323,9 @@ struct echo_reference_itfe *Device::getEchoReference(const SampleSpec &inputSamp
     return mEchoReference;
 }
 
-void Device::printPlatformFwErrorInfo()
+void Device::reportPlatformFwError()
 {
-    mStreamInterface->printPlatformFwErrorInfo();
+    mStreamInterface->reportPlatformFwError();
 }
 
 bool Device::hasStream(const audio_io_handle_t &streamHandle)
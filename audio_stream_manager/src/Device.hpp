@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -160,10 +160,10 @@ protected:
     friend class Stream;
 
     /**
-     * Print debug information from hw registers files.
-     * Dump on console platform hw debug files.
+     * Reports an error of the audio device.
+     * Platform hw debug files are dumped on console asynchronously, without blocking the caller.
      */
-    void printPlatformFwErrorInfo();
+    void reportPlatformFwError();
 
 private:
     /**
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "OffloadBufferSizer"
+
+#include "OffloadBufferSizer.hpp"
+#include <AudioCommsAssert.hpp>
+#include <utilities/Log.hpp>
+#include <algorithm>
+
+using audio_comms::utilities::Log;
+
+namespace intel_audio
+{
+
+/** Minimum rendered duration for a measurement to be trusted. */
+static const uint32_t gMinMeasuredDurationSec = 1;
+static const int64_t gNsecPerSec = 1000000000LL;
+static const int64_t gSecPerMinute = 60;
+
+const size_t OffloadBufferSizer::mMinFragments;
+const size_t OffloadBufferSizer::mMaxFragments;
+
+OffloadBufferSizer::OffloadBufferSizer(size_t minFragmentSize, size_t maxFragmentSize,
+                                       uint32_t wakeIntervalSec)
+    : mMinFragmentSize(minFragmentSize),
+      mMaxFragmentSize(maxFragmentSize),
+      mWakeIntervalSec(wakeIntervalSec),
+      mBaselineConsumedBytes(0),
+      mBaselineRenderedFrames(0),
+      mLastConsumedBytes(0),
+      mLastRenderedFrames(0),
+      mSampleRate(0),
+      mPreviousWakeupsPerMinute(0)
+{
+    AUDIOCOMMS_ASSERT(minFragmentSize != 0 && minFragmentSize <= maxFragmentSize,
+                      "Invalid fragment size range");
+    reset(minFragmentSize);
+    restartWindow(0);
+}
+
+size_t OffloadBufferSizer::roundDownToPowerOf2(size_t value)
+{
+    size_t power = 1;
+    while (value >>= 1) {
+        power <<= 1;
+    }
+    return power;
+}
+
+void OffloadBufferSizer::reset(size_t fragmentSize)
+{
+    mFragmentSize = roundDownToPowerOf2(
+        std::min(std::max(fragmentSize, mMinFragmentSize), mMaxFragmentSize));
+    mFragments = mMinFragments;
+    mMeasuredBytesPerSec = 0;
+    mHasBaseline = false;
+}
+
+void OffloadBufferSizer::restartWindow(int64_t nowNs)
+{
+    mHasBaseline = false;
+    mWindowStartNs = nowNs;
+    mWakeups = 0;
+}
+
+void OffloadBufferSizer::startMeasurement(int64_t nowNs)
+{
+    restartWindow(nowNs);
+}
+
+void OffloadBufferSizer::onFragmentConsumed(uint64_t consumedBytes, uint64_t renderedFrames,
+                                            uint32_t sampleRate)
+{
+    mWakeups++;
+    if (sampleRate == 0) {
+        return;
+    }
+    if (!mHasBaseline || sampleRate != mSampleRate ||
+        consumedBytes < mLastConsumedBytes || renderedFrames < mLastRenderedFrames) {
+        // First sample of the window, or counters restarted by the driver
+        mHasBaseline = true;
+        mBaselineConsumedBytes = consumedBytes;
+        mBaselineRenderedFrames = renderedFrames;
+        mSampleRate = sampleRate;
+    }
+    mLastConsumedBytes = consumedBytes;
+    mLastRenderedFrames = renderedFrames;
+}
+
+uint32_t OffloadBufferSizer::getWakeupsPerMinute(int64_t nowNs) const
+{
+    int64_t elapsedNs = nowNs - mWindowStartNs;
+    if (elapsedNs <= 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(mWakeups) * gSecPerMinute * gNsecPerSec / elapsedNs;
+}
+
+bool OffloadBufferSizer::onTrackBoundary(int64_t nowNs)
+{
+    uint64_t renderedFrames = mHasBaseline ? mLastRenderedFrames - mBaselineRenderedFrames : 0;
+    uint64_t consumedBytes = mHasBaseline ? mLastConsumedBytes - mBaselineConsumedBytes : 0;
+
+    if (nowNs > mWindowStartNs) {
+        mPreviousWakeupsPerMinute = getWakeupsPerMinute(nowNs);
+    }
+    bool trusted = mHasBaseline &&
+                   renderedFrames >= static_cast<uint64_t>(mSampleRate) * gMinMeasuredDurationSec;
+    restartWindow(nowNs);
+    if (!trusted) {
+        return false;
+    }
+    mMeasuredBytesPerSec = consumedBytes * mSampleRate / renderedFrames;
+
+    // One fragment shall last the wake interval, buffering shall cover two intervals: if the
+    // fragment size saturates, more fragments are used.
+    uint64_t targetBytes = static_cast<uint64_t>(mMeasuredBytesPerSec) * mWakeIntervalSec;
+    size_t fragmentSize = roundDownToPowerOf2(
+        std::min(std::max(targetBytes, static_cast<uint64_t>(mMinFragmentSize)),
+                 static_cast<uint64_t>(mMaxFragmentSize)));
+    size_t fragments = (mMinFragments * targetBytes + fragmentSize - 1) / fragmentSize;
+    fragments = std::min(std::max(fragments, mMinFragments), mMaxFragments);
+
+    if (fragmentSize == mFragmentSize && fragments == mFragments) {
+        return false;
+    }
+    Log::Debug() << __FUNCTION__ << ": measured " << mMeasuredBytesPerSec << " bytes/s, fragments "
+                 << mFragments << "x" << mFragmentSize << " -> " << fragments << "x"
+                 << fragmentSize;
+    mFragmentSize = fragmentSize;
+    mFragments = fragments;
+    return true;
+}
+
+} // namespace intel_audio
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace intel_audio
+{
+
+/**
+ * Computes the fragment geometry of a compress offload device from the consumption rate measured
+ * on the DSP, rather than from the nominal bitrate, which is inaccurate for VBR content.
+ *
+ * Each wakeup of the offload thread (i.e. a fragment released by the DSP) provides a sample of
+ * bytes consumed and frames rendered. At track boundaries, the measured bytes per second give the
+ * fragment size matching the targeted wake interval, to be used on next device opening.
+ */
+class OffloadBufferSizer
+{
+public:
+    /**
+     * @param[in] minFragmentSize lower bound of fragment size in bytes, power of 2.
+     * @param[in] maxFragmentSize upper bound of fragment size in bytes, power of 2.
+     * @param[in] wakeIntervalSec targeted duration of a fragment, in seconds.
+     */
+    OffloadBufferSizer(size_t minFragmentSize, size_t maxFragmentSize, uint32_t wakeIntervalSec);
+
+    /**
+     * Forgets about the measurements, restarting from a fragment size computed from nominal
+     * codec information.
+     *
+     * @param[in] fragmentSize initial fragment size in bytes.
+     */
+    void reset(size_t fragmentSize);
+
+    /**
+     * Restarts the measurement window, to be called when the device is (re)opened.
+     *
+     * @param[in] nowNs monotonic time in nanoseconds.
+     */
+    void startMeasurement(int64_t nowNs);
+
+    /**
+     * Records a wakeup of the offload thread upon a fragment consumed by the DSP.
+     *
+     * @param[in] consumedBytes number of bytes consumed by the DSP since device opening.
+     * @param[in] renderedFrames number of frames rendered by the DSP since device opening.
+     * @param[in] sampleRate rate of the rendered frames.
+     */
+    void onFragmentConsumed(uint64_t consumedBytes, uint64_t renderedFrames, uint32_t sampleRate);
+
+    /**
+     * Adapts the fragment geometry to the consumption rate measured on the track that ends,
+     * provided enough has been rendered to be trusted.
+     *
+     * @param[in] nowNs monotonic time in nanoseconds.
+     *
+     * @return true if the fragment geometry has changed, false otherwise.
+     */
+    bool onTrackBoundary(int64_t nowNs);
+
+    size_t getFragmentSize() const { return mFragmentSize; }
+
+    size_t getFragments() const { return mFragments; }
+
+    /** @return last measured consumption rate in bytes per second, 0 if none yet. */
+    uint32_t getMeasuredBytesPerSec() const { return mMeasuredBytesPerSec; }
+
+    /** @return wakeups since start of measurement window. */
+    uint32_t getWakeups() const { return mWakeups; }
+
+    /**
+     * @param[in] nowNs monotonic time in nanoseconds.
+     *
+     * @return number of wakeups per minute within current measurement window.
+     */
+    uint32_t getWakeupsPerMinute(int64_t nowNs) const;
+
+    /** @return number of wakeups per minute within previous measurement window. */
+    uint32_t getPreviousWakeupsPerMinute() const { return mPreviousWakeupsPerMinute; }
+
+    static size_t roundDownToPowerOf2(size_t value);
+
+    static const size_t mMinFragments = 2;
+    static const size_t mMaxFragments = 4;
+
+private:
+    void restartWindow(int64_t nowNs);
+
+    const size_t mMinFragmentSize;
+    const size_t mMaxFragmentSize;
+    const uint32_t mWakeIntervalSec;
+
+    size_t mFragmentSize;
+    size_t mFragments;
+    uint32_t mMeasuredBytesPerSec;
+
+    /** Measurement window: counters of the first sample of the window. */
+    bool mHasBaseline;
+    uint64_t mBaselineConsumedBytes;
+    uint64_t mBaselineRenderedFrames;
+    uint64_t mLastConsumedBytes;
+    uint64_t mLastRenderedFrames;
+    uint32_t mSampleRate;
+
+    int64_t mWindowStartNs;
+    uint32_t mWakeups;
+    uint32_t mPreviousWakeupsPerMinute;
+};
+
+} // namespace intel_audio
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "OffloadCommandQueue"
+
+#include "OffloadCommandQueue.hpp"
+#include <AudioCommsAssert.hpp>
+#include <utilities/Log.hpp>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+using audio_comms::utilities::Log;
+
+namespace intel_audio
+{
+
+static_assert((OffloadCommandQueue::mCapacity & (OffloadCommandQueue::mCapacity - 1)) == 0,
+              "Capacity of offload command queue shall be a power of 2");
+
+OffloadCommandQueue::OffloadCommandQueue()
+    : mEnqueuePosition(0),
+      mDequeuePosition(0),
+      mEventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+    for (size_t position = 0; position < mCapacity; position++) {
+        mSlots[position].sequence.store(position, std::memory_order_relaxed);
+    }
+    AUDIOCOMMS_ASSERT(mEventFd >= 0, "could not create eventfd: " << strerror(errno));
+}
+
+OffloadCommandQueue::~OffloadCommandQueue()
+{
+    close(mEventFd);
+}
+
+bool OffloadCommandQueue::push(const Command &command, bool isControl)
+{
+    size_t maxPending = isControl ? mCapacity : mCapacity - mReservedSlots;
+    size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &mSlots[position & (mCapacity - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        ssize_t difference = static_cast<ssize_t>(sequence) - static_cast<ssize_t>(position);
+        if (difference == 0) {
+            size_t dequeuePosition = mDequeuePosition.load(std::memory_order_acquire);
+            if (dequeuePosition <= position && position - dequeuePosition >= maxPending) {
+                // Claiming this position would leave fewer free slots than reserved
+                return false;
+            }
+            // Slot free for this position, claim it (position updated on failure)
+            if (mEnqueuePosition.compare_exchange_weak(position, position + 1,
+                                                       std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // Slot still holds the command pushed one lap before
+            return false;
+        } else {
+            // Another producer claimed this position
+            position = mEnqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    slot->command = command;
+    slot->sequence.store(position + 1, std::memory_order_release);
+
+    uint64_t increment = 1;
+    if (write(mEventFd, &increment, sizeof(increment)) != sizeof(increment)) {
+        Log::Error() << __FUNCTION__ << ": could not signal eventfd: " << strerror(errno);
+    }
+    return true;
+}
+
+bool OffloadCommandQueue::pop(Command &command)
+{
+    size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+    Slot &slot = mSlots[position & (mCapacity - 1)];
+    size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != position + 1) {
+        return false;
+    }
+    command = slot.command;
+    slot.sequence.store(position + mCapacity, std::memory_order_release);
+    mDequeuePosition.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+void OffloadCommandQueue::run(Handler &handler, int exitCode)
+{
+    for (;;) {
+        Command command;
+        if (!pop(command)) {
+            Log::Verbose() << __FUNCTION__ << ": Cmd queue empty, SLEEPING";
+            wait(-1);
+            Log::Verbose() << __FUNCTION__ << ": RUNNING";
+            continue;
+        }
+        Log::Verbose() << __FUNCTION__ << ": CMD " << command.code;
+        if (command.code == exitCode) {
+            Log::Verbose() << __FUNCTION__ << ": EXITING";
+            return;
+        }
+        handler.onCommand(command);
+    }
+}
+
+bool OffloadCommandQueue::wait(int timeoutMs)
+{
+    struct pollfd pollFd;
+    pollFd.fd = mEventFd;
+    pollFd.events = POLLIN;
+    pollFd.revents = 0;
+    int ret = poll(&pollFd, 1, timeoutMs);
+    if (ret <= 0 || !(pollFd.revents & POLLIN)) {
+        return false;
+    }
+    uint64_t counter;
+    if (read(mEventFd, &counter, sizeof(counter)) != sizeof(counter)) {
+        return false;
+    }
+    return true;
+}
+
+} // namespace intel_audio
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <AudioNonCopyable.hpp>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace intel_audio
+{
+
+/**
+ * Bounded queue of commands sent to an offload thread.
+ *
+ * Any thread may push commands (multiple producers), a single thread pops them. Slots are
+ * preallocated and claimed with atomic operations, so that neither pushing nor popping allocates
+ * or takes a lock. The consumer sleeps on an eventfd, signaled on each push, that may also be
+ * polled along with other file descriptors.
+ *
+ * The last slots are reserved to control commands, e.g. exit of the consumer, so that they are
+ * never dropped even if the consumer is stuck with the queue full of other commands.
+ */
+class OffloadCommandQueue : private audio_comms::utilities::NonCopyable
+{
+public:
+    struct Command
+    {
+        int code;
+        uint32_t generation; /**< Allows the consumer to discard commands issued before a reset. */
+    };
+
+    /** Consumer of the commands. */
+    class Handler
+    {
+    public:
+        /**
+         * Handles a command popped by run, from the consumer thread.
+         *
+         * @param[in] command popped, other than the exit command.
+         */
+        virtual void onCommand(const Command &command) = 0;
+
+    protected:
+        virtual ~Handler() {}
+    };
+
+    OffloadCommandQueue();
+    ~OffloadCommandQueue();
+
+    /**
+     * Pushes a command and wakes up the consumer. Never blocks. May be called from any thread.
+     *
+     * @param[in] command to push.
+     * @param[in] isControl true if the command may use the reserved slots. As long as fewer than
+     *                      mReservedSlots control commands are pending, they cannot be dropped.
+     *
+     * @return true if the command has been queued, false if the queue is full.
+     */
+    bool push(const Command &command, bool isControl = false);
+
+    /**
+     * Pops the oldest command. Never blocks. Shall only be called from the consumer thread.
+     *
+     * @param[out] command popped.
+     *
+     * @return true if a command has been popped, false if the queue is empty.
+     */
+    bool pop(Command &command);
+
+    /**
+     * Waits for a push. Returns immediately if a command has been pushed since last wait.
+     * Shall only be called from the consumer thread.
+     *
+     * @param[in] timeoutMs maximum time to wait, negative to wait forever.
+     *
+     * @return true if woken up by a push, false upon timeout or error.
+     */
+    bool wait(int timeoutMs);
+
+    /**
+     * Pops and handles the commands, sleeping while the queue is empty, until the exit command is
+     * popped. Commands queued after the exit command are left in the queue.
+     * Shall only be called from the consumer thread.
+     *
+     * @param[in] handler of the commands.
+     * @param[in] exitCode code of the exit command.
+     */
+    void run(Handler &handler, int exitCode);
+
+    /** @return file descriptor readable when commands have been pushed. */
+    int getFd() const { return mEventFd; }
+
+    static const size_t mCapacity = 32; /**< Power of 2, commands are few and short lived. */
+    static const size_t mReservedSlots = 2; /**< Slots only usable by control commands. */
+
+private:
+    struct Slot
+    {
+        /**
+         * Position the slot is ready for: equals the enqueue position when free, enqueue
+         * position + 1 when filled.
+         */
+        std::atomic<size_t> sequence;
+        Command command;
+    };
+
+    Slot mSlots[mCapacity];
+    std::atomic<size_t> mEnqueuePosition;
+    /** Only written by the consumer, read by producers to keep the reserved slots free. */
+    std::atomic<size_t> mDequeuePosition;
+    int mEventFd;
+};
+
+} // namespace intel_audio
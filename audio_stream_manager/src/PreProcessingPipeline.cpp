@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "PreProcessingPipeline"
+
+#include "PreProcessingPipeline.hpp"
+#include <utilities/Log.hpp>
+#include <algorithm>
+#include <string.h>
+
+using audio_comms::utilities::Log;
+using audio_comms::utilities::Mutex;
+
+namespace intel_audio
+{
+
+/**
+ * Periods of the rings on top of the latency: the worker may produce up to two periods out of a
+ * chunk, when the processor flushes frames kept buffered, plus the period being read.
+ */
+static const size_t gRingExtraPeriods = 3;
+
+/** Room left for the worker to process a chunk, in periods. */
+static const size_t gWorkOutputPeriods = 2;
+
+PreProcessingPipeline::PreProcessingPipeline()
+    : mProcessor(NULL),
+      mFrameSize(0),
+      mPeriodFrames(0),
+      mLatencyFrames(0),
+      mInputRingFrames(0),
+      mInputReadPosition(0),
+      mInputWritePosition(0),
+      mOutputRingFrames(0),
+      mOutputReadPosition(0),
+      mOutputWritePosition(0),
+      mCaptureTimePosition(0),
+      mWorkerBusy(false),
+      mLateCount(0),
+      mFramesLost(0),
+      mThreadRunning(false),
+      mExitRequested(false)
+{
+    mCaptureTime.time.tv_sec = 0;
+    mCaptureTime.time.tv_nsec = 0;
+    mCaptureTime.framesAfter = 0;
+}
+
+PreProcessingPipeline::~PreProcessingPipeline()
+{
+    stop();
+}
+
+android::status_t PreProcessingPipeline::start(Processor &processor, size_t frameSize,
+                                               size_t periodFrames, size_t latencyPeriods)
+{
+    Mutex::Locker locker(mLock);
+    if (mThreadRunning) {
+        return android::INVALID_OPERATION;
+    }
+    if (frameSize == 0 || periodFrames == 0 || latencyPeriods == 0) {
+        return android::BAD_VALUE;
+    }
+    mProcessor = &processor;
+    mFrameSize = frameSize;
+    mPeriodFrames = periodFrames;
+    mLatencyFrames = latencyPeriods * periodFrames;
+    mInputRingFrames = mLatencyFrames + gRingExtraPeriods * periodFrames;
+    mOutputRingFrames = mInputRingFrames;
+    mInputRing.resize(mInputRingFrames * frameSize);
+    mOutputRing.resize(mOutputRingFrames * frameSize);
+    mWorkInput.resize(periodFrames * frameSize);
+    mWorkOutput.resize(gWorkOutputPeriods * periodFrames * frameSize);
+    mInputReadPosition = mInputWritePosition = 0;
+    mCaptureTimePosition = 0;
+
+    // Silence primed is the latency: the reader pops it while the first period is processed
+    memset(mOutputRing.data(), 0, mLatencyFrames * frameSize);
+    mOutputReadPosition = 0;
+    mOutputWritePosition = mLatencyFrames;
+    mWorkerBusy = false;
+    mLateCount = 0;
+    mFramesLost = 0;
+
+    mExitRequested = false;
+    if (pthread_create(&mThread, NULL, workerThreadLoop, this) != 0) {
+        Log::Error() << __FUNCTION__ << ": failed to create preprocessing thread";
+        return android::NO_INIT;
+    }
+    mThreadRunning = true;
+    Log::Debug() << __FUNCTION__ << ": latency " << mLatencyFrames << " frames";
+    return android::OK;
+}
+
+void PreProcessingPipeline::stop()
+{
+    Mutex::Locker locker(mLock);
+    if (!mThreadRunning) {
+        return;
+    }
+    mExitRequested = true;
+    mWorkerCondition.signal();
+    mLock.unlock();
+    pthread_join(mThread, NULL);
+    mLock.lock();
+    mThreadRunning = false;
+    mInputReadPosition = mInputWritePosition;
+    mOutputReadPosition = mOutputWritePosition;
+    mReaderCondition.signal();
+}
+
+bool PreProcessingPipeline::isRunning() const
+{
+    Mutex::Locker locker(mLock);
+    return mThreadRunning;
+}
+
+void *PreProcessingPipeline::workerThreadLoop(void *context)
+{
+    static_cast<PreProcessingPipeline *>(context)->workerLoop();
+    return NULL;
+}
+
+void PreProcessingPipeline::workerLoop()
+{
+    Log::Debug() << __FUNCTION__ << ": started";
+    mLock.lock();
+    while (!mExitRequested) {
+        size_t pending = mInputWritePosition - mInputReadPosition;
+        size_t outputRoom = mOutputRingFrames - (mOutputWritePosition - mOutputReadPosition);
+        if (pending == 0 || outputRoom < gWorkOutputPeriods * mPeriodFrames) {
+            mWorkerCondition.wait(mLock);
+            continue;
+        }
+        size_t frames = std::min(pending, mPeriodFrames);
+        readRingUnsafe(mInputRing, mInputRingFrames, mInputReadPosition, mWorkInput.data(),
+                       frames);
+        mInputReadPosition += frames;
+        // Frames pushed after the chunk were captured after it as well
+        CaptureTime captureTime = mCaptureTime;
+        captureTime.framesAfter += mCaptureTimePosition - mInputReadPosition;
+        mWorkerBusy = true;
+        mReaderCondition.signal();
+
+        // Effects are processed without lock: the reader pushes and pops meanwhile.
+        mLock.unlock();
+        size_t workOutputFrames = gWorkOutputPeriods * mPeriodFrames;
+        size_t processedFrames = mProcessor->processCapturedFrames(mWorkInput.data(), frames,
+                                                                   captureTime,
+                                                                   mWorkOutput.data(),
+                                                                   workOutputFrames);
+        mLock.lock();
+        if (processedFrames > workOutputFrames) {
+            Log::Error() << __FUNCTION__ << ": processor output " << processedFrames
+                         << " frames, beyond room for " << workOutputFrames;
+            mFramesLost += processedFrames - workOutputFrames;
+            processedFrames = workOutputFrames;
+        }
+        writeRingUnsafe(mOutputRing, mOutputRingFrames, mOutputWritePosition, mWorkOutput.data(),
+                        processedFrames);
+        mOutputWritePosition += processedFrames;
+        mWorkerBusy = false;
+        mReaderCondition.signal();
+    }
+    mLock.unlock();
+    Log::Debug() << __FUNCTION__ << ": stopped";
+}
+
+void PreProcessingPipeline::push(const void *buffer, size_t frames,
+                                 const CaptureTime &captureTime)
+{
+    Mutex::Locker locker(mLock);
+    mCaptureTime = captureTime;
+    mCaptureTimePosition = mInputWritePosition + frames;
+    const char *src = static_cast<const char *>(buffer);
+    while (frames > 0 && mThreadRunning) {
+        size_t room = mInputRingFrames - (mInputWritePosition - mInputReadPosition);
+        if (room == 0) {
+            mReaderCondition.wait(mLock);
+            continue;
+        }
+        size_t toCopy = std::min(frames, room);
+        writeRingUnsafe(mInputRing, mInputRingFrames, mInputWritePosition, src, toCopy);
+        mInputWritePosition += toCopy;
+        src += toCopy * mFrameSize;
+        frames -= toCopy;
+        mWorkerCondition.signal();
+    }
+}
+
+size_t PreProcessingPipeline::pop(void *buffer, size_t frames)
+{
+    Mutex::Locker locker(mLock);
+    bool late = false;
+    while (mThreadRunning && (mOutputWritePosition - mOutputReadPosition) < frames &&
+           (mInputWritePosition != mInputReadPosition || mWorkerBusy)) {
+        late = true;
+        mReaderCondition.wait(mLock);
+    }
+    if (late) {
+        mLateCount++;
+    }
+    size_t available = std::min<size_t>(mOutputWritePosition - mOutputReadPosition, frames);
+    readRingUnsafe(mOutputRing, mOutputRingFrames, mOutputReadPosition, buffer, available);
+    mOutputReadPosition += available;
+    mWorkerCondition.signal();
+    return available;
+}
+
+void PreProcessingPipeline::writeRingUnsafe(std::vector<char> &ring, size_t ringFrames,
+                                            uint64_t position, const void *src,
+                                            size_t frames) const
+{
+    size_t offset = position % ringFrames;
+    size_t first = std::min(frames, ringFrames - offset);
+    memcpy(&ring[offset * mFrameSize], src, first * mFrameSize);
+    memcpy(ring.data(), static_cast<const char *>(src) + first * mFrameSize,
+           (frames - first) * mFrameSize);
+}
+
+void PreProcessingPipeline::readRingUnsafe(const std::vector<char> &ring, size_t ringFrames,
+                                           uint64_t position, void *dst, size_t frames) const
+{
+    size_t offset = position % ringFrames;
+    size_t first = std::min(frames, ringFrames - offset);
+    memcpy(dst, &ring[offset * mFrameSize], first * mFrameSize);
+    memcpy(static_cast<char *>(dst) + first * mFrameSize, ring.data(),
+           (frames - first) * mFrameSize);
+}
+
+size_t PreProcessingPipeline::getPeriodFrames() const
+{
+    Mutex::Locker locker(mLock);
+    return mPeriodFrames;
+}
+
+size_t PreProcessingPipeline::getPendingFrames() const
+{
+    Mutex::Locker locker(mLock);
+    return mInputWritePosition - mInputReadPosition;
+}
+
+size_t PreProcessingPipeline::getLatencyFrames() const
+{
+    Mutex::Locker locker(mLock);
+    return mThreadRunning ? mLatencyFrames : 0;
+}
+
+bool PreProcessingPipeline::getBufferedFrames(size_t &frames) const
+{
+    Mutex::Locker locker(mLock);
+    if (!mThreadRunning) {
+        return false;
+    }
+    // Next frame to pop was pushed the primed latency before, in the input positions
+    frames = mInputWritePosition + mLatencyFrames - mOutputReadPosition;
+    return true;
+}
+
+uint32_t PreProcessingPipeline::getLateCount() const
+{
+    Mutex::Locker locker(mLock);
+    return mLateCount;
+}
+
+size_t PreProcessingPipeline::consumeFramesLost()
+{
+    Mutex::Locker locker(mLock);
+    size_t framesLost = mFramesLost;
+    mFramesLost = 0;
+    return framesLost;
+}
+
+} // namespace intel_audio
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <AudioNonCopyable.hpp>
+#include <ConditionVariable.hpp>
+#include <Mutex.hpp>
+#include <utils/Errors.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+namespace intel_audio
+{
+
+/**
+ * Runs the preprocessing of a capture stream on a worker thread, one or more periods behind
+ * the capture.
+ *
+ * The reader pushes the frames captured into an input ring, then pops processed frames from an
+ * output ring. The output ring is primed with silence upon start: the worker processes a period
+ * while the reader waits for the next one from the device, and may fall behind by the primed
+ * periods upon an effect CPU spike without delaying the reader. The added latency is therefore
+ * constant, equal to the frames primed.
+ *
+ * The capture time of the frames is measured by the reader when pushing them, and handed to the
+ * worker with each chunk: the worker accesses neither the device nor the state of the reader.
+ */
+class PreProcessingPipeline : private audio_comms::utilities::NonCopyable
+{
+public:
+    /**
+     * Capture time of frames: at the given time, the given number of frames had been captured
+     * after the last of these frames.
+     */
+    struct CaptureTime
+    {
+        struct timespec time; /**< Monotonic time of the measure, 0 if not measured. */
+        size_t framesAfter; /**< Frames captured after the last frame, at that time. */
+    };
+
+    /** Preprocessing run by the worker. */
+    class Processor
+    {
+    public:
+        /**
+         * Processes captured frames. Called from the worker thread, without pipeline lock held.
+         *
+         * @param[in] src frames captured.
+         * @param[in] frames number of frames captured, up to the period.
+         * @param[in] captureTime capture time of the frames.
+         * @param[out] dst processed frames.
+         * @param[in] dstFrames room in dst, twice the period: the processor may flush frames
+         *                      kept buffered, up to a period.
+         *
+         * @return number of processed frames, up to dstFrames.
+         */
+        virtual size_t processCapturedFrames(const void *src, size_t frames,
+                                             const CaptureTime &captureTime, void *dst,
+                                             size_t dstFrames) = 0;
+
+    protected:
+        virtual ~Processor() {}
+    };
+
+    PreProcessingPipeline();
+    ~PreProcessingPipeline();
+
+    /**
+     * Primes the pipeline and starts the worker thread.
+     *
+     * @param[in] processor run on each chunk of captured frames, up to a period.
+     * @param[in] frameSize size of a frame in bytes.
+     * @param[in] periodFrames frames captured per read.
+     * @param[in] latencyPeriods periods of latency added, i.e. of silence primed.
+     *
+     * @return OK if started, error code otherwise.
+     */
+    android::status_t start(Processor &processor, size_t frameSize, size_t periodFrames,
+                            size_t latencyPeriods);
+
+    /** Stops the worker thread, dropping the frames within the pipeline. */
+    void stop();
+
+    bool isRunning() const;
+
+    /**
+     * Pushes captured frames, waiting for room if the worker is late by more than the latency.
+     *
+     * @param[in] buffer captured frames.
+     * @param[in] frames number of frames, up to the period.
+     * @param[in] captureTime capture time of the frames, measured once they were read.
+     */
+    void push(const void *buffer, size_t frames, const CaptureTime &captureTime);
+
+    /**
+     * Pops processed frames, waiting for the worker while it has frames to process.
+     *
+     * @param[out] buffer processed frames.
+     * @param[in] frames requested.
+     *
+     * @return number of frames popped, fewer than requested if the processor keeps frames
+     *         buffered.
+     */
+    size_t pop(void *buffer, size_t frames);
+
+    /** @return frames captured per read, as given upon start. */
+    size_t getPeriodFrames() const;
+
+    /** @return frames captured, not taken by the worker yet. */
+    size_t getPendingFrames() const;
+
+    /** @return latency added by the pipeline, in frames. */
+    size_t getLatencyFrames() const;
+
+    /**
+     * Consistent snapshot of the frames pushed and not popped yet, including the silence
+     * primed, whether pending, held by the processor or processed: these are the frames captured
+     * from the next frame to pop onwards.
+     *
+     * @param[out] frames within the pipeline, valid only if returning true.
+     *
+     * @return true if running, false otherwise.
+     */
+    bool getBufferedFrames(size_t &frames) const;
+
+    /** @return number of pops that waited for the worker since start, i.e. of worker lates. */
+    uint32_t getLateCount() const;
+
+    /**
+     * @return frames dropped since last call because the processor output more frames than
+     *         room given.
+     */
+    size_t consumeFramesLost();
+
+private:
+    static void *workerThreadLoop(void *context);
+
+    /** Processes the captured frames until the pipeline is stopped. */
+    void workerLoop();
+
+    /**
+     * Copies frames into a ring, wrapping around its end.
+     *
+     * @param[in,out] ring buffer.
+     * @param[in] ringFrames size of the ring in frames.
+     * @param[in] position in frames at which frames are copied.
+     * @param[in] src frames to copy.
+     * @param[in] frames number of frames.
+     */
+    void writeRingUnsafe(std::vector<char> &ring, size_t ringFrames, uint64_t position,
+                         const void *src, size_t frames) const;
+
+    /** Copies frames from a ring, wrapping around its end. */
+    void readRingUnsafe(const std::vector<char> &ring, size_t ringFrames, uint64_t position,
+                        void *dst, size_t frames) const;
+
+    Processor *mProcessor;
+    size_t mFrameSize;
+    size_t mPeriodFrames;
+    size_t mLatencyFrames;
+
+    std::vector<char> mInputRing; /**< Captured frames. */
+    size_t mInputRingFrames;
+    uint64_t mInputReadPosition;
+    uint64_t mInputWritePosition;
+
+    std::vector<char> mOutputRing; /**< Processed frames. */
+    size_t mOutputRingFrames;
+    uint64_t mOutputReadPosition;
+    uint64_t mOutputWritePosition;
+
+    CaptureTime mCaptureTime; /**< Capture time of the frames pushed last. */
+    uint64_t mCaptureTimePosition; /**< Input position following the frames pushed last. */
+
+    std::vector<char> mWorkInput; /**< Chunk being processed, copied out of the input ring. */
+    std::vector<char> mWorkOutput; /**< Chunk processed, before copy into the output ring. */
+
+    bool mWorkerBusy; /**< The worker is processing a chunk out of the input ring. */
+    uint32_t mLateCount;
+    size_t mFramesLost;
+
+    pthread_t mThread;
+    bool mThreadRunning;
+    bool mExitRequested;
+    audio_comms::utilities::ConditionVariable mWorkerCondition; /**< Frames or room for worker. */
+    audio_comms::utilities::ConditionVariable mReaderCondition; /**< Frames or room for reader. */
+    mutable audio_comms::utilities::Mutex mLock;
+};
+
+} // namespace intel_audio
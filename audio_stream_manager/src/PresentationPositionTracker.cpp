@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PresentationPositionTracker.hpp"
+#include <algorithm>
+
+using audio_comms::utilities::Mutex;
+
+namespace intel_audio
+{
+
+static const int64_t gNsecPerSec = 1000000000LL;
+
+PresentationPositionTracker::PresentationPositionTracker()
+    : mValid(false),
+      mRunning(false),
+      mWrittenFrames(0),
+      mQueuedFrames(0),
+      mTimestampNs(0),
+      mRate(0),
+      mLastPresentedFrames(0)
+{
+}
+
+void PresentationPositionTracker::update(uint64_t writtenFrames, size_t queuedFrames,
+                                         const struct timespec &timestamp, uint32_t rate)
+{
+    Mutex::Locker locker(mWriterLock);
+    Position position;
+    if (rate == 0 || queuedFrames > writtenFrames) {
+        // Unusual device report: readers fall back on querying the device
+        invalidateL();
+        return;
+    }
+    uint64_t presentedFrames = writtenFrames - queuedFrames;
+    position.valid = true;
+    // Until the device starts, e.g. while priming the ring buffer, the position must not move
+    position.running = mValid.load(std::memory_order_relaxed) &&
+                       presentedFrames > mLastPresentedFrames;
+    position.writtenFrames = writtenFrames;
+    position.queuedFrames = queuedFrames;
+    position.timestampNs = timestamp.tv_sec * gNsecPerSec + timestamp.tv_nsec;
+    position.rate = rate;
+    mLastPresentedFrames = presentedFrames;
+    writePositionL(position);
+}
+
+void PresentationPositionTracker::invalidate()
+{
+    Mutex::Locker locker(mWriterLock);
+    invalidateL();
+}
+
+void PresentationPositionTracker::invalidateL()
+{
+    Position position;
+    position.valid = false;
+    position.running = false;
+    position.writtenFrames = position.queuedFrames = 0;
+    position.timestampNs = 0;
+    position.rate = 0;
+    mLastPresentedFrames = 0;
+    writePositionL(position);
+}
+
+void PresentationPositionTracker::writePositionL(const Position &position)
+{
+    mSequenceLock.beginWrite();
+    mValid.store(position.valid, std::memory_order_relaxed);
+    mRunning.store(position.running, std::memory_order_relaxed);
+    mWrittenFrames.store(position.writtenFrames, std::memory_order_relaxed);
+    mQueuedFrames.store(position.queuedFrames, std::memory_order_relaxed);
+    mTimestampNs.store(position.timestampNs, std::memory_order_relaxed);
+    mRate.store(position.rate, std::memory_order_relaxed);
+    mSequenceLock.endWrite();
+}
+
+void PresentationPositionTracker::readPosition(Position &position) const
+{
+    uint32_t sequence;
+    do {
+        sequence = mSequenceLock.beginRead();
+        position.valid = mValid.load(std::memory_order_relaxed);
+        position.running = mRunning.load(std::memory_order_relaxed);
+        position.writtenFrames = mWrittenFrames.load(std::memory_order_relaxed);
+        position.queuedFrames = mQueuedFrames.load(std::memory_order_relaxed);
+        position.timestampNs = mTimestampNs.load(std::memory_order_relaxed);
+        position.rate = mRate.load(std::memory_order_relaxed);
+    } while (mSequenceLock.retryRead(sequence));
+}
+
+bool PresentationPositionTracker::getPresentationPosition(uint64_t &frames,
+                                                          struct timespec &timestamp) const
+{
+    Position position;
+    readPosition(position);
+    if (!position.valid) {
+        return false;
+    }
+    int64_t nowNs = getMonotonicTimeNs();
+    uint64_t playedFrames = 0;
+    if (position.running && nowNs > position.timestampNs) {
+        // Never beyond the frames queued: the device underruns rather than presenting more
+        playedFrames = std::min<uint64_t>(
+            (nowNs - position.timestampNs) * position.rate / gNsecPerSec, position.queuedFrames);
+    } else {
+        nowNs = position.timestampNs;
+    }
+    frames = position.writtenFrames - position.queuedFrames + playedFrames;
+    timestamp.tv_sec = nowNs / gNsecPerSec;
+    timestamp.tv_nsec = nowNs % gNsecPerSec;
+    return true;
+}
+
+bool PresentationPositionTracker::getNextWriteTimestamp(int64_t &timestampNs) const
+{
+    Position position;
+    readPosition(position);
+    if (!position.valid) {
+        return false;
+    }
+    timestampNs = position.timestampNs +
+                  static_cast<int64_t>(position.queuedFrames * gNsecPerSec / position.rate);
+    return true;
+}
+
+int64_t PresentationPositionTracker::getMonotonicTimeNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * gNsecPerSec + now.tv_nsec;
+}
+
+} // namespace intel_audio
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "SequenceLock.hpp"
+#include <AudioNonCopyable.hpp>
+#include <Mutex.hpp>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+namespace intel_audio
+{
+
+/**
+ * Tracks the presentation position of a playback stream while routed.
+ *
+ * The stream thread updates it once per write from the HW timestamp of the audio device. Position
+ * pollers read the latest update, interpolated with the monotonic clock since then, through a
+ * seqlock: they take neither the stream lock nor issue any syscall to the device.
+ */
+class PresentationPositionTracker : private audio_comms::utilities::NonCopyable
+{
+public:
+    PresentationPositionTracker();
+
+    /**
+     * Publishes the position of the stream after a write.
+     *
+     * @param[in] writtenFrames frames written since the stream started.
+     * @param[in] queuedFrames frames written not presented yet, i.e. queued in the ring buffer.
+     * @param[in] timestamp monotonic HW timestamp at which queuedFrames were queued.
+     * @param[in] rate of the frames, to interpolate the position.
+     */
+    void update(uint64_t writtenFrames, size_t queuedFrames, const struct timespec &timestamp,
+                uint32_t rate);
+
+    /** Invalidates the position, e.g. when the stream is unrouted or flushed. */
+    void invalidate();
+
+    /**
+     * @param[out] frames presented at the timestamp.
+     * @param[out] timestamp monotonic time of the position.
+     *
+     * @return true if the position is valid, false if no update since invalidated.
+     */
+    bool getPresentationPosition(uint64_t &frames, struct timespec &timestamp) const;
+
+    /**
+     * @param[out] timestampNs monotonic time at which the frames queued will have been presented.
+     *
+     * @return true if the position is valid, false if no update since invalidated.
+     */
+    bool getNextWriteTimestamp(int64_t &timestampNs) const;
+
+private:
+    /** Snapshot of an update. */
+    struct Position
+    {
+        bool valid;
+        bool running; /**< The device presented frames since the previous update. */
+        uint64_t writtenFrames;
+        uint64_t queuedFrames;
+        int64_t timestampNs;
+        uint32_t rate;
+    };
+
+    /** Reads a consistent snapshot, retrying while an update is in progress. */
+    void readPosition(Position &position) const;
+
+    /** Publishes an invalid position, under writer lock. */
+    void invalidateL();
+
+    /** Publishes a snapshot, under writer lock. */
+    void writePositionL(const Position &position);
+
+    static int64_t getMonotonicTimeNs();
+
+    SequenceLock mSequenceLock;
+
+    std::atomic<bool> mValid;
+    std::atomic<bool> mRunning;
+    std::atomic<uint64_t> mWrittenFrames;
+    std::atomic<uint64_t> mQueuedFrames;
+    std::atomic<int64_t> mTimestampNs;
+    std::atomic<uint32_t> mRate;
+
+    /** Presented frames at previous update, only accessed by writers. */
+    uint64_t mLastPresentedFrames;
+
+    /** Serializes the writers: write, flush and route detachment may happen in any thread. */
+    audio_comms::utilities::Mutex mWriterLock;
+};
+
+} // namespace intel_audio
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <AudioNonCopyable.hpp>
+#include <atomic>
+#include <stdint.h>
+
+namespace intel_audio
+{
+
+/**
+ * Sequence counter of a seqlock: a single writer publishes a set of values that readers copy
+ * without lock, retrying if the values were updated meanwhile.
+ *
+ * The values are atomics accessed with relaxed ordering, the counter providing the ordering:
+ *
+ *     writer:                          reader:
+ *         lock.beginWrite();               uint32_t sequence;
+ *         mValue.store(v, relaxed);        do {
+ *         lock.endWrite();                     sequence = lock.beginRead();
+ *                                              v = mValue.load(relaxed);
+ *                                          } while (lock.retryRead(sequence));
+ *
+ * Writers must be serialized by the caller.
+ */
+class SequenceLock : private audio_comms::utilities::NonCopyable
+{
+public:
+    SequenceLock() : mSequence(0) {}
+
+    void beginWrite()
+    {
+        mSequence.store(mSequence.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void endWrite()
+    {
+        mSequence.store(mSequence.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+    }
+
+    /** @return sequence to give to retryRead once the values are read. */
+    uint32_t beginRead() const { return mSequence.load(std::memory_order_acquire); }
+
+    /** @return true if the values read may be inconsistent, i.e. must be read again. */
+    bool retryRead(uint32_t sequence) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return (sequence & 1) != 0 || sequence != mSequence.load(std::memory_order_relaxed);
+    }
+
+private:
+    /** Odd while a write is in progress. */
+    std::atomic<uint32_t> mSequence;
+};
+
+} // namespace intel_audio
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -159,13 +159,11 @@ bool Stream::isRoutedByPolicy() const
 
 uint32_t Stream::getFlagMask() const
 {
-    AutoR lock(mStreamLock);
     return mFlagMask;
 }
 
 uint32_t Stream::getUseCaseMask() const
 {
-    AutoR lock(mStreamLock);
     return mUseCaseMask;
 }
 
@@ -237,10 +235,6 @@ uint32_t Stream::getLatencyMs() const
 
 void Stream::setUseCaseMask(uint32_t useCaseMask)
 {
-    if (getUseCaseMask() == useCaseMask) {
-        return;
-    }
-    AutoW lock(mStreamLock);
     mUseCaseMask = useCaseMask;
 }
 
@@ -269,7 +263,10 @@ status_t Stream::setStandby(bool isSet)
 status_t Stream::attachRouteL()
 {
     Log::Verbose() << __FUNCTION__ << ": " << (isOut() ? "output" : "input") << " stream";
-    IoStream::attachRouteL();
+    status_t err = IoStream::attachRouteL();
+    if (err != android::OK) {
+        return err;
+    }
 
     SampleSpec ssSrc;
     SampleSpec ssDst;
@@ -277,7 +274,7 @@ status_t Stream::attachRouteL()
     ssSrc = isOut() ? streamSampleSpec() : routeSampleSpec();
     ssDst = isOut() ? routeSampleSpec() : streamSampleSpec();
 
-    status_t err = configureAudioConversion(ssSrc, ssDst);
+    err = configureAudioConversion(ssSrc, ssDst);
     if (err != android::OK) {
         Log::Error() << __FUNCTION__
                      << ": could not initialize audio conversion chain (err=" << err << ")";
@@ -314,17 +311,16 @@ status_t Stream::applyAudioConversion(const void *src, void **dst, size_t inFram
 
 bool Stream::isStarted() const
 {
-    AutoR lock(mStreamLock);
     return !mStandby;
 }
 
 void Stream::setStarted(bool isStarted)
 {
-    AutoW lock(mStreamLock);
     mStandby = !isStarted;
 
     if (isStarted) {
-
+        // Dump objects are used by the read / write path under stream lock
+        AutoW lock(mStreamLock);
         initAudioDump();
     }
 }
@@ -398,6 +394,7 @@ android::status_t Stream::dump(int fd) const
              InputSourceConverter::maskToString(mUseCaseMask, ",").c_str());
     result.append(buffer);
     write(fd, result.string(), result.size());
+    mAudioConversion->dump(fd, spaces + 2);
     return IoStream::dump(fd, spaces + 2);
 }
 
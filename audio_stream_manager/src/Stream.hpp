@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -22,6 +22,7 @@
 #include <IoStream.hpp>
 #include <media/AudioBufferProvider.h>
 #include <hardware/audio.h>
+#include <atomic>
 #include <string>
 #include <utils/RWLock.h>
 
@@ -281,7 +282,11 @@ private:
     void initAudioDump();
 
 
-    bool mStandby; /**< state of the stream, true if standby, false if started. */
+    /**
+     * state of the stream, true if standby, false if started.
+     * Atomic as polled by the route manager without stream lock.
+     */
+    std::atomic<bool> mStandby;
 
     AudioConversion *mAudioConversion; /**< Audio Conversion utility class. */
 
@@ -296,7 +301,7 @@ private:
      *          Note that 0 will be taken as none.
      * The values must match audio.h file definitions.
      */
-    uint32_t mFlagMask;
+    std::atomic<uint32_t> mFlagMask;
 
     /**
      * Use case mask is either:
@@ -304,7 +309,7 @@ private:
      *  -for input streams: input source translated into a bit.
      *          Note that 0 will be taken as none.
      */
-    uint32_t mUseCaseMask;
+    std::atomic<uint32_t> mUseCaseMask;
 
     /**
      * Audio dump object used if one of the dump property before
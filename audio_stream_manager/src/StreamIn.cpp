@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -17,23 +17,32 @@
 
 #include "StreamIn.hpp"
 #include <AudioCommsAssert.hpp>
+#include <AudioUtils.hpp>
 #include <HalAudioDump.hpp>
 #include <KeyValuePairs.hpp>
 #include <BitField.hpp>
 #include <EffectHelper.hpp>
+#include <property/Property.hpp>
 #include <utilities/Log.hpp>
+#include <utils/String8.h>
 #include <algorithm>
 
 using namespace std;
 using audio_comms::utilities::BitField;
 using android::status_t;
 using audio_comms::utilities::Log;
+using audio_comms::utilities::Property;
 
 namespace intel_audio
 {
 
 const std::string StreamIn::mHwEffectImplementor = "IntelLPE";
 
+const char *const StreamIn::mPreProcPipelinePropName = "media.preproc.pipeline_periods";
+
+/** Upper bound of the latency of the preprocessing pipeline, in periods. */
+static const uint32_t gMaxPreProcPipelinePeriods = 4;
+
 StreamIn::StreamIn(Device *parent, audio_io_handle_t handle, uint32_t flagMask,
                    audio_source_t source, audio_devices_t devices, const std::string &address)
     : Stream(parent, handle, flagMask),
@@ -47,6 +56,9 @@ StreamIn::StreamIn(Device *parent, audio_io_handle_t handle, uint32_t flagMask,
       mReferenceBuffer(NULL),
       mReferenceBufferSizeInFrames(0),
       mPreprocessorsHandlerList(),
+      mPreProcPipelinePeriods(std::min(Property<uint32_t>(mPreProcPipelinePropName, 0).getValue(),
+                                       gMaxPreProcPipelinePeriods)),
+      mPipelineCaptureTime(NULL),
       mHwBuffer(NULL)
 {
     setDevices(devices & ~AUDIO_DEVICE_BIT_IN, address);
@@ -56,6 +68,8 @@ StreamIn::StreamIn(Device *parent, audio_io_handle_t handle, uint32_t flagMask,
 StreamIn::~StreamIn()
 {
     setStandby(true);
+    // The pipeline thread calls back the stream: it is stopped before destroying the stream
+    mPreProcPipeline.stop();
     freeAllocatedBuffers();
 }
 
@@ -109,6 +123,13 @@ status_t StreamIn::readHwFrames(void *buffer, size_t frames)
         return ret;
     }
 
+    // Frames lost upon overrun are reported to the client in stream frames.
+    uint64_t xrunFramesLost = consumeXrunFramesLost();
+    if (xrunFramesLost != 0) {
+        mFramesLost += AudioUtils::convertSrcToDstInFrames(xrunFramesLost, routeSampleSpec(),
+                                                           streamSampleSpec());
+    }
+
     // Dump audio input before eventual conversions
     // FOR DEBUG PURPOSE ONLY
     if (getDumpObjectBeforeConv() != NULL) {
@@ -229,7 +250,11 @@ status_t StreamIn::processFrames(void *buffer, ssize_t frames, ssize_t *processe
         AUDIOCOMMS_ASSERT(mProcessingFramesIn >= frames, "Not enough frames");
 
     }
+    return applyPreprocessors(buffer, frames, processedFrames);
+}
 
+status_t StreamIn::applyPreprocessors(void *buffer, ssize_t frames, ssize_t *processedFrames)
+{
     *processedFrames = 0;
     ssize_t processingFramesIn = mProcessingFramesIn;
     int processingReturn = 0;
@@ -269,6 +294,80 @@ status_t StreamIn::processFrames(void *buffer, ssize_t frames, ssize_t *processe
     return android::OK;
 }
 
+size_t StreamIn::processCapturedFrames(const void *src, size_t frames,
+                                       const PreProcessingPipeline::CaptureTime &captureTime,
+                                       void *dst, size_t dstFrames)
+{
+    AutoR lock(mPreProcEffectLock);
+    size_t bytes = streamSampleSpec().convertFramesToBytes(frames);
+    if (mProcessingFramesIn + frames > dstFrames) {
+        // Upon effect failure, all the frames to process are output: oldest ones dropped to fit
+        size_t dropped = mProcessingFramesIn + frames - dstFrames;
+        Log::Error() << __FUNCTION__ << ": dropping " << dropped << " frames kept by effects";
+        memmove(mProcessingBuffer,
+                (char *)mProcessingBuffer + streamSampleSpec().convertFramesToBytes(dropped),
+                streamSampleSpec().convertFramesToBytes(mProcessingFramesIn - dropped));
+        mProcessingFramesIn -= dropped;
+        mFramesLost += dropped;
+    }
+    ssize_t framesToProcess = mProcessingFramesIn + frames;
+    if (mPreprocessorsHandlerList.empty() ||
+        (mProcessingBufferSizeInFrames < framesToProcess &&
+         allocateProcessingMemory(framesToProcess) != android::OK)) {
+        // Frames are passed through, not to change the latency while the pipeline is running
+        memcpy(dst, src, bytes);
+        return frames;
+    }
+    memcpy((char *)mProcessingBuffer +
+           streamSampleSpec().convertFramesToBytes(mProcessingFramesIn), src, bytes);
+    mProcessingFramesIn = framesToProcess;
+
+    // Echo delay is computed from the capture time measured by the reader
+    mPipelineCaptureTime = &captureTime;
+    ssize_t processedFrames = 0;
+    applyPreprocessors(dst, frames, &processedFrames);
+    mPipelineCaptureTime = NULL;
+    return processedFrames;
+}
+
+status_t StreamIn::readPipelined(void *buffer, ssize_t frames, ssize_t *processedFrames)
+{
+    if (mPreProcPipeline.isRunning() && static_cast<size_t>(frames) >
+        mPreProcPipeline.getPeriodFrames()) {
+        Log::Debug() << __FUNCTION__ << ": read size increased, restarting pipeline";
+        mPreProcPipeline.stop();
+    }
+    size_t bytes = streamSampleSpec().convertFramesToBytes(frames);
+    if (!mPreProcPipeline.isRunning()) {
+        mCaptureBuffer.resize(bytes);
+        status_t status = mPreProcPipeline.start(*this, streamSampleSpec().getFrameSize(),
+                                                 frames, mPreProcPipelinePeriods);
+        if (status != android::OK) {
+            return status;
+        }
+    }
+    status_t status = readFrames(mCaptureBuffer.data(), frames, processedFrames);
+    if (status < 0) {
+        return status;
+    }
+    // Measured by the reader, which owns the device and the conversion buffer
+    PreProcessingPipeline::CaptureTime captureTime;
+    size_t kernelFrames;
+    if (getFramesAvailable(kernelFrames, captureTime.time) != android::OK) {
+        captureTime.time.tv_sec = 0;
+        captureTime.time.tv_nsec = 0;
+        kernelFrames = 0;
+    }
+    captureTime.framesAfter = AudioUtils::convertSrcToDstInFrames(kernelFrames,
+                                                                  routeSampleSpec(),
+                                                                  streamSampleSpec()) +
+                              mFramesIn;
+    mPreProcPipeline.push(mCaptureBuffer.data(), *processedFrames, captureTime);
+    *processedFrames = mPreProcPipeline.pop(buffer, frames);
+    mFramesLost += mPreProcPipeline.consumeFramesLost();
+    return android::OK;
+}
+
 status_t StreamIn::read(void *buffer, size_t &bytes)
 {
     setStandby(false);
@@ -293,14 +392,25 @@ status_t StreamIn::read(void *buffer, size_t &bytes)
     // Take the effect lock while processing
     mPreProcEffectLock.readLock();
 
-    if (!mPreprocessorsHandlerList.empty()) {
+    // Once started, the pipeline keeps running even without effect not to change the latency.
+    // The effect lock is released before waiting for the pipeline thread, which takes it.
+    bool pipelined = mPreProcPipelinePeriods != 0 &&
+                     (!mPreprocessorsHandlerList.empty() || mPreProcPipeline.isRunning());
+    if (pipelined) {
 
-        status = processFrames(buffer, frames, &received_frames);
+        mPreProcEffectLock.unlock();
+        status = readPipelined(buffer, frames, &received_frames);
     } else {
 
-        status = readFrames(buffer, frames, &received_frames);
+        if (!mPreprocessorsHandlerList.empty()) {
+
+            status = processFrames(buffer, frames, &received_frames);
+        } else {
+
+            status = readFrames(buffer, frames, &received_frames);
+        }
+        mPreProcEffectLock.unlock();
     }
-    mPreProcEffectLock.unlock();
 
     if (status < 0) {
         Log::Error() << __FUNCTION__ << ": (buffer=" << buffer << ", bytes=" << bytes
@@ -312,32 +422,48 @@ status_t StreamIn::read(void *buffer, size_t &bytes)
     }
     bytes = streamSampleSpec().convertFramesToBytes(received_frames);
     mFramesInCount += received_frames;
+    updateCapturePositionL();
 
     mStreamLock.unlock();
     return android::OK;
 }
 
-void StreamIn::resetFramesLost()
-{
-    // setVoiceVolume and mixing during voice call cannot happen together
-    // need a lock; but deadlock may appear during simultaneous R or W
-    // so remove lock and the reset of mFramesLost which is never updated btw
-}
-
 unsigned int StreamIn::getInputFramesLost() const
 {
-    unsigned int count = mFramesLost;   // set to 0 during construction
-
-    StreamIn *mutable_this = const_cast<StreamIn *>(this);
     // Requirement from AudioHardwareInterface.h:
     // Audio driver is expected to reset the value to 0 and restart counting upon
     // returning the current value by this function call.
-    mutable_this->resetFramesLost();
-    return count;
+    // Atomic exchange rather than stream lock, which may deadlock with simultaneous R or W.
+    return mFramesLost.exchange(0);
+}
+
+void StreamIn::updateCapturePositionL()
+{
+    size_t kernelFrames;
+    struct timespec tstamp;
+    if (getFramesAvailable(kernelFrames, tstamp) != android::OK) {
+        mCapturePositionTracker.invalidate();
+        return;
+    }
+    // Leftovers of the preprocessing are owned by the worker while the pipeline runs: the
+    // pipeline reports a snapshot of all the frames it holds instead.
+    size_t preProcFrames;
+    if (!mPreProcPipeline.getBufferedFrames(preProcFrames)) {
+        preProcFrames = mProcessingFramesIn;
+    }
+    mCapturePositionTracker.update(mFramesInCount, kernelFrames,
+                                   routeSampleSpec().getSampleRate(),
+                                   mFramesIn + preProcFrames,
+                                   streamSampleSpec().getSampleRate(), tstamp);
 }
 
 status_t StreamIn::getCapturePosition(int64_t &frames, int64_t &time)
 {
+    if (mCapturePositionTracker.getCapturePosition(frames, time)) {
+        return android::OK;
+    }
+
+    // Nothing read since the route was attached: estimated from the time of the call
     struct timespec tstamp={0,0};
     if (clock_gettime(CLOCK_MONOTONIC, &tstamp) != 0)
     {
@@ -346,14 +472,44 @@ status_t StreamIn::getCapturePosition(int64_t &frames, int64_t &time)
     }
     mStreamLock.readLock();
     frames = (int64_t)mFramesInCount;
+    // Frames read were captured the latency of the preprocessing pipeline before
+    uint64_t pipelineLatencyNs =
+        streamSampleSpec().convertFramesToUsec(mPreProcPipeline.getLatencyFrames()) * 1000ull;
     mStreamLock.unlock();
     uint64_t now;
     now = ((tstamp.tv_sec) * 1000000000ull) +
           (tstamp.tv_nsec);
-    time = (int64_t)now;
+    time = (int64_t)(now - pipelineLatencyNs);
     return android::OK;
 }
 
+status_t StreamIn::dump(int fd) const
+{
+    status_t status = Stream::dump(fd);
+    const size_t SIZE = 256;
+    char buffer[SIZE];
+    android::String8 result;
+    int spaces = 4;
+
+    size_t latencyFrames = mPreProcPipeline.getLatencyFrames();
+    if (latencyFrames == 0) {
+        snprintf(buffer, SIZE, "%*s- Preprocessing pipeline: %s\n", spaces, "",
+                 mPreProcPipelinePeriods == 0 ? "disabled" : "stopped");
+        result.append(buffer);
+    } else {
+        AutoR lock(mStreamLock);
+        snprintf(buffer, SIZE, "%*s- Preprocessing pipeline: latency %zu frames (%zu us)\n",
+                 spaces, "", latencyFrames,
+                 streamSampleSpec().convertFramesToUsec(latencyFrames));
+        result.append(buffer);
+        snprintf(buffer, SIZE, "%*s- Preprocessing pipeline late reads: %u\n", spaces, "",
+                 mPreProcPipeline.getLateCount());
+        result.append(buffer);
+    }
+    write(fd, result.string(), result.size());
+    return status;
+}
+
 
 status_t StreamIn::allocateHwBuffer()
 {
@@ -387,6 +543,9 @@ status_t StreamIn::attachRouteL()
 
 status_t StreamIn::detachRouteL()
 {
+    // The frames within the pipeline were captured on the route being detached
+    mPreProcPipeline.stop();
+    mCapturePositionTracker.invalidate();
     freeAllocatedBuffers();
     return Stream::detachRouteL();
 }
@@ -629,6 +788,17 @@ void StreamIn::getCaptureDelay(struct echo_reference_buffer *buffer)
     long kernel_delay;
     long delay_ns;
 
+    if (mPipelineCaptureTime != NULL) {
+
+        // Preprocessing pipeline thread: the reader measured the capture time of the chunk
+        bool isMeasured = mPipelineCaptureTime->time.tv_sec != 0 ||
+                          mPipelineCaptureTime->time.tv_nsec != 0;
+        buffer->time_stamp = mPipelineCaptureTime->time;
+        buffer->delay_ns = isMeasured ?
+                           streamSampleSpec().convertFramesToUsec(
+                               mPipelineCaptureTime->framesAfter + mProcessingFramesIn) : 0;
+        return;
+    }
     if (getFramesAvailable(kernel_frames, tstamp) != android::OK) {
 
         buffer->time_stamp.tv_sec = 0;
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -15,9 +15,12 @@
  */
 #pragma once
 
+#include "CapturePositionTracker.hpp"
 #include "Device.hpp"
+#include "PreProcessingPipeline.hpp"
 #include "Stream.hpp"
 #include <media/AudioBufferProvider.h>
+#include <atomic>
 #include <vector>
 #include <list>
 
@@ -25,7 +28,8 @@ namespace intel_audio
 {
 
 class StreamIn : public StreamInInterface, public Stream,
-                 public android::AudioBufferProvider
+                 public android::AudioBufferProvider,
+                 private PreProcessingPipeline::Processor
 {
 private:
     typedef std::list<effect_handle_t>::iterator AudioEffectsListIterator;
@@ -46,6 +50,7 @@ public:
     virtual uint32_t getInputFramesLost() const;
     virtual android::status_t getCapturePosition(int64_t &frames, int64_t &time);
     virtual android::status_t setDevice(audio_devices_t device);
+    virtual android::status_t dump(int fd) const;
 
     // From AudioBufferProvider
     virtual android::status_t getNextBuffer(android::AudioBufferProvider::Buffer *buffer);
@@ -96,6 +101,22 @@ protected:
 private:
     android::status_t readHwFrames(void *buffer, size_t frames);
 
+    /**
+     * Runs the preprocessing effects on frames captured, from the preprocessing pipeline thread.
+     * From PreProcessingPipeline::Processor.
+     *
+     * @param[in] src frames captured.
+     * @param[in] frames number of frames captured.
+     * @param[in] captureTime capture time of the frames, measured by the reader.
+     * @param[out] dst processed frames.
+     * @param[in] dstFrames room in dst.
+     *
+     * @return number of processed frames.
+     */
+    virtual size_t processCapturedFrames(const void *src, size_t frames,
+                                         const PreProcessingPipeline::CaptureTime &captureTime,
+                                         void *dst, size_t dstFrames);
+
     /**
      * Performs the removal of an effect.
      * It removes the effect from the stream list of requested effects
@@ -186,12 +207,6 @@ private:
         }
     };
 
-    /**
-     * Reset the amount of input frames lost in the audio driver since the last call of
-     * getInputFramesLost.
-     */
-    void resetFramesLost();
-
     /**
      * Read audio frames into the buffer.
      *
@@ -235,6 +250,30 @@ private:
      */
     android::status_t processFrames(void *buffer, ssize_t frames, ssize_t *processedFrames);
 
+    /**
+     * Applies the preprocessing effects on the frames of the processing buffer, keeping the
+     * frames not consumed by the effects for the next call.
+     *
+     * @param[out] buffer memory in which it will copy the processed frames.
+     * @param[in] frames requested frames to process.
+     * @param[out] processedFrames number of frames processed.
+     *
+     * @return OK.
+     */
+    android::status_t applyPreprocessors(void *buffer, ssize_t frames, ssize_t *processedFrames);
+
+    /**
+     * Captures audio frames and hands them over to the preprocessing pipeline, then retrieves
+     * the frames it processed, i.e. captured the pipeline latency before.
+     *
+     * @param[out] buffer memory in which it will copy the processed frames.
+     * @param[in] frames requested frames to read.
+     * @param[out] processedFrames number of frames processed if successful.
+     *
+     * @return 0 if success, negative error code otherwise.
+     */
+    android::status_t readPipelined(void *buffer, ssize_t frames, ssize_t *processedFrames);
+
     /**
      * Process audio frames into the buffer.
      *
@@ -301,14 +340,25 @@ private:
     void getCaptureDelay(struct echo_reference_buffer *buffer);
 
     /**
-     * amount of input frames lost in the audio driver (i.e. not provided on time to client).
+     * Publishes the capture position after a read, from the HW timestamp of the device, corrected
+     * by the frames captured but not read yet by the client, i.e. still in the kernel buffer,
+     * in the conversion and preprocessing buffers or in the preprocessing pipeline.
+     * Called with stream lock held.
      */
-    unsigned int mFramesLost;
+    void updateCapturePositionL();
+
+    /**
+     * amount of input frames lost in the audio driver (i.e. not provided on time to client) since
+     * the last call of getInputFramesLost, accumulated from the overruns of the audio device.
+     */
+    mutable std::atomic<uint32_t> mFramesLost;
 
     ssize_t mFramesIn; /**< frames available in stream input buffer. */
 
     ssize_t mFramesInCount; /**< Total frames read. */
 
+    CapturePositionTracker mCapturePositionTracker; /**< Polled without stream lock. */
+
     /**
      * This variable represents the number of frames of in mProcessingBuffer.
      */
@@ -346,9 +396,28 @@ private:
      */
     std::vector<AudioEffectHandle> mPreprocessorsHandlerList;
 
+    /**
+     * Pipeline running the preprocessing effects on a worker thread, if enabled by property.
+     * Started upon first read with effects, stopped upon route detachment.
+     */
+    PreProcessingPipeline mPreProcPipeline;
+
+    /** Periods of latency of the preprocessing pipeline, 0 to process on the reader thread. */
+    uint32_t mPreProcPipelinePeriods;
+
+    std::vector<char> mCaptureBuffer; /**< Frames captured, before the pipeline. */
+
+    /**
+     * Capture time of the chunk processed by the preprocessing pipeline thread, NULL when
+     * processing on the reader thread.
+     */
+    const PreProcessingPipeline::CaptureTime *mPipelineCaptureTime;
+
     char *mHwBuffer; /**< buffer in which samples are read from audio device. */
     ssize_t mHwBufferSize; /**< Size of the buffer in which samples are read from audio device. */
 
     static const std::string mHwEffectImplementor; /**< Implementor name for HW effects. */
+
+    static const char *const mPreProcPipelinePropName; /**< Pipeline latency property name. */
 };
 } // namespace intel_audio
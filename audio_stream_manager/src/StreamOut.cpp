@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -20,6 +20,7 @@
 #include <AudioCommsAssert.hpp>
 #include <HalAudioDump.hpp>
 #include <utilities/Log.hpp>
+#include <algorithm>
 
 using namespace std;
 using android::status_t;
@@ -100,6 +101,7 @@ status_t StreamOut::write(const void *buffer, size_t &bytes)
         Log::Warning() << __FUNCTION__ << ": Trashing " << bytes << " bytes for stream " << this
                        << (isMuted() ? ": Stream muted" : ": No route available");
         mStreamLock.unlock();
+        mPositionTracker.invalidate();
         status = generateSilence(bytes);
         mFrameCount += srcFrames;
         return status;
@@ -141,9 +143,8 @@ status_t StreamOut::write(const void *buffer, size_t &bytes)
                      << ") frames";
 
         if (error.find(strerror(EIO)) != std::string::npos) {
-            // Dump hw registers debug file info in console
-            mParent->printPlatformFwErrorInfo();
-
+            // Hw registers debug file info is dumped in console asynchronously
+            mParent->reportPlatformFwError();
         }
         AUDIOCOMMS_ASSERT(error.find(strerror(EBADF)) == std::string::npos,
                           "Audio Device handle closed not by Audio HAL."
@@ -172,10 +173,26 @@ status_t StreamOut::write(const void *buffer, size_t &bytes)
         mFrameCount = 0;
     }
     mFrameCount += srcFrames;
+    updatePresentationPositionL();
     mStreamLock.unlock();
     return status;
 }
 
+void StreamOut::updatePresentationPositionL()
+{
+    size_t avail;
+    struct timespec timestamp;
+    if (getFramesAvailable(avail, timestamp) != android::OK) {
+        mPositionTracker.invalidate();
+        return;
+    }
+    size_t kernelBufferSize = getBufferSizeInFrames();
+    // Underrun in progress: all the frames written have been presented
+    size_t queuedFrames = kernelBufferSize - std::min(avail, kernelBufferSize);
+    mPositionTracker.update(mFrameCount, queuedFrames, timestamp,
+                            streamSampleSpec().getSampleRate());
+}
+
 uint32_t StreamOut::getLatency()
 {
     return getLatencyMs();
@@ -212,6 +229,7 @@ status_t StreamOut::attachRouteL()
 
 status_t StreamOut::detachRouteL()
 {
+    mPositionTracker.invalidate();
     removeEchoReference(mEchoReference);
     return Stream::detachRouteL();
 }
@@ -223,6 +241,14 @@ status_t StreamOut::getRenderPosition(uint32_t &dspFrames) const
 }
 
 status_t StreamOut::getPresentationPosition(uint64_t &frames, struct timespec &timestamp) const
+{
+    if (mPositionTracker.getPresentationPosition(frames, timestamp)) {
+        return android::OK;
+    }
+    return queryPresentationPosition(frames, timestamp);
+}
+
+status_t StreamOut::queryPresentationPosition(uint64_t &frames, struct timespec &timestamp) const
 {
     /** Take the stream lock in read mode to avoid the route manager unrouting this stream,
      * and closing the audio device while dealing with it.
@@ -238,6 +264,11 @@ status_t StreamOut::getPresentationPosition(uint64_t &frames, struct timespec &t
         return error;
     }
     size_t kernelBufferSize = getBufferSizeInFrames();
+    if (avail > kernelBufferSize) {
+        // Underrun in progress (accounted by the audio device): all the frames written have been
+        // presented, the frames beyond the ring buffer are lost, i.e. silence was played.
+        avail = kernelBufferSize;
+    }
     // FIXME This calculation is incorrect if there is buffering after app processor
     int64_t signedFrames = mFrameCount - kernelBufferSize + avail;
     if (signedFrames < 0) {
@@ -253,6 +284,14 @@ status_t StreamOut::getPresentationPosition(uint64_t &frames, struct timespec &t
 }
 
 status_t StreamOut::getNextWriteTimestamp(int64_t &ts) const
+{
+    if (mPositionTracker.getNextWriteTimestamp(ts)) {
+        return android::OK;
+    }
+    return queryNextWriteTimestamp(ts);
+}
+
+status_t StreamOut::queryNextWriteTimestamp(int64_t &ts) const
 {
     AutoR lock(mStreamLock);
 
@@ -297,7 +336,7 @@ status_t StreamOut::flush()
 
         return android::OK;
     }
-
+    mPositionTracker.invalidate();
     return pcmStop();
 }
 
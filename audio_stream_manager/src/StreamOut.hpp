@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -17,6 +17,7 @@
 
 #include "Stream.hpp"
 #include "Device.hpp"
+#include "PresentationPositionTracker.hpp"
 
 struct echo_reference_itfe;
 
@@ -136,8 +137,27 @@ private:
      */
     int getPlaybackDelay(ssize_t frames, struct echo_reference_buffer *buffer);
 
+    /**
+     * Publishes the presentation position after a write, from the HW timestamp of the device.
+     * Called with stream lock held.
+     */
+    void updatePresentationPositionL();
+
+    /**
+     * Gets the presentation position from the audio device, under stream lock.
+     * Used until the position is tracked, i.e. until the first write while routed.
+     */
+    android::status_t queryPresentationPosition(uint64_t &frames,
+                                                struct timespec &timestamp) const;
+
+    /** Gets the next write timestamp from the audio device, under stream lock. */
+    android::status_t queryNextWriteTimestamp(int64_t &ts) const;
+
     uint64_t mFrameCount; /**< number of audio frames written by AudioFlinger. */
 
+    /** Position published at each write, polled without stream lock. */
+    PresentationPositionTracker mPositionTracker;
+
     struct echo_reference_itfe *mEchoReference; /**< echo reference pointer, for SW AEC effect. */
 
     static const uint32_t mMaxAgainRetry; /**< Max retry for write operations before recovering. */
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CapturePositionTracker.hpp>
+#include <gtest/gtest.h>
+
+namespace intel_audio
+{
+
+static const uint32_t gKernelRate = 48000;
+static const uint32_t gStreamRate = 16000;
+static const int64_t gMsecInNs = 1000000LL;
+
+static const struct timespec gTimestamp = { 10, 0 };
+static const int64_t gTimestampNs = 10000 * gMsecInNs;
+
+TEST(CapturePositionTracker, invalidUntilUpdated)
+{
+    CapturePositionTracker tracker;
+    int64_t frames;
+    int64_t timeNs;
+    EXPECT_FALSE(tracker.getCapturePosition(frames, timeNs));
+
+    tracker.update(160, 0, gKernelRate, 0, gStreamRate, gTimestamp);
+    ASSERT_TRUE(tracker.getCapturePosition(frames, timeNs));
+    EXPECT_EQ(160, frames);
+    EXPECT_EQ(gTimestampNs, timeNs);
+
+    tracker.invalidate();
+    EXPECT_FALSE(tracker.getCapturePosition(frames, timeNs));
+
+    // Unknown rate: left to the estimation from the time of the call
+    tracker.update(160, 0, 0, 0, gStreamRate, gTimestamp);
+    EXPECT_FALSE(tracker.getCapturePosition(frames, timeNs));
+}
+
+TEST(CapturePositionTracker, delayOfFramesNotRead)
+{
+    CapturePositionTracker tracker;
+    int64_t frames;
+    int64_t timeNs;
+
+    // 10 ms in the kernel buffer, at the rate of the device
+    tracker.update(320, 480, gKernelRate, 0, gStreamRate, gTimestamp);
+    ASSERT_TRUE(tracker.getCapturePosition(frames, timeNs));
+    EXPECT_EQ(320, frames);
+    EXPECT_EQ(gTimestampNs - 10 * gMsecInNs, timeNs);
+
+    // Plus 5 ms of conversion leftovers and 20 ms within the preprocessing pipeline, i.e. its
+    // primed latency, at the rate of the stream
+    tracker.update(480, 480, gKernelRate, 80 + 320, gStreamRate, gTimestamp);
+    ASSERT_TRUE(tracker.getCapturePosition(frames, timeNs));
+    EXPECT_EQ(480, frames);
+    EXPECT_EQ(gTimestampNs - 35 * gMsecInNs, timeNs);
+
+    // Sub-millisecond precision kept: 1 frame at 48 kHz
+    tracker.update(480, 1, gKernelRate, 0, gStreamRate, gTimestamp);
+    ASSERT_TRUE(tracker.getCapturePosition(frames, timeNs));
+    EXPECT_EQ(gTimestampNs - 20833, timeNs);
+}
+
+} // namespace intel_audio
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2014-2015 Intel Corporation
+ * Copyright (C) 2014-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -22,6 +22,8 @@
 
 #include <iostream>
 #include <algorithm>
+#include <vector>
+#include <time.h>
 
 using namespace android;
 using namespace std;
@@ -557,3 +559,58 @@ INSTANTIATE_TEST_CASE_P(
         std::make_pair("screen_state", "neither_on_nor_off")
         )
     );
+
+// Measures the start latency, i.e. the duration of the first write after a standby: with a
+// standby delay set on the route, the device is still opened and the write shall not wait for
+// the whole routing. The latency depends on the platform, it is recorded, not asserted.
+TEST_F(AudioHalTest, outputStartLatency)
+{
+    static const int iterations = 10;
+    audio_hw_device *audioDevice = getDevice();
+    audio_config_t config;
+    setConfig(48000, AUDIO_CHANNEL_OUT_STEREO, AUDIO_FORMAT_PCM_16_BIT, config);
+    audio_stream_out_t *outStream = NULL;
+
+    ASSERT_EQ(android::OK, audioDevice->open_output_stream(audioDevice,
+                                                           0,
+                                                           AUDIO_DEVICE_OUT_SPEAKER,
+                                                           AUDIO_OUTPUT_FLAG_PRIMARY,
+                                                           &config,
+                                                           &outStream,
+                                                           "dont_care"));
+    ASSERT_TRUE(outStream != NULL);
+
+    intel_audio::KeyValuePairs valuePair;
+    valuePair.add<int32_t>(android::AudioParameter::keyRouting, AUDIO_DEVICE_OUT_SPEAKER);
+    ASSERT_EQ(android::OK, outStream->common.set_parameters(&outStream->common,
+                                                            valuePair.toString().c_str()));
+
+    size_t bufferSize = outStream->common.get_buffer_size(&outStream->common);
+    ASSERT_NE(0u, bufferSize);
+    std::vector<char> buffer(bufferSize, 0);
+
+    int64_t totalUs = 0;
+    int64_t maxUs = 0;
+    for (int i = 0; i < iterations; i++) {
+        ASSERT_EQ(static_cast<ssize_t>(bufferSize),
+                  outStream->write(outStream, buffer.data(), bufferSize));
+        ASSERT_EQ(android::OK, outStream->common.standby(&outStream->common));
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ASSERT_EQ(static_cast<ssize_t>(bufferSize),
+                  outStream->write(outStream, buffer.data(), bufferSize));
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        int64_t latencyUs = (end.tv_sec - start.tv_sec) * 1000000LL +
+                            (end.tv_nsec - start.tv_nsec) / 1000;
+        totalUs += latencyUs;
+        maxUs = std::max(maxUs, latencyUs);
+
+        ASSERT_EQ(android::OK, outStream->common.standby(&outStream->common));
+    }
+    ::testing::Test::RecordProperty("averageStartLatencyUs",
+                                    static_cast<int>(totalUs / iterations));
+    ::testing::Test::RecordProperty("maxStartLatencyUs", static_cast<int>(maxUs));
+
+    audioDevice->close_output_stream(audioDevice, outStream);
+}
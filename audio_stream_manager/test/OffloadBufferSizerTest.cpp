@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <OffloadBufferSizer.hpp>
+#include <gtest/gtest.h>
+
+namespace intel_audio
+{
+
+static const size_t gMinFragmentSize = 2 * 1024;
+static const size_t gMaxFragmentSize = 128 * 1024;
+static const uint32_t gWakeIntervalSec = 8;
+static const uint32_t gRate = 44100;
+static const int64_t gNsecPerSec = 1000000000LL;
+
+/**
+ * Simulates the playback of a track consumed at a constant rate, with a wakeup each time a
+ * fragment is consumed.
+ *
+ * @return time at end of track.
+ */
+static int64_t playTrack(OffloadBufferSizer &sizer, uint32_t bytesPerSec, uint32_t durationSec,
+                         int64_t startNs, uint64_t &consumedBytes, uint64_t &renderedFrames)
+{
+    uint64_t trackBytes = static_cast<uint64_t>(bytesPerSec) * durationSec;
+    uint64_t endBytes = consumedBytes + trackBytes;
+    uint64_t startBytes = consumedBytes;
+    uint64_t startFrames = renderedFrames;
+    while (consumedBytes + sizer.getFragmentSize() <= endBytes) {
+        consumedBytes += sizer.getFragmentSize();
+        uint64_t elapsedBytes = consumedBytes - startBytes;
+        renderedFrames = startFrames + elapsedBytes * gRate / bytesPerSec;
+        sizer.onFragmentConsumed(consumedBytes, renderedFrames, gRate);
+    }
+    return startNs + static_cast<int64_t>(durationSec) * gNsecPerSec;
+}
+
+TEST(OffloadBufferSizer, nominalSize)
+{
+    OffloadBufferSizer sizer(gMinFragmentSize, gMaxFragmentSize, gWakeIntervalSec);
+    EXPECT_EQ(gMinFragmentSize, sizer.getFragmentSize());
+    EXPECT_EQ(OffloadBufferSizer::mMinFragments, sizer.getFragments());
+
+    sizer.reset(40000);
+    EXPECT_EQ(32768u, sizer.getFragmentSize());
+    sizer.reset(1);
+    EXPECT_EQ(gMinFragmentSize, sizer.getFragmentSize());
+    sizer.reset(1024 * 1024);
+    EXPECT_EQ(gMaxFragmentSize, sizer.getFragmentSize());
+    EXPECT_EQ(0u, sizer.getMeasuredBytesPerSec());
+}
+
+TEST(OffloadBufferSizer, roundDownToPowerOf2)
+{
+    EXPECT_EQ(1u, OffloadBufferSizer::roundDownToPowerOf2(0));
+    EXPECT_EQ(1u, OffloadBufferSizer::roundDownToPowerOf2(1));
+    EXPECT_EQ(2u, OffloadBufferSizer::roundDownToPowerOf2(3));
+    EXPECT_EQ(4096u, OffloadBufferSizer::roundDownToPowerOf2(4096));
+    EXPECT_EQ(4096u, OffloadBufferSizer::roundDownToPowerOf2(8191));
+}
+
+TEST(OffloadBufferSizer, adaptsToMeasuredRate)
+{
+    OffloadBufferSizer sizer(gMinFragmentSize, gMaxFragmentSize, gWakeIntervalSec);
+    sizer.reset(32 * 1024); // Nominal 32 kB, i.e. 32 kbps announced
+    sizer.startMeasurement(0);
+    uint64_t consumedBytes = 0;
+    uint64_t renderedFrames = 0;
+
+    // VBR track actually consumed at 2 kB/s: 16 kB per wake interval
+    int64_t now = playTrack(sizer, 2048, 120, 0, consumedBytes, renderedFrames);
+    EXPECT_TRUE(sizer.onTrackBoundary(now));
+    EXPECT_EQ(2048u, sizer.getMeasuredBytesPerSec());
+    EXPECT_EQ(16384u, sizer.getFragmentSize());
+    EXPECT_EQ(2u, sizer.getFragments());
+
+    // Same rate on next track: unchanged
+    now = playTrack(sizer, 2048, 120, now, consumedBytes, renderedFrames);
+    EXPECT_FALSE(sizer.onTrackBoundary(now));
+    EXPECT_EQ(16384u, sizer.getFragmentSize());
+}
+
+TEST(OffloadBufferSizer, saturatesWithinBounds)
+{
+    OffloadBufferSizer sizer(gMinFragmentSize, gMaxFragmentSize, gWakeIntervalSec);
+    uint64_t consumedBytes = 0;
+    uint64_t renderedFrames = 0;
+
+    // 320 kbps: fragment size saturates, more fragments are used
+    int64_t now = playTrack(sizer, 40000, 60, 0, consumedBytes, renderedFrames);
+    EXPECT_TRUE(sizer.onTrackBoundary(now));
+    EXPECT_EQ(gMaxFragmentSize, sizer.getFragmentSize());
+    EXPECT_EQ(OffloadBufferSizer::mMaxFragments, sizer.getFragments());
+
+    // 2 kbps: long enough for a few wakeups with largest fragments
+    now = playTrack(sizer, 256, 2048, now, consumedBytes, renderedFrames);
+    EXPECT_TRUE(sizer.onTrackBoundary(now));
+    EXPECT_EQ(gMinFragmentSize, sizer.getFragmentSize());
+    EXPECT_EQ(OffloadBufferSizer::mMinFragments, sizer.getFragments());
+}
+
+TEST(OffloadBufferSizer, untrustedMeasurement)
+{
+    OffloadBufferSizer sizer(gMinFragmentSize, gMaxFragmentSize, gWakeIntervalSec);
+    sizer.reset(8192);
+
+    // No sample at all
+    EXPECT_FALSE(sizer.onTrackBoundary(gNsecPerSec));
+
+    // Less than a second rendered
+    sizer.onFragmentConsumed(8192, 0, gRate);
+    sizer.onFragmentConsumed(16384, gRate / 2, gRate);
+    EXPECT_FALSE(sizer.onTrackBoundary(2 * gNsecPerSec));
+    EXPECT_EQ(8192u, sizer.getFragmentSize());
+
+    // Counters restarted by the driver: window restarts from the new counters
+    sizer.onFragmentConsumed(1000000, 10 * gRate, gRate);
+    sizer.onFragmentConsumed(8192, 0, gRate);
+    sizer.onFragmentConsumed(8192 + 4096, gRate, gRate);
+    EXPECT_TRUE(sizer.onTrackBoundary(3 * gNsecPerSec));
+    EXPECT_EQ(4096u, sizer.getMeasuredBytesPerSec());
+}
+
+TEST(OffloadBufferSizer, wakeupsPerMinute)
+{
+    OffloadBufferSizer sizer(gMinFragmentSize, gMaxFragmentSize, gWakeIntervalSec);
+    sizer.startMeasurement(10 * gNsecPerSec);
+    EXPECT_EQ(0u, sizer.getWakeupsPerMinute(10 * gNsecPerSec));
+
+    for (int i = 0; i < 10; i++) {
+        sizer.onFragmentConsumed(0, 0, 0);
+    }
+    EXPECT_EQ(10u, sizer.getWakeups());
+    EXPECT_EQ(20u, sizer.getWakeupsPerMinute(40 * gNsecPerSec));
+
+    sizer.onTrackBoundary(40 * gNsecPerSec);
+    EXPECT_EQ(20u, sizer.getPreviousWakeupsPerMinute());
+    EXPECT_EQ(0u, sizer.getWakeups());
+}
+
+} // namespace intel_audio
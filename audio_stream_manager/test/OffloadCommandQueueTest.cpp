@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <OffloadCommandQueue.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace intel_audio
+{
+
+typedef std::chrono::steady_clock Clock;
+
+enum FakeCommand
+{
+    EXIT,
+    DRAIN,
+    WAIT_FOR_BUFFER
+};
+
+/**
+ * Fake compress device: compress_wait blocks until a buffer is released by the DSP or until the
+ * stream is stopped.
+ */
+class FakeCompress
+{
+public:
+    FakeCompress() : mBuffersReleased(0), mStopped(false), mWaitCount(0) {}
+
+    int wait()
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mWaitCount++;
+        mCond.wait(lock, [this] { return mStopped || mBuffersReleased > 0; });
+        if (mStopped) {
+            return -1;
+        }
+        mBuffersReleased--;
+        return 0;
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mStopped = true;
+        mCond.notify_all();
+    }
+
+    void releaseBuffer()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mBuffersReleased++;
+        mCond.notify_all();
+    }
+
+    int getWaitCount()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mWaitCount;
+    }
+
+private:
+    std::mutex mLock;
+    std::condition_variable mCond;
+    int mBuffersReleased;
+    bool mStopped;
+    int mWaitCount;
+};
+
+/**
+ * Offload thread running the consumer loop of the queue, as CompressedStreamOut does, with a
+ * handler mimicking the stream upon the fake compress device.
+ */
+class FakeOffloadThread : private OffloadCommandQueue::Handler
+{
+public:
+    FakeOffloadThread(OffloadCommandQueue &queue, FakeCompress &compress)
+        : mStopGeneration(0), mQueue(queue), mCompress(compress), mHandledDrains(0),
+          mThread(&OffloadCommandQueue::run, &queue, std::ref<Handler>(*this), EXIT)
+    {}
+
+    ~FakeOffloadThread()
+    {
+        OffloadCommandQueue::Command exit = { EXIT, mStopGeneration };
+        EXPECT_TRUE(mQueue.push(exit, true));
+        mThread.join();
+    }
+
+    void waitForDrains(int count)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCond.wait(lock, [this, count] { return mHandledDrains >= count; });
+    }
+
+    std::atomic<uint32_t> mStopGeneration;
+
+private:
+    virtual void onCommand(const OffloadCommandQueue::Command &cmd)
+    {
+        if (cmd.code == WAIT_FOR_BUFFER) {
+            if (cmd.generation == mStopGeneration) {
+                mCompress.wait();
+            }
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mLock);
+        mHandledDrains++;
+        mCond.notify_all();
+    }
+
+    OffloadCommandQueue &mQueue;
+    FakeCompress &mCompress;
+    std::mutex mLock;
+    std::condition_variable mCond;
+    int mHandledDrains;
+    std::thread mThread;
+};
+
+TEST(OffloadCommandQueue, fifo)
+{
+    OffloadCommandQueue queue;
+    OffloadCommandQueue::Command cmd;
+    EXPECT_FALSE(queue.pop(cmd));
+
+    for (int lap = 0; lap < 3; lap++) {
+        for (uint32_t i = 0; i < OffloadCommandQueue::mCapacity; i++) {
+            OffloadCommandQueue::Command pushed = { static_cast<int>(i), i + lap };
+            bool isControl =
+                i >= OffloadCommandQueue::mCapacity - OffloadCommandQueue::mReservedSlots;
+            ASSERT_TRUE(queue.push(pushed, isControl));
+        }
+        for (uint32_t i = 0; i < OffloadCommandQueue::mCapacity; i++) {
+            ASSERT_TRUE(queue.pop(cmd));
+            EXPECT_EQ(static_cast<int>(i), cmd.code);
+            EXPECT_EQ(i + lap, cmd.generation);
+        }
+        EXPECT_FALSE(queue.pop(cmd));
+    }
+}
+
+TEST(OffloadCommandQueue, full)
+{
+    OffloadCommandQueue queue;
+    OffloadCommandQueue::Command cmd = { DRAIN, 0 };
+    size_t unreservedSlots = OffloadCommandQueue::mCapacity - OffloadCommandQueue::mReservedSlots;
+    for (size_t i = 0; i < unreservedSlots; i++) {
+        ASSERT_TRUE(queue.push(cmd));
+    }
+    EXPECT_FALSE(queue.push(cmd));
+    EXPECT_TRUE(queue.pop(cmd));
+    EXPECT_TRUE(queue.push(cmd));
+    EXPECT_FALSE(queue.push(cmd));
+
+    // Reserved slots remain for control commands
+    OffloadCommandQueue::Command exit = { EXIT, 0 };
+    for (size_t i = 0; i < OffloadCommandQueue::mReservedSlots; i++) {
+        ASSERT_TRUE(queue.push(exit, true));
+    }
+    EXPECT_FALSE(queue.push(exit, true));
+    EXPECT_TRUE(queue.pop(cmd));
+    EXPECT_FALSE(queue.push(cmd));
+    EXPECT_TRUE(queue.push(exit, true));
+}
+
+TEST(OffloadCommandQueue, wait)
+{
+    OffloadCommandQueue queue;
+    EXPECT_GE(queue.getFd(), 0);
+    EXPECT_FALSE(queue.wait(0));
+
+    OffloadCommandQueue::Command cmd = { DRAIN, 0 };
+    ASSERT_TRUE(queue.push(cmd));
+    ASSERT_TRUE(queue.push(cmd));
+    // Both pushes are reported by a single wakeup
+    EXPECT_TRUE(queue.wait(0));
+    EXPECT_FALSE(queue.wait(0));
+    EXPECT_TRUE(queue.pop(cmd));
+    EXPECT_TRUE(queue.pop(cmd));
+    EXPECT_FALSE(queue.pop(cmd));
+}
+
+TEST(OffloadCommandQueue, multipleProducers)
+{
+    static const int producerCount = 4;
+    static const uint32_t commandsPerProducer = 20000;
+    OffloadCommandQueue queue;
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < producerCount; producer++) {
+        producers.push_back(std::thread([&queue, producer] {
+            for (uint32_t sequence = 0; sequence < commandsPerProducer; sequence++) {
+                OffloadCommandQueue::Command cmd = { producer, sequence };
+                while (!queue.push(cmd)) {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    std::vector<uint32_t> expectedSequence(producerCount, 0);
+    uint32_t received = 0;
+    while (received < producerCount * commandsPerProducer) {
+        OffloadCommandQueue::Command cmd;
+        if (!queue.pop(cmd)) {
+            queue.wait(100);
+            continue;
+        }
+        ASSERT_GE(cmd.code, 0);
+        ASSERT_LT(cmd.code, producerCount);
+        // Commands of a given producer are received in order
+        ASSERT_EQ(expectedSequence[cmd.code], cmd.generation);
+        expectedSequence[cmd.code]++;
+        received++;
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    OffloadCommandQueue::Command cmd;
+    EXPECT_FALSE(queue.pop(cmd));
+}
+
+TEST(OffloadCommandQueue, commandIssue)
+{
+    static const int iterations = 1000;
+    OffloadCommandQueue queue;
+    FakeCompress compress;
+    FakeOffloadThread thread(queue, compress);
+
+    // Each command wakes the offload thread up, none is left pending
+    std::vector<Clock::duration> latencies;
+    for (int i = 0; i < iterations; i++) {
+        Clock::time_point issued = Clock::now();
+        OffloadCommandQueue::Command cmd = { DRAIN, thread.mStopGeneration };
+        ASSERT_TRUE(queue.push(cmd));
+        thread.waitForDrains(i + 1);
+        latencies.push_back(Clock::now() - issued);
+    }
+
+    // Issue latency depends on the host scheduler: recorded, not asserted
+    std::sort(latencies.begin(), latencies.end());
+    auto usec = [](Clock::duration duration) {
+        return static_cast<int>(
+            std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    };
+    ::testing::Test::RecordProperty("medianIssueLatencyUs", usec(latencies[iterations / 2]));
+    ::testing::Test::RecordProperty("p99IssueLatencyUs",
+                                    usec(latencies[iterations * 99 / 100]));
+    ::testing::Test::RecordProperty("maxIssueLatencyUs", usec(latencies.back()));
+}
+
+TEST(OffloadCommandQueue, stopDropsPendingWaitForBuffer)
+{
+    OffloadCommandQueue queue;
+    FakeCompress compress;
+    FakeOffloadThread thread(queue, compress);
+
+    // Offload thread gets blocked in compress wait, other commands pile up behind
+    for (int i = 0; i < 3; i++) {
+        OffloadCommandQueue::Command cmd = { WAIT_FOR_BUFFER, thread.mStopGeneration };
+        ASSERT_TRUE(queue.push(cmd));
+    }
+    while (compress.getWaitCount() == 0) {
+        std::this_thread::yield();
+    }
+
+    // Stop: obsolete pending commands, then unblock compress wait
+    thread.mStopGeneration++;
+    compress.stop();
+    OffloadCommandQueue::Command drain = { DRAIN, thread.mStopGeneration };
+    ASSERT_TRUE(queue.push(drain));
+    thread.waitForDrains(1);
+    EXPECT_EQ(1, compress.getWaitCount());
+}
+
+TEST(OffloadCommandQueue, exitWhileQueueFull)
+{
+    OffloadCommandQueue queue;
+    FakeCompress compress;
+    {
+        FakeOffloadThread thread(queue, compress);
+
+        // Offload thread blocked in compress wait, the queue gets full of commands behind
+        OffloadCommandQueue::Command cmd = { WAIT_FOR_BUFFER, thread.mStopGeneration };
+        ASSERT_TRUE(queue.push(cmd));
+        while (compress.getWaitCount() == 0) {
+            std::this_thread::yield();
+        }
+        size_t pushed = 0;
+        while (queue.push(cmd)) {
+            pushed++;
+        }
+        EXPECT_EQ(OffloadCommandQueue::mCapacity - OffloadCommandQueue::mReservedSlots, pushed);
+
+        // Exit request cannot be dropped
+        OffloadCommandQueue::Command exit = { EXIT, thread.mStopGeneration };
+        EXPECT_TRUE(queue.push(exit, true));
+
+        // Stop: pending commands become stale, the thread reaches the exit and can be joined
+        thread.mStopGeneration++;
+        compress.stop();
+    }
+    EXPECT_EQ(1, compress.getWaitCount());
+}
+
+} // namespace intel_audio
@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <PreProcessingPipeline.hpp>
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace intel_audio
+{
+
+static const size_t gPeriodFrames = 160;
+
+/**
+ * Fake effect: negates the samples. Processing may be held, to simulate an effect CPU spike
+ * lasting as long as needed by the test.
+ */
+class FakeEffect : public PreProcessingPipeline::Processor
+{
+public:
+    FakeEffect() : mIsHeld(false), mStartedChunks(0), mProcessedChunks(0) {}
+
+    virtual size_t processCapturedFrames(const void *src, size_t frames,
+                                         const PreProcessingPipeline::CaptureTime &captureTime,
+                                         void *dst, size_t dstFrames)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mStartedChunks++;
+        mCaptureTimes.push_back(captureTime);
+        mCond.notify_all();
+        mCond.wait(lock, [this] { return !mIsHeld; });
+        EXPECT_LE(frames, dstFrames);
+        const int16_t *in = static_cast<const int16_t *>(src);
+        int16_t *out = static_cast<int16_t *>(dst);
+        for (size_t i = 0; i < frames; i++) {
+            out[i] = -in[i];
+        }
+        mProcessedChunks++;
+        mCond.notify_all();
+        return frames;
+    }
+
+    /** Holds the processing of next chunks until released. */
+    void hold()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mIsHeld = true;
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mIsHeld = false;
+        mCond.notify_all();
+    }
+
+    void waitForStartedChunks(uint32_t chunks)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCond.wait(lock, [this, chunks] { return mStartedChunks >= chunks; });
+    }
+
+    void waitForProcessedChunks(uint32_t chunks)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCond.wait(lock, [this, chunks] { return mProcessedChunks >= chunks; });
+    }
+
+    uint32_t getProcessedChunks()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mProcessedChunks;
+    }
+
+    std::vector<PreProcessingPipeline::CaptureTime> getCaptureTimes()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mCaptureTimes;
+    }
+
+private:
+    std::mutex mLock;
+    std::condition_variable mCond;
+    bool mIsHeld;
+    uint32_t mStartedChunks;
+    uint32_t mProcessedChunks;
+    std::vector<PreProcessingPipeline::CaptureTime> mCaptureTimes;
+};
+
+/** @return capture time measured by the reader, with frames captured after the pushed ones. */
+static PreProcessingPipeline::CaptureTime getCaptureTime(time_t seconds, size_t framesAfter)
+{
+    PreProcessingPipeline::CaptureTime captureTime;
+    captureTime.time.tv_sec = seconds;
+    captureTime.time.tv_nsec = 0;
+    captureTime.framesAfter = framesAfter;
+    return captureTime;
+}
+
+static void fillPeriod(std::vector<int16_t> &period, int16_t index)
+{
+    for (size_t i = 0; i < period.size(); i++) {
+        period[i] = index * 1000 + static_cast<int16_t>(i % 1000);
+    }
+}
+
+TEST(PreProcessingPipeline, primedLatency)
+{
+    static const size_t latencyPeriods = 2;
+    FakeEffect effect;
+    PreProcessingPipeline pipeline;
+    EXPECT_EQ(android::BAD_VALUE, pipeline.start(effect, sizeof(int16_t), gPeriodFrames, 0));
+    ASSERT_EQ(android::OK,
+              pipeline.start(effect, sizeof(int16_t), gPeriodFrames, latencyPeriods));
+    EXPECT_TRUE(pipeline.isRunning());
+    EXPECT_EQ(latencyPeriods * gPeriodFrames, pipeline.getLatencyFrames());
+
+    std::vector<int16_t> captured(gPeriodFrames);
+    std::vector<int16_t> processed(gPeriodFrames);
+    for (int16_t index = 0; index < 10; index++) {
+        fillPeriod(captured, index + 1);
+        pipeline.push(captured.data(), gPeriodFrames, getCaptureTime(index + 1, 0));
+        ASSERT_EQ(gPeriodFrames, pipeline.pop(processed.data(), gPeriodFrames));
+
+        // Silence until the latency elapsed, then the periods processed in order
+        std::vector<int16_t> expected(gPeriodFrames, 0);
+        if (index >= static_cast<int16_t>(latencyPeriods)) {
+            fillPeriod(expected, index + 1 - latencyPeriods);
+            for (auto &sample : expected) {
+                sample = -sample;
+            }
+        }
+        ASSERT_EQ(expected, processed) << "period " << index;
+    }
+    pipeline.stop();
+    EXPECT_FALSE(pipeline.isRunning());
+    EXPECT_EQ(0u, pipeline.getLatencyFrames());
+}
+
+TEST(PreProcessingPipeline, absorbEffectSpike)
+{
+    static const size_t latencyPeriods = 3;
+    FakeEffect effect;
+    PreProcessingPipeline pipeline;
+    ASSERT_EQ(android::OK,
+              pipeline.start(effect, sizeof(int16_t), gPeriodFrames, latencyPeriods));
+
+    // Effect stuck on the first period while the reader gets as many periods as the latency
+    std::vector<int16_t> captured(gPeriodFrames);
+    std::vector<int16_t> processed(gPeriodFrames);
+    effect.hold();
+    for (int16_t index = 0; index < static_cast<int16_t>(latencyPeriods); index++) {
+        fillPeriod(captured, index + 1);
+        pipeline.push(captured.data(), gPeriodFrames, getCaptureTime(index + 1, 0));
+        effect.waitForStartedChunks(1);
+        ASSERT_EQ(gPeriodFrames, pipeline.pop(processed.data(), gPeriodFrames));
+        EXPECT_EQ(std::vector<int16_t>(gPeriodFrames, 0), processed);
+    }
+    // The reader never waited for the worker, which is still on the first period
+    EXPECT_EQ(0u, pipeline.getLateCount());
+    EXPECT_EQ(0u, effect.getProcessedChunks());
+    EXPECT_EQ((latencyPeriods - 1) * gPeriodFrames, pipeline.getPendingFrames());
+
+    // Once the spike is over, the worker catches up, the periods being processed in order
+    effect.release();
+    effect.waitForProcessedChunks(latencyPeriods);
+    fillPeriod(captured, latencyPeriods + 1);
+    pipeline.push(captured.data(), gPeriodFrames, getCaptureTime(latencyPeriods + 1, 0));
+    ASSERT_EQ(gPeriodFrames, pipeline.pop(processed.data(), gPeriodFrames));
+    std::vector<int16_t> expected(gPeriodFrames);
+    fillPeriod(expected, 1);
+    for (auto &sample : expected) {
+        sample = -sample;
+    }
+    EXPECT_EQ(expected, processed);
+    EXPECT_EQ(0u, pipeline.getLateCount());
+    EXPECT_EQ(0u, pipeline.consumeFramesLost());
+}
+
+TEST(PreProcessingPipeline, bufferedFrames)
+{
+    static const size_t latencyPeriods = 2;
+    FakeEffect effect;
+    PreProcessingPipeline pipeline;
+    size_t frames;
+    EXPECT_FALSE(pipeline.getBufferedFrames(frames));
+    ASSERT_EQ(android::OK,
+              pipeline.start(effect, sizeof(int16_t), gPeriodFrames, latencyPeriods));
+
+    // Silence primed counts as frames captured before the first frames pushed
+    ASSERT_TRUE(pipeline.getBufferedFrames(frames));
+    EXPECT_EQ(latencyPeriods * gPeriodFrames, frames);
+
+    // Frames pending, being processed or processed are counted alike
+    std::vector<int16_t> buffer(gPeriodFrames);
+    effect.hold();
+    pipeline.push(buffer.data(), gPeriodFrames, getCaptureTime(1, 0));
+    effect.waitForStartedChunks(1);
+    pipeline.push(buffer.data(), gPeriodFrames, getCaptureTime(2, 0));
+    ASSERT_TRUE(pipeline.getBufferedFrames(frames));
+    EXPECT_EQ((latencyPeriods + 2) * gPeriodFrames, frames);
+    ASSERT_EQ(gPeriodFrames, pipeline.pop(buffer.data(), gPeriodFrames));
+    ASSERT_TRUE(pipeline.getBufferedFrames(frames));
+    EXPECT_EQ((latencyPeriods + 1) * gPeriodFrames, frames);
+
+    effect.release();
+    effect.waitForProcessedChunks(2);
+    ASSERT_TRUE(pipeline.getBufferedFrames(frames));
+    EXPECT_EQ((latencyPeriods + 1) * gPeriodFrames, frames);
+
+    // Once the reader popped all the frames pushed, the latency is left
+    ASSERT_EQ(gPeriodFrames, pipeline.pop(buffer.data(), gPeriodFrames));
+    ASSERT_TRUE(pipeline.getBufferedFrames(frames));
+    EXPECT_EQ(latencyPeriods * gPeriodFrames, frames);
+
+    pipeline.stop();
+    EXPECT_FALSE(pipeline.getBufferedFrames(frames));
+}
+
+TEST(PreProcessingPipeline, captureTimeOfChunk)
+{
+    FakeEffect effect;
+    PreProcessingPipeline pipeline;
+    ASSERT_EQ(android::OK, pipeline.start(effect, sizeof(int16_t), gPeriodFrames, 2));
+
+    // Frames pushed while the worker is held were captured after the chunk it processes
+    std::vector<int16_t> captured(gPeriodFrames);
+    effect.hold();
+    pipeline.push(captured.data(), gPeriodFrames, getCaptureTime(1, 100));
+    effect.waitForStartedChunks(1);
+    pipeline.push(captured.data(), gPeriodFrames, getCaptureTime(2, 50));
+    effect.release();
+    effect.waitForProcessedChunks(2);
+
+    std::vector<PreProcessingPipeline::CaptureTime> captureTimes = effect.getCaptureTimes();
+    ASSERT_EQ(2u, captureTimes.size());
+    // First chunk measured by the reader when pushed
+    EXPECT_EQ(1, captureTimes[0].time.tv_sec);
+    EXPECT_EQ(100u, captureTimes[0].framesAfter);
+    // Second chunk measured when pushed, nothing pushed after
+    EXPECT_EQ(2, captureTimes[1].time.tv_sec);
+    EXPECT_EQ(50u, captureTimes[1].framesAfter);
+
+    // Reader pops the frames, making room for the worker
+    std::vector<int16_t> processed(4 * gPeriodFrames);
+    ASSERT_EQ(4 * gPeriodFrames, pipeline.pop(processed.data(), 4 * gPeriodFrames));
+
+    // A chunk taken while more frames were pushed counts them as captured after it
+    effect.hold();
+    pipeline.push(captured.data(), gPeriodFrames, getCaptureTime(3, 10));
+    effect.waitForStartedChunks(3);
+    pipeline.push(captured.data(), gPeriodFrames / 2, getCaptureTime(4, 20));
+    pipeline.push(captured.data(), gPeriodFrames / 2, getCaptureTime(5, 30));
+    effect.release();
+    effect.waitForProcessedChunks(4);
+    captureTimes = effect.getCaptureTimes();
+    ASSERT_EQ(4u, captureTimes.size());
+    EXPECT_EQ(3, captureTimes[2].time.tv_sec);
+    EXPECT_EQ(10u, captureTimes[2].framesAfter);
+    // Both halves processed at once: measured by the latest push
+    EXPECT_EQ(5, captureTimes[3].time.tv_sec);
+    EXPECT_EQ(30u, captureTimes[3].framesAfter);
+}
+
+TEST(PreProcessingPipeline, stopUnblocksReader)
+{
+    FakeEffect effect;
+    PreProcessingPipeline pipeline;
+    ASSERT_EQ(android::OK, pipeline.start(effect, sizeof(int16_t), gPeriodFrames, 1));
+
+    // Reader waiting for the worker held on the first period
+    std::vector<int16_t> buffer(4 * gPeriodFrames);
+    effect.hold();
+    pipeline.push(buffer.data(), 4 * gPeriodFrames, getCaptureTime(1, 0));
+    effect.waitForStartedChunks(1);
+    size_t frames = 0;
+    std::thread reader([&pipeline, &buffer, &frames] {
+        frames = pipeline.pop(buffer.data(), 4 * gPeriodFrames);
+    });
+    std::thread stopper([&pipeline] { pipeline.stop(); });
+    effect.release();
+    stopper.join();
+    reader.join();
+
+    // Frames not processed before the stop are dropped
+    EXPECT_LE(frames, 4 * gPeriodFrames);
+    EXPECT_FALSE(pipeline.isRunning());
+    EXPECT_EQ(0u, pipeline.getPendingFrames());
+    EXPECT_EQ(0u, pipeline.pop(buffer.data(), gPeriodFrames));
+
+    // Restarts primed again
+    ASSERT_EQ(android::OK, pipeline.start(effect, sizeof(int16_t), gPeriodFrames, 1));
+    EXPECT_EQ(gPeriodFrames, pipeline.pop(buffer.data(), gPeriodFrames));
+}
+
+} // namespace intel_audio
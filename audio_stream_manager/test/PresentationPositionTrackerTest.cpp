@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <PresentationPositionTracker.hpp>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+
+namespace intel_audio
+{
+
+static const uint32_t gRate = 48000;
+static const size_t gBufferFrames = 1920;
+
+static struct timespec getTimeFromNow(int64_t offsetNs)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t ns = now.tv_sec * 1000000000LL + now.tv_nsec + offsetNs;
+    struct timespec time = {
+        static_cast<time_t>(ns / 1000000000LL), static_cast<long>(ns % 1000000000LL)
+    };
+    return time;
+}
+
+TEST(PresentationPositionTracker, invalidUntilUpdated)
+{
+    PresentationPositionTracker tracker;
+    uint64_t frames;
+    struct timespec timestamp;
+    int64_t nextWriteNs;
+    EXPECT_FALSE(tracker.getPresentationPosition(frames, timestamp));
+    EXPECT_FALSE(tracker.getNextWriteTimestamp(nextWriteNs));
+
+    tracker.update(gBufferFrames, gBufferFrames, getTimeFromNow(0), gRate);
+    EXPECT_TRUE(tracker.getPresentationPosition(frames, timestamp));
+    // The device has not presented any frame yet: the position does not move
+    EXPECT_EQ(0u, frames);
+
+    tracker.invalidate();
+    EXPECT_FALSE(tracker.getPresentationPosition(frames, timestamp));
+
+    // More frames queued than written: left to the device query
+    tracker.update(100, gBufferFrames, getTimeFromNow(0), gRate);
+    EXPECT_FALSE(tracker.getPresentationPosition(frames, timestamp));
+}
+
+TEST(PresentationPositionTracker, interpolateWhileRunning)
+{
+    PresentationPositionTracker tracker;
+    tracker.update(gBufferFrames, gBufferFrames, getTimeFromNow(0), gRate);
+    // 10 ms ago, 480 frames have been presented out of 2 buffers written
+    tracker.update(2 * gBufferFrames, 2 * gBufferFrames - 480, getTimeFromNow(-10000000), gRate);
+
+    uint64_t frames;
+    struct timespec timestamp;
+    ASSERT_TRUE(tracker.getPresentationPosition(frames, timestamp));
+    // At least 10 ms elapsed since the HW timestamp, capped to the frames written
+    EXPECT_GE(frames, 960u);
+    EXPECT_LE(frames, 2 * gBufferFrames);
+
+    int64_t nextWriteNs;
+    ASSERT_TRUE(tracker.getNextWriteTimestamp(nextWriteNs));
+    struct timespec now = getTimeFromNow(0);
+    int64_t nowNs = now.tv_sec * 1000000000LL + now.tv_nsec;
+    // Queued frames are presented 70 ms after the HW timestamp, i.e. 60 ms from now at most
+    EXPECT_GT(nextWriteNs, nowNs);
+    EXPECT_LE(nextWriteNs, nowNs + 60000000);
+}
+
+TEST(PresentationPositionTracker, capToQueuedFrames)
+{
+    PresentationPositionTracker tracker;
+    tracker.update(gBufferFrames, gBufferFrames, getTimeFromNow(-2000000000LL), gRate);
+    tracker.update(2 * gBufferFrames, gBufferFrames, getTimeFromNow(-1000000000LL), gRate);
+
+    // One second elapsed: the device underran, all the frames written have been presented
+    uint64_t frames;
+    struct timespec timestamp;
+    ASSERT_TRUE(tracker.getPresentationPosition(frames, timestamp));
+    EXPECT_EQ(2 * gBufferFrames, frames);
+}
+
+TEST(PresentationPositionTracker, consistentSnapshots)
+{
+    // HW timestamps ahead of the clock are not interpolated: each update presents as many frames
+    // as the nanoseconds of its timestamp past the base, a torn read would break the equality.
+    static const int64_t baseNs = 3600 * 1000000000LL;
+    PresentationPositionTracker tracker;
+    std::atomic<bool> stop(false);
+    std::thread writer([&tracker, &stop] {
+        uint64_t presented = 0;
+        while (!stop) {
+            presented++;
+            struct timespec timestamp = getTimeFromNow(0);
+            int64_t ns = baseNs + timestamp.tv_sec * 1000000000LL + presented;
+            timestamp.tv_sec = ns / 1000000000LL;
+            timestamp.tv_nsec = ns % 1000000000LL;
+            tracker.update(2 * presented, presented, timestamp, gRate);
+        }
+    });
+    for (int i = 0; i < 100000; i++) {
+        uint64_t frames;
+        struct timespec timestamp;
+        if (tracker.getPresentationPosition(frames, timestamp)) {
+            ASSERT_EQ(static_cast<int64_t>(frames),
+                      (timestamp.tv_sec * 1000000000LL + timestamp.tv_nsec - baseNs) %
+                      1000000000LL);
+        }
+    }
+    stop = true;
+    writer.join();
+}
+
+} // namespace intel_audio
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <StreamIn.hpp>
+#include <StreamOut.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace intel_audio
+{
+
+typedef std::chrono::steady_clock Clock;
+
+/** Duration of a transfer with the audio device, during which the stream lock is held. */
+static const auto gTransferDuration = std::chrono::milliseconds(5);
+
+/** Polls longer than this duration are considered blocked by a transfer. */
+static const auto gBlockedPollDuration = std::chrono::milliseconds(1);
+
+static const uint32_t gOutFlagMask = AUDIO_OUTPUT_FLAG_PRIMARY;
+static const uint32_t gInFlagMask = AUDIO_INPUT_FLAG_NONE;
+static const uint32_t gUseCaseMask = 1 << AUDIO_SOURCE_VOICE_COMMUNICATION;
+
+/**
+ * Stream of the HAL, without parent device: transfers hold the stream lock as the read / write
+ * path does, and the state is accessed through the stream accessors. The stream is never
+ * started through the device, hence never routed.
+ */
+template <class StreamType>
+class TransferringStream : public StreamType
+{
+public:
+    template <typename... Args>
+    explicit TransferringStream(Args... args) : StreamType(NULL, args...) {}
+
+    void transfer()
+    {
+        AutoR lock(this->mStreamLock);
+        std::this_thread::sleep_for(gTransferDuration);
+    }
+
+    using Stream::setStarted;
+    using Stream::setUseCaseMask;
+};
+
+/**
+ * Polls the state of a stream as the route manager does upon routing.
+ *
+ * @return true if the state polled is one the policy thread set, false otherwise.
+ */
+static bool pollState(const Stream &stream, uint32_t &startedPolls)
+{
+    if (stream.isStarted()) {
+        startedPolls++;
+    }
+    std::string address = stream.getDeviceAddress();
+    return !stream.isRouted() && !stream.isNewRouteAvailable() &&
+           stream.getDevices() != AUDIO_DEVICE_NONE &&
+           stream.getFlagMask() == (stream.isOut() ? gOutFlagMask : gInFlagMask) &&
+           (stream.getUseCaseMask() == 0 || stream.getUseCaseMask() == gUseCaseMask) &&
+           (address.empty() || address == "card=0;device=0" || address == "bottom");
+}
+
+/**
+ * Polls the state of streams as the route manager does upon routing, while a playback and a
+ * capture stream transfer and the policy changes their state at a fast pace.
+ * Polls must return a state set by the policy. Their duration is recorded as test properties,
+ * e.g. in the XML output, and does not decide whether the test passes: it depends on the load of
+ * the machine.
+ */
+TEST(StreamStateContention, pollWhileTransferring)
+{
+    static const auto benchDuration = std::chrono::milliseconds(500);
+    TransferringStream<StreamOut> playback(1, gOutFlagMask, AUDIO_DEVICE_OUT_SPEAKER,
+                                           std::string());
+    TransferringStream<StreamIn> capture(2, gInFlagMask, AUDIO_SOURCE_MIC,
+                                         AUDIO_DEVICE_IN_BUILTIN_MIC, std::string());
+    std::atomic<bool> stop(false);
+
+    std::thread playbackThread([&] {
+        while (!stop) {
+            playback.transfer();
+        }
+    });
+    std::thread captureThread([&] {
+        while (!stop) {
+            capture.transfer();
+        }
+    });
+    std::thread policyThread([&] {
+        for (uint32_t i = 0; !stop; i++) {
+            playback.setDevices(i % 2 ? AUDIO_DEVICE_OUT_SPEAKER : AUDIO_DEVICE_OUT_WIRED_HEADSET,
+                                i % 2 ? "" : "card=0;device=0");
+            capture.setDevices(AUDIO_DEVICE_IN_BUILTIN_MIC, i % 2 ? "" : "bottom");
+            capture.setUseCaseMask(i % 2 ? 0 : gUseCaseMask);
+            playback.setStarted(i % 2);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        // Destroyed in standby, not to stop through the parent device
+        playback.setStarted(false);
+    });
+
+    Clock::duration longestPoll(0);
+    Clock::duration totalPoll(0);
+    uint32_t polls = 0;
+    uint32_t blockedPolls = 0;
+    uint32_t inconsistentPolls = 0;
+    uint32_t startedPolls = 0;
+    Clock::time_point end = Clock::now() + benchDuration;
+    while (Clock::now() < end) {
+        Clock::time_point before = Clock::now();
+        bool isPlaybackConsistent = pollState(playback, startedPolls);
+        bool isCaptureConsistent = pollState(capture, startedPolls);
+        Clock::duration poll = Clock::now() - before;
+        longestPoll = std::max(longestPoll, poll);
+        totalPoll += poll;
+        polls++;
+        if (poll > gBlockedPollDuration) {
+            blockedPolls++;
+        }
+        if (!isPlaybackConsistent || !isCaptureConsistent) {
+            inconsistentPolls++;
+        }
+    }
+    stop = true;
+    playbackThread.join();
+    captureThread.join();
+    policyThread.join();
+
+    EXPECT_EQ(0u, inconsistentPolls);
+    ASSERT_NE(0u, polls);
+    ::testing::Test::RecordProperty("polls", static_cast<int>(polls));
+    ::testing::Test::RecordProperty("startedPolls", static_cast<int>(startedPolls));
+    ::testing::Test::RecordProperty(
+        "averagePollNs",
+        static_cast<int>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(totalPoll).count() / polls));
+    ::testing::Test::RecordProperty(
+        "longestPollUs",
+        static_cast<int>(
+            std::chrono::duration_cast<std::chrono::microseconds>(longestPoll).count()));
+    ::testing::Test::RecordProperty("blockedPolls", static_cast<int>(blockedPolls));
+}
+
+} // namespace intel_audio
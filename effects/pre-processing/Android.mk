@@ -126,6 +126,31 @@ include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
 include $(BUILD_HOST_STATIC_LIBRARY)
 endif
 
+# Component unit tests (using fake audio parameters)
+#######################################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    src/AudioEffect.cpp \
+    test/AudioEffectTest.cpp
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/test/fake \
+    $(LOCAL_PATH)/src \
+    $(effect_pre_proc_includes_dir_target) \
+    $(effect_pre_proc_includes_common)
+LOCAL_STATIC_LIBRARIES := \
+    $(effect_pre_proc_static_lib_target) \
+    liblog
+LOCAL_SHARED_LIBRARIES := libcutils libutils
+LOCAL_MODULE := audio_effects_unit_test
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Werror -Wextra -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+include $(BUILD_NATIVE_TEST)
+
 # Component functional test
 #######################################################################
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2015 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -23,9 +23,10 @@
 #include <utilities/Log.hpp>
 #include <convert.hpp>
 #include <parameters/AudioParameters.hpp>
+#include <algorithm>
+#include <stdio.h>
 
 using android::status_t;
-using android::String8;
 using android::NO_ERROR;
 using audio_comms::utilities::convertTo;
 using audio_comms::utilities::Log;
@@ -102,107 +103,301 @@ int AudioEffect::getParamId(const effect_param_t *param, int32_t &paramId) const
     return 0;
 }
 
-int AudioEffect::formatParamKey(const effect_param_t *param, android::String8 &key) const
+size_t AudioEffect::getValueSize(ParameterType type)
 {
+    switch (type) {
+    case Int8Parameter:
+        return sizeof(int8_t);
+    case Int16Parameter:
+        return sizeof(int16_t);
+    case Int32Parameter:
+        return sizeof(int32_t);
+    }
+    AUDIOCOMMS_ASSERT(false, "Invalid parameter type");
+    return 0;
+}
+
+void AudioEffect::registerParameter(int32_t paramId, ParameterType type, uint32_t arrayLength)
+{
+    insertParameter(paramId, type, arrayLength);
+}
+
+AudioEffect::Parameter *AudioEffect::insertParameter(int32_t paramId, ParameterType type,
+                                                     uint32_t arrayLength) const
+{
+    AUDIOCOMMS_ASSERT(arrayLength > 0, "Invalid parameter array length");
+    std::vector<Parameter>::iterator it =
+        std::lower_bound(mParameters.begin(), mParameters.end(), paramId,
+                         [](const Parameter &parameter, int32_t id) { return parameter.id < id; });
+    AUDIOCOMMS_ASSERT(it == mParameters.end() || it->id != paramId,
+                      "Parameter registered twice");
+
     /**
-     * Retrieve the parameter(s) - Only supports a single paramId at the moment.
-     * @todo: supports of multiple paramId.
+     * Format the key once. key is made of <Name of the effect>-<paramId>
      */
+    char paramIdString[sizeof("-2147483648")];
+    snprintf(paramIdString, sizeof(paramIdString), "%d", paramId);
+
+    Parameter parameter;
+    parameter.id = paramId;
+    parameter.type = type;
+    parameter.arrayLength = arrayLength;
+    parameter.offset = mParameterValues.size();
+    parameter.valueCount = 0;
+    parameter.key = getDescriptor()->name + mParamKeyDelimiter + paramIdString;
+    parameter.isDirty = false;
+    mParameterValues.resize(parameter.offset + arrayLength, 0);
+    return &*mParameters.insert(it, parameter);
+}
+
+AudioEffect::Parameter *AudioEffect::getParameterEntry(const effect_param_t *param) const
+{
     int32_t paramId = 0;
     if (getParamId(param, paramId)) {
-        return -EINVAL;
+        return NULL;
+    }
+    std::vector<Parameter>::iterator it =
+        std::lower_bound(mParameters.begin(), mParameters.end(), paramId,
+                         [](const Parameter &parameter, int32_t id) { return parameter.id < id; });
+    if (it != mParameters.end() && it->id == paramId) {
+        return &*it;
+    }
+    if (param->vsize == 0) {
+        return NULL;
     }
+    // Not registered by the effect: values are deduced from the size
+    if (param->vsize % sizeof(int32_t) == 0) {
+        return insertParameter(paramId, Int32Parameter, param->vsize / sizeof(int32_t));
+    }
+    if (param->vsize % sizeof(int16_t) == 0) {
+        return insertParameter(paramId, Int16Parameter, param->vsize / sizeof(int16_t));
+    }
+    return insertParameter(paramId, Int8Parameter, param->vsize);
+}
 
-    /**
-     * Format the key. key is made of <Name of the effect>-<paramId>
-     */
-    std::ostringstream ostr;
-    ostr << paramId;
-    key = String8(std::string(getDescriptor()->name + mParamKeyDelimiter + ostr.str()).c_str());
+/**
+ * @return size in bytes of the values held by the effect parameter structure. Single values
+ *         may be given as int16_t or int32_t whatever the type of the parameter, as accepted
+ *         before parameters were typed.
+ */
+static size_t getParamValueSize(const effect_param_t *param, size_t valueSize,
+                                uint32_t arrayLength)
+{
+    if (arrayLength == 1 &&
+        (param->vsize == sizeof(int16_t) || param->vsize == sizeof(int32_t))) {
+        return param->vsize;
+    }
+    return valueSize;
+}
+
+/**
+ * @return number of values held by the effect parameter structure for the parameter, 0 if its
+ *         value size does not match.
+ */
+static uint32_t getValueCount(const effect_param_t *param, size_t valueSize,
+                              uint32_t arrayLength)
+{
+    if (param->vsize == 0 || param->vsize % valueSize != 0 ||
+        param->vsize / valueSize > arrayLength) {
+        return 0;
+    }
+    return param->vsize / valueSize;
+}
+
+/**
+ * The start of value field inside the data field is always on a 32 bit boundary.
+ * cf to audio_effect.h for the structure of the effect_param_t structure.
+ */
+static size_t getValueOffset(const effect_param_t *param)
+{
+    return ((param->psize - 1) / sizeof(uint32_t) + 1) * sizeof(uint32_t);
+}
+
+static int32_t readValue(const char *pValue, size_t valueSize)
+{
+    switch (valueSize) {
+    case sizeof(int8_t):
+        return *reinterpret_cast<const int8_t *>(pValue);
+    case sizeof(int16_t):
+        return *reinterpret_cast<const int16_t *>(pValue);
+    default:
+        return *reinterpret_cast<const int32_t *>(pValue);
+    }
+}
+
+static void writeValue(char *pValue, size_t valueSize, int32_t value)
+{
+    switch (valueSize) {
+    case sizeof(int8_t):
+        *reinterpret_cast<int8_t *>(pValue) = value;
+        break;
+    case sizeof(int16_t):
+        *reinterpret_cast<int16_t *>(pValue) = value;
+        break;
+    default:
+        *reinterpret_cast<int32_t *>(pValue) = value;
+        break;
+    }
+}
+
+int AudioEffect::storeParameter(const effect_param_t *param, Parameter *&parameter)
+{
+    parameter = getParameterEntry(param);
+    if (parameter == NULL) {
+        return -EINVAL;
+    }
+    size_t valueSize = getParamValueSize(param, getValueSize(parameter->type),
+                                         parameter->arrayLength);
+    uint32_t valueCount = getValueCount(param, valueSize, parameter->arrayLength);
+    if (valueCount == 0) {
+        Log::Verbose() << __FUNCTION__ << ": effect " << getDescriptor()->name
+                       << ", invalid value size " << param->vsize << " for key "
+                       << parameter->key;
+        return -EINVAL;
+    }
+    const char *pValue = param->data + getValueOffset(param);
+    int32_t *values = &mParameterValues[parameter->offset];
+    for (uint32_t i = 0; i < valueCount; i++) {
+        values[i] = readValue(pValue + i * valueSize, valueSize);
+    }
+    parameter->valueCount = valueCount;
+    parameter->isDirty = true;
     return 0;
 }
 
+std::string AudioEffect::formatArray(const int32_t *values, uint32_t valueCount)
+{
+    std::string arrayValue = "[";
+    for (uint32_t i = 0; i < valueCount; i++) {
+        char value[sizeof(",-2147483648")];
+        snprintf(value, sizeof(value), i == 0 ? "%d" : ",%d", values[i]);
+        arrayValue += value;
+    }
+    arrayValue += "]";
+    return arrayValue;
+}
+
+bool AudioEffect::parseArray(const std::string &arrayValue, uint32_t maxValueCount,
+                             std::vector<int32_t> &values)
+{
+    if (arrayValue.size() < 2 || arrayValue[0] != '[' ||
+        arrayValue[arrayValue.size() - 1] != ']') {
+        return false;
+    }
+    values.clear();
+    size_t start = 1;
+    while (start < arrayValue.size() - 1 && values.size() < maxValueCount) {
+        size_t end = arrayValue.find(',', start);
+        if (end == std::string::npos) {
+            end = arrayValue.size() - 1;
+        }
+        int32_t value;
+        if (!convertTo(arrayValue.substr(start, end - start), value)) {
+            return false;
+        }
+        values.push_back(value);
+        start = end + 1;
+    }
+    return true;
+}
+
+void AudioEffect::applyParameter(Parameter &parameter)
+{
+    Log::Verbose() << __FUNCTION__
+                   << ": effect " << getDescriptor()->name << " key " << parameter.key;
+    const int32_t *values = &mParameterValues[parameter.offset];
+    if (parameter.arrayLength == 1) {
+        audio_comms::utilities::AudioParameters::set(parameter.key.c_str(), values[0]);
+    } else {
+        // Array of values formatted as [<value[0]>,<value[1]>, ...]
+        audio_comms::utilities::AudioParameters::set(parameter.key.c_str(),
+                                                     formatArray(values, parameter.valueCount));
+    }
+    parameter.isDirty = false;
+}
+
+bool AudioEffect::readParameter(const Parameter &parameter, std::vector<int32_t> &values) const
+{
+    std::string value;
+    if (!audio_comms::utilities::AudioParameters::get(parameter.key.c_str(), value)) {
+        return false;
+    }
+    if (parameter.arrayLength == 1) {
+        values.resize(1);
+        return convertTo(value, values[0]);
+    }
+    return parseArray(value, parameter.arrayLength, values);
+}
+
 int AudioEffect::setParameter(const effect_param_t *param)
 {
-    // Format a key from the effect param structure.
-    String8 key;
-    int ret = formatParamKey(param, key);
+    Parameter *parameter;
+    int ret = storeParameter(param, parameter);
     if (ret) {
         return ret;
     }
-    Log::Verbose() << __FUNCTION__
-                   << ": effect " << getDescriptor()->name << " key " << key.string();
-
-    /**
-     * Retrieve the value(s) - Only supports a single value at the moment.
-     * @todo: supports of multiple values.
-     */
-    uint32_t paramSizeWithPadding =
-        ((param->psize - 1) / sizeof(uint32_t) + 1) * sizeof(uint32_t);
+    applyParameter(*parameter);
+    return 0;
+}
 
-    const int32_t *pValue =  reinterpret_cast<const int32_t *>(param->data + paramSizeWithPadding);
+int AudioEffect::setParameterDeferred(const effect_param_t *param)
+{
+    Parameter *parameter;
+    return storeParameter(param, parameter);
+}
 
-    int32_t value;
-    if (param->vsize == sizeof(int16_t)) {
-        value = *reinterpret_cast<const int16_t *>(pValue);
-    } else if (param->vsize == sizeof(int32_t)) {
-        value = *reinterpret_cast<const int32_t *>(pValue);
-    } else {
-        Log::Verbose() << __FUNCTION__
-                       << ": effect" << getDescriptor()->name << ", only single value supported";
-        // @todo: Manage array of value by formatting a string with [<value[0]>,<value[1]>, ...].
-        return -EINVAL;
+int AudioEffect::commitParameters()
+{
+    // Parameters set several times since last commit are applied once, with their last values
+    for (std::vector<Parameter>::iterator it = mParameters.begin(); it != mParameters.end();
+         ++it) {
+        if (it->isDirty) {
+            applyParameter(*it);
+        }
     }
-
-    audio_comms::utilities::AudioParameters::set(key.c_str(), value);
     return 0;
 }
 
 int AudioEffect::getParameter(effect_param_t *param) const
 {
-    // Format a key from the effect param structure.
-    String8 key;
-    int ret = formatParamKey(param, key);
-    if (ret) {
-        return ret;
+    const Parameter *parameter = getParameterEntry(param);
+    if (parameter == NULL) {
+        return -EINVAL;
     }
     Log::Verbose() << __FUNCTION__
-                   << ":  effect " << getDescriptor()->name << " key " << key.string();
+                   << ":  effect " << getDescriptor()->name << " key " << parameter->key;
 
-    std::string value;
-    bool result = audio_comms::utilities::AudioParameters::get(key.c_str(), value);
-
-    if (!result) {
+    size_t valueSize = getParamValueSize(param, getValueSize(parameter->type),
+                                         parameter->arrayLength);
+    uint32_t valueCount = getValueCount(param, valueSize, parameter->arrayLength);
+    if (valueCount == 0) {
+        Log::Error() << __FUNCTION__
+                     << ": effect = " << getDescriptor()->name << ", invalid value size "
+                     << param->vsize;
+        return -EINVAL;
+    }
+    // Values are read back from the platform, as its configuration may have been reapplied
+    // since the effect set them.
+    std::vector<int32_t> values;
+    if (!readParameter(*parameter, values)) {
         Log::Error() << __FUNCTION__
                      << ": effect " << getDescriptor()->name << ", could not get the read value";
         return -EINVAL;
     }
-    int32_t *pValue = reinterpret_cast<int32_t *>(param->data + param->psize);
-    if (param->vsize == sizeof(int16_t)) {
-        if (!convertTo(value,
-                       *reinterpret_cast<int16_t *>(pValue))) {
-            Log::Error() << __FUNCTION__
-                         << ": effect " << getDescriptor()->name
-                         << ", could not get the read value as int16_t";
-            return -EINVAL;
-        }
-    } else if (param->vsize == sizeof(int32_t)) {
-        if (!convertTo(value, *pValue)) {
-            Log::Error() << __FUNCTION__
-                         << ": effect " << getDescriptor()->name
-                         << ", could not get the read value as int32_t";
-            return -EINVAL;
-        }
-    } else {
+    if (valueCount > values.size()) {
         Log::Error() << __FUNCTION__
-                     << ": effect = " << getDescriptor()->name << ", only single value supported";
-        // @todo: Manage array of value by formatting a string with [<value[0]>,<value[1]>, ...].
+                     << ": effect " << getDescriptor()->name << ", " << valueCount
+                     << " values requested, " << values.size() << " available";
         return -EINVAL;
     }
+    char *pValue = param->data + getValueOffset(param);
+    for (uint32_t i = 0; i < valueCount; i++) {
+        writeValue(pValue + i * valueSize, valueSize, values[i]);
+    }
     return 0;
 }
 
-int AudioEffect::setDevice(uint32_t device)
+int AudioEffect::setDevice(uint32_t /*device*/)
 {
     Log::Verbose() << __FUNCTION__ << ": NOP";
     return 0;
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -17,11 +17,37 @@
 
 #include <hardware/audio_effect.h>
 #include <AudioNonCopyable.hpp>
-#include <utils/String8.h>
+#include <utils/Errors.h>
+#include <string.h>
 #include <string>
+#include <vector>
 
 class AudioEffectSession;
 
+/**
+ * Hash of an effect UUID, to index effects in unordered containers.
+ */
+struct EffectUuidHash
+{
+    size_t operator()(const effect_uuid_t &uuid) const
+    {
+        size_t hash = uuid.timeLow ^ (uuid.timeMid << 16) ^ uuid.timeHiAndVersion ^
+                      (uuid.clockSeq << 16);
+        for (size_t i = 0; i < sizeof(uuid.node); i++) {
+            hash = hash * 31 + uuid.node[i];
+        }
+        return hash;
+    }
+};
+
+struct EffectUuidEqual
+{
+    bool operator()(const effect_uuid_t &uuid1, const effect_uuid_t &uuid2) const
+    {
+        return memcmp(&uuid1, &uuid2, sizeof(effect_uuid_t)) == 0;
+    }
+};
+
 class AudioEffect : private audio_comms::utilities::NonCopyable
 {
 public:
@@ -71,6 +97,23 @@ public:
      */
     virtual int setParameter(const effect_param_t *param);
 
+    /**
+     * Set Parameter to the effect, without applying it until the parameters are committed.
+     * Allows to apply several parameters at once, e.g. AGC and NS tuning during calls.
+     *
+     * @param[in] param parameter effect structure
+     *
+     * @return 0 if success, error code otherwise.
+     */
+    int setParameterDeferred(const effect_param_t *param);
+
+    /**
+     * Apply the parameters set since last commit, in a single pass.
+     *
+     * @return 0 if success, error code otherwise.
+     */
+    int commitParameters();
+
     /**
      * Get the effect parameter.
      *
@@ -126,7 +169,66 @@ public:
      */
     effect_handle_t getHandle() { return (effect_handle_t)(&mItfe); }
 
+    /**
+     * Format an array of values as applied to the platform, i.e. [<value[0]>,<value[1]>, ...]
+     *
+     * @param[in] values to format.
+     * @param[in] valueCount number of values.
+     *
+     * @return formatted array.
+     */
+    static std::string formatArray(const int32_t *values, uint32_t valueCount);
+
+    /**
+     * Parse an array of values formatted as applied to the platform.
+     *
+     * @param[in] arrayValue formatted array.
+     * @param[in] maxValueCount maximum number of values parsed, further values being ignored.
+     * @param[out] values parsed, valid only if returning true.
+     *
+     * @return true if parsed, false if the array is malformed.
+     */
+    static bool parseArray(const std::string &arrayValue, uint32_t maxValueCount,
+                           std::vector<int32_t> &values);
+
+protected:
+    /** Type of the values of a parameter, as found in the value field of effect_param_t. */
+    enum ParameterType
+    {
+        Int8Parameter, /**< bool values. */
+        Int16Parameter,
+        Int32Parameter
+    };
+
+    /**
+     * Register a parameter of the effect, to be called by the effect constructor.
+     * A parameter not registered is registered upon first access, its type and array length
+     * being deduced from the value size.
+     *
+     * @param[in] paramId identifier of the parameter.
+     * @param[in] type of the values.
+     * @param[in] arrayLength maximum number of values of the parameter.
+     */
+    void registerParameter(int32_t paramId, ParameterType type, uint32_t arrayLength = 1);
+
 private:
+    /** Entry of the parameter table of the effect, sorted by paramId. */
+    struct Parameter
+    {
+        int32_t id;
+        ParameterType type;
+        uint32_t arrayLength;
+        size_t offset; /**< Index of the first value in mParameterValues. */
+        uint32_t valueCount; /**< Values set, lower or equal to array length. */
+
+        /**
+         * AudioParameter key of the parameter, formatted upon registration as:
+         *      <human readable type name>-<paramId>
+         */
+        std::string key;
+        bool isDirty; /**< Values set since last commit, not applied yet. */
+    };
+
     /**
      * Extract from the effect_param_t structure the parameter Id.
      * It supports only single parameter. If more than one paramId is found in the structure,
@@ -140,15 +242,56 @@ private:
     int getParamId(const effect_param_t *param, int32_t &paramId) const;
 
     /**
-     * Format the Parameter key from the effect parameter structure.
-     * The followed formalism is:
-     *      <human readable type name>-<paramId>[-<subParamId1>-<subParamId2>-...]
+     * Find the parameter addressed by the effect parameter structure, registering it if not
+     * registered yet.
+     *
+     * @param[in] param: Effect Parameter structure
+     *
+     * @return parameter if found or registered, NULL if the structure is not supported.
+     */
+    Parameter *getParameterEntry(const effect_param_t *param) const;
+
+    /**
+     * Insert a parameter into the table, with its values.
+     *
+     * @return parameter inserted.
+     */
+    Parameter *insertParameter(int32_t paramId, ParameterType type, uint32_t arrayLength) const;
+
+    /**
+     * Decode the values of the effect parameter structure into the parameter table, marking
+     * the parameter dirty until applied.
      *
      * @param[in] param: Effect Parameter structure
+     * @param[out] parameter entry of the table updated.
+     *
+     * @return 0 if success, error code otherwise.
+     */
+    int storeParameter(const effect_param_t *param, Parameter *&parameter);
+
+    /** Apply the values of a parameter of the table to the platform. */
+    void applyParameter(Parameter &parameter);
+
+    /**
+     * Read back the values of a parameter from the platform. The parameter table is left
+     * untouched, as it may hold values not committed yet.
      *
-     * @return valid AudioParameter key if success, empty key if failure.
+     * @param[in] parameter entry of the table to read.
+     * @param[out] values read, valid only if returning true.
+     *
+     * @return true if read, false otherwise.
+     */
+    bool readParameter(const Parameter &parameter, std::vector<int32_t> &values) const;
+
+    /** @return size in bytes of a value of the given type. */
+    static size_t getValueSize(ParameterType type);
+
+    /**
+     * Parameter table, small and sorted by paramId. Mutable as reading a parameter may register
+     * it.
      */
-    int formatParamKey(const effect_param_t *param, android::String8 &key) const;
+    mutable std::vector<Parameter> mParameters;
+    mutable std::vector<int32_t> mParameterValues; /**< Values of all the parameters. */
 
     /**
      * Effect Descriptor structure.
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2015 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -23,8 +23,6 @@
 #include <audio_effects/effect_agc.h>
 #include <AudioCommsAssert.hpp>
 #include <utilities/Log.hpp>
-#include <functional>
-#include <algorithm>
 
 using android::status_t;
 using android::OK;
@@ -53,17 +51,15 @@ status_t AudioEffectSession::addEffect(AudioEffect *effect)
 {
     AUDIOCOMMS_ASSERT(effect != NULL, "trying to add null Effect");
     effect->setSession(this);
-    mEffectsList.push_back(effect);
+    mEffectsByUuid[*effect->getUuid()] = effect;
     return OK;
 }
 
-AudioEffect *AudioEffectSession::findEffectByUuid(const effect_uuid_t *uuid)
+AudioEffect *AudioEffectSession::findEffectByUuid(const effect_uuid_t *uuid) const
 {
     AUDIOCOMMS_ASSERT(uuid != NULL, "Invalid UUID");
-    EffectListIterator it;
-    it = std::find_if(mEffectsList.begin(), mEffectsList.end(), std::bind2nd(MatchUuid(), uuid));
-
-    return (it != mEffectsList.end()) ? *it : NULL;
+    EffectUuidMap::const_iterator it = mEffectsByUuid.find(*uuid);
+    return (it != mEffectsByUuid.end()) ? it->second : NULL;
 }
 
 status_t AudioEffectSession::createEffect(const effect_uuid_t *uuid, effect_handle_t *interface)
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -19,6 +19,7 @@
 #include <hardware/audio_effect.h>
 #include <AudioNonCopyable.hpp>
 #include <list>
+#include <unordered_map>
 #include <utils/Errors.h>
 
 class AudioEffect;
@@ -28,6 +29,8 @@ class AudioEffectSession : private audio_comms::utilities::NonCopyable
 private:
     typedef std::list<AudioEffect *>::iterator EffectListIterator;
     typedef std::list<AudioEffect *>::const_iterator EffectListConstIterator;
+    typedef std::unordered_map<effect_uuid_t, AudioEffect *,
+                               EffectUuidHash, EffectUuidEqual> EffectUuidMap;
 
 public:
     AudioEffectSession(uint32_t sessionId);
@@ -86,18 +89,6 @@ public:
     static const int mSessionNone = -1; /**< No session tag. */
 
 private:
-    /**
-     * Function to be used as the predicate in find_if call.
-     */
-    struct MatchUuid : public std::binary_function<AudioEffect *, const effect_uuid_t *, bool>
-    {
-
-        bool operator()(const AudioEffect *effect,
-                        const effect_uuid_t *uuid) const
-        {
-            return memcmp(effect->getUuid(), uuid, sizeof(effect_uuid_t)) == 0;
-        }
-    };
     /**
      * Initialise the effect session.
      * It resets the io handle attached to it and the audio source.
@@ -111,7 +102,7 @@ private:
      *
      * @return valid effect pointer if found, NULL otherwise.
      */
-    AudioEffect *findEffectByUuid(const effect_uuid_t *uuid);
+    AudioEffect *findEffectByUuid(const effect_uuid_t *uuid) const;
 
     int mIoHandle; /**< handle of input stream this session is linked to. */
     uint32_t mId; /**< Id of the sessions.*/
@@ -119,6 +110,6 @@ private:
 
     std::list<AudioEffect *> mEffectsCreatedList; /**< created pre processors. */
     std::list<AudioEffect *> mEffectsActiveList; /**< active pre processors - for later use?. */
-    std::list<AudioEffect *> mEffectsList; /**< Effects in the sessions. */
+    EffectUuidMap mEffectsByUuid; /**< Effects in the sessions, indexed by UUID. */
 
 };
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -22,6 +22,7 @@
 AecAudioEffect::AecAudioEffect(const effect_interface_s *itfe)
     : AudioEffect(itfe, &mAecDescriptor)
 {
+    registerParameter(AEC_PARAM_ECHO_DELAY, Int32Parameter);
 }
 
 const effect_descriptor_t AecAudioEffect::mAecDescriptor = {
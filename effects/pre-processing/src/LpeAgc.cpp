@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -22,7 +22,9 @@
 AgcAudioEffect::AgcAudioEffect(const effect_interface_s *itfe)
     : AudioEffect(itfe, &mAgcDescriptor)
 {
-
+    registerParameter(AGC_PARAM_TARGET_LEVEL, Int16Parameter);
+    registerParameter(AGC_PARAM_COMP_GAIN, Int16Parameter);
+    registerParameter(AGC_PARAM_LIMITER_ENA, Int8Parameter);
 }
 
 const effect_descriptor_t AgcAudioEffect::mAgcDescriptor = {
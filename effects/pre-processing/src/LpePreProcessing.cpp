@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2015 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -26,8 +26,6 @@
 #include <utils/Errors.h>
 #include <utilities/Log.hpp>
 #include <fcntl.h>
-#include <functional>
-#include <algorithm>
 
 using android::status_t;
 using android::OK;
@@ -147,6 +145,25 @@ int LpePreProcessing::intelLpeFxCommand(effect_handle_t interface,
         break;
     }
 
+    case EFFECT_CMD_SET_PARAM_DEFERRED: {
+        if (cmdData == NULL ||
+            cmdSize < static_cast<int>(sizeof(effect_param_t))) {
+            Log::Verbose() << __FUNCTION__ << ": EFFECT_CMD_SET_PARAM_DEFERRED: ERROR";
+            return -EINVAL;
+        }
+        effect->setParameterDeferred(static_cast<effect_param_t *>(cmdData));
+        break;
+    }
+
+    case EFFECT_CMD_SET_PARAM_COMMIT:
+        if (replyData == NULL || *replySize != sizeof(int32_t)) {
+            Log::Verbose() << __FUNCTION__ << ": EFFECT_CMD_SET_PARAM_COMMIT: ERROR";
+            return -EINVAL;
+        }
+        // Parameters deferred are applied at once
+        *static_cast<int *>(replyData) = effect->commitParameters();
+        break;
+
     case EFFECT_CMD_ENABLE:
         if (replyData == NULL || *replySize != sizeof(int)) {
             Log::Verbose() << __FUNCTION__ << ": EFFECT_CMD_ENABLE: ERROR";
@@ -245,7 +262,7 @@ status_t LpePreProcessing::createEffect(const effect_uuid_t *uuid,
         Log::Error() << __FUNCTION__ << ": invalue interface and/or uuid";
         return BAD_VALUE;
     }
-    Mutex::Locker Locker(mLpeEffectsLock);
+    Mutex::Locker Locker(mEffectSessionsLock);
     AudioEffectSession *session = getSession(ioId);
     if (session == NULL) {
         Log::Error() << __FUNCTION__
@@ -262,7 +279,6 @@ status_t LpePreProcessing::createEffect(const effect_uuid_t *uuid,
 status_t LpePreProcessing::releaseEffect(effect_handle_t interface)
 {
     Log::Debug() << __FUNCTION__;
-    Mutex::Locker Locker(mLpeEffectsLock);
     AudioEffect *effect = findEffectByInterface(interface);
     if (effect == NULL) {
         Log::Error() << __FUNCTION__ << ": could not find effect for requested interface";
@@ -273,7 +289,17 @@ status_t LpePreProcessing::releaseEffect(effect_handle_t interface)
         Log::Error() << __FUNCTION__ << ": no session for effect";
         return BAD_VALUE;
     }
-    return session->removeEffect(effect);
+    Mutex::Locker Locker(mEffectSessionsLock);
+    int ioId = session->getIoHandle();
+    status_t status = session->removeEffect(effect);
+
+    // Session detached from its input stream once its last effect is removed
+    if (session->getIoHandle() == AudioEffectSession::mSessionNone &&
+        ioId != AudioEffectSession::mSessionNone) {
+        mEffectSessionsByIoHandle.erase(ioId);
+        mFreeEffectSessions.push_back(session);
+    }
+    return status;
 }
 
 status_t LpePreProcessing::init()
@@ -283,105 +309,53 @@ status_t LpePreProcessing::init()
         AudioEffectSession *effectSession = new AudioEffectSession(i);
 
         // Each session has an instance of effects provided by LPE
-        AgcAudioEffect *agc = new AgcAudioEffect(&mEffectInterface);
-        mEffectsList.push_back(agc);
-        effectSession->addEffect(agc);
-        NsAudioEffect *ns = new NsAudioEffect(&mEffectInterface);
-        mEffectsList.push_back(ns);
-        effectSession->addEffect(ns);
-        AecAudioEffect *aec = new AecAudioEffect(&mEffectInterface);
-        mEffectsList.push_back(aec);
-        effectSession->addEffect(aec);
-        BmfAudioEffect *bmf = new BmfAudioEffect(&mEffectInterface);
-        mEffectsList.push_back(bmf);
-        effectSession->addEffect(bmf);
-        WnrAudioEffect *wnr = new WnrAudioEffect(&mEffectInterface);
-        mEffectsList.push_back(wnr);
-        effectSession->addEffect(wnr);
-
-        mEffectSessionsList.push_back(effectSession);
+        addEffect(effectSession, new AgcAudioEffect(&mEffectInterface));
+        addEffect(effectSession, new NsAudioEffect(&mEffectInterface));
+        addEffect(effectSession, new AecAudioEffect(&mEffectInterface));
+        addEffect(effectSession, new BmfAudioEffect(&mEffectInterface));
+        addEffect(effectSession, new WnrAudioEffect(&mEffectInterface));
+
+        mFreeEffectSessions.push_back(effectSession);
     }
     return OK;
 }
 
-// Function to be used as the predicate in find_if call.
-struct MatchUuid : public std::binary_function<AudioEffect *, const effect_uuid_t *, bool>
+void LpePreProcessing::addEffect(AudioEffectSession *effectSession, AudioEffect *effect)
 {
-
-    bool operator()(const AudioEffect *effect,
-                    const effect_uuid_t *uuid) const
-    {
-
-        return memcmp(effect->getUuid(), uuid, sizeof(effect_uuid_t)) == 0;
-    }
-};
-
-AudioEffect *LpePreProcessing::findEffectByUuid(const effect_uuid_t *uuid)
-{
-    EffectListIterator it;
-    it = std::find_if(mEffectsList.begin(), mEffectsList.end(), std::bind2nd(MatchUuid(), uuid));
-
-    return (it != mEffectsList.end()) ? *it : NULL;
+    mEffectsByInterface[effect->getHandle()] = effect;
+    // Keeps the first instance, descriptors being the same for all sessions
+    mEffectsByUuid.insert(std::make_pair(*effect->getUuid(), effect));
+    effectSession->addEffect(effect);
 }
 
-/**
- * Function to be used as the predicate in find_if call.
- */
-struct MatchInterface : public std::binary_function<AudioEffect *, const effect_handle_t, bool>
-{
-
-    bool operator()(AudioEffect *effect,
-                    const effect_handle_t interface) const
-    {
-
-        return effect->getHandle() == interface;
-    }
-};
-
-AudioEffect *LpePreProcessing::findEffectByInterface(const effect_handle_t interface)
+AudioEffect *LpePreProcessing::findEffectByUuid(const effect_uuid_t *uuid) const
 {
-    EffectListIterator it;
-    it = std::find_if(mEffectsList.begin(), mEffectsList.end(),
-                      std::bind2nd(MatchInterface(), interface));
-
-    return (it != mEffectsList.end()) ? *it : NULL;
+    EffectUuidMap::const_iterator it = mEffectsByUuid.find(*uuid);
+    return (it != mEffectsByUuid.end()) ? it->second : NULL;
 }
 
-/**
- * Function to be used as the predicate in find_if call.
- */
-struct MatchSession : public std::binary_function<AudioEffectSession *, int, bool>
+AudioEffect *LpePreProcessing::findEffectByInterface(const effect_handle_t interface) const
 {
-
-    bool operator()(const AudioEffectSession *effectSession,
-                    int ioId) const
-    {
-        return effectSession->getIoHandle() == ioId;
-    }
-};
-
-AudioEffectSession *LpePreProcessing::findSession(int ioId)
-{
-    EffectSessionListIterator it;
-    it = std::find_if(mEffectSessionsList.begin(), mEffectSessionsList.end(),
-                      std::bind2nd(MatchSession(), ioId));
-
-    return (it != mEffectSessionsList.end()) ? *it : NULL;
+    EffectInterfaceMap::const_iterator it = mEffectsByInterface.find(interface);
+    return (it != mEffectsByInterface.end()) ? it->second : NULL;
 }
 
 AudioEffectSession *LpePreProcessing::getSession(uint32_t ioId)
 {
-    AudioEffectSession *session = findSession(ioId);
-    if (session == NULL) {
-        Log::Debug() << __FUNCTION__
-                     << ": no session assigned for io=" << ioId
-                     << ", try to get one...";
-        session = findSession(AudioEffectSession::mSessionNone);
-        if (session != NULL) {
-
-            session->setIoHandle(ioId);
-        }
+    EffectSessionMap::const_iterator it = mEffectSessionsByIoHandle.find(ioId);
+    if (it != mEffectSessionsByIoHandle.end()) {
+        return it->second;
+    }
+    Log::Debug() << __FUNCTION__
+                 << ": no session assigned for io=" << ioId
+                 << ", try to get one...";
+    if (mFreeEffectSessions.empty()) {
+        return NULL;
     }
+    AudioEffectSession *session = mFreeEffectSessions.front();
+    mFreeEffectSessions.pop_front();
+    session->setIoHandle(ioId);
+    mEffectSessionsByIoHandle[ioId] = session;
     return session;
 }
 
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2016 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -16,22 +16,24 @@
 
 #pragma once
 
+#include "AudioEffect.hpp"
 #include <hardware/audio_effect.h>
 #include <AudioNonCopyable.hpp>
 #include <list>
+#include <map>
+#include <unordered_map>
 #include <utils/Errors.h>
 #include <Mutex.hpp>
 
-class AudioEffect;
 class AudioEffectSession;
 
 class LpePreProcessing : private audio_comms::utilities::NonCopyable
 {
 private:
-    typedef std::list<AudioEffect *>::iterator EffectListIterator;
-    typedef std::list<AudioEffect *>::const_iterator EffectListConstIterator;
-    typedef std::list<AudioEffectSession *>::iterator EffectSessionListIterator;
-    typedef std::list<AudioEffectSession *>::const_iterator EffectSessionListConstIterator;
+    typedef std::unordered_map<effect_handle_t, AudioEffect *> EffectInterfaceMap;
+    typedef std::unordered_map<effect_uuid_t, AudioEffect *,
+                               EffectUuidHash, EffectUuidEqual> EffectUuidMap;
+    typedef std::map<int, AudioEffectSession *> EffectSessionMap;
 
 public:
     LpePreProcessing();
@@ -104,25 +106,24 @@ private:
      *
      * @return AudioEffect instance if interface is valid, NULL otherwise
      */
-    AudioEffect *findEffectByUuid(const effect_uuid_t *uuid);
+    AudioEffect *findEffectByUuid(const effect_uuid_t *uuid) const;
 
     /**
-     * Retrieve the AudioEffect instance from the handle.
-     *
-     * @param[in] interface handle on the audio effect.
+     * Add an effect to a session and index it.
      *
-     * @return AudioEffect instance if interface is valid, NULL otherwise
+     * @param[in] effectSession session of the effect.
+     * @param[in] effect Audio Effect to add.
      */
-    AudioEffect *findEffectByInterface(const effect_handle_t interface);
+    void addEffect(AudioEffectSession *effectSession, AudioEffect *effect);
 
     /**
-     * Return the session object for the request Id and IO handle Id
+     * Retrieve the AudioEffect instance from the handle.
      *
-     * @param[in] ioId Id of the input stream
+     * @param[in] interface handle on the audio effect.
      *
-     * @return AudioEffectSession handle
+     * @return AudioEffect instance if interface is valid, NULL otherwise
      */
-    AudioEffectSession *findSession(int ioId);
+    AudioEffect *findEffectByInterface(const effect_handle_t interface) const;
 
     /**
      * Get a session for a ioHandle.
@@ -136,14 +137,27 @@ private:
     AudioEffectSession *getSession(uint32_t ioId);
 
     /**
-     * List of Audio Effects available on LPE
+     * Audio Effects available on LPE, indexed by their interface handle.
+     * Effects are all instantiated upon construction and never changed afterwards: effect
+     * commands look up this index without lock.
+     */
+    EffectInterfaceMap mEffectsByInterface;
+
+    /**
+     * Audio Effects available on LPE indexed by their UUID, i.e. an instance of each effect, to
+     * retrieve descriptors. Never changed after construction either.
+     */
+    EffectUuidMap mEffectsByUuid;
+
+    /**
+     * Audio Effect Sessions available on LPE attached to an input stream, indexed by IO handle.
      */
-    std::list<AudioEffect *> mEffectsList;
+    EffectSessionMap mEffectSessionsByIoHandle;
 
     /**
-     * List of Audio Effect Sessions available on LPE
+     * Audio Effect Sessions available on LPE not attached to any input stream.
      */
-    std::list<AudioEffectSession *> mEffectSessionsList;
+    std::list<AudioEffectSession *> mFreeEffectSessions;
 
     static const uint32_t mMaxEffectSessions = 8; /**< Max number of sessions for effect bundle. */
 
@@ -195,8 +209,8 @@ private:
     static const struct effect_interface_s mEffectInterface;
 
     /**
-     * Effects are handled in a separated thread, need to lock to protect concurrent
-     * access to the input stream.
+     * Effects are created and released from different threads, need to lock to protect the
+     * attachment of sessions to input streams. Effect commands do not take it.
      */
-    audio_comms::utilities::Mutex mLpeEffectsLock;
+    audio_comms::utilities::Mutex mEffectSessionsLock;
 };
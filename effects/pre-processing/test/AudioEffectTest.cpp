@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <AudioEffect.hpp>
+#include <parameters/AudioParameters.hpp>
+#include <gtest/gtest.h>
+#include <vector>
+
+using audio_comms::utilities::AudioParameters;
+
+static const effect_descriptor_t gDescriptor = {
+    {}, {}, EFFECT_CONTROL_API_VERSION, 0, 0, 0, "Fx", "Intel"
+};
+
+static const int32_t gLevelId = 1;
+static const int32_t gGainsId = 2;
+static const uint32_t gGainCount = 3;
+
+/** Effect registering an int16 single value and an int32 array. */
+class FakeEffect : public AudioEffect
+{
+public:
+    FakeEffect() : AudioEffect(NULL, &gDescriptor)
+    {
+        registerParameter(gLevelId, Int16Parameter);
+        registerParameter(gGainsId, Int32Parameter, gGainCount);
+    }
+};
+
+/** Effect parameter structure, with a single paramId and room for a few values. */
+class EffectParam
+{
+public:
+    EffectParam(int32_t paramId, uint32_t vsize) : mBuffer(sizeof(effect_param_t) / 4 + 8, 0)
+    {
+        get()->psize = sizeof(int32_t);
+        get()->vsize = vsize;
+        *reinterpret_cast<int32_t *>(get()->data) = paramId;
+    }
+
+    effect_param_t *get() { return reinterpret_cast<effect_param_t *>(mBuffer.data()); }
+
+    template <typename T>
+    T *values() { return reinterpret_cast<T *>(get()->data + sizeof(int32_t)); }
+
+private:
+    std::vector<uint32_t> mBuffer;
+};
+
+class AudioEffectTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        AudioParameters::getValues().clear();
+        AudioParameters::getSetCount() = 0;
+    }
+
+    FakeEffect mEffect;
+};
+
+TEST_F(AudioEffectTest, setAppliedEachTime)
+{
+    EffectParam param(gLevelId, sizeof(int16_t));
+    *param.values<int16_t>() = -7;
+    ASSERT_EQ(0, mEffect.setParameter(param.get()));
+    EXPECT_EQ("-7", AudioParameters::getValues()["Fx-1"]);
+
+    // Same value applied again, as the platform may have reapplied its configuration meanwhile
+    AudioParameters::getValues()["Fx-1"] = "3";
+    ASSERT_EQ(0, mEffect.setParameter(param.get()));
+    EXPECT_EQ("-7", AudioParameters::getValues()["Fx-1"]);
+    EXPECT_EQ(2u, AudioParameters::getSetCount());
+}
+
+TEST_F(AudioEffectTest, deferredAppliedOncePerCommit)
+{
+    EffectParam level(gLevelId, sizeof(int16_t));
+    *level.values<int16_t>() = 5;
+    ASSERT_EQ(0, mEffect.setParameterDeferred(level.get()));
+    *level.values<int16_t>() = 6;
+    ASSERT_EQ(0, mEffect.setParameterDeferred(level.get()));
+    EffectParam gains(gGainsId, 2 * sizeof(int32_t));
+    gains.values<int32_t>()[0] = 1;
+    gains.values<int32_t>()[1] = -2;
+    ASSERT_EQ(0, mEffect.setParameterDeferred(gains.get()));
+    EXPECT_EQ(0u, AudioParameters::getSetCount());
+
+    // Last values of the batch applied, once per parameter
+    ASSERT_EQ(0, mEffect.commitParameters());
+    EXPECT_EQ(2u, AudioParameters::getSetCount());
+    EXPECT_EQ("6", AudioParameters::getValues()["Fx-1"]);
+    EXPECT_EQ("[1,-2]", AudioParameters::getValues()["Fx-2"]);
+
+    // Nothing left to apply
+    ASSERT_EQ(0, mEffect.commitParameters());
+    EXPECT_EQ(2u, AudioParameters::getSetCount());
+
+    // Values set again in a new batch are applied again, even if unchanged
+    ASSERT_EQ(0, mEffect.setParameterDeferred(level.get()));
+    ASSERT_EQ(0, mEffect.commitParameters());
+    EXPECT_EQ(3u, AudioParameters::getSetCount());
+}
+
+TEST_F(AudioEffectTest, getReadsPlatform)
+{
+    EffectParam gains(gGainsId, gGainCount * sizeof(int32_t));
+    gains.values<int32_t>()[0] = 10;
+    gains.values<int32_t>()[1] = 20;
+    gains.values<int32_t>()[2] = 30;
+    ASSERT_EQ(0, mEffect.setParameter(gains.get()));
+
+    // Configuration reapplied by the platform
+    AudioParameters::getValues()["Fx-2"] = "[4,5,6]";
+    // Deferred values not committed yet are not reported
+    gains.values<int32_t>()[0] = 0;
+    ASSERT_EQ(0, mEffect.setParameterDeferred(gains.get()));
+
+    EffectParam read(gGainsId, gGainCount * sizeof(int32_t));
+    ASSERT_EQ(0, mEffect.getParameter(read.get()));
+    EXPECT_EQ(4, read.values<int32_t>()[0]);
+    EXPECT_EQ(5, read.values<int32_t>()[1]);
+    EXPECT_EQ(6, read.values<int32_t>()[2]);
+
+    // Deferred values kept for the commit
+    ASSERT_EQ(0, mEffect.commitParameters());
+    EXPECT_EQ("[0,20,30]", AudioParameters::getValues()["Fx-2"]);
+
+    // Fewer values available than requested
+    AudioParameters::getValues()["Fx-2"] = "[4]";
+    EXPECT_NE(0, mEffect.getParameter(read.get()));
+}
+
+TEST_F(AudioEffectTest, singleValueWidth)
+{
+    // int16 parameter given as int32, as accepted before parameters were typed
+    EffectParam wide(gLevelId, sizeof(int32_t));
+    *wide.values<int32_t>() = -40000;
+    ASSERT_EQ(0, mEffect.setParameter(wide.get()));
+    EXPECT_EQ("-40000", AudioParameters::getValues()["Fx-1"]);
+
+    *wide.values<int32_t>() = 0;
+    ASSERT_EQ(0, mEffect.getParameter(wide.get()));
+    EXPECT_EQ(-40000, *wide.values<int32_t>());
+
+    EffectParam narrow(gLevelId, sizeof(int16_t));
+    AudioParameters::getValues()["Fx-1"] = "-12";
+    ASSERT_EQ(0, mEffect.getParameter(narrow.get()));
+    EXPECT_EQ(-12, *narrow.values<int16_t>());
+
+    // Arrays are given with the registered type only
+    EffectParam odd(gGainsId, 3 * sizeof(int16_t));
+    EXPECT_NE(0, mEffect.setParameter(odd.get()));
+    EffectParam tooLong(gGainsId, (gGainCount + 1) * sizeof(int32_t));
+    EXPECT_NE(0, mEffect.setParameter(tooLong.get()));
+    EXPECT_EQ(1u, AudioParameters::getSetCount());
+}
+
+TEST_F(AudioEffectTest, unregisteredParameter)
+{
+    // Type deduced from the value size
+    EffectParam param(9, 2 * sizeof(int32_t));
+    param.values<int32_t>()[0] = 7;
+    param.values<int32_t>()[1] = 8;
+    ASSERT_EQ(0, mEffect.setParameter(param.get()));
+    EXPECT_EQ("[7,8]", AudioParameters::getValues()["Fx-9"]);
+
+    EffectParam read(9, 2 * sizeof(int32_t));
+    ASSERT_EQ(0, mEffect.getParameter(read.get()));
+    EXPECT_EQ(7, read.values<int32_t>()[0]);
+    EXPECT_EQ(8, read.values<int32_t>()[1]);
+}
+
+TEST(AudioEffectArray, format)
+{
+    const int32_t values[] = { 0, -2147483647 - 1, 2147483647 };
+    EXPECT_EQ("[]", AudioEffect::formatArray(values, 0));
+    EXPECT_EQ("[0]", AudioEffect::formatArray(values, 1));
+    EXPECT_EQ("[0,-2147483648,2147483647]", AudioEffect::formatArray(values, 3));
+}
+
+TEST(AudioEffectArray, parse)
+{
+    std::vector<int32_t> values;
+    ASSERT_TRUE(AudioEffect::parseArray("[1,-2,3]", 4, values));
+    ASSERT_EQ(3u, values.size());
+    EXPECT_EQ(1, values[0]);
+    EXPECT_EQ(-2, values[1]);
+    EXPECT_EQ(3, values[2]);
+
+    ASSERT_TRUE(AudioEffect::parseArray("[]", 4, values));
+    EXPECT_TRUE(values.empty());
+
+    // Values beyond the maximum are ignored
+    ASSERT_TRUE(AudioEffect::parseArray("[1,2,3]", 2, values));
+    EXPECT_EQ(2u, values.size());
+
+    // Round trip
+    const int32_t formatted[] = { -5, 0, 42 };
+    ASSERT_TRUE(AudioEffect::parseArray(AudioEffect::formatArray(formatted, 3), 3, values));
+    EXPECT_EQ(std::vector<int32_t>(formatted, formatted + 3), values);
+
+    EXPECT_FALSE(AudioEffect::parseArray("1,2", 4, values));
+    EXPECT_FALSE(AudioEffect::parseArray("[1,a]", 4, values));
+    EXPECT_FALSE(AudioEffect::parseArray("[1,,2]", 4, values));
+    EXPECT_FALSE(AudioEffect::parseArray("[", 4, values));
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace audio_comms
+{
+namespace utilities
+{
+
+/**
+ * Fake of the platform audio parameters for unit tests, keeping the values set and counting
+ * the accesses to the platform.
+ */
+class AudioParameters
+{
+public:
+    template <typename T>
+    static bool set(const std::string &key, const T &value)
+    {
+        std::ostringstream stream;
+        stream << value;
+        getValues()[key] = stream.str();
+        getSetCount()++;
+        return true;
+    }
+
+    static bool get(const std::string &key, std::string &value)
+    {
+        std::map<std::string, std::string>::const_iterator it = getValues().find(key);
+        if (it == getValues().end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+    /** Values held by the platform, by key. */
+    static std::map<std::string, std::string> &getValues()
+    {
+        static std::map<std::string, std::string> values;
+        return values;
+    }
+
+    /** Number of values set to the platform. */
+    static unsigned int &getSetCount()
+    {
+        static unsigned int setCount = 0;
+        return setCount;
+    }
+};
+
+} // namespace utilities
+} // namespace audio_comms
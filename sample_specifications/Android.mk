@@ -26,7 +26,9 @@ include $(OPTIONAL_QUALITY_ENV_SETUP)
 
 component_src_files :=  \
     src/AudioUtils.cpp \
-    src/SampleSpec.cpp
+    src/SampleSpec.cpp \
+    src/RateRatio.cpp \
+    src/SoundCardRegistry.cpp
 
 ifeq ($(USE_ALSA_LIB), 1)
 component_src_files += src/AlsaAudioUtils.cpp
@@ -54,7 +56,7 @@ component_static_lib_host += \
     $(foreach lib, $(component_static_lib), $(lib)_host)
 
 
-component_dynamic_lib := libtypeconverter
+component_dynamic_lib := libtypeconverter libtinyalsa
 
 ifeq ($(USE_ALSA_LIB), 1)
 component_dynamic_lib += libasound
@@ -114,7 +116,9 @@ include $(BUILD_STATIC_LIBRARY)
 
 component_functional_test_src_files += \
     test/SampleSpecTest.cpp \
-    test/AudioUtilsTest.cpp
+    test/AudioUtilsTest.cpp \
+    test/RateRatioTest.cpp \
+    test/SoundCardRegistryTest.cpp
 
 component_functional_test_static_lib := \
     libsamplespec_static
@@ -142,7 +146,8 @@ component_functional_test_static_lib_target += \
     liblog
 
 component_functional_test_shared_lib_target += \
-    libcutils
+    libcutils \
+    libtinyalsa
 
 ifeq ($(USE_ALSA_LIB), 1)
 component_functional_test_shared_lib_target += libasound
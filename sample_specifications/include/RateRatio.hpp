@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace intel_audio
+{
+
+/**
+ * Division of unsigned 64-bit integers by a constant 32-bit divisor.
+ * The reciprocal of the divisor is computed once, so that each division is performed with a
+ * multiplication and shifts (Granlund-Montgomery), giving exactly the same result as the
+ * integer division for the whole range of dividends.
+ */
+class FastDivider
+{
+public:
+    /** @param[in] divisor shall not be null. */
+    explicit FastDivider(uint32_t divisor = 1);
+
+    uint64_t divide(uint64_t dividend) const
+    {
+        if (mShift == 0) {
+            return dividend;
+        }
+        uint64_t high = multiplyHigh(mMagic, dividend);
+        return (high + ((dividend - high) >> 1)) >> (mShift - 1);
+    }
+
+    uint32_t getDivisor() const { return mDivisor; }
+
+private:
+    /** @return the upper 64 bits of the 128-bit product, without relying on 128-bit types. */
+    static uint64_t multiplyHigh(uint64_t left, uint64_t right)
+    {
+        uint64_t leftLow = left & 0xFFFFFFFF;
+        uint64_t leftHigh = left >> 32;
+        uint64_t rightLow = right & 0xFFFFFFFF;
+        uint64_t rightHigh = right >> 32;
+
+        uint64_t lowLow = leftLow * rightLow;
+        uint64_t highLow = leftHigh * rightLow;
+        uint64_t lowHigh = leftLow * rightHigh;
+        uint64_t highHigh = leftHigh * rightHigh;
+
+        uint64_t cross = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+        return highHigh + (highLow >> 32) + (cross >> 32);
+    }
+
+    uint64_t mMagic; /**< 2^64 * (2^shift - divisor) / divisor + 1. */
+    uint32_t mDivisor;
+    uint32_t mShift; /**< Ceiling of log2(divisor). */
+};
+
+/**
+ * Conversion of a number of frames from a source rate to a destination rate, rounded up:
+ *      dstFrames = ceil(srcFrames * dstRate / srcRate)
+ * Rates are reduced by their greatest common divisor once for all.
+ */
+class RateRatio
+{
+public:
+    RateRatio(uint32_t srcRate = 1, uint32_t dstRate = 1);
+
+    /**
+     * Converts a number of frames at source rate into a number of frames at destination rate.
+     * This function asserts if overflow is detected.
+     *
+     * @param[in] frames at source rate.
+     *
+     * @return frames at destination rate, rounded up.
+     */
+    size_t convert(size_t frames) const;
+
+private:
+    uint32_t mNumerator;
+    FastDivider mDenominator;
+    uint64_t mMaxFrames; /**< Largest number of frames that can be converted without overflow. */
+};
+
+/**
+ * Conversion between a number of frames and a duration in microseconds at a given rate, rounded
+ * down, as done by SampleSpec.
+ */
+class FrameTiming
+{
+public:
+    explicit FrameTiming(uint32_t rate = 1);
+
+    /**
+     * @param[in] frames to convert.
+     *
+     * @return duration in microseconds of the frames, 0 if null rate.
+     */
+    size_t convertFramesToUsec(uint32_t frames) const;
+
+    /**
+     * @param[in] intervalUsec duration in microseconds.
+     *
+     * @return number of frames within the duration.
+     */
+    size_t convertUsecToFrames(uint32_t intervalUsec) const
+    {
+        return mUsecToFramesDenominator.divide(
+            static_cast<uint64_t>(intervalUsec) * mUsecToFramesNumerator);
+    }
+
+private:
+    uint32_t mFramesToUsecNumerator;
+    FastDivider mFramesToUsecDenominator;
+    uint32_t mUsecToFramesNumerator;
+    FastDivider mUsecToFramesDenominator;
+
+    static const uint32_t mUsecPerSec = 1000000;
+};
+
+} // namespace intel_audio
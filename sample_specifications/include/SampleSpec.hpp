@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -16,9 +16,11 @@
 #pragma once
 
 
+#include "RateRatio.hpp"
 #include <hardware/audio.h>
 #include <utils/Errors.h>
 #include <string.h>
+#include <stdint.h>
 #include <vector>
 
 namespace intel_audio
@@ -38,7 +40,12 @@ enum SampleSpecItem
     NbSampleSpecItems
 };
 
-
+/**
+ * Sample specifications: channels (count, mask and policy of each channel), format and rate.
+ * As it is read several times per buffer on the audio paths, the class is trivially copyable:
+ * channels policy are packed into a bit field, the frame size is cached and the conversions
+ * rely on reciprocals computed when the specifications change.
+ */
 class SampleSpec
 {
 
@@ -139,10 +146,14 @@ public:
     }
 
     void setChannelsPolicy(const std::vector<ChannelsPolicy> &channelsPolicy);
-    const std::vector<ChannelsPolicy> &getChannelsPolicy() const
-    {
-        return mChannelsPolicy;
-    }
+
+    /**
+     * Builds the channels policy array. Intended to be used out of the audio paths as it allocates.
+     *
+     * @return policy of each channel.
+     */
+    std::vector<ChannelsPolicy> getChannelsPolicy() const;
+
     ChannelsPolicy getChannelsPolicy(uint32_t channelIndex) const;
 
     // Generic Accessor
@@ -150,7 +161,15 @@ public:
 
     uint32_t getSampleSpecItem(SampleSpecItem sampleSpecItem) const;
 
-    size_t getFrameSize() const;
+    size_t getFrameSize() const
+    {
+        return mFrameSize;
+    }
+
+    size_t getBytesPerSample() const
+    {
+        return mBytesPerSample;
+    }
 
     /**
      * Converts the bytes number to frames number.
@@ -235,9 +254,21 @@ private:
 
     audio_channel_mask_t mChannelMask; /**< Bit field that defines the channels used. */
 
-    std::vector<ChannelsPolicy> mChannelsPolicy; /**< channels policy array. */
+    /**
+     * Channels policy, packed on mBitsPerChannelsPolicy bits per channel, channel 0 on LSB.
+     * Policy of channels above channel count is always Copy, so that bit fields can be compared.
+     */
+    uint64_t mChannelsPolicy;
+
+    uint32_t mBytesPerSample; /**< Cached from the format. */
+    uint32_t mFrameSize; /**< Cached from the format and the channel count. */
+
+    FastDivider mFrameSizeDivider; /**< Bytes to frames conversion. */
+    FrameTiming mFrameTiming; /**< Frames to / from time conversions. */
+
+    static const uint32_t mBitsPerChannelsPolicy = 2;
+    static const uint64_t mChannelsPolicyMask = (1 << mBitsPerChannelsPolicy) - 1;
 
-    static const uint32_t mUsecPerSec = 1000000; /**<  to convert sec to-from microseconds. */
     static const uint32_t mDefaultChannels = 2; /**< default channel used is stereo. */
     static const uint32_t mDefaultFormat = AUDIO_FORMAT_PCM_16_BIT; /**< default format is 16bits.*/
     static const uint32_t mDefaultRate = 48000; /**< default rate is 48 kHz. */
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <tinyalsa/asoundlib.h>
+#include <memory>
+#include <string>
+
+namespace intel_audio
+{
+
+/**
+ * Process-wide cache of the sound card resources.
+ *
+ * Resolving a card name requires a readlink in procfs, finding the compressed device a scan of
+ * /dev/snd and each mixer access an open of the control device parsing all its controls. The
+ * registry keeps the result of these lookups until the sound cards may have changed, i.e. until
+ * invalidate is called upon a sound card uevent (hotplug, audio subsystem crash / recovery).
+ * Failed lookups are not cached, as the card may appear later on.
+ */
+class SoundCardRegistry
+{
+public:
+    /**
+     * Get the index of a sound card, resolving it on first call.
+     * @see AudioUtils::getCardIndexByName
+     *
+     * @param[in] name of the sound card, either user friendly or "cardX".
+     *
+     * @return index if found, negative value otherwise.
+     */
+    static int getCardIndex(const std::string &name);
+
+    /**
+     * Get the index of the compressed device, looking for it on first call.
+     * @see AudioUtils::getCompressDeviceIndex
+     *
+     * @return index of the first compress device found, negative value otherwise.
+     */
+    static int getCompressDeviceIndex();
+
+    /**
+     * Get the mixer of a sound card, opening it on first call.
+     * The mixer shall not be closed by the caller: it is released once the registry has been
+     * invalidated and the last user has dropped its reference.
+     *
+     * @param[in] cardIndex index of the sound card.
+     *
+     * @return mixer handle if valid card, nullptr otherwise.
+     */
+    static std::shared_ptr<struct mixer> getMixer(int cardIndex);
+
+    /**
+     * Drops all the cached resources, next lookups will access the file system again.
+     * Intended to be called whenever the sound cards may have appeared, disappeared or been reset.
+     */
+    static void invalidate();
+};
+
+} // namespace intel_audio
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "RateRatio"
+
+#include "RateRatio.hpp"
+#include <AudioCommsAssert.hpp>
+#include <sys/types.h>
+#include <limits>
+
+using namespace std;
+
+namespace intel_audio
+{
+
+static uint32_t greatestCommonDivisor(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        uint32_t remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
+
+FastDivider::FastDivider(uint32_t divisor)
+    : mMagic(0),
+      mDivisor(divisor),
+      mShift(0)
+{
+    AUDIOCOMMS_ASSERT(divisor != 0, "Null divisor");
+    while ((static_cast<uint64_t>(1) << mShift) < divisor) {
+        mShift++;
+    }
+    if (mShift == 0) {
+        return;
+    }
+    // Long division of (2^shift - divisor) * 2^64 by the divisor, the remainder always fits
+    // on 33 bits as the divisor is 32-bit wide.
+    uint64_t remainder = (static_cast<uint64_t>(1) << mShift) - divisor;
+    for (int bit = 0; bit < 64; bit++) {
+        remainder <<= 1;
+        mMagic <<= 1;
+        if (remainder >= divisor) {
+            remainder -= divisor;
+            mMagic |= 1;
+        }
+    }
+    mMagic += 1;
+}
+
+RateRatio::RateRatio(uint32_t srcRate, uint32_t dstRate)
+{
+    AUDIOCOMMS_ASSERT(srcRate != 0, "Source Sample Rate not set");
+    AUDIOCOMMS_ASSERT(dstRate != 0, "Destination Sample Rate not set");
+    uint32_t gcd = greatestCommonDivisor(srcRate, dstRate);
+    mNumerator = dstRate / gcd;
+    mDenominator = FastDivider(srcRate / gcd);
+    mMaxFrames = (numeric_limits<uint64_t>::max() - (mDenominator.getDivisor() - 1)) / mNumerator;
+}
+
+size_t RateRatio::convert(size_t frames) const
+{
+    AUDIOCOMMS_ASSERT(frames <= mMaxFrames, "Overflow detected");
+    uint64_t dstFrames = mDenominator.divide(static_cast<uint64_t>(frames) * mNumerator +
+                                             mDenominator.getDivisor() - 1);
+    AUDIOCOMMS_ASSERT(dstFrames <= static_cast<uint64_t>(numeric_limits<ssize_t>::max()),
+                      "conversion exceeding limit");
+    return dstFrames;
+}
+
+FrameTiming::FrameTiming(uint32_t rate)
+{
+    if (rate == 0) {
+        mFramesToUsecNumerator = 0;
+        mFramesToUsecDenominator = FastDivider(1);
+        mUsecToFramesNumerator = 0;
+        mUsecToFramesDenominator = FastDivider(1);
+        return;
+    }
+    uint32_t gcd = greatestCommonDivisor(mUsecPerSec, rate);
+    mFramesToUsecNumerator = mUsecPerSec / gcd;
+    mFramesToUsecDenominator = FastDivider(rate / gcd);
+    mUsecToFramesNumerator = rate / gcd;
+    mUsecToFramesDenominator = FastDivider(mUsecPerSec / gcd);
+}
+
+size_t FrameTiming::convertFramesToUsec(uint32_t frames) const
+{
+    uint64_t usec = mFramesToUsecDenominator.divide(static_cast<uint64_t>(frames) *
+                                                    mFramesToUsecNumerator);
+    AUDIOCOMMS_ASSERT(usec <= numeric_limits<size_t>::max(), "conversion exceeds limit");
+    return usec;
+}
+
+} // namespace intel_audio
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -22,6 +22,7 @@
 #include <stdint.h>
 #include <errno.h>
 #include <limits>
+#include <type_traits>
 #include <utils/String8.h>
 
 using audio_comms::utilities::Log;
@@ -30,6 +31,9 @@ using namespace std;
 namespace intel_audio
 {
 
+static_assert(std::is_trivially_copyable<SampleSpec>::value,
+              "SampleSpec is copied on audio paths, it shall not allocate");
+
 #define SAMPLE_SPEC_ITEM_IS_VALID(sampleSpecItem)                                    \
     AUDIOCOMMS_ASSERT((sampleSpecItem) >= 0 && (sampleSpecItem) < NbSampleSpecItems, \
                       "Invalid Sample Specifications")
@@ -39,7 +43,10 @@ SampleSpec::SampleSpec(uint32_t channel,
                        uint32_t rate,
                        const vector<ChannelsPolicy> &channelsPolicy)
 {
+    static_assert(mMaxChannels * mBitsPerChannelsPolicy <= sizeof(mChannelsPolicy) * 8,
+                  "Channels policy bit field too small");
     mChannelMask = 0;
+    mSampleSpec[FormatSampleSpecItem] = 0;
     setSampleSpecItem(ChannelCountSampleSpecItem, channel);
     setSampleSpecItem(FormatSampleSpecItem, format);
     setSampleSpecItem(RateSampleSpecItem, rate);
@@ -58,10 +65,17 @@ void SampleSpec::setSampleSpecItem(SampleSpecItem sampleSpecItem, uint32_t value
         AUDIOCOMMS_ASSERT(value < mMaxChannels, "Max channel number reached");
 
         // Reset all the channels policy to copy by default
-        mChannelsPolicy.clear();
-        mChannelsPolicy = std::vector<ChannelsPolicy>(value, Copy);
+        mChannelsPolicy = 0;
     }
     mSampleSpec[sampleSpecItem] = value;
+
+    if (sampleSpecItem != RateSampleSpecItem) {
+        mBytesPerSample = audio_bytes_per_sample(getFormat());
+        mFrameSize = mBytesPerSample * getChannelCount();
+        mFrameSizeDivider = FastDivider(mFrameSize != 0 ? mFrameSize : 1);
+    } else {
+        mFrameTiming = FrameTiming(value);
+    }
 }
 
 void SampleSpec::setChannelsPolicy(const vector<ChannelsPolicy> &channelsPolicy)
@@ -70,14 +84,28 @@ void SampleSpec::setChannelsPolicy(const vector<ChannelsPolicy> &channelsPolicy)
         Log::Warning() << __FUNCTION__ << ": Cannot set requested channel policy";
         return;
     }
-    mChannelsPolicy = channelsPolicy;
+    mChannelsPolicy = 0;
+    for (uint32_t channelIndex = 0; channelIndex < channelsPolicy.size(); channelIndex++) {
+        mChannelsPolicy |= static_cast<uint64_t>(channelsPolicy[channelIndex] & mChannelsPolicyMask)
+                           << (channelIndex * mBitsPerChannelsPolicy);
+    }
+}
+
+vector<SampleSpec::ChannelsPolicy> SampleSpec::getChannelsPolicy() const
+{
+    vector<ChannelsPolicy> channelsPolicy;
+    for (uint32_t channelIndex = 0; channelIndex < getChannelCount(); channelIndex++) {
+        channelsPolicy.push_back(getChannelsPolicy(channelIndex));
+    }
+    return channelsPolicy;
 }
 
 SampleSpec::ChannelsPolicy SampleSpec::getChannelsPolicy(uint32_t channelIndex) const
 {
-    AUDIOCOMMS_ASSERT(channelIndex < mChannelsPolicy.size(),
+    AUDIOCOMMS_ASSERT(channelIndex < getChannelCount(),
                       "request of channel policy outside channel numbers");
-    return mChannelsPolicy[channelIndex];
+    return static_cast<ChannelsPolicy>(
+        (mChannelsPolicy >> (channelIndex * mBitsPerChannelsPolicy)) & mChannelsPolicyMask);
 }
 
 uint32_t SampleSpec::getSampleSpecItem(SampleSpecItem sampleSpecItem) const
@@ -86,18 +114,13 @@ uint32_t SampleSpec::getSampleSpecItem(SampleSpecItem sampleSpecItem) const
     return mSampleSpec[sampleSpecItem];
 }
 
-size_t SampleSpec::getFrameSize() const
-{
-    return audio_bytes_per_sample(getFormat()) * getChannelCount();
-}
-
 size_t SampleSpec::convertBytesToFrames(size_t bytes) const
 {
     if (getFrameSize() == 0) {
         Log::Error() << __FUNCTION__ << ": Null frame size";
         return 0;
     }
-    return bytes / getFrameSize();
+    return mFrameSizeDivider.divide(bytes);
 }
 
 size_t SampleSpec::convertFramesToBytes(size_t frames) const
@@ -106,9 +129,10 @@ size_t SampleSpec::convertFramesToBytes(size_t frames) const
         Log::Error() << __FUNCTION__ << ": Null frame size";
         return 0;
     }
-    AUDIOCOMMS_ASSERT(frames <= numeric_limits<size_t>::max() / getFrameSize(),
+    size_t bytes;
+    AUDIOCOMMS_ASSERT(!__builtin_mul_overflow(frames, getFrameSize(), &bytes),
                       "conversion exceeds limit");
-    return frames * getFrameSize();
+    return bytes;
 }
 
 size_t SampleSpec::convertFramesToUsec(uint32_t frames) const
@@ -117,15 +141,12 @@ size_t SampleSpec::convertFramesToUsec(uint32_t frames) const
         Log::Error() << __FUNCTION__ << ": Null sample rate";
         return 0;
     }
-    AUDIOCOMMS_ASSERT((static_cast<uint64_t>(frames) / getSampleRate()) <=
-                      (numeric_limits<size_t>::max() / mUsecPerSec),
-                      "conversion exceeds limit");
-    return (mUsecPerSec * static_cast<uint64_t>(frames)) / getSampleRate();
+    return mFrameTiming.convertFramesToUsec(frames);
 }
 
 size_t SampleSpec::convertUsecToframes(uint32_t intervalUsec) const
 {
-    return static_cast<uint64_t>(intervalUsec) * getSampleRate() / mUsecPerSec;
+    return mFrameTiming.convertUsecToFrames(intervalUsec);
 }
 
 bool SampleSpec::isSampleSpecItemEqual(SampleSpecItem sampleSpecItem,
@@ -138,7 +159,7 @@ bool SampleSpec::isSampleSpecItemEqual(SampleSpecItem sampleSpecItem,
     }
 
     return (sampleSpecItem != ChannelCountSampleSpecItem) ||
-           ssSrc.getChannelsPolicy() == ssDst.getChannelsPolicy();
+           ssSrc.mChannelsPolicy == ssDst.mChannelsPolicy;
 }
 
 android::status_t SampleSpec::dump(const int fd, bool isOut, int spaces) const
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "SoundCardRegistry"
+
+#include "SoundCardRegistry.hpp"
+#include "AudioUtils.hpp"
+#include <Mutex.hpp>
+#include <utilities/Log.hpp>
+#include <map>
+
+using namespace std;
+using audio_comms::utilities::Log;
+using audio_comms::utilities::Mutex;
+
+namespace intel_audio
+{
+
+static Mutex gRegistryLock;
+
+/** Card indexes, indexed by card name. */
+static map<string, int> gCardIndexes;
+
+/** Index of the compressed device, negative if not yet found. */
+static int gCompressDeviceIndex = -1;
+
+/** Opened mixers, indexed by card index. */
+static map<int, shared_ptr<struct mixer> > gMixers;
+
+int SoundCardRegistry::getCardIndex(const string &name)
+{
+    Mutex::Locker locker(gRegistryLock);
+    auto it = gCardIndexes.find(name);
+    if (it != gCardIndexes.end()) {
+        return it->second;
+    }
+    int cardIndex = AudioUtils::getCardIndexByName(name.c_str());
+    if (cardIndex >= 0) {
+        gCardIndexes[name] = cardIndex;
+    }
+    return cardIndex;
+}
+
+int SoundCardRegistry::getCompressDeviceIndex()
+{
+    Mutex::Locker locker(gRegistryLock);
+    if (gCompressDeviceIndex < 0) {
+        gCompressDeviceIndex = AudioUtils::getCompressDeviceIndex();
+    }
+    return gCompressDeviceIndex;
+}
+
+shared_ptr<struct mixer> SoundCardRegistry::getMixer(int cardIndex)
+{
+    if (cardIndex < 0) {
+        return nullptr;
+    }
+    Mutex::Locker locker(gRegistryLock);
+    auto it = gMixers.find(cardIndex);
+    if (it != gMixers.end()) {
+        return it->second;
+    }
+    struct mixer *mixer = mixer_open(cardIndex);
+    if (mixer == nullptr) {
+        Log::Error() << __FUNCTION__ << ": Failed to open mixer for card " << cardIndex;
+        return nullptr;
+    }
+    shared_ptr<struct mixer> sharedMixer(mixer, mixer_close);
+    gMixers[cardIndex] = sharedMixer;
+    return sharedMixer;
+}
+
+void SoundCardRegistry::invalidate()
+{
+    Mutex::Locker locker(gRegistryLock);
+    Log::Debug() << __FUNCTION__ << ": dropping " << gCardIndexes.size() << " card(s), "
+                 << gMixers.size() << " mixer(s)";
+    gCardIndexes.clear();
+    gCompressDeviceIndex = -1;
+    gMixers.clear();
+}
+
+} // namespace intel_audio
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <RateRatio.hpp>
+#include <SampleSpec.hpp>
+#include <AudioUtils.hpp>
+#include <limits>
+#include <gtest/gtest.h>
+
+namespace intel_audio
+{
+
+static const uint32_t gRates[] = {
+    8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000, 64000, 88200, 96000, 176400,
+    192000
+};
+
+/** Number of frames checked for each conversion, i.e. 1 second at highest rate. */
+static const uint32_t gFramesRange = 192000;
+
+TEST(FastDivider, smallDivisors)
+{
+    for (uint32_t divisor = 1; divisor <= 4096; divisor++) {
+        FastDivider divider(divisor);
+        for (uint64_t dividend = 0; dividend < 4 * 4096; dividend++) {
+            ASSERT_EQ(dividend / divisor, divider.divide(dividend)) << dividend << "/" << divisor;
+        }
+    }
+}
+
+TEST(FastDivider, limits)
+{
+    const uint64_t maxDividend = std::numeric_limits<uint64_t>::max();
+    const uint32_t divisors[] = {
+        1, 2, 3, 5, 6, 7, 160, 441, 1000000, 0x7FFFFFFF, 0x80000000, 0x80000001, 0xFFFFFFFF
+    };
+    for (auto divisor : divisors) {
+        FastDivider divider(divisor);
+        EXPECT_EQ(divisor, divider.getDivisor());
+        for (uint64_t delta = 0; delta < 4096; delta++) {
+            uint64_t dividend = maxDividend - delta;
+            ASSERT_EQ(dividend / divisor, divider.divide(dividend)) << dividend << "/" << divisor;
+            dividend = (static_cast<uint64_t>(1) << 32) - 2048 + delta;
+            ASSERT_EQ(dividend / divisor, divider.divide(dividend)) << dividend << "/" << divisor;
+            dividend = static_cast<uint64_t>(divisor) * delta;
+            ASSERT_EQ(dividend / divisor, divider.divide(dividend)) << dividend << "/" << divisor;
+            ASSERT_EQ((dividend - 1) / divisor, divider.divide(dividend - 1))
+                << dividend - 1 << "/" << divisor;
+        }
+    }
+}
+
+TEST(RateRatio, allRatesAllFrames)
+{
+    for (auto srcRate : gRates) {
+        for (auto dstRate : gRates) {
+            RateRatio ratio(srcRate, dstRate);
+            SampleSpec ssSrc(2, AUDIO_FORMAT_PCM_16_BIT, srcRate);
+            SampleSpec ssDst(2, AUDIO_FORMAT_PCM_16_BIT, dstRate);
+            for (uint32_t frames = 0; frames < gFramesRange; frames++) {
+                ASSERT_EQ(AudioUtils::convertSrcToDstInFrames(frames, ssSrc, ssDst),
+                          ratio.convert(frames))
+                    << frames << " frames from " << srcRate << " to " << dstRate;
+            }
+        }
+    }
+}
+
+TEST(FrameTiming, allRatesAllFrames)
+{
+    for (auto rate : gRates) {
+        FrameTiming timing(rate);
+        for (uint32_t frames = 0; frames < gFramesRange; frames++) {
+            ASSERT_EQ(1000000ull * frames / rate, timing.convertFramesToUsec(frames))
+                << frames << " frames at " << rate;
+        }
+        EXPECT_EQ(1000000ull * std::numeric_limits<uint32_t>::max() / rate,
+                  timing.convertFramesToUsec(std::numeric_limits<uint32_t>::max()));
+
+        for (uint32_t usec = 0; usec < 1000000; usec++) {
+            ASSERT_EQ(static_cast<uint64_t>(usec) * rate / 1000000, timing.convertUsecToFrames(usec))
+                << usec << " us at " << rate;
+        }
+        EXPECT_EQ(static_cast<uint64_t>(std::numeric_limits<uint32_t>::max()) * rate / 1000000,
+                  timing.convertUsecToFrames(std::numeric_limits<uint32_t>::max()));
+    }
+}
+
+TEST(FrameTiming, nullRate)
+{
+    FrameTiming timing(0);
+    EXPECT_EQ(0u, timing.convertFramesToUsec(48000));
+    EXPECT_EQ(0u, timing.convertUsecToFrames(1000000));
+}
+
+} // namespace intel_audio
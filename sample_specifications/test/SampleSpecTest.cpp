@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2012-2016 Intel Corporation
+ * Copyright (C) 2012-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -90,6 +90,48 @@ TEST(SampleSpec, setGetChannelPolicy)
 
 }
 
+TEST(SampleSpec, channelPolicyAllChannels)
+{
+    const uint32_t channelCount = 31;
+    SampleSpec sampleSpec(channelCount, AUDIO_FORMAT_PCM_16_BIT, 48000);
+    std::vector<SampleSpec::ChannelsPolicy> channelsPolicy;
+    for (uint32_t channel = 0; channel < channelCount; channel++) {
+        channelsPolicy.push_back(static_cast<SampleSpec::ChannelsPolicy>(
+                                     channel % SampleSpec::NbChannelsPolicy));
+    }
+    sampleSpec.setChannelsPolicy(channelsPolicy);
+    EXPECT_EQ(channelsPolicy, sampleSpec.getChannelsPolicy());
+
+    // Copy does not allocate and keeps policies
+    SampleSpec copy = sampleSpec;
+    EXPECT_TRUE(copy == sampleSpec);
+    EXPECT_EQ(SampleSpec::Ignore, copy.getChannelsPolicy(channelCount - 2));
+
+    // Changing the channel count resets the policies to copy
+    copy.setChannelCount(2);
+    EXPECT_EQ(SampleSpec::Copy, copy.getChannelsPolicy(0));
+    EXPECT_EQ(SampleSpec::Copy, copy.getChannelsPolicy(1));
+    EXPECT_EQ(SampleSpec(2, AUDIO_FORMAT_PCM_16_BIT, 48000), copy);
+}
+
+TEST(SampleSpec, cachedSizes)
+{
+    SampleSpec sampleSpec(2, AUDIO_FORMAT_PCM_16_BIT, 48000);
+    EXPECT_EQ(2u, sampleSpec.getBytesPerSample());
+    EXPECT_EQ(4u, sampleSpec.getFrameSize());
+
+    sampleSpec.setFormat(AUDIO_FORMAT_PCM_8_24_BIT);
+    EXPECT_EQ(4u, sampleSpec.getBytesPerSample());
+    EXPECT_EQ(8u, sampleSpec.getFrameSize());
+
+    sampleSpec.setChannelMask(AUDIO_CHANNEL_OUT_5POINT1, true);
+    EXPECT_EQ(4u, sampleSpec.getBytesPerSample());
+    EXPECT_EQ(24u, sampleSpec.getFrameSize());
+
+    sampleSpec.setSampleRate(44100);
+    EXPECT_EQ(24u, sampleSpec.getFrameSize());
+}
+
 TEST(SampleSpec, monoStereoHelpers)
 {
     SampleSpec sampleSpec;
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <SoundCardRegistry.hpp>
+#include <gtest/gtest.h>
+
+namespace intel_audio
+{
+
+TEST(SoundCardRegistry, cardIndex)
+{
+    // Card names provided as "cardX" do not require any file system access
+    EXPECT_EQ(9, SoundCardRegistry::getCardIndex("card9"));
+    EXPECT_EQ(0, SoundCardRegistry::getCardIndex("card0"));
+
+    // Cached value
+    EXPECT_EQ(9, SoundCardRegistry::getCardIndex("card9"));
+
+    SoundCardRegistry::invalidate();
+    EXPECT_EQ(9, SoundCardRegistry::getCardIndex("card9"));
+
+    // Errors are reported and not cached
+    EXPECT_GT(0, SoundCardRegistry::getCardIndex("cardXYZ"));
+    EXPECT_GT(0, SoundCardRegistry::getCardIndex("cardXYZ"));
+}
+
+TEST(SoundCardRegistry, invalidMixer)
+{
+    EXPECT_EQ(nullptr, SoundCardRegistry::getMixer(-1));
+    SoundCardRegistry::invalidate();
+    EXPECT_EQ(nullptr, SoundCardRegistry::getMixer(-1));
+}
+
+} // namespace intel_audio
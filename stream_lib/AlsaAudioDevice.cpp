@@ -35,7 +35,8 @@ android::status_t AlsaAudioDevice::open(const char *deviceName, uint32_t /*devic
 
     snd_pcm_stream_t stream = (isOut ? SND_PCM_STREAM_PLAYBACK : SND_PCM_STREAM_CAPTURE);
 
-    int err = snd_pcm_open(&mPcmDevice, deviceName, stream, SND_PCM_ASYNC);
+    // Blocking mode: nothing handles SIGIO, the device is not opened in asynchronous mode.
+    int err = snd_pcm_open(&mPcmDevice, deviceName, stream, 0);
     if (err) {
         Log::Error() << __FUNCTION__
                      << ": Cannot open alsa (" << deviceName
@@ -58,7 +59,7 @@ android::status_t AlsaAudioDevice::open(const char *deviceName, uint32_t /*devic
         static_cast<int32_t>(AlsaAudioUtils::convertHalToAlsaFormat(routeConfig.getFormat()))
                  << " channels=" << routeConfig.getChannelCount()
                  << ").";
-
+    mXrunMonitor.onOpen(routeConfig.getRate(), getBufferSizeInFrames());
     return android::OK;
 
 close_device:
@@ -250,6 +251,7 @@ android::status_t AlsaAudioDevice::close()
         return android::DEAD_OBJECT;
     }
     Log::Debug() << __FUNCTION__;
+    mXrunMonitor.onClose();
     snd_pcm_drain(mPcmDevice);
     snd_pcm_close(mPcmDevice);
     mPcmDevice = NULL;
@@ -264,9 +266,17 @@ android::status_t AlsaAudioDevice::pcmReadFrames(void *buffer, size_t frames, st
         return android::BAD_VALUE;
     }
 
+    mXrunMonitor.onTransferStart();
     snd_pcm_sframes_t frames_read;
     frames_read = snd_pcm_readi(mPcmDevice, (char *)buffer, frames);
 
+    if (frames_read == -EPIPE) {
+        // Overrun: once recovered, the read restarts the stream.
+        mXrunMonitor.onXrunError();
+        if (snd_pcm_recover(mPcmDevice, frames_read, 1) == 0) {
+            frames_read = snd_pcm_readi(mPcmDevice, (char *)buffer, frames);
+        }
+    }
     if (frames_read < 0) {
         error = snd_strerror(frames_read);
         if (snd_pcm_recover(mPcmDevice, frames_read, 0) != android::OK) {
@@ -274,6 +284,7 @@ android::status_t AlsaAudioDevice::pcmReadFrames(void *buffer, size_t frames, st
         }
         return frames_read;
     }
+    mXrunMonitor.onTransferDone();
 
     if ((size_t)frames_read < frames) {
         Log::Warning() << " We read " << frames_read << " instead of " << frames;
@@ -284,7 +295,16 @@ android::status_t AlsaAudioDevice::pcmReadFrames(void *buffer, size_t frames, st
 
 android::status_t AlsaAudioDevice::pcmWriteFrames(void *buffer, ssize_t frames, string &error) const
 {
+    mXrunMonitor.onTransferStart();
     snd_pcm_sframes_t frames_written = snd_pcm_writei(mPcmDevice, (char *)buffer, frames);
+    if (frames_written == -EPIPE) {
+        // Underrun: once recovered, the write re-primes the ring buffer, the stream restarting
+        // once the start threshold is reached.
+        mXrunMonitor.onXrunError();
+        if (snd_pcm_recover(mPcmDevice, frames_written, 1) == 0) {
+            frames_written = snd_pcm_writei(mPcmDevice, (char *)buffer, frames);
+        }
+    }
     if (frames_written < 0) {
         error = snd_strerror(frames_written);
         if (snd_pcm_recover(mPcmDevice, frames_written, 0) != android::OK) {
@@ -293,7 +313,7 @@ android::status_t AlsaAudioDevice::pcmWriteFrames(void *buffer, ssize_t frames,
         }
         return frames_written;
     }
-
+    mXrunMonitor.onTransferDone();
     return android::OK;
 }
 
@@ -326,19 +346,30 @@ android::status_t AlsaAudioDevice::getFramesAvailable(size_t &avail, struct time
 #endif
     // @todo snd_pcm_htimestamp not supported by ioplug so emulating the behavior
     clock_gettime(CLOCK_MONOTONIC, &tStamp);
-    snd_pcm_uframes_t availFrames = snd_pcm_avail(mPcmDevice);
+    snd_pcm_sframes_t availFrames = snd_pcm_avail(mPcmDevice);
+    if (availFrames < 0) {
+        if (availFrames == -EPIPE) {
+            mXrunMonitor.onXrunError();
+        }
+        Log::Error() << __FUNCTION__ << ": Unable to get available frames: "
+                     << snd_strerror(availFrames);
+        return android::INVALID_OPERATION;
+    }
+    mXrunMonitor.checkAvail(availFrames);
     avail = availFrames;
     return android::OK;
 }
 
 android::status_t AlsaAudioDevice::pcmStop() const
 {
-    int err = snd_pcm_drain(mPcmDevice);
-    Log::Error() << __FUNCTION__ << " draining samples returned " << snd_strerror(err);
-    err = snd_pcm_close(mPcmDevice);
-    Log::Error() << __FUNCTION__ << " pcm_close returned " << snd_strerror(err);
-
-    return err;
+    mXrunMonitor.onStop();
+    // Stop the device, pending frames dropped, but keep it opened: next transfer restarts it.
+    int err = snd_pcm_drop(mPcmDevice);
+    if (err < 0) {
+        Log::Error() << __FUNCTION__ << ": failed: " << snd_strerror(err);
+        return err;
+    }
+    return snd_pcm_prepare(mPcmDevice);
 }
 
 } // namespace intel_audio
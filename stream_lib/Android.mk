@@ -1,6 +1,6 @@
 #
 #
-# Copyright (C) Intel 2013-2017
+# Copyright (C) Intel 2013-2018
 #
 # Licensed under the Apache License, Version 2.0 (the "License");
 # you may not use this file except in compliance with the License.
@@ -25,7 +25,10 @@ component_export_include_dir := $(LOCAL_PATH)/include
 
 component_src_files :=  \
     IoStream.cpp \
-    TinyAlsaAudioDevice.cpp 
+    CaptureFanOut.cpp \
+    PlaybackMixer.cpp \
+    TinyAlsaAudioDevice.cpp \
+    XrunMonitor.cpp
 
 ifeq ($(USE_ALSA_LIB), 1)
 component_src_files += AlsaAudioDevice.cpp
@@ -56,6 +59,8 @@ component_static_lib += \
     audio.routemanager.includes \
     libproperty
 
+component_dynamic_lib := libcutils
+
 ifeq ($(USE_ALSA_LIB), 1)
 component_dynamic_lib += libasound
 endif
@@ -110,3 +115,59 @@ LOCAL_MODULE_TAGS := optional
 include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
 
 include $(BUILD_STATIC_LIBRARY)
+
+#######################################################################
+# Component unit tests (using fake audio devices)
+
+stream_lib_test_src_files := \
+    CaptureFanOut.cpp \
+    PlaybackMixer.cpp \
+    XrunMonitor.cpp \
+    test/CaptureFanOutTest.cpp \
+    test/PlaybackMixerTest.cpp \
+    test/XrunMonitorTest.cpp
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(stream_lib_test_src_files)
+LOCAL_C_INCLUDES := $(component_includes_dir_target)
+LOCAL_STATIC_LIBRARIES := \
+    libsamplespec_static \
+    libaudio_comms_utilities \
+    audio.routemanager.includes \
+    liblog
+LOCAL_SHARED_LIBRARIES := libcutils
+LOCAL_MODULE := stream_lib_test
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Werror -Wextra -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+include $(BUILD_NATIVE_TEST)
+
+ifeq (ENABLE_HOST_VERSION,1)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(stream_lib_test_src_files)
+LOCAL_C_INCLUDES := \
+    $(component_includes_dir_host) \
+    external/gtest/include
+LOCAL_STATIC_LIBRARIES := \
+    libsamplespec_static_host \
+    libaudio_comms_utilities_host \
+    audio.routemanager.includes_host \
+    libcutils \
+    liblog \
+    libgtest_host \
+    libgtest_main_host
+LOCAL_LDFLAGS += -lpthread -lrt
+LOCAL_MODULE := stream_lib_test_host
+LOCAL_MODULE_OWNER := intel
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS := -Wall -Werror -Wextra -O0 -ggdb
+
+include $(OPTIONAL_QUALITY_COVERAGE_JUMPER)
+# Cannot use $(BUILD_HOST_NATIVE_TEST) because of compilation flag
+# misalignment against gtest mk files
+include $(BUILD_HOST_EXECUTABLE)
+endif
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "CaptureFanOut"
+
+#include "CaptureFanOut.hpp"
+#include "AudioDevice.hpp"
+#include <AudioCommsAssert.hpp>
+#include <utilities/Log.hpp>
+#include <algorithm>
+#include <string.h>
+
+using audio_comms::utilities::Log;
+using audio_comms::utilities::Mutex;
+
+namespace intel_audio
+{
+
+/** Ring buffer size, in device ring buffers: leaves room for the readers jitter. */
+static const size_t gRingBufferCount = 2;
+
+CaptureFanOut::CaptureFanOut()
+    : mDevice(NULL),
+      mFrameSize(0),
+      mCapacityFrames(0),
+      mPeriodFrames(0),
+      mWritePosition(0),
+      mFilling(false),
+      mFillEndPosition(0),
+      mFillWaiters(0),
+      mSlowReaderCount(0)
+{
+}
+
+void CaptureFanOut::reset(IAudioDevice &device, size_t periodFrames)
+{
+    Mutex::Locker locker(mLock);
+    AUDIOCOMMS_ASSERT(mReaders.empty(), "Device changed while shared");
+    size_t bufferFrames = device.getBufferSizeInFrames();
+    mDevice = &device;
+    mFrameSize = bufferFrames != 0 ? device.getBufferSizeInBytes() / bufferFrames : 0;
+    mCapacityFrames = gRingBufferCount * bufferFrames;
+    mPeriodFrames = std::max<size_t>(periodFrames, 1);
+    mRing.resize(mCapacityFrames * mFrameSize);
+    mWritePosition = 0;
+}
+
+android::status_t CaptureFanOut::addReader(const void *reader)
+{
+    Mutex::Locker locker(mLock);
+    if (mDevice == NULL || mCapacityFrames == 0) {
+        Log::Error() << __FUNCTION__ << ": no device to share";
+        return android::NO_INIT;
+    }
+    Reader newReader;
+    // Frames being read by the filling reader may not be kept in the ring buffer
+    newReader.position = mFilling ? mFillEndPosition : mWritePosition;
+    newReader.framesLost = 0;
+    newReader.isLagging = false;
+    if (!mReaders.insert(std::make_pair(reader, newReader)).second) {
+        return android::ALREADY_EXISTS;
+    }
+    Log::Debug() << __FUNCTION__ << ": " << mReaders.size() << " reader(s)";
+    return android::OK;
+}
+
+void CaptureFanOut::removeReader(const void *reader)
+{
+    Mutex::Locker locker(mLock);
+    mReaders.erase(reader);
+    Log::Debug() << __FUNCTION__ << ": " << mReaders.size() << " reader(s)";
+}
+
+size_t CaptureFanOut::getReaderCount() const
+{
+    Mutex::Locker locker(mLock);
+    return mReaders.size();
+}
+
+uint32_t CaptureFanOut::getSlowReaderCount() const
+{
+    Mutex::Locker locker(mLock);
+    return mSlowReaderCount;
+}
+
+void CaptureFanOut::accountDeviceFramesLostUnsafe()
+{
+    uint64_t framesLost = mDevice->getXrunMonitor().consumeFramesLost();
+    if (framesLost == 0) {
+        return;
+    }
+    for (auto &it : mReaders) {
+        it.second.framesLost += framesLost;
+    }
+}
+
+void CaptureFanOut::pushSlowReadersUnsafe(size_t frames)
+{
+    for (auto &it : mReaders) {
+        Reader &reader = it.second;
+        uint64_t lag = mWritePosition + frames - reader.position;
+        if (lag > mCapacityFrames) {
+            uint64_t framesLost = lag - mCapacityFrames;
+            reader.position += framesLost;
+            reader.framesLost += framesLost;
+            if (!reader.isLagging) {
+                reader.isLagging = true;
+                mSlowReaderCount++;
+                Log::Warning() << __FUNCTION__ << ": slow reader " << it.first
+                               << " loses frames";
+            }
+        }
+    }
+}
+
+android::status_t CaptureFanOut::fillUnsafe(void *buffer, size_t frames, std::string &error)
+{
+    IAudioDevice *device = mDevice;
+    mFilling = true;
+    mFillEndPosition = mWritePosition + frames;
+
+    mLock.unlock();
+    android::status_t status = device->pcmReadFrames(buffer, frames, error);
+    mLock.lock();
+
+    if (status == android::OK) {
+        mWritePosition = mFillEndPosition;
+        accountDeviceFramesLostUnsafe();
+    } else {
+        // Readers added meanwhile expected these frames
+        for (auto &it : mReaders) {
+            it.second.position = std::min(it.second.position, mWritePosition);
+        }
+    }
+    mFilling = false;
+    for (uint32_t waiter = 0; waiter < mFillWaiters; waiter++) {
+        mFillDone.signal();
+    }
+    return status;
+}
+
+android::status_t CaptureFanOut::read(const void *reader, void *buffer, size_t frames,
+                                      std::string &error)
+{
+    Mutex::Locker locker(mLock);
+    char *dst = static_cast<char *>(buffer);
+    while (frames > 0) {
+        // Readers may change while the lock is released for the device read
+        auto it = mReaders.find(reader);
+        if (it == mReaders.end()) {
+            error = "not a reader of the shared device";
+            return android::BAD_VALUE;
+        }
+        Reader &self = it->second;
+
+        if (self.position == mWritePosition) {
+            if (mFilling) {
+                // Another reader is reading the device: its frames are for us too
+                mFillWaiters++;
+                mFillDone.wait(mLock);
+                mFillWaiters--;
+                continue;
+            }
+            if (mReaders.size() == 1) {
+                // Sole reader up to date: no need to keep a copy of the frames
+                android::status_t status = fillUnsafe(dst, frames, error);
+                if (status != android::OK) {
+                    return status;
+                }
+                auto updated = mReaders.find(reader);
+                if (updated != mReaders.end()) {
+                    updated->second.position = std::max(updated->second.position,
+                                                        mWritePosition);
+                    updated->second.isLagging = false;
+                }
+                return android::OK;
+            }
+            // Device frames are read contiguously in the ring buffer
+            size_t offset = mWritePosition % mCapacityFrames;
+            size_t toFill = std::min(std::max(frames, mPeriodFrames), mCapacityFrames / 2);
+            toFill = std::min(toFill, mCapacityFrames - offset);
+            pushSlowReadersUnsafe(toFill);
+            android::status_t status = fillUnsafe(&mRing[offset * mFrameSize], toFill, error);
+            if (status != android::OK) {
+                return status;
+            }
+            continue;
+        }
+        size_t offset = self.position % mCapacityFrames;
+        size_t available = std::min<uint64_t>(mWritePosition - self.position,
+                                              mCapacityFrames - offset);
+        size_t toCopy = std::min(frames, available);
+        memcpy(dst, &mRing[offset * mFrameSize], toCopy * mFrameSize);
+        dst += toCopy * mFrameSize;
+        frames -= toCopy;
+        self.position += toCopy;
+        self.isLagging = false;
+    }
+    return android::OK;
+}
+
+uint64_t CaptureFanOut::consumeFramesLost(const void *reader)
+{
+    Mutex::Locker locker(mLock);
+    auto it = mReaders.find(reader);
+    if (it == mReaders.end()) {
+        return 0;
+    }
+    uint64_t framesLost = it->second.framesLost;
+    it->second.framesLost = 0;
+    return framesLost;
+}
+
+size_t CaptureFanOut::getPendingFrames(const void *reader) const
+{
+    Mutex::Locker locker(mLock);
+    auto it = mReaders.find(reader);
+    return it == mReaders.end() ? 0 : mWritePosition - it->second.position;
+}
+
+} // namespace intel_audio
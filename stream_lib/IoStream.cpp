@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -15,6 +15,8 @@
  */
 #include "IoStream.hpp"
 #include "AudioDevice.hpp"
+#include "CaptureFanOut.hpp"
+#include "PlaybackMixer.hpp"
 #include <typeconverter/TypeConverter.hpp>
 #include <IStreamRoute.hpp>
 #include <AudioCommsAssert.hpp>
@@ -31,7 +33,6 @@ namespace intel_audio
 
 bool IoStream::isRouted() const
 {
-    AutoR lock(mStreamLock);
     return isRoutedL();
 }
 
@@ -42,7 +43,6 @@ bool IoStream::isRoutedL() const
 
 bool IoStream::isNewRouteAvailable() const
 {
-    AutoR lock(mStreamLock);
     return mNewStreamRoute != NULL;
 }
 
@@ -65,8 +65,31 @@ android::status_t IoStream::attachRouteL()
         Log::Error() << __FUNCTION__ << ": Invalid new stream route to attach";
         return android::BAD_VALUE;
     }
-    setCurrentStreamRouteL(mNewStreamRoute);
-    setRouteSampleSpecL(mCurrentStreamRoute->getSampleSpec());
+    IStreamRoute *route = mNewStreamRoute;
+    CaptureFanOut *captureFanOut = isOut() ? NULL : route->getCaptureFanOut();
+    if (captureFanOut != NULL) {
+        // Reading the shared device directly would steal the frames of the other readers
+        android::status_t status = captureFanOut->addReader(this);
+        if (status != android::OK) {
+            Log::Error() << __FUNCTION__ << ": cannot share capture of route "
+                         << route->getName();
+            return status;
+        }
+    }
+    PlaybackMixer *playbackMixer = isOut() ? route->getPlaybackMixer() : NULL;
+    if (playbackMixer != NULL) {
+        // Writing the shared device directly would interleave the frames of the other inputs
+        android::status_t status = playbackMixer->addInput(this);
+        if (status != android::OK) {
+            Log::Error() << __FUNCTION__ << ": cannot mix into route "
+                         << route->getName();
+            return status;
+        }
+    }
+    mCaptureFanOut = captureFanOut;
+    mPlaybackMixer = playbackMixer;
+    setCurrentStreamRouteL(route);
+    setRouteSampleSpecL(route->getSampleSpec());
     mAudioDevice = getNewStreamRoute()->getAudioDevice();
     // now we are attached to a route, it is high time to reset need reconfigure flag
     resetNeedReconfigure();
@@ -76,6 +99,14 @@ android::status_t IoStream::attachRouteL()
 
 android::status_t IoStream::detachRouteL()
 {
+    if (mCaptureFanOut != NULL) {
+        mCaptureFanOut->removeReader(this);
+        mCaptureFanOut = NULL;
+    }
+    if (mPlaybackMixer != NULL) {
+        mPlaybackMixer->removeInput(this);
+        mPlaybackMixer = NULL;
+    }
     mCurrentStreamRoute = NULL;
     mAudioDevice = NULL;
     // not routed anymore, it is high time to reset need reconfigure flag
@@ -97,22 +128,26 @@ void IoStream::removeRequestedEffect(uint32_t effectId)
 
 uint32_t IoStream::getOutputSilencePrologMs() const
 {
-    if (mCurrentStreamRoute == NULL) {
+    IStreamRoute *route = mCurrentStreamRoute;
+    if (route == NULL) {
         Log::Warning() << __FUNCTION__ << ": called from invalid context(No route), returning 0 ms";
         return 0;
     }
-    return mCurrentStreamRoute->getOutputSilencePrologMs();
+    return route->getOutputSilencePrologMs();
 }
 
 android::status_t IoStream::setDevices(audio_devices_t devices, const std::string &address)
 {
-    AutoW lock(mStreamLock);
+    audio_comms::utilities::Mutex::Locker locker(mDevicesLock);
     // A change of device requires to be reconfigure (aka muted / unmuted) to garantee safe transition
-    if ((mDevices != devices) || (mDeviceAddress != address)) {
+    bool addressChanged = *std::atomic_load(&mDeviceAddress) != address;
+    if ((mDevices != devices) || addressChanged) {
         setNeedReconfigure();
     }
     mDevices = devices;
-    mDeviceAddress = address;
+    if (addressChanged) {
+        std::atomic_store(&mDeviceAddress, std::make_shared<const std::string>(address));
+    }
     return android::OK;
 }
 
@@ -138,11 +173,17 @@ void IoStream::setRouteSampleSpecL(SampleSpec sampleSpec)
 
 android::status_t IoStream::pcmReadFrames(void *buffer, size_t frames, string &error) const
 {
+    if (mCaptureFanOut != NULL) {
+        return mCaptureFanOut->read(this, buffer, frames, error);
+    }
     return mAudioDevice->pcmReadFrames(buffer, frames, error);
 }
 
 android::status_t IoStream::pcmWriteFrames(void *buffer, ssize_t frames, string &error) const
 {
+    if (mPlaybackMixer != NULL) {
+        return mPlaybackMixer->write(this, buffer, frames, error);
+    }
     return mAudioDevice->pcmWriteFrames(buffer, frames, error);
 }
 
@@ -158,11 +199,32 @@ size_t IoStream::getBufferSizeInFrames() const
 
 android::status_t IoStream::getFramesAvailable(size_t &avail, struct timespec &tStamp) const
 {
-    return mAudioDevice->getFramesAvailable(avail, tStamp);
+    android::status_t status = mAudioDevice->getFramesAvailable(avail, tStamp);
+    if (status == android::OK && mCaptureFanOut != NULL) {
+        avail += mCaptureFanOut->getPendingFrames(this);
+    }
+    if (status == android::OK && mPlaybackMixer != NULL) {
+        size_t pending = mPlaybackMixer->getPendingFrames(this);
+        avail = avail > pending ? avail - pending : 0;
+    }
+    return status;
+}
+
+uint64_t IoStream::consumeXrunFramesLost() const
+{
+    if (mCaptureFanOut != NULL) {
+        return mCaptureFanOut->consumeFramesLost(this);
+    }
+    return mAudioDevice->getXrunMonitor().consumeFramesLost();
 }
 
 android::status_t IoStream::pcmStop() const
 {
+    if (mPlaybackMixer != NULL) {
+        // Other streams are still played: only drops the frames of this stream
+        mPlaybackMixer->flush(this);
+        return android::OK;
+    }
     return mAudioDevice->pcmStop();
 }
 
@@ -181,20 +243,23 @@ android::status_t IoStream::dump(const int fd, int spaces) const
     char buffer[SIZE];
     android::String8 result;
 
-    snprintf(buffer, SIZE, "%*s- mEffectsRequestedMask: 0x%X\n", spaces, "", mEffectsRequestedMask);
+    snprintf(buffer, SIZE, "%*s- mEffectsRequestedMask: 0x%X\n", spaces, "",
+             mEffectsRequestedMask.load());
     result.append(buffer);
     snprintf(buffer, SIZE, "%*s- Need Reconfigure: %s\n", spaces, "", mNeedReconfigure ? "Y" : "N");
     result.append(buffer);
+    IStreamRoute *currentRoute = mCurrentStreamRoute;
+    IStreamRoute *newRoute = mNewStreamRoute;
     snprintf(buffer, SIZE, "%*s- is attached to route: %s\n", spaces, "",
-             (mCurrentStreamRoute == nullptr ? "none" : mCurrentStreamRoute->getName().c_str()));
+             (currentRoute == nullptr ? "none" : currentRoute->getName().c_str()));
     result.append(buffer);
     snprintf(buffer, SIZE, "%*s- will be attached to route: %s\n", spaces, "",
-             (mNewStreamRoute == nullptr ? "none" : mNewStreamRoute->getName().c_str()));
+             (newRoute == nullptr ? "none" : newRoute->getName().c_str()));
     result.append(buffer);
     snprintf(buffer, SIZE, "%*s- Device Types: %s\n", spaces, "",
              DeviceConverter::maskToString(mDevices, ",").c_str());
     result.append(buffer);
-    snprintf(buffer, SIZE, "%*s- Device Address: %s\n", spaces, "", mDeviceAddress.c_str());
+    snprintf(buffer, SIZE, "%*s- Device Address: %s\n", spaces, "", getDeviceAddress().c_str());
     result.append(buffer);
     snprintf(buffer, SIZE, "%*s- Stream Sample Specification: \n", spaces, "");
     result.append(buffer);
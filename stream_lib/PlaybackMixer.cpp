@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "PlaybackMixer"
+
+#include "PlaybackMixer.hpp"
+#include "AudioDevice.hpp"
+#include <AudioCommsAssert.hpp>
+#include <utilities/Log.hpp>
+#include <utils/threads.h>
+#include <cutils/sched_policy.h>
+#include <algorithm>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using audio_comms::utilities::Log;
+using audio_comms::utilities::Mutex;
+
+namespace intel_audio
+{
+
+/** Ring buffer of each input, in periods: one being mixed, one being written. */
+static const size_t gInputRingPeriods = 2;
+
+/** Range of 24 bits samples held in 32 bits containers. */
+static const int64_t gMin824 = -(1 << 23);
+static const int64_t gMax824 = (1 << 23) - 1;
+
+PlaybackMixer::PlaybackMixer()
+    : mDevice(NULL),
+      mFormat(AUDIO_FORMAT_INVALID),
+      mSamplesPerFrame(0),
+      mFrameSize(0),
+      mPeriodFrames(0),
+      mRingFrames(0),
+      mUnderrunCount(0),
+      mThreadRunning(false),
+      mThreadStopping(false),
+      mThreadStopWaiters(0),
+      mExitRequested(false),
+      mDirectWriters(0)
+{
+}
+
+PlaybackMixer::~PlaybackMixer()
+{
+    Mutex::Locker locker(mLock);
+    stopThreadUnsafe();
+    for (auto &it : mInputs) {
+        delete it.second;
+    }
+}
+
+android::status_t PlaybackMixer::reset(IAudioDevice &device, const SampleSpec &spec,
+                                       size_t periodFrames)
+{
+    Mutex::Locker locker(mLock);
+    AUDIOCOMMS_ASSERT(mInputs.empty(), "Device changed while shared");
+    mDevice = NULL;
+    audio_format_t format = spec.getFormat();
+    switch (format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+    case AUDIO_FORMAT_PCM_32_BIT:
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        break;
+    default:
+        Log::Error() << __FUNCTION__ << ": cannot mix format " << format;
+        return android::BAD_VALUE;
+    }
+    if (spec.getChannelCount() == 0 || periodFrames == 0) {
+        return android::BAD_VALUE;
+    }
+    mDevice = &device;
+    mSampleSpec = spec;
+    mFormat = format;
+    mSamplesPerFrame = spec.getChannelCount();
+    mFrameSize = spec.getFrameSize();
+    mPeriodFrames = periodFrames;
+    mRingFrames = gInputRingPeriods * periodFrames;
+    mMixBuffer.resize(mPeriodFrames * mFrameSize);
+    if (format == AUDIO_FORMAT_PCM_16_BIT) {
+        mAccumulator16.resize(mPeriodFrames * mSamplesPerFrame);
+    } else {
+        mAccumulator32.resize(mPeriodFrames * mSamplesPerFrame);
+    }
+    return android::OK;
+}
+
+android::status_t PlaybackMixer::addInput(const void *writer)
+{
+    Mutex::Locker locker(mLock);
+    // An input added while the thread is stopping would be left without mixer thread
+    waitThreadStoppedUnsafe();
+    if (mDevice == NULL) {
+        Log::Error() << __FUNCTION__ << ": no device to share";
+        return android::NO_INIT;
+    }
+    if (mInputs.find(writer) != mInputs.end()) {
+        return android::ALREADY_EXISTS;
+    }
+    Input *input = new Input;
+    input->ring.resize(mRingFrames * mFrameSize);
+    input->readPosition = 0;
+    input->writePosition = 0;
+    mInputs[writer] = input;
+    Log::Debug() << __FUNCTION__ << ": " << mInputs.size() << " input(s)";
+    if (mInputs.size() > 1) {
+        startThreadUnsafe();
+    }
+    return android::OK;
+}
+
+void PlaybackMixer::removeInput(const void *writer)
+{
+    Mutex::Locker locker(mLock);
+    waitThreadStoppedUnsafe();
+    auto it = mInputs.find(writer);
+    if (it == mInputs.end()) {
+        return;
+    }
+    // Inputs are mixed with the lock held: the thread does not use the input once erased
+    delete it->second;
+    mInputs.erase(it);
+    Log::Debug() << __FUNCTION__ << ": " << mInputs.size() << " input(s)";
+    if (mInputs.size() < 2) {
+        // The remaining input will write the device directly
+        stopThreadUnsafe();
+    }
+}
+
+void PlaybackMixer::startThreadUnsafe()
+{
+    if (mThreadRunning) {
+        return;
+    }
+    mExitRequested = false;
+    if (pthread_create(&mThread, NULL, mixerThreadLoop, this) != 0) {
+        Log::Error() << __FUNCTION__ << ": failed to create mixer thread";
+        return;
+    }
+    mThreadRunning = true;
+}
+
+void PlaybackMixer::stopThreadUnsafe()
+{
+    if (!mThreadRunning) {
+        return;
+    }
+    mExitRequested = true;
+    mThreadStopping = true;
+    mFramesAvailable.signal();
+    mDirectWriteDone.signal();
+    mLock.unlock();
+    pthread_join(mThread, NULL);
+    mLock.lock();
+    mThreadRunning = false;
+    mThreadStopping = false;
+    for (uint32_t waiter = 0; waiter < mThreadStopWaiters; waiter++) {
+        mThreadStopped.signal();
+    }
+    // Inputs waiting for room write the device directly from now on
+    for (auto &it : mInputs) {
+        it.second->roomAvailable.signal();
+    }
+}
+
+void PlaybackMixer::waitThreadStoppedUnsafe()
+{
+    while (mThreadStopping) {
+        mThreadStopWaiters++;
+        mThreadStopped.wait(mLock);
+        mThreadStopWaiters--;
+    }
+}
+
+void *PlaybackMixer::mixerThreadLoop(void *context)
+{
+    // Writes the device on behalf of the streams: same priority as the other playback threads
+    setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_AUDIO);
+    set_sched_policy(0, SP_FOREGROUND);
+    prctl(PR_SET_NAME, (unsigned long)"Playback Mixer", 0, 0, 0);
+
+    static_cast<PlaybackMixer *>(context)->mixerLoop();
+    return NULL;
+}
+
+void PlaybackMixer::mixerLoop()
+{
+    Log::Debug() << __FUNCTION__ << ": started";
+    mLock.lock();
+    while (!mExitRequested) {
+        bool hasPeriod = false;
+        for (const auto &it : mInputs) {
+            hasPeriod = hasPeriod || (getFramesReady(*it.second) >= mPeriodFrames);
+        }
+        if (!hasPeriod) {
+            mFramesAvailable.wait(mLock);
+            continue;
+        }
+        mixPeriodUnsafe();
+        for (auto &it : mInputs) {
+            it.second->roomAvailable.signal();
+        }
+        // The sole input may still be writing the device directly when the thread starts
+        while (mDirectWriters > 0 && !mExitRequested) {
+            mDirectWriteDone.wait(mLock);
+        }
+        if (mExitRequested) {
+            break;
+        }
+
+        // The device is written without lock: inputs may write while the device is consumed.
+        mLock.unlock();
+        std::string error;
+        android::status_t status = mDevice->pcmWriteFrames(mMixBuffer.data(), mPeriodFrames,
+                                                           error);
+        if (status != android::OK) {
+            Log::Error() << __FUNCTION__ << ": write error: " << error;
+            // Keeps the pace of the device not to spin on a broken device
+            usleep(mSampleSpec.convertFramesToUsec(mPeriodFrames));
+        }
+        mLock.lock();
+    }
+    mLock.unlock();
+    Log::Debug() << __FUNCTION__ << ": stopped";
+}
+
+template <typename Sample, typename Accumulator>
+void PlaybackMixer::mixInputsUnsafe(std::vector<Accumulator> &accumulator, Accumulator min,
+                                    Accumulator max)
+{
+    std::fill(accumulator.begin(), accumulator.end(), 0);
+    size_t ringSamples = mRingFrames * mSamplesPerFrame;
+    for (auto &it : mInputs) {
+        Input &input = *it.second;
+        size_t frames = std::min(getFramesReady(input), mPeriodFrames);
+        if (frames < mPeriodFrames) {
+            mUnderrunCount++;
+        }
+        const Sample *ring = reinterpret_cast<const Sample *>(input.ring.data());
+        size_t offset = (input.readPosition % mRingFrames) * mSamplesPerFrame;
+        size_t samples = frames * mSamplesPerFrame;
+        // Two contiguous chunks at most within the ring buffer
+        size_t first = std::min(samples, ringSamples - offset);
+        Accumulator *acc = accumulator.data();
+        for (size_t i = 0; i < first; i++) {
+            acc[i] += ring[offset + i];
+        }
+        for (size_t i = first; i < samples; i++) {
+            acc[i] += ring[i - first];
+        }
+        input.readPosition += frames;
+    }
+    Sample *out = reinterpret_cast<Sample *>(mMixBuffer.data());
+    for (size_t i = 0; i < accumulator.size(); i++) {
+        out[i] = static_cast<Sample>(std::min(std::max(accumulator[i], min), max));
+    }
+}
+
+void PlaybackMixer::mixPeriodUnsafe()
+{
+    switch (mFormat) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+        mixInputsUnsafe<int16_t, int32_t>(mAccumulator16, INT16_MIN, INT16_MAX);
+        break;
+    case AUDIO_FORMAT_PCM_32_BIT:
+        mixInputsUnsafe<int32_t, int64_t>(mAccumulator32, INT32_MIN, INT32_MAX);
+        break;
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        mixInputsUnsafe<int32_t, int64_t>(mAccumulator32, gMin824, gMax824);
+        break;
+    default:
+        AUDIOCOMMS_ASSERT(false, "Unsupported format");
+    }
+}
+
+android::status_t PlaybackMixer::writeDeviceUnsafe(const void *buffer, size_t frames,
+                                                   std::string &error)
+{
+    mLock.unlock();
+    android::status_t status = mDevice->pcmWriteFrames(const_cast<void *>(buffer), frames, error);
+    mLock.lock();
+    return status;
+}
+
+android::status_t PlaybackMixer::writeDirectUnsafe(Input &input, const void *buffer,
+                                                   size_t frames, std::string &error)
+{
+    mDirectWriters++;
+    android::status_t status = android::OK;
+    // Frames left by the mixer thread are written first, not to lose them.
+    while (status == android::OK && getFramesReady(input) > 0) {
+        size_t offset = input.readPosition % mRingFrames;
+        size_t chunk = std::min(getFramesReady(input), mRingFrames - offset);
+        // Consumed before the write, not to be mixed as well by a mixer thread started meanwhile
+        input.readPosition += chunk;
+        status = writeDeviceUnsafe(&input.ring[offset * mFrameSize], chunk, error);
+    }
+    if (status == android::OK) {
+        status = writeDeviceUnsafe(buffer, frames, error);
+    }
+    if (--mDirectWriters == 0) {
+        mDirectWriteDone.signal();
+    }
+    return status;
+}
+
+android::status_t PlaybackMixer::write(const void *writer, const void *buffer, size_t frames,
+                                       std::string &error)
+{
+    Mutex::Locker locker(mLock);
+    auto it = mInputs.find(writer);
+    if (it == mInputs.end()) {
+        error = "not an input of the shared device";
+        return android::BAD_VALUE;
+    }
+    Input &input = *it->second;
+    if (!mThreadRunning) {
+        return writeDirectUnsafe(input, buffer, frames, error);
+    }
+
+    const char *src = static_cast<const char *>(buffer);
+    while (frames > 0) {
+        size_t room = mRingFrames - getFramesReady(input);
+        if (room == 0) {
+            input.roomAvailable.wait(mLock);
+            if (!mThreadRunning) {
+                return writeDirectUnsafe(input, src, frames, error);
+            }
+            continue;
+        }
+        size_t offset = input.writePosition % mRingFrames;
+        size_t toCopy = std::min(std::min(frames, room), mRingFrames - offset);
+        memcpy(&input.ring[offset * mFrameSize], src, toCopy * mFrameSize);
+        src += toCopy * mFrameSize;
+        frames -= toCopy;
+        input.writePosition += toCopy;
+        mFramesAvailable.signal();
+    }
+    return android::OK;
+}
+
+void PlaybackMixer::flush(const void *writer)
+{
+    Mutex::Locker locker(mLock);
+    auto it = mInputs.find(writer);
+    if (it != mInputs.end()) {
+        it->second->readPosition = it->second->writePosition;
+        it->second->roomAvailable.signal();
+    }
+}
+
+size_t PlaybackMixer::getPendingFrames(const void *writer) const
+{
+    Mutex::Locker locker(mLock);
+    auto it = mInputs.find(writer);
+    return it == mInputs.end() ? 0 : getFramesReady(*it->second);
+}
+
+uint32_t PlaybackMixer::getUnderrunCount() const
+{
+    Mutex::Locker locker(mLock);
+    return mUnderrunCount;
+}
+
+bool PlaybackMixer::isMixing() const
+{
+    Mutex::Locker locker(mLock);
+    return mThreadRunning && !mThreadStopping;
+}
+
+} // namespace intel_audio
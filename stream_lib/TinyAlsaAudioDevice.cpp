@@ -18,8 +18,10 @@
 #include "TinyAlsaAudioDevice.hpp"
 #include <AudioUtils.hpp>
 #include <SampleSpec.hpp>
+#include <SoundCardRegistry.hpp>
 #include <AudioCommsAssert.hpp>
 #include <utilities/Log.hpp>
+#include <errno.h>
 
 using audio_comms::utilities::Log;
 using namespace std;
@@ -62,8 +64,9 @@ android::status_t TinyAlsaAudioDevice::open(const char *cardName,
     // guarantee to return a pcm structure, even when failing to open
     // it will return a reference on a "bad pcm" structure
     //
-    uint32_t flags = (isOut ? PCM_OUT : PCM_IN) | PCM_MONOTONIC;
-    int cardIndex = AudioUtils::getCardIndexByName(cardName);
+    // Playback xruns are reported rather than silently restarted by tiny alsa, to be accounted.
+    uint32_t flags = (isOut ? PCM_OUT | PCM_NORESTART : PCM_IN) | PCM_MONOTONIC;
+    int cardIndex = SoundCardRegistry::getCardIndex(cardName);
     if (cardIndex < 0) {
         return android::BAD_VALUE;
     }
@@ -88,6 +91,7 @@ android::status_t TinyAlsaAudioDevice::open(const char *cardName,
                        << "(frames), expected by AudioHAL and AudioFlinger = "
                        << config.period_count * config.period_size << " (frames)";
     }
+    mXrunMonitor.onOpen(config.rate, pcm_get_buffer_size(mPcmDevice));
     return android::OK;
 
 close_device:
@@ -108,6 +112,7 @@ android::status_t TinyAlsaAudioDevice::close()
         return android::DEAD_OBJECT;
     }
     Log::Debug() << __FUNCTION__;
+    mXrunMonitor.onClose();
     pcm_close(mPcmDevice);
     mPcmDevice = NULL;
 
@@ -122,29 +127,45 @@ android::status_t TinyAlsaAudioDevice::pcmReadFrames(void *buffer, size_t frames
         return android::BAD_VALUE;
     }
 
-    android::status_t ret;
-    ret = pcm_read(mPcmDevice, (char *)buffer, pcm_frames_to_bytes(mPcmDevice, frames));
-
+    unsigned int bytes = pcm_frames_to_bytes(mPcmDevice, frames);
+    mXrunMonitor.onTransferStart();
+    // Capture is opened without PCM_NORESTART: pcm_read recovers overruns internally and never
+    // returns EPIPE. Overruns are detected before the read instead, from the state of the device:
+    // stopped by the driver (timestamp not available), or ring buffer overflowed.
+    // An overrun occurring within the read itself is only detected by the elapsed time check.
+    unsigned int availFrames;
+    struct timespec tStamp;
+    if (pcm_get_htimestamp(mPcmDevice, &availFrames, &tStamp) < 0) {
+        mXrunMonitor.onNotRunning();
+    } else {
+        mXrunMonitor.checkAvail(availFrames);
+    }
+    int ret = pcm_read(mPcmDevice, buffer, bytes);
     if (ret < 0) {
         error = pcm_get_error(mPcmDevice);
         return ret;
     }
-
+    mXrunMonitor.onTransferDone();
     return android::OK;
 }
 
 android::status_t TinyAlsaAudioDevice::pcmWriteFrames(void *buffer, ssize_t frames,
                                                       string &error) const
 {
-    android::status_t ret;
-
-    ret = pcm_write(mPcmDevice, (char *)buffer, pcm_frames_to_bytes(mPcmDevice, frames));
-
+    unsigned int bytes = pcm_frames_to_bytes(mPcmDevice, frames);
+    mXrunMonitor.onTransferStart();
+    int ret = pcm_write(mPcmDevice, buffer, bytes);
+    if (ret == -EPIPE) {
+        // Underrun: the device is prepared by next write, which re-primes the ring buffer, the
+        // stream restarting once the start threshold is reached.
+        mXrunMonitor.onXrunError();
+        ret = pcm_write(mPcmDevice, buffer, bytes);
+    }
     if (ret < 0) {
         error = pcm_get_error(mPcmDevice);
         return ret;
     }
-
+    mXrunMonitor.onTransferDone();
     return android::OK;
 }
 
@@ -167,13 +188,22 @@ android::status_t TinyAlsaAudioDevice::getFramesAvailable(size_t &avail,
         Log::Error() << __FUNCTION__ << ": Unable to get available frames";
         return android::INVALID_OPERATION;
     }
+    mXrunMonitor.checkAvail(availFrames);
     avail = availFrames;
     return android::OK;
 }
 
 android::status_t TinyAlsaAudioDevice::pcmStop() const
 {
-    return pcm_stop(mPcmDevice);
+    mXrunMonitor.onStop();
+    // Stop the device, pending frames dropped, but keep it opened: the device is left in SETUP
+    // state by the stop, prepare it again so that next transfer restarts it.
+    int err = pcm_stop(mPcmDevice);
+    if (err < 0) {
+        Log::Error() << __FUNCTION__ << ": failed: " << pcm_get_error(mPcmDevice);
+        return err;
+    }
+    return pcm_prepare(mPcmDevice);
 }
 
 } // namespace intel_audio
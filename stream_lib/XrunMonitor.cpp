@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "XrunMonitor"
+
+#include "XrunMonitor.hpp"
+#include <utilities/Log.hpp>
+#include <time.h>
+
+using audio_comms::utilities::Log;
+
+namespace intel_audio
+{
+
+static const int64_t gNsecPerSec = 1000000000LL;
+static const int64_t gSecPerMinute = 60;
+
+XrunMonitor::XrunMonitor()
+    : mRate(0),
+      mBufferFrames(0),
+      mLastTransferNs(0),
+      mLastTransferStartNs(0),
+      mMaxTransferIntervalNs(0),
+      mXrunAccounted(false),
+      mXrunCount(0),
+      mFramesLost(0),
+      mFramesLostUnread(0),
+      mOpenedNs(0),
+      mActiveNs(0)
+{
+}
+
+int64_t XrunMonitor::getMonotonicTimeNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * gNsecPerSec + ts.tv_nsec;
+}
+
+void XrunMonitor::onOpen(uint32_t rate, size_t bufferFrames)
+{
+    mRate = rate;
+    mBufferFrames = bufferFrames;
+    mLastTransferNs = 0;
+    mLastTransferStartNs = 0;
+    mXrunAccounted = false;
+    mOpenedNs = getMonotonicTimeNs();
+}
+
+void XrunMonitor::onClose()
+{
+    int64_t openedNs = mOpenedNs.exchange(0);
+    if (openedNs != 0) {
+        mActiveNs += getMonotonicTimeNs() - openedNs;
+    }
+    mLastTransferNs = 0;
+    mLastTransferStartNs = 0;
+}
+
+void XrunMonitor::onStop()
+{
+    mLastTransferNs = 0;
+    mLastTransferStartNs = 0;
+    mXrunAccounted = false;
+}
+
+uint64_t XrunMonitor::getFramesElapsedBeyondBuffer(int64_t nowNs) const
+{
+    int64_t lastTransferNs = mLastTransferNs;
+    if (lastTransferNs == 0 || nowNs <= lastTransferNs) {
+        return 0;
+    }
+    uint64_t elapsedFrames = static_cast<uint64_t>(nowNs - lastTransferNs) * mRate / gNsecPerSec;
+    return elapsedFrames > mBufferFrames ? elapsedFrames - mBufferFrames : 0;
+}
+
+void XrunMonitor::onTransferStart()
+{
+    int64_t nowNs = getMonotonicTimeNs();
+    uint64_t framesLost = getFramesElapsedBeyondBuffer(nowNs);
+    if (framesLost != 0) {
+        recordXrun(framesLost);
+    }
+    int64_t lastTransferStartNs = mLastTransferStartNs.exchange(nowNs);
+    if (lastTransferStartNs != 0 && mLastTransferNs != 0) {
+        int64_t intervalNs = nowNs - lastTransferStartNs;
+        // Raced by consumeMaxTransferIntervalNs: an interval shall not overwrite the reset.
+        int64_t maxIntervalNs = mMaxTransferIntervalNs;
+        while (intervalNs > maxIntervalNs &&
+               !mMaxTransferIntervalNs.compare_exchange_weak(maxIntervalNs, intervalNs)) {
+        }
+    }
+}
+
+void XrunMonitor::onTransferDone()
+{
+    mLastTransferNs = getMonotonicTimeNs();
+    mXrunAccounted = false;
+}
+
+void XrunMonitor::onXrunError()
+{
+    recordXrun(getFramesElapsedBeyondBuffer(getMonotonicTimeNs()));
+}
+
+void XrunMonitor::onNotRunning()
+{
+    if (mLastTransferNs != 0) {
+        recordXrun(getFramesElapsedBeyondBuffer(getMonotonicTimeNs()));
+    }
+}
+
+void XrunMonitor::checkAvail(size_t avail)
+{
+    size_t bufferFrames = mBufferFrames;
+    if (bufferFrames != 0 && avail > bufferFrames) {
+        recordXrun(avail - bufferFrames);
+    }
+}
+
+void XrunMonitor::recordXrun(uint64_t framesLost)
+{
+    if (mXrunAccounted.exchange(true)) {
+        return;
+    }
+    mXrunCount++;
+    mFramesLost += framesLost;
+    mFramesLostUnread += framesLost;
+    Log::Warning() << __FUNCTION__ << ": xrun #" << mXrunCount << ", " << framesLost
+                   << " frames lost";
+}
+
+int64_t XrunMonitor::getActiveTimeNs() const
+{
+    int64_t activeNs = mActiveNs;
+    int64_t openedNs = mOpenedNs;
+    if (openedNs != 0) {
+        activeNs += getMonotonicTimeNs() - openedNs;
+    }
+    return activeNs;
+}
+
+uint32_t XrunMonitor::getXrunsPerMinute() const
+{
+    int64_t activeNs = getActiveTimeNs();
+    if (activeNs <= 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(mXrunCount) * gSecPerMinute * gNsecPerSec / activeNs;
+}
+
+} // namespace intel_audio
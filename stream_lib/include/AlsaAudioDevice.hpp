@@ -50,11 +50,14 @@ public:
 
     virtual android::status_t pcmStop() const;
 
+    virtual XrunMonitor &getXrunMonitor() { return mXrunMonitor; }
+
 private:
     int setPcmParams(snd_pcm_stream_t stream, const MixPortConfig &config,
                      snd_pcm_access_t access, int soft_resample);
 
     snd_pcm_t *mPcmDevice; /**< Handle on alsa PCM device. */
+    mutable XrunMonitor mXrunMonitor;
 };
 
 } // namespace intel_audio
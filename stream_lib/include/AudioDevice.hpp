@@ -15,6 +15,7 @@
  */
 #pragma once
 
+#include "XrunMonitor.hpp"
 #include <MixPortConfig.hpp>
 #include <stdint.h>
 #include <utils/Errors.h>
@@ -53,6 +54,14 @@ public:
     virtual android::status_t getFramesAvailable(size_t &avail, struct timespec &tStamp) const = 0;
 
     virtual android::status_t pcmStop() const = 0;
+
+    /**
+     * Under / over runs are detected and recovered by the device itself: the stream restarts
+     * once the start threshold is reached again.
+     *
+     * @return xrun statistics of the device, kept across openings.
+     */
+    virtual XrunMonitor &getXrunMonitor() = 0;
 };
 
 } // namespace intel_audio
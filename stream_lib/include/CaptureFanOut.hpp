@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <AudioNonCopyable.hpp>
+#include <ConditionVariable.hpp>
+#include <Mutex.hpp>
+#include <utils/Errors.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace intel_audio
+{
+
+class IAudioDevice;
+
+/**
+ * Shares a capture device between several input streams: frames are read once from the device
+ * into a ring buffer, from which each stream (aka reader) consumes at its own pace, following its
+ * own read cursor. Each stream then applies its own conversions and effects.
+ *
+ * A reader lagging behind by more than the ring buffer loses its oldest frames, accounted as
+ * frames lost for this reader only. A sole reader up to date reads the device directly, without
+ * copy.
+ *
+ * The device is read from the context of the first reader that runs out of frames, i.e. the
+ * filling reader, without the lock held: the other readers keep consuming the frames already read
+ * meanwhile, and readers may be added or removed. Readers running out of frames too wait for the
+ * filling reader.
+ */
+class CaptureFanOut : private audio_comms::utilities::NonCopyable
+{
+public:
+    CaptureFanOut();
+
+    /**
+     * Sizes the ring buffer upon opening of the shared device.
+     * Shall be called before adding any reader.
+     *
+     * @param[in] device opened.
+     * @param[in] periodFrames period size of the device, i.e. the smallest read from the device.
+     */
+    void reset(IAudioDevice &device, size_t periodFrames);
+
+    /**
+     * Adds a reader, which starts reading from the latest frames read from the device.
+     *
+     * @param[in] reader identifier, i.e. the stream.
+     *
+     * @return OK if added, error code otherwise.
+     */
+    android::status_t addReader(const void *reader);
+
+    /** @param[in] reader to remove. */
+    void removeReader(const void *reader);
+
+    /** @return number of readers sharing the device. */
+    size_t getReaderCount() const;
+
+    /**
+     * Reads frames for a reader, from the ring buffer, reading the device if needed.
+     *
+     * @param[in] reader identifier.
+     * @param[out] buffer to fill with device frames.
+     * @param[in] frames to read.
+     * @param[out] error readable error, if any.
+     *
+     * @return OK if successful, error code otherwise.
+     */
+    android::status_t read(const void *reader, void *buffer, size_t frames, std::string &error);
+
+    /**
+     * @param[in] reader identifier.
+     *
+     * @return frames lost by the reader since previous call, either lagging behind or upon
+     *         device overrun, in device frames.
+     */
+    uint64_t consumeFramesLost(const void *reader);
+
+    /**
+     * @param[in] reader identifier.
+     *
+     * @return frames already read from the device but not consumed yet by the reader.
+     */
+    size_t getPendingFrames(const void *reader) const;
+
+    /** @return number of times a reader has been lagging behind and lost frames. */
+    uint32_t getSlowReaderCount() const;
+
+private:
+    struct Reader
+    {
+        uint64_t position; /**< Read cursor, in frames read from the device. */
+        uint64_t framesLost;
+        bool isLagging; /**< Lost frames since its previous read. */
+    };
+
+    /** Pushes forward the readers whose frames would be overwritten by next frames read. */
+    void pushSlowReadersUnsafe(size_t frames);
+
+    /**
+     * Reads frames from the device as the filling reader, releasing the lock meanwhile.
+     *
+     * @param[out] buffer to fill, either the ring buffer or the buffer of a sole reader.
+     * @param[in] frames to read.
+     * @param[out] error readable error, if any.
+     *
+     * @return OK if successful, error code otherwise.
+     */
+    android::status_t fillUnsafe(void *buffer, size_t frames, std::string &error);
+
+    /** Accounts device overrun to all readers. */
+    void accountDeviceFramesLostUnsafe();
+
+    IAudioDevice *mDevice;
+    std::vector<char> mRing;
+    size_t mFrameSize;
+    size_t mCapacityFrames;
+    size_t mPeriodFrames;
+    uint64_t mWritePosition; /**< Frames read from the device since reset. */
+    bool mFilling; /**< A reader is reading the device, without lock held. */
+    uint64_t mFillEndPosition; /**< Write position once the device read succeeded. */
+    uint32_t mFillWaiters; /**< Readers waiting for the device read. */
+    audio_comms::utilities::ConditionVariable mFillDone;
+    std::map<const void *, Reader> mReaders;
+    uint32_t mSlowReaderCount;
+    mutable audio_comms::utilities::Mutex mLock;
+};
+
+} // namespace intel_audio
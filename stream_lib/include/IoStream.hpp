@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2013-2017 Intel Corporation
+ * Copyright (C) 2013-2018 Intel Corporation
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -16,8 +16,11 @@
 #pragma once
 
 #include <SampleSpec.hpp>
+#include <Mutex.hpp>
 #include <system/audio.h>
 #include <utils/RWLock.h>
+#include <atomic>
+#include <memory>
 #include <string>
 
 typedef android::RWLock::AutoRLock AutoR;
@@ -28,18 +31,26 @@ namespace intel_audio
 
 class IStreamRoute;
 class IAudioDevice;
+class CaptureFanOut;
+class PlaybackMixer;
 
 class IoStream
 {
 public:
     IoStream()
-        : mCurrentStreamRoute(NULL),
+        : mAudioDevice(NULL),
+          mCaptureFanOut(NULL),
+          mPlaybackMixer(NULL),
+          mCurrentStreamRoute(NULL),
           mNewStreamRoute(NULL),
-          mEffectsRequestedMask(0)
+          mEffectsRequestedMask(0),
+          mDeviceAddress(std::make_shared<const std::string>())
     {}
 
     /**
      * indicates if the stream has been routed (ie audio device available and the routing is done)
+     * Lock free: the routing may change right after, take the stream lock and use isRoutedL
+     * to access the audio device.
      *
      * @return true if stream is routed, false otherwise
      */
@@ -152,7 +163,7 @@ public:
      *
      * @return sample specifications.
      */
-    SampleSpec routeSampleSpec() const { return mRouteSampleSpec; }
+    const SampleSpec &routeSampleSpec() const { return mRouteSampleSpec; }
 
     /**
      * Get the stream sample specification.
@@ -160,7 +171,7 @@ public:
      *
      * @return sample specifications.
      */
-    SampleSpec streamSampleSpec() const
+    const SampleSpec &streamSampleSpec() const
     {
         return mSampleSpec;
     }
@@ -282,7 +293,8 @@ public:
     size_t getBufferSizeInFrames() const;
 
     /**
-     * Read frames from audio device.
+     * Read frames from audio device, or from the frames shared with other streams if the route
+     * fans the capture out.
      *
      * @param[in] buffer: audio samples buffer to fill from audio device.
      * @param[out] frames: number of frames to read.
@@ -293,7 +305,7 @@ public:
     android::status_t pcmReadFrames(void *buffer, size_t frames, std::string &error) const;
 
     /**
-     * Write frames to audio device.
+     * Write frames to audio device, or to the mixer of the route if shared with other streams.
      *
      * @param[in] buffer: audio samples buffer to render on audio device.
      * @param[out] frames: number of frames to render.
@@ -308,15 +320,23 @@ public:
     /**
      * Returns available frames in pcm buffer and corresponding time stamp.
      * For an input stream, frames available are frames ready for the
-     * application to read.
+     * application to read, including the frames shared with other streams not read yet.
      * For an output stream, frames available are the number of empty frames available
-     * for the application to write.
+     * for the application to write, less the frames of the stream not mixed yet.
      */
     android::status_t getFramesAvailable(size_t &avail, struct timespec &tStamp) const;
 
-    IStreamRoute *getCurrentStreamRoute() const { return mCurrentStreamRoute; }
+    /**
+     * Returns the frames lost by the audio device upon under / over runs since the last call.
+     * Must be called from locked context, with the stream routed.
+     *
+     * @return frames lost, in route frames.
+     */
+    uint64_t consumeXrunFramesLost() const;
 
-    IStreamRoute *getNewStreamRoute() const { return mNewStreamRoute; }
+    IStreamRoute *getCurrentStreamRoute() const { return mCurrentStreamRoute.load(); }
+
+    IStreamRoute *getNewStreamRoute() const { return mNewStreamRoute.load(); }
 
     /**
      * Attach the stream to its route.
@@ -347,17 +367,9 @@ public:
      * Retrieve the device(s) that has been assigned by the policy to this stream.
      * @return device(s) selected by the policy for this stream.
      */
-    audio_devices_t getDevices() const
-    {
-        AutoR lock(mStreamLock);
-        return mDevices;
-    }
+    audio_devices_t getDevices() const { return mDevices; }
 
-    std::string getDeviceAddress() const
-    {
-        AutoR lock(mStreamLock);
-        return mDeviceAddress;
-    }
+    std::string getDeviceAddress() const { return *std::atomic_load(&mDeviceAddress); }
 
     bool needReconfigure() const { return mNeedReconfigure; }
     void setNeedReconfigure();
@@ -386,7 +398,8 @@ protected:
 
     /**
      * Lock to protect not only the access to pcm device but also any access to device dependant
-     * parameters as sample specification.
+     * parameters as sample specification, i.e. held for writing upon route attachment and
+     * detachment only. The state of the stream (devices, route assigned) is accessed without it.
      */
     mutable android::RWLock mStreamLock;
 
@@ -396,6 +409,8 @@ protected:
 
 private:
     IAudioDevice *mAudioDevice; /**< Platform dependant audio device. */
+    CaptureFanOut *mCaptureFanOut; /**< Shared capture of the route, NULL if not shared. */
+    PlaybackMixer *mPlaybackMixer; /**< Mixer of the route, NULL if not shared. */
 
     void setCurrentStreamRouteL(IStreamRoute *currentStreamRoute);
 
@@ -407,20 +422,30 @@ private:
      */
     void setRouteSampleSpecL(SampleSpec sampleSpec);
 
-    IStreamRoute *mCurrentStreamRoute; /**< route assigned to the stream (routed yet). */
-    IStreamRoute *mNewStreamRoute; /**< New route assigned to the stream (not routed yet). */
+    /** route assigned to the stream (routed yet), written under stream lock. */
+    std::atomic<IStreamRoute *> mCurrentStreamRoute;
+    /** New route assigned to the stream (not routed yet). */
+    std::atomic<IStreamRoute *> mNewStreamRoute;
 
     /**
      * Sample specifications of the route assigned to the stream.
      */
     SampleSpec mRouteSampleSpec;
 
-    uint32_t mEffectsRequestedMask; /**< Mask of requested effects. */
+    std::atomic<uint32_t> mEffectsRequestedMask; /**< Mask of requested effects. */
+
+    std::atomic<audio_devices_t> mDevices{AUDIO_DEVICE_NONE}; /**< devices assgined by the policy.*/
+
+    /**
+     * Address of the devices, immutable snapshot replaced as a whole upon change, so that readers
+     * copy it without lock while the policy changes it.
+     */
+    std::shared_ptr<const std::string> mDeviceAddress;
 
-    audio_devices_t mDevices = AUDIO_DEVICE_NONE; /**< devices assgined by the policy.*/
-    std::string mDeviceAddress;
+    /** Serializes the changes of devices. */
+    audio_comms::utilities::Mutex mDevicesLock;
 
-    bool mNeedReconfigure = false;
+    std::atomic<bool> mNeedReconfigure{false};
 };
 
 } // namespace intel_audio
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <AudioNonCopyable.hpp>
+#include <ConditionVariable.hpp>
+#include <Mutex.hpp>
+#include <SampleSpec.hpp>
+#include <utils/Errors.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace intel_audio
+{
+
+class IAudioDevice;
+
+/**
+ * Shares a playback device between several output streams: each stream (aka input) writes
+ * into its own ring buffer, and a mixer thread sums, with saturation, a period of all the inputs
+ * before writing it to the device.
+ *
+ * Samples are mixed in the format of the device, i.e. after the conversions of each stream.
+ * Inputs block while their ring buffer is full, hence are paced by the device. An input running
+ * out of frames when a period is mixed is padded with silence (aka input underrun).
+ * A sole input writes the device directly, without copy nor mixer thread. The device is always
+ * written without the lock held, either by the mixer thread or by the sole input.
+ */
+class PlaybackMixer : private audio_comms::utilities::NonCopyable
+{
+public:
+    PlaybackMixer();
+    ~PlaybackMixer();
+
+    /**
+     * Configures the mixer upon opening of the shared device.
+     * Shall be called before adding any input.
+     *
+     * @param[in] device opened.
+     * @param[in] spec sample specification of the device.
+     * @param[in] periodFrames period size of the device, i.e. the frames mixed at once.
+     *
+     * @return OK if the format can be mixed, error code otherwise.
+     */
+    android::status_t reset(IAudioDevice &device, const SampleSpec &spec, size_t periodFrames);
+
+    /**
+     * Adds an input, starting the mixer thread if the device is shared.
+     *
+     * @param[in] writer identifier, i.e. the stream.
+     *
+     * @return OK if added, error code otherwise.
+     */
+    android::status_t addInput(const void *writer);
+
+    /**
+     * Removes an input, stopping the mixer thread if the device is not shared anymore.
+     * Frames not mixed yet are dropped.
+     *
+     * @param[in] writer identifier.
+     */
+    void removeInput(const void *writer);
+
+    /**
+     * Writes frames of an input, waiting for room in its ring buffer.
+     *
+     * @param[in] writer identifier.
+     * @param[in] buffer of device frames.
+     * @param[in] frames to write.
+     * @param[out] error readable error, if any.
+     *
+     * @return OK if successful, error code otherwise.
+     */
+    android::status_t write(const void *writer, const void *buffer, size_t frames,
+                            std::string &error);
+
+    /**
+     * Drops the frames of an input not mixed yet.
+     *
+     * @param[in] writer identifier.
+     */
+    void flush(const void *writer);
+
+    /**
+     * @param[in] writer identifier.
+     *
+     * @return frames written by the input but not mixed yet.
+     */
+    size_t getPendingFrames(const void *writer) const;
+
+    /** @return number of periods mixed while an input had not enough frames. */
+    uint32_t getUnderrunCount() const;
+
+    /** @return true if the inputs are mixed by the mixer thread, false if written directly. */
+    bool isMixing() const;
+
+private:
+    struct Input
+    {
+        std::vector<char> ring;
+        uint64_t readPosition;
+        uint64_t writePosition;
+        audio_comms::utilities::ConditionVariable roomAvailable;
+    };
+
+    static void *mixerThreadLoop(void *context);
+
+    /** Mixes periods of the inputs and writes them to the device until the thread is stopped. */
+    void mixerLoop();
+
+    /** Sums the available frames of the inputs, up to a period, into the mix buffer. */
+    void mixPeriodUnsafe();
+
+    /**
+     * Sums a period of the inputs, then saturates the sum into the mix buffer.
+     * Loops are kept branchless over the samples so that they are vectorized by the compiler.
+     *
+     * @tparam Sample type of the samples of the device.
+     * @tparam Accumulator type wide enough to sum the inputs without overflow.
+     * @param[in,out] accumulator of a period of samples.
+     * @param[in] min lowest valid sample value.
+     * @param[in] max highest valid sample value.
+     */
+    template <typename Sample, typename Accumulator>
+    void mixInputsUnsafe(std::vector<Accumulator> &accumulator, Accumulator min,
+                         Accumulator max);
+
+    void startThreadUnsafe();
+
+    /** Stops the mixer thread, releasing the lock while joining it. */
+    void stopThreadUnsafe();
+
+    /** Waits for the mixer thread being stopped by another caller, if any. */
+    void waitThreadStoppedUnsafe();
+
+    /** Writes the device, releasing the lock meanwhile. */
+    android::status_t writeDeviceUnsafe(const void *buffer, size_t frames, std::string &error);
+
+    /** Writes the frames of the sole input not mixed yet, then writes it directly. */
+    android::status_t writeDirectUnsafe(Input &input, const void *buffer, size_t frames,
+                                        std::string &error);
+
+    /** @return frames of an input that may be read. */
+    static size_t getFramesReady(const Input &input)
+    {
+        return input.writePosition - input.readPosition;
+    }
+
+    IAudioDevice *mDevice;
+    SampleSpec mSampleSpec;
+    audio_format_t mFormat;
+    size_t mSamplesPerFrame;
+    size_t mFrameSize;
+    size_t mPeriodFrames;
+    size_t mRingFrames;
+    std::vector<char> mMixBuffer; /**< Period mixed, in device format. */
+    std::vector<int32_t> mAccumulator16; /**< Period summed, for 16 bits samples. */
+    std::vector<int64_t> mAccumulator32; /**< Period summed, for 32 bits samples. */
+
+    std::map<const void *, Input *> mInputs;
+    uint32_t mUnderrunCount;
+
+    pthread_t mThread;
+    bool mThreadRunning;
+    bool mThreadStopping; /**< Thread being joined, without lock held. */
+    uint32_t mThreadStopWaiters;
+    audio_comms::utilities::ConditionVariable mThreadStopped;
+    bool mExitRequested;
+    uint32_t mDirectWriters; /**< Inputs writing the device, without lock held. */
+    audio_comms::utilities::ConditionVariable mDirectWriteDone;
+    audio_comms::utilities::ConditionVariable mFramesAvailable;
+    mutable audio_comms::utilities::Mutex mLock;
+};
+
+} // namespace intel_audio
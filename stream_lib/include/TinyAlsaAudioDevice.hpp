@@ -48,8 +48,11 @@ public:
 
     virtual android::status_t pcmStop() const;
 
+    virtual XrunMonitor &getXrunMonitor() { return mXrunMonitor; }
+
 private:
     pcm *mPcmDevice; /**< Handle on tiny alsa PCM device. */
+    mutable XrunMonitor mXrunMonitor;
 };
 
 } // namespace intel_audio
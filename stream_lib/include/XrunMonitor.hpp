@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <AudioNonCopyable.hpp>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace intel_audio
+{
+
+/**
+ * Detects and accounts the under / over runs of an audio device.
+ *
+ * An xrun is detected either from:
+ *  - the transfer returning EPIPE,
+ *  - the device not running any more whereas previous transfer succeeded,
+ *  - the time elapsed since previous transfer, longer than the ring buffer duration,
+ *  - the available frames, larger than the ring buffer (hw pointer overtook appl pointer).
+ * An xrun is accounted once whatever the number of ways it is detected, until the device is
+ * running again, i.e. a transfer succeeded.
+ *
+ * Statistics are kept across openings of the device, so that the rate reflects the whole life of
+ * the route. Transfers are notified from the stream thread, whereas the available frames may be
+ * checked from other threads, hence atomic counters.
+ */
+class XrunMonitor : private audio_comms::utilities::NonCopyable
+{
+public:
+    XrunMonitor();
+
+    /**
+     * Starts monitoring upon device opening.
+     *
+     * @param[in] rate of the device.
+     * @param[in] bufferFrames size of the ring buffer in frames.
+     */
+    void onOpen(uint32_t rate, size_t bufferFrames);
+
+    /** Stops monitoring upon device closing. */
+    void onClose();
+
+    /** The device has been stopped: next transfer restarts it, not an xrun. */
+    void onStop();
+
+    /** To be called before each transfer: detects xrun from the time elapsed since previous one. */
+    void onTransferStart();
+
+    /** To be called after each successful transfer. */
+    void onTransferDone();
+
+    /** To be called when a transfer returned EPIPE, before recovering. */
+    void onXrunError();
+
+    /**
+     * To be called when the device reports it is not running before a transfer, for devices
+     * recovering xruns by themselves: an xrun if the device was running since previous transfer.
+     */
+    void onNotRunning();
+
+    /**
+     * Detects xrun from the available frames reported by the device.
+     *
+     * @param[in] avail frames available for the application.
+     */
+    void checkAvail(size_t avail);
+
+    /** @return number of xruns since first opening. */
+    uint32_t getXrunCount() const { return mXrunCount; }
+
+    /** @return number of frames lost since first opening, in device frames. */
+    uint64_t getFramesLost() const { return mFramesLost; }
+
+    /** @return number of frames lost since previous call, in device frames. */
+    uint64_t consumeFramesLost() { return mFramesLostUnread.exchange(0); }
+
+    /** @return number of xruns per minute, over the time the device has been opened. */
+    uint32_t getXrunsPerMinute() const;
+
+    /** @return cumulated time the device has been opened, in nanoseconds. */
+    int64_t getActiveTimeNs() const;
+
+    /**
+     * Interval between the start of consecutive transfers while running, i.e. the jitter of the
+     * stream thread: the larger, the closer the device has been to an xrun.
+     *
+     * @return largest interval since previous call, in nanoseconds.
+     */
+    int64_t consumeMaxTransferIntervalNs() { return mMaxTransferIntervalNs.exchange(0); }
+
+private:
+    /** Accounts an xrun, unless already accounted since device is stalled. */
+    void recordXrun(uint64_t framesLost);
+
+    /** @return frames elapsed beyond the ring buffer since previous transfer, 0 if none. */
+    uint64_t getFramesElapsedBeyondBuffer(int64_t nowNs) const;
+
+    static int64_t getMonotonicTimeNs();
+
+    std::atomic<uint32_t> mRate;
+    std::atomic<size_t> mBufferFrames;
+
+    /** End of previous transfer, 0 if device not running. */
+    std::atomic<int64_t> mLastTransferNs;
+    /** Start of previous transfer, 0 if device not running. */
+    std::atomic<int64_t> mLastTransferStartNs;
+    std::atomic<int64_t> mMaxTransferIntervalNs;
+    /** Set once an xrun is accounted, until device is running again. */
+    std::atomic<bool> mXrunAccounted;
+
+    std::atomic<uint32_t> mXrunCount;
+    std::atomic<uint64_t> mFramesLost;
+    std::atomic<uint64_t> mFramesLostUnread;
+
+    /** Opening time of the device, 0 if closed. */
+    std::atomic<int64_t> mOpenedNs;
+    /** Cumulated duration of previous openings. */
+    std::atomic<int64_t> mActiveNs;
+};
+
+} // namespace intel_audio
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CaptureFanOut.hpp>
+#include <AudioDevice.hpp>
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace intel_audio
+{
+
+static const size_t gBufferFrames = 480;
+static const size_t gPeriodFrames = 240;
+/** Ring buffer of the fan out, i.e. 2 device ring buffers. */
+static const size_t gCapacityFrames = 2 * gBufferFrames;
+
+/**
+ * Fake capture device producing frames holding their sequence number. Reads may be held, to
+ * check what the other readers can do while a reader is blocked on the device.
+ */
+class FakeCaptureDevice : public IAudioDevice
+{
+public:
+    FakeCaptureDevice() : mSequence(0), mReads(0), mIsHeld(false), mIsReading(false) {}
+
+    virtual android::status_t open(const char *, uint32_t, const MixPortConfig &, bool)
+    {
+        return android::OK;
+    }
+    virtual android::status_t close() { return android::OK; }
+    virtual bool isOpened() { return true; }
+
+    virtual android::status_t pcmReadFrames(void *buffer, size_t frames, std::string &) const
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mIsReading = true;
+        mCond.notify_all();
+        mCond.wait(lock, [this] { return !mIsHeld; });
+        uint32_t *samples = static_cast<uint32_t *>(buffer);
+        for (size_t frame = 0; frame < frames; frame++) {
+            samples[frame] = mSequence++;
+        }
+        mReads++;
+        mIsReading = false;
+        return android::OK;
+    }
+
+    virtual android::status_t pcmWriteFrames(void *, ssize_t, std::string &) const
+    {
+        return android::INVALID_OPERATION;
+    }
+    virtual uint32_t getBufferSizeInBytes() const { return gBufferFrames * sizeof(uint32_t); }
+    virtual size_t getBufferSizeInFrames() const { return gBufferFrames; }
+    virtual android::status_t getFramesAvailable(size_t &, struct timespec &) const
+    {
+        return android::INVALID_OPERATION;
+    }
+    virtual android::status_t pcmStop() const { return android::OK; }
+    virtual XrunMonitor &getXrunMonitor() { return mXrunMonitor; }
+
+    /** Holds next reads until released. */
+    void hold()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mIsHeld = true;
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mIsHeld = false;
+        mCond.notify_all();
+    }
+
+    void waitForReading()
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCond.wait(lock, [this] { return mIsReading; });
+    }
+
+    uint32_t getReads() const
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        return mReads;
+    }
+
+    /** Simulates an overrun of the device, accounted by its xrun monitor. */
+    void overrun(size_t framesLost)
+    {
+        mXrunMonitor.onOpen(48000, gBufferFrames);
+        mXrunMonitor.checkAvail(gBufferFrames + framesLost);
+    }
+
+private:
+    mutable std::mutex mLock;
+    mutable std::condition_variable mCond;
+    mutable uint32_t mSequence;
+    mutable uint32_t mReads;
+    bool mIsHeld;
+    mutable bool mIsReading;
+    XrunMonitor mXrunMonitor;
+};
+
+class CaptureFanOutTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp() { mFanOut.reset(mDevice, gPeriodFrames); }
+
+    /** Reads frames for a reader, checking they follow the given sequence number. */
+    void readAndCheck(const void *reader, size_t frames, uint32_t firstSequence)
+    {
+        std::vector<uint32_t> buffer(frames);
+        std::string error;
+        ASSERT_EQ(android::OK, mFanOut.read(reader, buffer.data(), frames, error));
+        for (size_t frame = 0; frame < frames; frame++) {
+            ASSERT_EQ(firstSequence + frame, buffer[frame]) << "frame " << frame;
+        }
+    }
+
+    FakeCaptureDevice mDevice;
+    CaptureFanOut mFanOut;
+    const int mFirst = 0;
+    const int mSecond = 0;
+};
+
+TEST_F(CaptureFanOutTest, soleReader)
+{
+    ASSERT_EQ(android::OK, mFanOut.addReader(&mFirst));
+    EXPECT_EQ(android::ALREADY_EXISTS, mFanOut.addReader(&mFirst));
+    EXPECT_EQ(1u, mFanOut.getReaderCount());
+
+    readAndCheck(&mFirst, 100, 0);
+    readAndCheck(&mFirst, 1000, 100);
+    EXPECT_EQ(0u, mFanOut.getPendingFrames(&mFirst));
+    // Read directly, as requested
+    EXPECT_EQ(2u, mDevice.getReads());
+}
+
+TEST_F(CaptureFanOutTest, readersShareFrames)
+{
+    ASSERT_EQ(android::OK, mFanOut.addReader(&mFirst));
+    ASSERT_EQ(android::OK, mFanOut.addReader(&mSecond));
+
+    // Frames read once from the device, at least a period at a time
+    readAndCheck(&mFirst, 100, 0);
+    EXPECT_EQ(gPeriodFrames, mFanOut.getPendingFrames(&mSecond));
+    readAndCheck(&mSecond, 60, 0);
+    readAndCheck(&mSecond, 60, 60);
+    EXPECT_EQ(gPeriodFrames - 100, mFanOut.getPendingFrames(&mFirst));
+    readAndCheck(&mFirst, 20, 100);
+    EXPECT_EQ(1u, mDevice.getReads());
+    EXPECT_EQ(0u, mFanOut.consumeFramesLost(&mFirst));
+    EXPECT_EQ(0u, mFanOut.consumeFramesLost(&mSecond));
+    EXPECT_EQ(0u, mFanOut.getSlowReaderCount());
+
+    // A new reader starts from the latest frames
+    const int third = 0;
+    ASSERT_EQ(android::OK, mFanOut.addReader(&third));
+    EXPECT_EQ(0u, mFanOut.getPendingFrames(&third));
+    readAndCheck(&third, 10, gPeriodFrames);
+    mFanOut.removeReader(&third);
+    EXPECT_EQ(2u, mFanOut.getReaderCount());
+
+    std::string error;
+    uint32_t frame;
+    EXPECT_EQ(android::BAD_VALUE, mFanOut.read(&third, &frame, 1, error));
+}
+
+TEST_F(CaptureFanOutTest, slowReaderLosesOldestFrames)
+{
+    ASSERT_EQ(android::OK, mFanOut.addReader(&mFirst));
+    ASSERT_EQ(android::OK, mFanOut.addReader(&mSecond));
+
+    // First reader runs ahead by more than the ring buffer
+    static const size_t ahead = gCapacityFrames + gPeriodFrames;
+    for (size_t read = 0; read < ahead; read += gPeriodFrames) {
+        readAndCheck(&mFirst, gPeriodFrames, read);
+    }
+    EXPECT_EQ(gCapacityFrames, mFanOut.getPendingFrames(&mSecond));
+    EXPECT_EQ(1u, mFanOut.getSlowReaderCount());
+    EXPECT_EQ(gPeriodFrames, mFanOut.consumeFramesLost(&mSecond));
+    EXPECT_EQ(0u, mFanOut.consumeFramesLost(&mSecond));
+    EXPECT_EQ(0u, mFanOut.consumeFramesLost(&mFirst));
+
+    // The slow reader resumes from the oldest frames kept
+    readAndCheck(&mSecond, gCapacityFrames, gPeriodFrames);
+    EXPECT_EQ(1u, mFanOut.getSlowReaderCount());
+}
+
+TEST_F(CaptureFanOutTest, deviceOverrunAccountedToAllReaders)
+{
+    ASSERT_EQ(android::OK, mFanOut.addReader(&mFirst));
+    ASSERT_EQ(android::OK, mFanOut.addReader(&mSecond));
+
+    mDevice.overrun(30);
+    readAndCheck(&mFirst, 10, 0);
+    EXPECT_EQ(30u, mFanOut.consumeFramesLost(&mFirst));
+    EXPECT_EQ(30u, mFanOut.consumeFramesLost(&mSecond));
+    EXPECT_EQ(0u, mFanOut.consumeFramesLost(&mFirst));
+}
+
+TEST_F(CaptureFanOutTest, lockReleasedWhileReadingDevice)
+{
+    ASSERT_EQ(android::OK, mFanOut.addReader(&mFirst));
+    ASSERT_EQ(android::OK, mFanOut.addReader(&mSecond));
+    readAndCheck(&mFirst, gPeriodFrames, 0);
+
+    // First reader blocked in the device read
+    mDevice.hold();
+    std::thread firstReader([this] { readAndCheck(&mFirst, gPeriodFrames, gPeriodFrames); });
+    mDevice.waitForReading();
+
+    // Meanwhile, frames already read are served, and readers may change
+    readAndCheck(&mSecond, gPeriodFrames, 0);
+    const int third = 0;
+    ASSERT_EQ(android::OK, mFanOut.addReader(&third));
+    mFanOut.removeReader(&third);
+
+    // Second reader runs out of frames: it waits for the frames being read
+    std::thread secondReader([this] { readAndCheck(&mSecond, gPeriodFrames, gPeriodFrames); });
+    mDevice.release();
+    firstReader.join();
+    secondReader.join();
+    EXPECT_EQ(2u, mDevice.getReads());
+}
+
+TEST_F(CaptureFanOutTest, readerAddedWhileReadingDevice)
+{
+    ASSERT_EQ(android::OK, mFanOut.addReader(&mFirst));
+
+    // Sole reader reading the device directly into its own buffer
+    mDevice.hold();
+    std::thread firstReader([this] { readAndCheck(&mFirst, gPeriodFrames, 0); });
+    mDevice.waitForReading();
+
+    // Frames being read are not kept for a new reader, which starts after them
+    ASSERT_EQ(android::OK, mFanOut.addReader(&mSecond));
+    mDevice.release();
+    firstReader.join();
+    EXPECT_EQ(0u, mFanOut.getPendingFrames(&mSecond));
+    readAndCheck(&mSecond, 10, gPeriodFrames);
+}
+
+} // namespace intel_audio
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <PlaybackMixer.hpp>
+#include <AudioDevice.hpp>
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace intel_audio
+{
+
+static const uint32_t gChannels = 2;
+static const size_t gPeriodFrames = 4;
+static const size_t gPeriodSamples = gPeriodFrames * gChannels;
+
+/**
+ * Fake playback device keeping the samples written. Writes may be held, to control when the
+ * mixer thread mixes its next period.
+ */
+class FakePlaybackDevice : public IAudioDevice
+{
+public:
+    FakePlaybackDevice() : mWrites(0), mIsHeld(false), mIsWriting(false) {}
+
+    virtual android::status_t open(const char *, uint32_t, const MixPortConfig &, bool)
+    {
+        return android::OK;
+    }
+    virtual android::status_t close() { return android::OK; }
+    virtual bool isOpened() { return true; }
+
+    virtual android::status_t pcmReadFrames(void *, size_t, std::string &) const
+    {
+        return android::INVALID_OPERATION;
+    }
+
+    virtual android::status_t pcmWriteFrames(void *buffer, ssize_t frames, std::string &) const
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mIsWriting = true;
+        mCond.notify_all();
+        mCond.wait(lock, [this] { return !mIsHeld; });
+        const int16_t *samples = static_cast<const int16_t *>(buffer);
+        mSamples.insert(mSamples.end(), samples, samples + frames * gChannels);
+        mWrites++;
+        mIsWriting = false;
+        mCond.notify_all();
+        return android::OK;
+    }
+
+    virtual uint32_t getBufferSizeInBytes() const { return 0; }
+    virtual size_t getBufferSizeInFrames() const { return 0; }
+    virtual android::status_t getFramesAvailable(size_t &, struct timespec &) const
+    {
+        return android::INVALID_OPERATION;
+    }
+    virtual android::status_t pcmStop() const { return android::OK; }
+    virtual XrunMonitor &getXrunMonitor() { return mXrunMonitor; }
+
+    /** Holds next writes until released. */
+    void hold()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mIsHeld = true;
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mIsHeld = false;
+        mCond.notify_all();
+    }
+
+    void waitForWriting()
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCond.wait(lock, [this] { return mIsWriting; });
+    }
+
+    /** Waits for a number of writes, then returns the samples written so far. */
+    std::vector<int16_t> waitForWrites(uint32_t writes)
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCond.wait(lock, [this, writes] { return mWrites >= writes; });
+        return mSamples;
+    }
+
+private:
+    mutable std::mutex mLock;
+    mutable std::condition_variable mCond;
+    mutable std::vector<int16_t> mSamples;
+    mutable uint32_t mWrites;
+    bool mIsHeld;
+    mutable bool mIsWriting;
+    XrunMonitor mXrunMonitor;
+};
+
+class PlaybackMixerTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        ASSERT_EQ(android::OK,
+                  mMixer.reset(mDevice, SampleSpec(gChannels, AUDIO_FORMAT_PCM_16_BIT, 48000),
+                               gPeriodFrames));
+    }
+
+    /** Writes frames of an input, all of its samples holding the same value. */
+    void write(const void *writer, size_t frames, int16_t value)
+    {
+        std::vector<int16_t> buffer(frames * gChannels, value);
+        std::string error;
+        ASSERT_EQ(android::OK, mMixer.write(writer, buffer.data(), frames, error));
+    }
+
+    /**
+     * Blocks the mixer thread in the write of a first period of silence, so that the next
+     * period mixes all the frames written meanwhile.
+     */
+    void blockMixerThread()
+    {
+        mDevice.hold();
+        write(&mFirst, gPeriodFrames, 0);
+        mDevice.waitForWriting();
+    }
+
+    FakePlaybackDevice mDevice;
+    PlaybackMixer mMixer;
+    const int mFirst = 0;
+    const int mSecond = 0;
+};
+
+TEST_F(PlaybackMixerTest, inputsSummedWithClipping)
+{
+    ASSERT_EQ(android::OK, mMixer.addInput(&mFirst));
+    EXPECT_FALSE(mMixer.isMixing());
+    ASSERT_EQ(android::OK, mMixer.addInput(&mSecond));
+    EXPECT_EQ(android::ALREADY_EXISTS, mMixer.addInput(&mSecond));
+    EXPECT_TRUE(mMixer.isMixing());
+
+    blockMixerThread();
+    write(&mFirst, 1, 100);
+    write(&mFirst, 1, 20000);
+    write(&mFirst, 1, -20000);
+    write(&mFirst, 1, INT16_MAX);
+    write(&mSecond, 1, -50);
+    write(&mSecond, 1, 20000);
+    write(&mSecond, 1, -20000);
+    write(&mSecond, 1, INT16_MAX);
+    mDevice.release();
+
+    std::vector<int16_t> samples = mDevice.waitForWrites(2);
+    ASSERT_EQ(2 * gPeriodSamples, samples.size());
+    const int16_t expected[] = { 50, INT16_MAX, INT16_MIN, INT16_MAX };
+    for (size_t frame = 0; frame < gPeriodFrames; frame++) {
+        for (size_t channel = 0; channel < gChannels; channel++) {
+            EXPECT_EQ(expected[frame], samples[gPeriodSamples + frame * gChannels + channel])
+                << "frame " << frame;
+        }
+    }
+}
+
+TEST_F(PlaybackMixerTest, slowInputPaddedWithSilence)
+{
+    ASSERT_EQ(android::OK, mMixer.addInput(&mFirst));
+    ASSERT_EQ(android::OK, mMixer.addInput(&mSecond));
+
+    // Second input had no frames for the first period
+    blockMixerThread();
+    write(&mFirst, gPeriodFrames, 1000);
+    write(&mSecond, gPeriodFrames / 2, 500);
+    EXPECT_EQ(gPeriodFrames / 2, mMixer.getPendingFrames(&mSecond));
+    mDevice.release();
+
+    std::vector<int16_t> samples = mDevice.waitForWrites(2);
+    ASSERT_EQ(2 * gPeriodSamples, samples.size());
+    for (size_t sample = 0; sample < gPeriodSamples; sample++) {
+        EXPECT_EQ(sample < gPeriodSamples / 2 ? 1500 : 1000, samples[gPeriodSamples + sample])
+            << "sample " << sample;
+    }
+    EXPECT_EQ(2u, mMixer.getUnderrunCount());
+    EXPECT_EQ(0u, mMixer.getPendingFrames(&mSecond));
+}
+
+TEST_F(PlaybackMixerTest, inputRemovedWhileMixing)
+{
+    ASSERT_EQ(android::OK, mMixer.addInput(&mFirst));
+    ASSERT_EQ(android::OK, mMixer.addInput(&mSecond));
+
+    // Removal waits for the mixer thread blocked in the device
+    blockMixerThread();
+    std::thread remover([this] { mMixer.removeInput(&mSecond); });
+
+    // Whether added before, during or after the mixer thread is stopped, a new input is mixed
+    const int third = 0;
+    std::thread adder([this, &third] { EXPECT_EQ(android::OK, mMixer.addInput(&third)); });
+    mDevice.release();
+    remover.join();
+    adder.join();
+    EXPECT_TRUE(mMixer.isMixing());
+
+    // Sole input left writes the device directly
+    mMixer.removeInput(&third);
+    EXPECT_FALSE(mMixer.isMixing());
+    write(&mFirst, gPeriodFrames, 42);
+    EXPECT_EQ(0u, mMixer.getPendingFrames(&mFirst));
+    std::vector<int16_t> samples = mDevice.waitForWrites(2);
+    ASSERT_EQ(2 * gPeriodSamples, samples.size());
+    EXPECT_EQ(42, samples.back());
+
+    std::string error;
+    EXPECT_EQ(android::BAD_VALUE, mMixer.write(&third, samples.data(), 1, error));
+}
+
+TEST_F(PlaybackMixerTest, directWriteWithoutLock)
+{
+    ASSERT_EQ(android::OK, mMixer.addInput(&mFirst));
+
+    // Sole input blocked in the device
+    mDevice.hold();
+    std::thread writer([this] { write(&mFirst, gPeriodFrames, 7); });
+    mDevice.waitForWriting();
+
+    // Meanwhile, the mixer is available, and starts mixing once the direct write is done
+    EXPECT_EQ(0u, mMixer.getPendingFrames(&mFirst));
+    ASSERT_EQ(android::OK, mMixer.addInput(&mSecond));
+    EXPECT_TRUE(mMixer.isMixing());
+    write(&mSecond, gPeriodFrames, 3);
+    mDevice.release();
+    writer.join();
+
+    std::vector<int16_t> samples = mDevice.waitForWrites(2);
+    ASSERT_EQ(2 * gPeriodSamples, samples.size());
+    EXPECT_EQ(7, samples.front());
+    EXPECT_EQ(3, samples.back());
+}
+
+} // namespace intel_audio
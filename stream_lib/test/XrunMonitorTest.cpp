@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2018 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <XrunMonitor.hpp>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+namespace intel_audio
+{
+
+static const uint32_t gRate = 48000;
+static const size_t gBufferFrames = 960;
+
+TEST(XrunMonitor, availBeyondBuffer)
+{
+    XrunMonitor monitor;
+    monitor.onOpen(gRate, gBufferFrames);
+
+    monitor.checkAvail(gBufferFrames);
+    EXPECT_EQ(0u, monitor.getXrunCount());
+
+    monitor.checkAvail(gBufferFrames + 100);
+    EXPECT_EQ(1u, monitor.getXrunCount());
+    EXPECT_EQ(100u, monitor.getFramesLost());
+
+    // Same xrun, until the device runs again
+    monitor.checkAvail(gBufferFrames + 200);
+    monitor.onXrunError();
+    EXPECT_EQ(1u, monitor.getXrunCount());
+
+    monitor.onTransferStart();
+    monitor.onTransferDone();
+    monitor.checkAvail(gBufferFrames + 50);
+    EXPECT_EQ(2u, monitor.getXrunCount());
+    EXPECT_EQ(150u, monitor.getFramesLost());
+    EXPECT_EQ(150u, monitor.consumeFramesLost());
+    EXPECT_EQ(0u, monitor.consumeFramesLost());
+}
+
+TEST(XrunMonitor, notRunning)
+{
+    XrunMonitor monitor;
+    monitor.onOpen(gRate, gBufferFrames);
+
+    // Device not started yet
+    monitor.onNotRunning();
+    EXPECT_EQ(0u, monitor.getXrunCount());
+
+    // Device stopped by the driver after a successful transfer
+    monitor.onTransferStart();
+    monitor.onTransferDone();
+    monitor.onNotRunning();
+    EXPECT_EQ(1u, monitor.getXrunCount());
+
+    // Device stopped on purpose: next transfer restarts it
+    monitor.onTransferStart();
+    monitor.onTransferDone();
+    monitor.onStop();
+    monitor.onNotRunning();
+    EXPECT_EQ(1u, monitor.getXrunCount());
+}
+
+TEST(XrunMonitor, transferLate)
+{
+    XrunMonitor monitor;
+    // Ring buffer of a single frame: any delay between transfers overflows it
+    monitor.onOpen(gRate, 1);
+
+    monitor.onTransferStart();
+    monitor.onTransferDone();
+    usleep(2000);
+    monitor.onTransferStart();
+    EXPECT_EQ(1u, monitor.getXrunCount());
+    // At least 2 ms elapsed, i.e. 96 frames, less the ring buffer
+    EXPECT_GE(monitor.getFramesLost(), 95u);
+    EXPECT_GE(monitor.consumeMaxTransferIntervalNs(), 2000000);
+    EXPECT_EQ(0, monitor.consumeMaxTransferIntervalNs());
+    monitor.onTransferDone();
+
+    // Statistics kept across openings
+    monitor.onClose();
+    monitor.onOpen(gRate, gBufferFrames);
+    EXPECT_EQ(1u, monitor.getXrunCount());
+    EXPECT_GT(monitor.getActiveTimeNs(), 0);
+}
+
+} // namespace intel_audio